@@ -21,4 +21,15 @@
 #define DONT_COMPILE_TESTS
 #endif
 
+// Compiles a function for an instruction set extension, e.g. TARGET_ISA("avx2"). MSVC needs no attribute for intrinsics.
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_ISA(isa) __attribute__((target(isa)))
+#else
+#define TARGET_ISA(isa)
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ARCH_X64
+#endif
+
 #endif
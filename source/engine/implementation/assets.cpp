@@ -0,0 +1,294 @@
+module;
+#include "sdl-wrapper.hpp"
+#include "common-defines.hpp"
+module assets;
+
+import config;
+import singleton;
+import logger;
+import assert;
+
+namespace tektonik::assets
+{
+
+struct ImageEntry
+{
+    InternedString path{};
+    std::atomic<AssetState> state{AssetState::Loading};
+    // Written by the loader before it publishes the state.
+    Image image{};
+    std::string error{};
+    // Guarded by the manager's mutex.
+    std::list<InternedString>::iterator recentPosition{};
+};
+
+Image DecodeBmp(std::string_view path)
+{
+    SDL_Surface* const loaded = SDL_LoadBMP(std::string(path).c_str());
+    if (loaded == nullptr)
+        throw std::runtime_error(std::format("SDL could not load the BMP: {}", SDL_GetError()));
+    SDL_Surface* const converted = SDL_ConvertSurface(loaded, SDL_PIXELFORMAT_RGBA32);
+    SDL_DestroySurface(loaded);
+    if (converted == nullptr)
+        throw std::runtime_error(std::format("SDL could not convert the BMP to RGBA: {}", SDL_GetError()));
+
+    Image image{.width = static_cast<std::uint32_t>(converted->w), .height = static_cast<std::uint32_t>(converted->h)};
+    const std::size_t rowSize = std::size_t{image.width} * 4;
+    image.pixels.resize(rowSize * image.height);
+    const std::byte* const source = static_cast<const std::byte*>(converted->pixels);
+    for (std::size_t y = 0; y < image.height; ++y)
+        std::memcpy(image.pixels.data() + y * rowSize, source + y * static_cast<std::size_t>(converted->pitch), rowSize);
+    SDL_DestroySurface(converted);
+    return image;
+}
+
+const Image& GetPlaceholder()
+{
+    static const Image placeholder{.width = 1, .height = 1, .pixels = {std::byte{255}, std::byte{0}, std::byte{255}, std::byte{255}}};
+    return placeholder;
+}
+
+// PNG chunks are checksummed with CRC-32, see the PNG specification, annex D.
+constexpr std::array<std::uint32_t, 256> kCrcTable = []
+{
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t n = 0; n < table.size(); ++n)
+    {
+        std::uint32_t c = n;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table[n] = c;
+    }
+    return table;
+}();
+
+std::uint32_t Crc32(std::span<const std::byte> bytes)
+{
+    std::uint32_t c = 0xFFFFFFFFu;
+    for (const std::byte byte : bytes)
+        c = kCrcTable[(c ^ std::to_integer<std::uint32_t>(byte)) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+void AppendBigEndian(std::vector<std::byte>& output, std::uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+        output.push_back(static_cast<std::byte>(value >> shift));
+}
+
+void AppendChunk(std::vector<std::byte>& output, std::string_view type, std::span<const std::byte> data)
+{
+    ASSUMERT(type.size() == 4);
+    AppendBigEndian(output, static_cast<std::uint32_t>(data.size()));
+    const std::size_t typeOffset = output.size();
+    for (const char c : type)
+        output.push_back(static_cast<std::byte>(c));
+    output.insert(output.end(), data.begin(), data.end());
+    AppendBigEndian(output, Crc32(std::span(output).subspan(typeOffset)));
+}
+
+std::vector<std::byte> EncodePng(const Image& image)
+{
+    const std::size_t rowSize = std::size_t{image.width} * 4;
+    ASSUMERT(image.pixels.size() == rowSize * image.height);
+
+    // Every row starts with filter type 0, none.
+    std::vector<std::byte> scanlines{};
+    scanlines.reserve((rowSize + 1) * image.height);
+    for (std::size_t y = 0; y < image.height; ++y)
+    {
+        scanlines.push_back(std::byte{0});
+        const auto row = image.pixels.begin() + static_cast<std::ptrdiff_t>(y * rowSize);
+        scanlines.insert(scanlines.end(), row, row + static_cast<std::ptrdiff_t>(rowSize));
+    }
+
+    // A zlib stream of stored deflate blocks, which hold at most 65535 bytes each.
+    constexpr std::size_t kMaxStoredBlock = 65535;
+    std::vector<std::byte> zlib{std::byte{0x78}, std::byte{0x01}};
+    std::size_t offset = 0;
+    do
+    {
+        const std::size_t size = std::min(kMaxStoredBlock, scanlines.size() - offset);
+        const bool last = offset + size == scanlines.size();
+        zlib.push_back(static_cast<std::byte>(last));
+        zlib.push_back(static_cast<std::byte>(size & 0xFF));
+        zlib.push_back(static_cast<std::byte>(size >> 8));
+        zlib.push_back(static_cast<std::byte>(~size & 0xFF));
+        zlib.push_back(static_cast<std::byte>((~size >> 8) & 0xFF));
+        zlib.insert(zlib.end(), scanlines.begin() + static_cast<std::ptrdiff_t>(offset), scanlines.begin() + static_cast<std::ptrdiff_t>(offset + size));
+        offset += size;
+    } while (offset < scanlines.size());
+
+    std::uint32_t adlerA = 1;
+    std::uint32_t adlerB = 0;
+    for (const std::byte byte : scanlines)
+    {
+        adlerA = (adlerA + std::to_integer<std::uint32_t>(byte)) % 65521;
+        adlerB = (adlerB + adlerA) % 65521;
+    }
+    AppendBigEndian(zlib, (adlerB << 16) | adlerA);
+
+    std::vector<std::byte> header{};
+    AppendBigEndian(header, image.width);
+    AppendBigEndian(header, image.height);
+    // 8 bits per channel, RGBA, deflate, adaptive filtering, no interlacing.
+    header.insert(header.end(), {std::byte{8}, std::byte{6}, std::byte{0}, std::byte{0}, std::byte{0}});
+
+    std::vector<std::byte> png{std::byte{0x89}, std::byte{'P'}, std::byte{'N'}, std::byte{'G'}, std::byte{'\r'}, std::byte{'\n'}, std::byte{0x1A}, std::byte{'\n'}};
+    AppendChunk(png, "IHDR", header);
+    AppendChunk(png, "IDAT", zlib);
+    AppendChunk(png, "IEND", {});
+    return png;
+}
+
+void WritePng(const Image& image, const std::filesystem::path& path)
+{
+    const std::vector<std::byte> png = EncodePng(image);
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+    if (!file)
+        throw std::runtime_error(std::format("Could not write PNG '{}'.", path.string()));
+}
+
+AssetState ImageHandle::GetState() const
+{
+    return entry ? entry->state.load(std::memory_order_acquire) : AssetState::Failed;
+}
+
+const Image& ImageHandle::Get() const
+{
+    return IsReady() ? entry->image : GetPlaceholder();
+}
+
+InternedString ImageHandle::GetPath() const
+{
+    return entry ? entry->path : InternedString();
+}
+
+std::string_view ImageHandle::GetError() const
+{
+    return GetState() == AssetState::Failed && entry ? std::string_view(entry->error) : std::string_view();
+}
+
+AssetManager::AssetManager(Decoder decoder) : decoder(std::move(decoder))
+{
+    static config::ConfigU32 loaderCount("AssetLoaderThreadCount", 2);
+    for (std::uint32_t i = 0; i < std::max(1u, *loaderCount); ++i)
+        loaders.emplace_back([this](std::stop_token stopToken) { LoaderLoop(stopToken); });
+}
+
+AssetManager::~AssetManager()
+{
+    for (std::jthread& loader : loaders)
+        loader.request_stop();
+}
+
+ImageHandle AssetManager::Request(InternedString path)
+{
+    std::scoped_lock lock(mutex);
+    auto [iterator, inserted] = entries.try_emplace(path);
+    std::shared_ptr<ImageEntry>& entry = iterator->second;
+    if (!inserted)
+    {
+        recentlyRequested.splice(recentlyRequested.begin(), recentlyRequested, entry->recentPosition);
+        return ImageHandle(entry);
+    }
+
+    entry = std::make_shared<ImageEntry>();
+    entry->path = path;
+    entry->recentPosition = recentlyRequested.insert(recentlyRequested.begin(), path);
+    queue.push_back(entry);
+    ++loadingCount;
+    queueChanged.notify_one();
+    return ImageHandle(entry);
+}
+
+void AssetManager::Update()
+{
+    std::scoped_lock lock(mutex);
+    for (const std::shared_ptr<ImageEntry>& entry : finished)
+    {
+        if (entry->state.load(std::memory_order_acquire) == AssetState::Failed)
+        {
+            // Handles keep the failed entry, the next request starts over.
+            Singleton<Logger>::Get().Log<LogLevel::Warning>(std::format("Could not load image '{}': {}", entry->path.View(), entry->error));
+            recentlyRequested.erase(entry->recentPosition);
+            entries.erase(entry->path);
+            continue;
+        }
+        cachedBytes += entry->image.pixels.size();
+    }
+    finished.clear();
+
+    if (cachedBytes > GetBudgetBytes())
+        Evict();
+}
+
+void AssetManager::WaitIdle()
+{
+    std::unique_lock lock(mutex);
+    idle.wait(lock, [this] { return loadingCount == 0; });
+}
+
+std::size_t AssetManager::GetBudgetBytes() const
+{
+    static config::ConfigU32 budgetKiB("AssetCacheBudgetKiB", 256 * 1024);
+    return std::size_t{*budgetKiB} * 1024;
+}
+
+std::size_t AssetManager::GetEntryCount() const
+{
+    std::scoped_lock lock(mutex);
+    return entries.size();
+}
+
+void AssetManager::LoaderLoop(std::stop_token stopToken)
+{
+    while (true)
+    {
+        std::shared_ptr<ImageEntry> entry{};
+        {
+            std::unique_lock lock(mutex);
+            if (!queueChanged.wait(lock, stopToken, [this] { return !queue.empty(); }))
+                return;
+            entry = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        try
+        {
+            entry->image = decoder(entry->path.View());
+            entry->state.store(AssetState::Ready, std::memory_order_release);
+        }
+        catch (const std::exception& exception)
+        {
+            entry->error = exception.what();
+            entry->state.store(AssetState::Failed, std::memory_order_release);
+        }
+
+        std::scoped_lock lock(mutex);
+        finished.push_back(std::move(entry));
+        if (--loadingCount == 0)
+            idle.notify_all();
+    }
+}
+
+void AssetManager::Evict()
+{
+    // Only the cache owns entries without handles, and new handles are made under the mutex, so they stay unused.
+    for (auto position = recentlyRequested.end(); position != recentlyRequested.begin() && cachedBytes > GetBudgetBytes();)
+    {
+        --position;
+        const auto entry = entries.find(*position);
+        ASSUMERT(entry != entries.end());
+        if (entry->second.use_count() > 1 || entry->second->state.load(std::memory_order_relaxed) == AssetState::Loading)
+            continue;
+
+        ASSUMERT(cachedBytes >= entry->second->image.pixels.size());
+        cachedBytes -= entry->second->image.pixels.size();
+        entries.erase(entry);
+        position = recentlyRequested.erase(position);
+    }
+}
+
+}  // namespace tektonik::assets
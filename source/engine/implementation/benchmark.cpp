@@ -0,0 +1,434 @@
+module;
+#include "common-defines.hpp"
+module benchmark;
+
+import ecs;
+import memory;
+import components;
+import collision;
+import transform;
+import spatial;
+import glm;
+import singleton;
+import logger;
+import std;
+
+namespace tektonik::benchmark
+{
+
+struct BenchmarkData
+{
+    std::function<void(void)> func;
+    std::string name;
+};
+
+std::vector<BenchmarkData>& GetBenchmarksVector()
+{
+    static std::vector<BenchmarkData> globalVector;
+    return globalVector;
+}
+
+#define ADD_BENCHMARK_FUNC(funcName)                                         \
+    void funcName();                                                         \
+    static bool init_##funcName = []()                                       \
+    {                                                                        \
+        GetBenchmarksVector().push_back(BenchmarkData{funcName, #funcName}); \
+        return true;                                                         \
+    }();                                                                     \
+    void funcName()
+
+// Measured functions return a checksum of their results, which ends up here so the optimizer can not drop the work.
+volatile std::uint64_t resultSink = 0;
+
+// Floating point checksums are taken bitwise, converting a negative one to an unsigned integer is undefined.
+std::uint64_t ToChecksum(auto result)
+{
+    if constexpr (std::is_floating_point_v<decltype(result)>)
+        return std::bit_cast<std::conditional_t<sizeof(result) == sizeof(std::uint32_t), std::uint32_t, std::uint64_t>>(result);
+    else
+        return static_cast<std::uint64_t>(result);
+}
+
+// Logs the fastest of repetitions runs of run(prepare()). Preparing and destroying the state is not measured.
+template <typename PrepareFunc, typename RunFunc>
+void Measure(std::string_view name, PrepareFunc&& prepare, RunFunc&& run, size_t repetitions = 5)
+{
+    auto fastest = std::chrono::steady_clock::duration::max();
+    for (size_t i = 0; i < repetitions; ++i)
+    {
+        auto state = prepare();
+        const auto start = std::chrono::steady_clock::now();
+        const auto result = run(state);
+        fastest = std::min(fastest, std::chrono::steady_clock::now() - start);
+        resultSink = resultSink + ToChecksum(result);
+    }
+    Singleton<Logger>::Get().Log(std::format("  {}: {} us", name, std::chrono::duration_cast<std::chrono::microseconds>(fastest).count()));
+}
+
+// Same for runs that need no fresh state.
+template <typename RunFunc>
+void Measure(std::string_view name, RunFunc&& run, size_t repetitions = 5)
+{
+    Measure(name, []() { return 0; }, [&](int) { return run(); }, repetitions);
+}
+
+struct ValueComponent
+{
+    std::uint32_t value;
+
+    auto Tie() const { return std::tie(value); }
+};
+
+struct OtherValueComponent
+{
+    std::uint32_t value;
+
+    auto Tie() const { return std::tie(value); }
+};
+
+ADD_BENCHMARK_FUNC(BenchmarkBulkCreation)
+{
+    using Manager = ecs::ComponentManager<ValueComponent, OtherValueComponent>;
+
+    constexpr size_t entityCount = 100'000;
+    const auto prepare = []() { return std::make_unique<ecs::World<Manager>>(); };
+    Measure(
+        "NewEntity and AddComponent",
+        prepare,
+        [](std::unique_ptr<ecs::World<Manager>>& world)
+        {
+            ecs::Entity entity = 0;
+            for (size_t i = 0; i < entityCount; ++i)
+            {
+                entity = world->NewEntity();
+                world->GetComponentManager().AddComponent(entity, ValueComponent{1});
+            }
+            return entity;
+        });
+    Measure(
+        "CreateEntities",
+        prepare,
+        [](std::unique_ptr<ecs::World<Manager>>& world) { return world->CreateEntities(entityCount, ValueComponent{1}).size(); });
+}
+
+ADD_BENCHMARK_FUNC(BenchmarkGroups)
+{
+    using Manager = ecs::ComponentManager<ValueComponent, OtherValueComponent>;
+
+    // Half of the entities get the second component, in shuffled order, so ungrouped iteration jumps around.
+    constexpr size_t entityCount = 1'000'000;
+    std::mt19937 random(1);
+    const auto populate = [&](ecs::World<Manager>& world)
+    {
+        std::vector<ecs::Entity> entities = world.CreateEntities(entityCount, ValueComponent{1});
+        std::ranges::shuffle(entities, random);
+        for (ecs::Entity entity : entities | std::views::take(entityCount / 2))
+            world.GetComponentManager().AddComponent(entity, OtherValueComponent{entity});
+    };
+    ecs::World<Manager> world{};
+    populate(world);
+    ecs::World<Manager> groupedWorld{};
+    groupedWorld.GetComponentManager().RegisterGroup<ValueComponent, OtherValueComponent>();
+    populate(groupedWorld);
+
+    const auto sum = [](ecs::World<Manager>& world)
+    {
+        std::uint64_t total = 0;
+        world.Each<const ValueComponent, const OtherValueComponent>(
+            [&](ecs::Entity, const ValueComponent& value, const OtherValueComponent& otherValue) { total += value.value + otherValue.value; });
+        return total;
+    };
+    Measure("ungrouped Each", [&]() { return sum(world); });
+    Measure("grouped Each", [&]() { return sum(groupedWorld); });
+}
+
+ADD_BENCHMARK_FUNC(BenchmarkBlockPool)
+{
+    // The node churn of the per-signature entity sets when components are added and removed.
+    constexpr size_t entityCount = 100'000;
+    const auto churn = [](std::pmr::memory_resource* resource)
+    {
+        std::pmr::set<ecs::Entity> entities(resource);
+        for (size_t round = 0; round < 10; ++round)
+        {
+            for (ecs::Entity entity = 0; entity < entityCount; ++entity)
+                entities.insert(entity);
+            for (ecs::Entity entity = 0; entity < entityCount; entity += 2)
+                entities.erase(entity);
+            for (ecs::Entity entity = 1; entity < entityCount; entity += 2)
+                entities.erase(entity);
+        }
+        return entities.size();
+    };
+    Measure("set churn, new_delete_resource", [&]() { return churn(std::pmr::new_delete_resource()); });
+    memory::BlockPool pool(ecs::ComponentManager<ValueComponent>::kNodeBlockSize, 1024);
+    Measure("set churn, BlockPool", [&]() { return churn(&pool); });
+
+    using Manager = ecs::ComponentManager<ValueComponent, OtherValueComponent>;
+    ecs::World<Manager> world{};
+    Manager& componentManager = world.GetComponentManager();
+    const std::vector<ecs::Entity> entities = world.CreateEntities(entityCount, ValueComponent{1});
+    Measure(
+        "AddComponent and RemoveComponent churn",
+        [&]()
+        {
+            for (ecs::Entity entity : entities)
+                componentManager.AddComponent(entity, OtherValueComponent{entity});
+            for (ecs::Entity entity : entities)
+                componentManager.RemoveComponent<OtherValueComponent>(entity);
+            return componentManager.GetSignature(entities.back()).count();
+        });
+}
+
+ADD_BENCHMARK_FUNC(BenchmarkSplitFields)
+{
+    // Transform2D without the split layout.
+    struct InterleavedTransform2D
+    {
+        glm::vec2 position = glm::gtc::zero<glm::vec2>();
+        float rotation = 0;
+        glm::vec2 scale = glm::gtc::one<glm::vec2>();
+
+        auto Tie() const { return std::tie(position, rotation, scale); }
+    };
+    using Manager = ecs::ComponentManager<components::Transform2D, InterleavedTransform2D>;
+
+    constexpr size_t entityCount = 1'000'000;
+    ecs::World<Manager> world{};
+    world.CreateEntities(entityCount, components::Transform2D{}, InterleavedTransform2D{});
+    Manager& componentManager = world.GetComponentManager();
+
+    const auto move = [](glm::vec2& position)
+    {
+        position.x += 1;
+        position.y += 2;
+    };
+    Measure(
+        "position update with Each, interleaved",
+        [&]()
+        {
+            world.Each<InterleavedTransform2D>([&](ecs::Entity, InterleavedTransform2D& transform) { move(transform.position); });
+            return componentManager.GetComponent<InterleavedTransform2D>(0).position.x;
+        });
+    Measure(
+        "position update through GetFieldColumn, split",
+        [&]()
+        {
+            for (glm::vec2& position : componentManager.GetFieldColumn<components::Transform2D, 0>())
+                move(position);
+            return componentManager.GetComponent<components::Transform2D>(0).Position().x;
+        });
+}
+
+ADD_BENCHMARK_FUNC(BenchmarkTransformKernels)
+{
+    using namespace transform;
+
+    constexpr size_t count = 1 << 20;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> distribution(-100, 100);
+    std::vector<glm::vec2> positions(count), scales(count);
+    std::vector<float> rotations(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        positions[i] = {distribution(random), distribution(random)};
+        rotations[i] = distribution(random) / 2;
+        scales[i] = {distribution(random) / 50, distribution(random) / 50};
+    }
+    std::vector<glm::vec2> composedPositions(count), composedScales(count);
+    std::vector<float> composedRotations(count);
+    const ConstTransformColumns parents{positions, rotations, scales};
+    const TransformColumns composed{composedPositions, composedRotations, composedScales};
+    std::vector<glm::mat4> matrices(count);
+
+    constexpr std::array<std::string_view, 3> instructionSetNames{"scalar", "SSE4.2", "AVX2"};
+    const InstructionSet supported = GetSupportedInstructionSet();
+    for (InstructionSet instructionSet : {InstructionSet::Scalar, InstructionSet::Sse42, InstructionSet::Avx2})
+    {
+        if (instructionSet > supported)
+            break;
+        SetInstructionSet(instructionSet);
+
+        const std::string_view name = instructionSetNames[static_cast<size_t>(instructionSet)];
+        Measure(
+            std::format("Compose, {}", name),
+            [&]()
+            {
+                Compose(parents, parents, composed);
+                return composedPositions.back().x;
+            });
+        Measure(
+            std::format("ToMatrices to mat4, {}", name),
+            [&]()
+            {
+                ToMatrices(composed, matrices);
+                return matrices.back()[3][0];
+            });
+    }
+    SetInstructionSet(supported);
+}
+
+ADD_BENCHMARK_FUNC(BenchmarkSpatialIndexes)
+{
+    using namespace spatial;
+
+    constexpr size_t count = 100'000;
+    std::mt19937 random(3);
+    const auto randomFloat = [&](float from, float to) { return std::uniform_real_distribution<float>(from, to)(random); };
+    std::vector<Aabb> bounds(count);
+    for (Aabb& aabb : bounds)
+    {
+        aabb.min = {randomFloat(-1000, 1000), randomFloat(-1000, 1000)};
+        aabb.max = {aabb.min.x + randomFloat(0, 2), aabb.min.y + randomFloat(0, 2)};
+    }
+    std::vector<glm::vec2> points(count);
+    std::vector<Ray> rays(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        points[i] = {randomFloat(-1000, 1000), randomFloat(-1000, 1000)};
+        const float angle = randomFloat(0, 6.28f);
+        rays[i].origin = {randomFloat(-1000, 1000), randomFloat(-1000, 1000)};
+        rays[i].direction = {std::cos(angle), std::sin(angle)};
+        rays[i].maxDistance = 100;
+    }
+
+    HashGrid grid(4.0f);
+    AabbTree tree(0.5f);
+    for (auto [name, index] : {std::pair<std::string_view, SpatialIndex*>{"HashGrid", &grid}, {"AabbTree", &tree}})
+    {
+        for (Entity entity = 0; entity < count; ++entity)
+            index->Update(entity, bounds[entity]);
+
+        std::vector<Entity> found{};
+        Measure(
+            std::format("{} region queries", name),
+            [&]()
+            {
+                size_t total = 0;
+                for (const Aabb& aabb : bounds)
+                {
+                    found.clear();
+                    index->QueryRegion(Aabb{.min = {aabb.min.x - 5, aabb.min.y - 5}, .max = {aabb.min.x + 5, aabb.min.y + 5}}, found);
+                    total += found.size();
+                }
+                return total;
+            });
+        Measure(
+            std::format("{} nearest queries", name),
+            [&]()
+            {
+                size_t total = 0;
+                for (glm::vec2 point : points)
+                    total += index->QueryNearest(point, std::numeric_limits<float>::infinity()).has_value();
+                return total;
+            });
+        Measure(
+            std::format("{} ray casts", name),
+            [&]()
+            {
+                size_t total = 0;
+                for (const Ray& ray : rays)
+                    total += index->RayCast(ray).has_value();
+                return total;
+            });
+        std::vector<std::pair<Entity, Entity>> pairs{};
+        Measure(
+            std::format("{} pairs", name),
+            [&]()
+            {
+                pairs.clear();
+                index->GeneratePairs(pairs);
+                return pairs.size();
+            });
+    }
+}
+
+ADD_BENCHMARK_FUNC(BenchmarkCollision)
+{
+    using namespace collision;
+    using Manager = ecs::ComponentManager<components::Transform2D, components::Box2D, components::Circle2D>;
+
+    constexpr size_t entityCount = 50'000;
+    constexpr size_t pairCount = 1'000'000;
+    std::mt19937 random(5);
+    const auto randomFloat = [&](float from, float to) { return std::uniform_real_distribution<float>(from, to)(random); };
+
+    ecs::World<Manager> world{};
+    Manager& componentManager = world.GetComponentManager();
+    std::vector<Entity> entities{};
+    for (size_t i = 0; i < entityCount; ++i)
+    {
+        const components::Transform2D transform{.position = {randomFloat(-100, 100), randomFloat(-100, 100)}, .rotation = randomFloat(-3, 3)};
+        if (i % 2)
+            entities.push_back(world.CreateEntities(1, transform, components::Box2D{.size = {randomFloat(0.5f, 3), randomFloat(0.5f, 3)}})[0]);
+        else
+            entities.push_back(world.CreateEntities(1, transform, components::Circle2D{.radius = randomFloat(0.3f, 2)})[0]);
+    }
+
+    std::vector<std::pair<Entity, Entity>> pairs{};
+    std::vector<Shape> shapes{};
+    for (size_t i = 0; i < pairCount; ++i)
+    {
+        pairs.emplace_back(entities[random() % entityCount], entities[random() % entityCount]);
+        shapes.push_back(*GetShape(componentManager, pairs.back().first));
+        shapes.push_back(*GetShape(componentManager, pairs.back().second));
+    }
+
+    std::vector<Contact> contacts{};
+    contacts.reserve(pairCount);
+    ContactBuffer buffer{};
+    Measure(
+        "per pair Collide, prebuilt shapes",
+        [&]()
+        {
+            contacts.clear();
+            for (size_t i = 0; i < pairCount; ++i)
+                if (const std::optional<Contact> contact = Collide(pairs[i].first, shapes[2 * i], pairs[i].second, shapes[2 * i + 1]))
+                    contacts.push_back(*contact);
+            return contacts.size();
+        });
+    Measure(
+        "ContactBuffer, prebuilt shapes",
+        [&]()
+        {
+            buffer.Clear();
+            for (size_t i = 0; i < pairCount; ++i)
+                buffer.Add(pairs[i].first, shapes[2 * i], pairs[i].second, shapes[2 * i + 1]);
+            buffer.Collide();
+            return buffer.GetContacts().size();
+        });
+    Measure(
+        "per pair GetShape and Collide",
+        [&]()
+        {
+            contacts.clear();
+            for (const auto& [first, second] : pairs)
+            {
+                const std::optional<Shape> firstShape = GetShape(componentManager, first);
+                const std::optional<Shape> secondShape = GetShape(componentManager, second);
+                if (const std::optional<Contact> contact = Collide(first, *firstShape, second, *secondShape))
+                    contacts.push_back(*contact);
+            }
+            return contacts.size();
+        });
+    Measure(
+        "GenerateContacts",
+        [&]()
+        {
+            GenerateContacts(componentManager, std::span<const std::pair<Entity, Entity>>(pairs), buffer);
+            return buffer.GetContacts().size();
+        });
+}
+
+void RunAll()
+{
+    Singleton<Logger>::Get().Log("Running benchmarks...");
+
+    for (const BenchmarkData& benchmark : GetBenchmarksVector())
+    {
+        Singleton<Logger>::Get().Log(std::format("Benchmark '{}':", benchmark.name));
+        benchmark.func();
+    }
+}
+
+}  // namespace tektonik::benchmark
@@ -0,0 +1,433 @@
+module;
+#include "common-defines.hpp"
+#ifdef ARCH_X64
+#include <immintrin.h>
+#endif
+module collision;
+
+import transform;
+import assert;
+
+namespace tektonik::collision
+{
+
+namespace
+{
+
+// The pair tests are written once for any float type: float for single pairs and batch tails,
+// Float4 for four pairs of a batch at once. They only select instead of branching and every type performs
+// the same IEEE operations, so batches give the same bits as single pairs.
+
+// Min and max pick the second argument on ties like SSE, so the sign of zero matches across the types.
+inline float Min(float first, float second) { return first < second ? first : second; }
+inline float Max(float first, float second) { return first > second ? first : second; }
+inline float Abs(float value) { return std::abs(value); }
+inline float Sqrt(float value) { return std::sqrt(value); }
+inline float Select(bool condition, float whenTrue, float whenFalse) { return condition ? whenTrue : whenFalse; }
+// Magnitude with the sign of sign.
+inline float CopySign(float magnitude, float sign) { return std::copysign(magnitude, sign); }
+
+#ifdef ARCH_X64
+
+// Four lanes of SSE2, which every x64 CPU supports. Comparisons yield masks with all bits of matching lanes set.
+struct Float4
+{
+    static constexpr size_t kWidth = 4;
+
+    __m128 value;
+
+    Float4(__m128 value) : value(value) {}
+    Float4(float scalar) : value(_mm_set1_ps(scalar)) {}
+
+    static Float4 Load(const float* source) { return _mm_loadu_ps(source); }
+    void Store(float* destination) const { _mm_storeu_ps(destination, value); }
+
+    friend Float4 operator+(Float4 first, Float4 second) { return _mm_add_ps(first.value, second.value); }
+    friend Float4 operator-(Float4 first, Float4 second) { return _mm_sub_ps(first.value, second.value); }
+    friend Float4 operator*(Float4 first, Float4 second) { return _mm_mul_ps(first.value, second.value); }
+    friend Float4 operator/(Float4 first, Float4 second) { return _mm_div_ps(first.value, second.value); }
+    friend Float4 operator-(Float4 value) { return _mm_xor_ps(value.value, _mm_set1_ps(-0.0f)); }
+    friend Float4 operator<(Float4 first, Float4 second) { return _mm_cmplt_ps(first.value, second.value); }
+    friend Float4 operator>(Float4 first, Float4 second) { return _mm_cmpgt_ps(first.value, second.value); }
+};
+
+inline Float4 Min(Float4 first, Float4 second) { return _mm_min_ps(first.value, second.value); }
+inline Float4 Max(Float4 first, Float4 second) { return _mm_max_ps(first.value, second.value); }
+inline Float4 Abs(Float4 value) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), value.value); }
+inline Float4 Sqrt(Float4 value) { return _mm_sqrt_ps(value.value); }
+inline Float4 Select(Float4 mask, Float4 whenTrue, Float4 whenFalse)
+{
+    return _mm_or_ps(_mm_and_ps(mask.value, whenTrue.value), _mm_andnot_ps(mask.value, whenFalse.value));
+}
+inline Float4 CopySign(Float4 magnitude, Float4 sign)
+{
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    return _mm_or_ps(_mm_andnot_ps(signBit, magnitude.value), _mm_and_ps(signBit, sign.value));
+}
+
+#endif
+
+// Normal from the first to the second shape and the penetration depth, positive when they overlap.
+template <typename FloatType>
+struct PairResult
+{
+    FloatType normalX;
+    FloatType normalY;
+    FloatType depth;
+};
+
+// Contact of coincident shapes falls back to a fixed normal.
+template <typename FloatType>
+PairResult<FloatType> CollideCircles(FloatType firstX, FloatType firstY, FloatType firstRadius, FloatType secondX, FloatType secondY, FloatType secondRadius)
+{
+    const FloatType zero(0.0f);
+    const FloatType deltaX = secondX - firstX;
+    const FloatType deltaY = secondY - firstY;
+    const FloatType distance = Sqrt(deltaX * deltaX + deltaY * deltaY);
+    const auto apart = distance > zero;
+    const FloatType inverseDistance = Select(apart, FloatType(1.0f) / distance, zero);
+    return PairResult<FloatType>{
+        .normalX = Select(apart, deltaX * inverseDistance, FloatType(1.0f)),
+        .normalY = deltaY * inverseDistance,
+        .depth = firstRadius + secondRadius - distance,
+    };
+}
+
+template <typename FloatType>
+PairResult<FloatType> CollideCircleBox(FloatType circleX,
+                                       FloatType circleY,
+                                       FloatType radius,
+                                       FloatType boxX,
+                                       FloatType boxY,
+                                       FloatType cos,
+                                       FloatType sin,
+                                       FloatType halfWidth,
+                                       FloatType halfHeight)
+{
+    const FloatType zero(0.0f);
+    const FloatType one(1.0f);
+
+    // Circle center in the space of the box and its offset from the closest point on the box.
+    const FloatType deltaX = circleX - boxX;
+    const FloatType deltaY = circleY - boxY;
+    const FloatType localX = cos * deltaX + sin * deltaY;
+    const FloatType localY = cos * deltaY - sin * deltaX;
+    const FloatType offsetX = localX - Min(Max(localX, -halfWidth), halfWidth);
+    const FloatType offsetY = localY - Min(Max(localY, -halfHeight), halfHeight);
+    const FloatType distance = Sqrt(offsetX * offsetX + offsetY * offsetY);
+    const auto outside = distance > zero;
+    const FloatType inverseDistance = Select(outside, one / distance, zero);
+
+    // A center inside the box is pushed out through the nearest side.
+    const FloatType penetrationX = halfWidth - Abs(localX);
+    const FloatType penetrationY = halfHeight - Abs(localY);
+    const auto throughX = penetrationX < penetrationY;
+    const FloatType insideNormalX = Select(throughX, CopySign(one, localX), zero);
+    const FloatType insideNormalY = Select(throughX, zero, CopySign(one, localY));
+
+    // Local normal from the box towards the circle, flipped and rotated back to point from the circle to the box.
+    const FloatType localNormalX = Select(outside, offsetX * inverseDistance, insideNormalX);
+    const FloatType localNormalY = Select(outside, offsetY * inverseDistance, insideNormalY);
+    return PairResult<FloatType>{
+        .normalX = sin * localNormalY - cos * localNormalX,
+        .normalY = -(sin * localNormalX + cos * localNormalY),
+        .depth = Select(outside, radius - distance, radius + Min(penetrationX, penetrationY)),
+    };
+}
+
+// Separating axis test over the two axes of each box, the axis of least overlap is the normal.
+template <typename FloatType>
+PairResult<FloatType> CollideBoxes(FloatType firstX,
+                                   FloatType firstY,
+                                   FloatType firstCos,
+                                   FloatType firstSin,
+                                   FloatType firstHalfWidth,
+                                   FloatType firstHalfHeight,
+                                   FloatType secondX,
+                                   FloatType secondY,
+                                   FloatType secondCos,
+                                   FloatType secondSin,
+                                   FloatType secondHalfWidth,
+                                   FloatType secondHalfHeight)
+{
+    const FloatType deltaX = secondX - firstX;
+    const FloatType deltaY = secondY - firstY;
+
+    // Absolute cosines between the axes of the boxes, the x axis is (cos, sin) and the y axis (-sin, cos).
+    const FloatType xx = Abs(firstCos * secondCos + firstSin * secondSin);
+    const FloatType xy = Abs(firstSin * secondCos - firstCos * secondSin);
+
+    // Center distance along each axis and the overlap of the projected boxes.
+    const FloatType alongFirstX = firstCos * deltaX + firstSin * deltaY;
+    const FloatType alongFirstY = firstCos * deltaY - firstSin * deltaX;
+    const FloatType alongSecondX = secondCos * deltaX + secondSin * deltaY;
+    const FloatType alongSecondY = secondCos * deltaY - secondSin * deltaX;
+    const FloatType overlapFirstX = firstHalfWidth + secondHalfWidth * xx + secondHalfHeight * xy - Abs(alongFirstX);
+    const FloatType overlapFirstY = firstHalfHeight + secondHalfWidth * xy + secondHalfHeight * xx - Abs(alongFirstY);
+    const FloatType overlapSecondX = secondHalfWidth + firstHalfWidth * xx + firstHalfHeight * xy - Abs(alongSecondX);
+    const FloatType overlapSecondY = secondHalfHeight + firstHalfWidth * xy + firstHalfHeight * xx - Abs(alongSecondY);
+
+    PairResult<FloatType> result{.normalX = firstCos, .normalY = firstSin, .depth = overlapFirstX};
+    FloatType along = alongFirstX;
+    const auto select = [&](FloatType overlap, FloatType axisX, FloatType axisY, FloatType axisAlong)
+    {
+        const auto smaller = overlap < result.depth;
+        result.depth = Select(smaller, overlap, result.depth);
+        result.normalX = Select(smaller, axisX, result.normalX);
+        result.normalY = Select(smaller, axisY, result.normalY);
+        along = Select(smaller, axisAlong, along);
+    };
+    select(overlapFirstY, -firstSin, firstCos, alongFirstY);
+    select(overlapSecondX, secondCos, secondSin, alongSecondX);
+    select(overlapSecondY, -secondSin, secondCos, alongSecondY);
+
+    // Points from the first box to the second.
+    const FloatType sign = Select(along < FloatType(0.0f), FloatType(-1.0f), FloatType(1.0f));
+    result.normalX = result.normalX * sign;
+    result.normalY = result.normalY * sign;
+    return result;
+}
+
+// Runs a pair test over columns of a batch, four pairs at a time where possible, and stores the results.
+template <size_t ColumnCount>
+void RunBatch(size_t count, const std::array<const float*, ColumnCount>& columns, float* normalX, float* normalY, float* depth, auto&& pairTest)
+{
+    size_t i = 0;
+#ifdef ARCH_X64
+    for (; i + Float4::kWidth <= count; i += Float4::kWidth)
+    {
+        const PairResult<Float4> result = std::apply([&](const auto*... column) { return pairTest(Float4::Load(column + i)...); }, columns);
+        result.normalX.Store(normalX + i);
+        result.normalY.Store(normalY + i);
+        result.depth.Store(depth + i);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        const PairResult<float> result = std::apply([&](const auto*... column) { return pairTest(column[i]...); }, columns);
+        normalX[i] = result.normalX;
+        normalY[i] = result.normalY;
+        depth[i] = result.depth;
+    }
+}
+
+Contact ToContact(Entity first, Entity second, const PairResult<float>& result)
+{
+    return Contact{.first = first, .second = second, .normal = {result.normalX, result.normalY}, .depth = result.depth};
+}
+
+}  // namespace
+
+Circle MakeShape(const components::Transform2D& transform, const components::Circle2D& circle)
+{
+    return Circle{
+        .center = transform.position,
+        .radius = circle.radius * std::max(std::abs(transform.scale.x), std::abs(transform.scale.y)),
+    };
+}
+
+Box MakeShape(const components::Transform2D& transform, const components::Box2D& box)
+{
+    return Box{
+        .center = transform.position,
+        .halfExtents = {std::abs(box.size.x * transform.scale.x) * 0.5f, std::abs(box.size.y * transform.scale.y) * 0.5f},
+        .rotation = transform.rotation,
+    };
+}
+
+std::optional<Contact> Collide(Entity first, const Shape& firstShape, Entity second, const Shape& secondShape)
+{
+    PairResult<float> result{};
+    if (const Circle* firstCircle = std::get_if<Circle>(&firstShape))
+    {
+        if (const Circle* secondCircle = std::get_if<Circle>(&secondShape))
+            result = CollideCircles(firstCircle->center.x,
+                                    firstCircle->center.y,
+                                    firstCircle->radius,
+                                    secondCircle->center.x,
+                                    secondCircle->center.y,
+                                    secondCircle->radius);
+        else
+        {
+            const Box& box = std::get<Box>(secondShape);
+            const auto [sin, cos] = transform::SinCos(box.rotation);
+            result = CollideCircleBox(
+                firstCircle->center.x, firstCircle->center.y, firstCircle->radius, box.center.x, box.center.y, cos, sin, box.halfExtents.x, box.halfExtents.y);
+        }
+    }
+    else if (std::holds_alternative<Circle>(secondShape))
+        return Collide(second, secondShape, first, firstShape);
+    else
+    {
+        const Box& firstBox = std::get<Box>(firstShape);
+        const Box& secondBox = std::get<Box>(secondShape);
+        const auto [firstSin, firstCos] = transform::SinCos(firstBox.rotation);
+        const auto [secondSin, secondCos] = transform::SinCos(secondBox.rotation);
+        result = CollideBoxes(firstBox.center.x,
+                              firstBox.center.y,
+                              firstCos,
+                              firstSin,
+                              firstBox.halfExtents.x,
+                              firstBox.halfExtents.y,
+                              secondBox.center.x,
+                              secondBox.center.y,
+                              secondCos,
+                              secondSin,
+                              secondBox.halfExtents.x,
+                              secondBox.halfExtents.y);
+    }
+
+    if (result.depth <= 0)
+        return std::nullopt;
+    return ToContact(first, second, result);
+}
+
+void ContactBuffer::CircleColumns::Push(const Circle& circle)
+{
+    x.push_back(circle.center.x);
+    y.push_back(circle.center.y);
+    radius.push_back(circle.radius);
+}
+
+void ContactBuffer::CircleColumns::Clear()
+{
+    x.clear();
+    y.clear();
+    radius.clear();
+}
+
+void ContactBuffer::BoxColumns::Push(const Box& box)
+{
+    x.push_back(box.center.x);
+    y.push_back(box.center.y);
+    rotation.push_back(box.rotation);
+    halfWidth.push_back(box.halfExtents.x);
+    halfHeight.push_back(box.halfExtents.y);
+}
+
+void ContactBuffer::BoxColumns::Clear()
+{
+    x.clear();
+    y.clear();
+    rotation.clear();
+    halfWidth.clear();
+    halfHeight.clear();
+    cos.clear();
+    sin.clear();
+}
+
+void ContactBuffer::BoxColumns::ComputeAxes()
+{
+    cos.resize(rotation.size());
+    sin.resize(rotation.size());
+    transform::SinCos(rotation, sin, cos);
+}
+
+void ContactBuffer::Clear()
+{
+    circleCircle.Clear();
+    circleBox.Clear();
+    boxBox.Clear();
+    contacts.clear();
+}
+
+void ContactBuffer::Add(Entity first, const Shape& firstShape, Entity second, const Shape& secondShape)
+{
+    const auto push = [this](auto& batch, Entity first, const auto& firstShape, Entity second, const auto& secondShape)
+    {
+        batch.Push(first, firstShape, second, secondShape);
+        if (batch.firsts.size() == kBatchSize)
+            Collide(batch);
+    };
+
+    const Circle* firstCircle = std::get_if<Circle>(&firstShape);
+    const Circle* secondCircle = std::get_if<Circle>(&secondShape);
+    if (firstCircle && secondCircle)
+        push(circleCircle, first, *firstCircle, second, *secondCircle);
+    else if (firstCircle)
+        push(circleBox, first, *firstCircle, second, std::get<Box>(secondShape));
+    else if (secondCircle)
+        push(circleBox, second, *secondCircle, first, std::get<Box>(firstShape));
+    else
+        push(boxBox, first, std::get<Box>(firstShape), second, std::get<Box>(secondShape));
+}
+
+void ContactBuffer::Collide()
+{
+    Collide(circleCircle);
+    Collide(circleBox);
+    Collide(boxBox);
+}
+
+void ContactBuffer::Collide(Batch<CircleColumns, CircleColumns>& batch)
+{
+    const CircleColumns& first = batch.firstShapes;
+    const CircleColumns& second = batch.secondShapes;
+    RunBatch<6>(batch.firsts.size(),
+                {first.x.data(), first.y.data(), first.radius.data(), second.x.data(), second.y.data(), second.radius.data()},
+                results.normalX.data(),
+                results.normalY.data(),
+                results.depth.data(),
+                [](auto... values) { return CollideCircles(values...); });
+    AppendContacts(batch.firsts, batch.seconds);
+    batch.Clear();
+}
+
+void ContactBuffer::Collide(Batch<CircleColumns, BoxColumns>& batch)
+{
+    batch.secondShapes.ComputeAxes();
+    const CircleColumns& circles = batch.firstShapes;
+    const BoxColumns& boxes = batch.secondShapes;
+    RunBatch<9>(batch.firsts.size(),
+                {circles.x.data(),
+                 circles.y.data(),
+                 circles.radius.data(),
+                 boxes.x.data(),
+                 boxes.y.data(),
+                 boxes.cos.data(),
+                 boxes.sin.data(),
+                 boxes.halfWidth.data(),
+                 boxes.halfHeight.data()},
+                results.normalX.data(),
+                results.normalY.data(),
+                results.depth.data(),
+                [](auto... values) { return CollideCircleBox(values...); });
+    AppendContacts(batch.firsts, batch.seconds);
+    batch.Clear();
+}
+
+void ContactBuffer::Collide(Batch<BoxColumns, BoxColumns>& batch)
+{
+    batch.firstShapes.ComputeAxes();
+    batch.secondShapes.ComputeAxes();
+    const BoxColumns& first = batch.firstShapes;
+    const BoxColumns& second = batch.secondShapes;
+    RunBatch<12>(batch.firsts.size(),
+                 {first.x.data(),
+                  first.y.data(),
+                  first.cos.data(),
+                  first.sin.data(),
+                  first.halfWidth.data(),
+                  first.halfHeight.data(),
+                  second.x.data(),
+                  second.y.data(),
+                  second.cos.data(),
+                  second.sin.data(),
+                  second.halfWidth.data(),
+                  second.halfHeight.data()},
+                 results.normalX.data(),
+                 results.normalY.data(),
+                 results.depth.data(),
+                 [](auto... values) { return CollideBoxes(values...); });
+    AppendContacts(batch.firsts, batch.seconds);
+    batch.Clear();
+}
+
+void ContactBuffer::AppendContacts(std::span<const Entity> firsts, std::span<const Entity> seconds)
+{
+    for (size_t i = 0; i < firsts.size(); ++i)
+        if (results.depth[i] > 0)
+            contacts.push_back(ToContact(firsts[i], seconds[i], {results.normalX[i], results.normalY[i], results.depth[i]}));
+}
+
+}  // namespace tektonik::collision
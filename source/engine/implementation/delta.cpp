@@ -0,0 +1,56 @@
+module;
+#include "common-defines.hpp"
+module delta;
+
+namespace tektonik::delta
+{
+
+void DeltaWriter::WriteVarint(std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        bytes.push_back(static_cast<std::byte>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<std::byte>(value));
+}
+
+void DeltaWriter::WriteBytes(const void* data, size_t size)
+{
+    const auto* begin = static_cast<const std::byte*>(data);
+    bytes.insert(bytes.end(), begin, begin + size);
+}
+
+std::uint64_t DeltaReader::ReadVarint()
+{
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        if (position == bytes.size())
+            throw DeltaError("Varint is truncated.");
+        const auto byte = std::to_integer<std::uint64_t>(bytes[position++]);
+        value |= (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+    throw DeltaError("Varint is longer than 64 bits.");
+}
+
+size_t DeltaReader::ReadSize()
+{
+    const std::uint64_t size = ReadVarint();
+    if (size > bytes.size() - position)
+        throw DeltaError(std::format("Size {} exceeds the remaining {} bytes.", size, bytes.size() - position));
+    return static_cast<size_t>(size);
+}
+
+void DeltaReader::ReadBytes(void* data, size_t size)
+{
+    if (size > bytes.size() - position)
+        throw DeltaError(std::format("Reading {} bytes past the end of the delta.", size - (bytes.size() - position)));
+    if (size > 0)
+        std::memcpy(data, bytes.data() + position, size);
+    position += size;
+}
+
+}  // namespace tektonik::delta
@@ -0,0 +1,311 @@
+module;
+#include "common-defines.hpp"
+module jobs;
+
+import config;
+import singleton;
+import logger;
+import assert;
+
+namespace tektonik::jobs
+{
+
+// Which job system and deque the calling thread owns.
+thread_local const JobSystem* tlsJobSystem = nullptr;
+thread_local std::size_t tlsDequeIndex = 0;
+
+WorkStealingDeque::WorkStealingDeque(std::size_t capacity)
+    : buffer(std::make_unique<std::atomic<Job*>[]>(capacity)), mask(static_cast<std::int64_t>(capacity) - 1)
+{
+    ASSUMERT(std::has_single_bit(capacity));
+}
+
+bool WorkStealingDeque::Push(Job* job)
+{
+    const std::int64_t currentBottom = bottom.load(std::memory_order_relaxed);
+    const std::int64_t currentTop = top.load(std::memory_order_acquire);
+    if (currentBottom - currentTop > mask)
+        return false;
+
+    buffer[currentBottom & mask].store(job, std::memory_order_relaxed);
+    // Publishes the job to thieves.
+    bottom.store(currentBottom + 1, std::memory_order_release);
+    return true;
+}
+
+Job* WorkStealingDeque::Pop()
+{
+    const std::int64_t currentBottom = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(currentBottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t currentTop = top.load(std::memory_order_relaxed);
+
+    // Empty.
+    if (currentTop > currentBottom)
+    {
+        bottom.store(currentBottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job* job = buffer[currentBottom & mask].load(std::memory_order_relaxed);
+    // Last element, thieves may be racing for it.
+    if (currentTop == currentBottom)
+    {
+        if (!top.compare_exchange_strong(currentTop, currentTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        bottom.store(currentBottom + 1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+Job* WorkStealingDeque::Steal()
+{
+    std::int64_t currentTop = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const std::int64_t currentBottom = bottom.load(std::memory_order_acquire);
+    if (currentTop >= currentBottom)
+        return nullptr;
+
+    Job* job = buffer[currentTop & mask].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(currentTop, currentTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+
+    return job;
+}
+
+void LogException(const std::exception_ptr& exception)
+{
+    try
+    {
+        std::rethrow_exception(exception);
+    }
+    catch (const std::exception& caught)
+    {
+        Singleton<Logger>::Get().Log<LogLevel::Error>(std::format("Job threw an exception: {}", caught.what()));
+    }
+    catch (...)
+    {
+        Singleton<Logger>::Get().Log<LogLevel::Error>("Job threw an unknown exception.");
+    }
+}
+
+std::uint32_t GetConfiguredWorkerCount()
+{
+    static config::ConfigU32 workerCount("JobWorkerCount", std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return *workerCount;
+}
+
+JobSystem::JobSystem() : JobSystem(GetConfiguredWorkerCount()) {}
+
+JobSystem::JobSystem(std::uint32_t workerCount)
+{
+    Singleton<Logger>::Get().Log(std::format("Starting job system with {} workers...", workerCount));
+
+    tlsJobSystem = this;
+    tlsDequeIndex = 0;
+
+    deques.reserve(workerCount + 1);
+    for (std::uint32_t i = 0; i < workerCount + 1; ++i)
+        deques.push_back(std::make_unique<WorkStealingDeque>());
+
+    workers.reserve(workerCount);
+    for (std::size_t dequeIndex = 1; dequeIndex < deques.size(); ++dequeIndex)
+        workers.emplace_back([this, dequeIndex](std::stop_token stopToken) { WorkerLoop(stopToken, dequeIndex); });
+}
+
+JobSystem::~JobSystem()
+{
+    Singleton<Logger>::Get().Log("Stopping job system...");
+
+    for (std::jthread& worker : workers)
+        worker.request_stop();
+    workEpoch.fetch_add(1, std::memory_order_release);
+    workEpoch.notify_all();
+    workers.clear();
+
+    // Jobs that were never executed.
+    for (const std::unique_ptr<WorkStealingDeque>& deque : deques)
+        while (Job* job = deque->Steal())
+            delete job;
+    for (Job* job : injectedJobs)
+        delete job;
+    for (Job* job : mainThreadJobs)
+        delete job;
+
+    if (tlsJobSystem == this)
+        tlsJobSystem = nullptr;
+}
+
+void JobSystem::Schedule(std::function<void()> function, Counter* counter)
+{
+    if (counter)
+        counter->value.fetch_add(1, std::memory_order_relaxed);
+
+    Enqueue(new Job{.function = std::move(function), .counter = counter});
+}
+
+void JobSystem::ScheduleOnMainThread(std::function<void()> function, Counter* counter)
+{
+    if (counter)
+        counter->value.fetch_add(1, std::memory_order_relaxed);
+
+    std::scoped_lock lock(mainThreadMutex);
+    mainThreadJobs.push_back(new Job{.function = std::move(function), .counter = counter});
+}
+
+void JobSystem::Wait(Counter& counter)
+{
+    const std::size_t ownDequeIndex = GetOwnDequeIndex();
+    const bool onMainThread = IsMainThread();
+
+    while (!counter.IsDone())
+    {
+        if (onMainThread)
+            PumpMainThread();
+
+        if (Job* job = FindJob(ownDequeIndex))
+            Execute(job);
+        else
+            std::this_thread::yield();
+    }
+
+    // All jobs finished, so nothing else touches the exception anymore.
+    if (counter.firstException)
+        std::rethrow_exception(std::exchange(counter.firstException, nullptr));
+}
+
+void JobSystem::PumpMainThread()
+{
+    ASSUMERT(IsMainThread());
+
+    std::deque<Job*> jobs{};
+    {
+        std::scoped_lock lock(mainThreadMutex);
+        std::swap(jobs, mainThreadJobs);
+    }
+
+    for (Job* job : jobs)
+        Execute(job);
+}
+
+void JobSystem::ParallelFor(std::size_t count, std::size_t grainSize, const std::function<void(std::size_t begin, std::size_t end)>& func)
+{
+    grainSize = std::max<std::size_t>(1, grainSize);
+
+    Counter counter{};
+    for (std::size_t begin = 0; begin < count; begin += grainSize)
+    {
+        const std::size_t end = std::min(count, begin + grainSize);
+        Schedule([&func, begin, end]() { func(begin, end); }, &counter);
+    }
+
+    Wait(counter);
+}
+
+void JobSystem::WorkerLoop(std::stop_token stopToken, std::size_t dequeIndex)
+{
+    tlsJobSystem = this;
+    tlsDequeIndex = dequeIndex;
+
+    while (!stopToken.stop_requested())
+    {
+        // Read before searching, so a job scheduled after an unsuccessful search changes the epoch.
+        const std::uint32_t epoch = workEpoch.load(std::memory_order_acquire);
+        if (Job* job = FindJob(dequeIndex))
+        {
+            Execute(job);
+            continue;
+        }
+
+        // Stop is requested before the destructor bumps the epoch, so seeing the bumped epoch implies seeing the
+        // stop request. Re-checking here keeps a worker from sleeping on an epoch that will never change again.
+        if (stopToken.stop_requested())
+            break;
+
+        workEpoch.wait(epoch, std::memory_order_acquire);
+    }
+}
+
+std::optional<std::size_t> JobSystem::GetThreadIndex() const
+{
+    const std::size_t index = GetOwnDequeIndex();
+    return index == kNotAWorker ? std::nullopt : std::optional(index);
+}
+
+std::size_t JobSystem::GetOwnDequeIndex() const
+{
+    return tlsJobSystem == this ? tlsDequeIndex : kNotAWorker;
+}
+
+Job* JobSystem::FindJob(std::size_t ownDequeIndex)
+{
+    if (ownDequeIndex != kNotAWorker)
+        if (Job* job = deques[ownDequeIndex]->Pop())
+            return job;
+
+    if (injectedCount.load(std::memory_order_acquire) != 0)
+    {
+        std::scoped_lock lock(injectedMutex);
+        if (!injectedJobs.empty())
+        {
+            Job* job = injectedJobs.front();
+            injectedJobs.pop_front();
+            injectedCount.fetch_sub(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+
+    // Steal, starting after the own deque so thieves spread out.
+    const std::size_t start = ownDequeIndex == kNotAWorker ? 0 : ownDequeIndex + 1;
+    for (std::size_t i = 0; i < deques.size(); ++i)
+    {
+        const std::size_t victim = (start + i) % deques.size();
+        if (victim == ownDequeIndex)
+            continue;
+        if (Job* job = deques[victim]->Steal())
+            return job;
+    }
+
+    return nullptr;
+}
+
+void JobSystem::Execute(Job* job)
+{
+    try
+    {
+        job->function();
+    }
+    catch (...)
+    {
+        if (job->counter)
+        {
+            std::scoped_lock lock(job->counter->exceptionMutex);
+            if (!job->counter->firstException)
+                job->counter->firstException = std::current_exception();
+        }
+        else
+            LogException(std::current_exception());
+    }
+
+    if (job->counter)
+        job->counter->value.fetch_sub(1, std::memory_order_release);
+
+    delete job;
+}
+
+void JobSystem::Enqueue(Job* job)
+{
+    const std::size_t ownDequeIndex = GetOwnDequeIndex();
+    if (ownDequeIndex == kNotAWorker || !deques[ownDequeIndex]->Push(job))
+    {
+        std::scoped_lock lock(injectedMutex);
+        injectedJobs.push_back(job);
+        injectedCount.fetch_add(1, std::memory_order_release);
+    }
+
+    workEpoch.fetch_add(1, std::memory_order_release);
+    workEpoch.notify_one();
+}
+
+}  // namespace tektonik::jobs
@@ -0,0 +1,127 @@
+module;
+#include "common-defines.hpp"
+module memory;
+
+import assert;
+
+namespace tektonik::memory
+{
+
+FrameArena::FrameArena(std::size_t initialCapacity, std::pmr::memory_resource* upstream) : upstream(upstream)
+{
+    ASSUMERT(initialCapacity > 0);
+    AddBlock(initialCapacity);
+}
+
+FrameArena::~FrameArena()
+{
+    FreeBlocks();
+}
+
+void FrameArena::Reset()
+{
+    // The frame did not fit, the next one gets a single block as large as all of them.
+    if (blocks.size() > 1)
+    {
+        const std::size_t capacity = GetCapacity();
+        FreeBlocks();
+        AddBlock(capacity);
+    }
+
+    current = blocks.back().data;
+    usedBytes = 0;
+}
+
+std::size_t FrameArena::GetCapacity() const
+{
+    std::size_t capacity = 0;
+    for (const Block& block : blocks)
+        capacity += block.size;
+    return capacity;
+}
+
+void* FrameArena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    void* pointer = current;
+    std::size_t space = static_cast<std::size_t>(end - current);
+    if (!std::align(alignment, bytes, pointer, space))
+    {
+        // Doubles the capacity, so a frame adds a logarithmic count of blocks at most.
+        AddBlock(std::max(GetCapacity(), bytes + alignment));
+        pointer = current;
+        space = static_cast<std::size_t>(end - current);
+        std::align(alignment, bytes, pointer, space);
+    }
+
+    std::byte* const next = static_cast<std::byte*>(pointer) + bytes;
+    usedBytes += static_cast<std::size_t>(next - current);
+    peakUsedBytes = std::max(peakUsedBytes, usedBytes);
+    current = next;
+    return pointer;
+}
+
+void FrameArena::AddBlock(std::size_t size)
+{
+    std::byte* const data = static_cast<std::byte*>(upstream->allocate(size, alignof(std::max_align_t)));
+    blocks.push_back(Block{.data = data, .size = size});
+    current = data;
+    end = data + size;
+}
+
+void FrameArena::FreeBlocks()
+{
+    for (const Block& block : blocks)
+        upstream->deallocate(block.data, block.size, alignof(std::max_align_t));
+    blocks.clear();
+}
+
+BlockPool::BlockPool(std::size_t blockSize, std::size_t blocksPerChunk, std::pmr::memory_resource* upstream)
+    : upstream(upstream),
+      blockSize((std::max(blockSize, sizeof(FreeBlock)) + kBlockAlignment - 1) / kBlockAlignment * kBlockAlignment),
+      blocksPerChunk(blocksPerChunk)
+{
+    ASSUMERT(blocksPerChunk > 0);
+}
+
+BlockPool::~BlockPool()
+{
+    for (std::byte* chunk : chunks)
+        upstream->deallocate(chunk, blockSize * blocksPerChunk, kBlockAlignment);
+}
+
+void* BlockPool::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    if (!IsPooled(bytes, alignment))
+        return upstream->allocate(bytes, alignment);
+
+    if (freeList == nullptr)
+        AddChunk();
+    FreeBlock* const block = freeList;
+    freeList = block->next;
+    ++usedBlockCount;
+    return block;
+}
+
+void BlockPool::do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment)
+{
+    if (!IsPooled(bytes, alignment))
+    {
+        upstream->deallocate(pointer, bytes, alignment);
+        return;
+    }
+
+    ASSUMERT(usedBlockCount > 0);
+    freeList = std::construct_at(static_cast<FreeBlock*>(pointer), FreeBlock{.next = freeList});
+    --usedBlockCount;
+}
+
+void BlockPool::AddChunk()
+{
+    std::byte* const chunk = static_cast<std::byte*>(upstream->allocate(blockSize * blocksPerChunk, kBlockAlignment));
+    chunks.push_back(chunk);
+    // Linked in address order, so consecutive allocations are adjacent.
+    for (std::size_t i = blocksPerChunk; i > 0; --i)
+        freeList = std::construct_at(reinterpret_cast<FreeBlock*>(chunk + (i - 1) * blockSize), FreeBlock{.next = freeList});
+}
+
+}  // namespace tektonik::memory
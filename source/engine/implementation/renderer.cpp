@@ -9,26 +9,1006 @@ import logger;
 import string_enum;
 import assert;
 import vulkan_version;
+import jobs;
 
 namespace tektonik::renderer
 {
 
-Renderer::Renderer()
-    : window(vulkan::util::RaiiWindowWrapper(vulkan::util::RaiiWindowWrapper::CreateInfo{.title = *windowTitle})), vulkanInvariants(window)
+constexpr std::uint32_t kBatchVertexShader[] = {
+#include "batch.vert.inc"
+};
+
+constexpr std::uint32_t kBatchFragmentShader[] = {
+#include "batch.frag.inc"
+};
+
+constexpr std::size_t kInitialInstanceCapacity = 1024;
+// Bounds the wait for a swapchain image, frames that get none are skipped.
+constexpr std::uint64_t kAcquireTimeoutNs = 1'000'000'000ULL;
+// Smaller slices of the batch cost more in starting and executing secondary buffers than recording them in parallel saves.
+constexpr std::size_t kMinInstancesPerSecondary = 4096;
+// Offscreen targets have the same layout as assets::Image, so readback is a plain copy.
+constexpr vk::Format kOffscreenFormat = vk::Format::eR8G8B8A8Unorm;
+constexpr std::uint32_t kTimestampsPerFrame = 2;
+// Holds a 2048x2048 RGBA8 texture, bigger ones keep the placeholder.
+constexpr vk::DeviceSize kStagingCapacity = 16 * 1024 * 1024;
+// Multiple of the texel size, which copy offsets must be, and of common optimal copy alignments.
+constexpr vk::DeviceSize kStagingAlignment = 16;
+
+/// Push constants of batch.vert, mapping world units to clip space.
+struct ViewConstants
+{
+    glm::vec2 scale{};
+    glm::vec2 offset{};
+};
+
+vk::SurfaceFormatKHR ChooseSurfaceFormat(const VulkanInvariants& vulkan)
+{
+    const std::vector<vk::SurfaceFormatKHR> formats = vulkan.physicalDevice.getSurfaceFormatsKHR(*vulkan.surface);
+    ASSUMERT(!formats.empty());
+
+    for (const vk::SurfaceFormatKHR& format : formats)
+        if ((format.format == vk::Format::eB8G8R8A8Unorm || format.format == vk::Format::eR8G8B8A8Unorm) &&
+            format.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear)
+            return format;
+
+    return formats.front();
+}
+
+vk::raii::RenderPass CreateRenderPass(const vk::raii::Device& device, vk::Format format, vk::ImageLayout finalLayout)
+{
+    vk::AttachmentDescription colorAttachment{
+        .format = format,
+        .samples = vk::SampleCountFlagBits::e1,
+        .loadOp = vk::AttachmentLoadOp::eClear,
+        .storeOp = vk::AttachmentStoreOp::eStore,
+        .stencilLoadOp = vk::AttachmentLoadOp::eDontCare,
+        .stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
+        .initialLayout = vk::ImageLayout::eUndefined,
+        .finalLayout = finalLayout,
+    };
+
+    vk::AttachmentReference colorAttachmentReference{
+        .attachment = 0,
+        .layout = vk::ImageLayout::eColorAttachmentOptimal,
+    };
+
+    vk::SubpassDescription subpass{
+        .pipelineBindPoint = vk::PipelineBindPoint::eGraphics,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colorAttachmentReference,
+    };
+
+    // The image is written only after the presentation engine released it, see the wait stage of the submit.
+    // Offscreen targets are copied to host memory after the pass.
+    const std::array subpassDependencies{
+        vk::SubpassDependency{
+                              .srcSubpass = VK_SUBPASS_EXTERNAL,
+                              .dstSubpass = 0,
+                              .srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                              .dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                              .srcAccessMask = {},
+                              .dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+                              },
+        vk::SubpassDependency{
+                              .srcSubpass = 0,
+                              .dstSubpass = VK_SUBPASS_EXTERNAL,
+                              .srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                              .dstStageMask = vk::PipelineStageFlagBits::eTransfer,
+                              .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+                              .dstAccessMask = vk::AccessFlagBits::eTransferRead,
+                              },
+    };
+
+    return device.createRenderPass(
+        vk::RenderPassCreateInfo{
+            .attachmentCount = 1,
+            .pAttachments = &colorAttachment,
+            .subpassCount = 1,
+            .pSubpasses = &subpass,
+            .dependencyCount = finalLayout == vk::ImageLayout::eTransferSrcOptimal ? 2u : 1u,
+            .pDependencies = subpassDependencies.data(),
+        });
+}
+
+vk::raii::ImageView CreateImageView(const vk::raii::Device& device, vk::Image image, vk::Format format)
+{
+    return device.createImageView(
+        vk::ImageViewCreateInfo{
+            .image = image,
+            .viewType = vk::ImageViewType::e2D,
+            .format = format,
+            .subresourceRange =
+                vk::ImageSubresourceRange{
+                                          .aspectMask = vk::ImageAspectFlagBits::eColor,
+                                          .baseMipLevel = 0,
+                                          .levelCount = 1,
+                                          .baseArrayLayer = 0,
+                                          .layerCount = 1,
+                                          },
+    });
+}
+
+SwapchainWrapper CreateSwapchainWrapper(
+    const VulkanInvariants& vulkan,
+    const vk::SurfaceFormatKHR& surfaceFormat,
+    const vk::raii::RenderPass& renderPass,
+    const vk::Extent2D& extent)
+{
+    const vk::SurfaceCapabilitiesKHR capabilities = vulkan.physicalDevice.getSurfaceCapabilitiesKHR(*vulkan.surface);
+    std::uint32_t imageCount = capabilities.minImageCount + 1;
+    if (capabilities.maxImageCount != 0)
+        imageCount = std::min(imageCount, capabilities.maxImageCount);
+
+    SwapchainWrapper swapchainWrapper;
+    swapchainWrapper.extent = extent;
+    swapchainWrapper.swapchain = vulkan.device.createSwapchainKHR(
+        vk::SwapchainCreateInfoKHR{
+            .surface = *vulkan.surface,
+            .minImageCount = imageCount,
+            .imageFormat = surfaceFormat.format,
+            .imageColorSpace = surfaceFormat.colorSpace,
+            .imageExtent = extent,
+            .imageArrayLayers = 1,
+            .imageUsage = vk::ImageUsageFlagBits::eColorAttachment,
+            .imageSharingMode = vk::SharingMode::eExclusive,
+            .preTransform = capabilities.currentTransform,
+            .compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
+            .presentMode = vk::PresentModeKHR::eFifo,  // only one required to be supported
+            .clipped = true,
+        });
+    swapchainWrapper.images = swapchainWrapper.swapchain.getImages();
+
+    for (const vk::Image image : swapchainWrapper.images)
+    {
+        const vk::raii::ImageView& imageView = swapchainWrapper.imageViews.emplace_back(CreateImageView(vulkan.device, image, surfaceFormat.format));
+        swapchainWrapper.framebuffers.push_back(vulkan.device.createFramebuffer(
+            vk::FramebufferCreateInfo{
+                .renderPass = *renderPass,
+                .attachmentCount = 1,
+                .pAttachments = &*imageView,
+                .width = extent.width,
+                .height = extent.height,
+                .layers = 1,
+            }));
+    }
+    swapchainWrapper.submitFinishedSemaphores = vulkan::util::CreateSemaphores(vulkan.device, swapchainWrapper.images.size());
+
+    swapchainWrapper.acquiredImageSemaphores = vulkan::util::CreateSemaphores(vulkan.device, kMaxFramesInFlight);
+
+    return swapchainWrapper;
+}
+
+void TransitionImage(
+    const vk::raii::CommandBuffer& commandBuffer,
+    vk::Image image,
+    vk::ImageLayout oldLayout,
+    vk::ImageLayout newLayout,
+    vk::PipelineStageFlags srcStage,
+    vk::AccessFlags srcAccess,
+    vk::PipelineStageFlags dstStage,
+    vk::AccessFlags dstAccess)
+{
+    commandBuffer.pipelineBarrier(
+        srcStage,
+        dstStage,
+        {},
+        {},
+        {},
+        vk::ImageMemoryBarrier{
+            .srcAccessMask = srcAccess,
+            .dstAccessMask = dstAccess,
+            .oldLayout = oldLayout,
+            .newLayout = newLayout,
+            .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+            .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+            .image = image,
+            .subresourceRange = vk::ImageSubresourceRange{.aspectMask = vk::ImageAspectFlagBits::eColor, .levelCount = 1, .layerCount = 1},
+    });
+}
+
+vulkan::util::RaiiWindowWrapper CreateRendererWindow(const Renderer::CreateInfo& createInfo)
+{
+    static config::ConfigString windowTitle("RendererWindowTitle", "Renderer Window");
+
+    if (createInfo.headless)
+        return vulkan::util::RaiiWindowWrapper();
+    return vulkan::util::RaiiWindowWrapper(vulkan::util::RaiiWindowWrapper::CreateInfo{.title = *windowTitle, .size = createInfo.size});
+}
+
+Renderer::Renderer(const CreateInfo& createInfo)
+    : headless(createInfo.headless),
+      readback(createInfo.headless && createInfo.readback),
+      window(CreateRendererWindow(createInfo)),
+      vulkanInvariants(headless ? nullptr : &window),
+      surfaceFormat(headless ? vk::SurfaceFormatKHR{.format = kOffscreenFormat} : ChooseSurfaceFormat(vulkanInvariants)),
+      renderPass(
+          CreateRenderPass(vulkanInvariants.device, surfaceFormat.format, headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR)),
+      batchPipelines(vulkanInvariants, renderPass)
+{
+    ASSUMERT(createInfo.size.x > 0 && createInfo.size.y > 0);
+    if (!headless)
+        RecreateSwapchain();
+
+    const vk::DescriptorPoolSize poolSize{.type = vk::DescriptorType::eCombinedImageSampler, .descriptorCount = kMaxTextures * kMaxFramesInFlight};
+    descriptorPool = vulkanInvariants.device.createDescriptorPool(
+        vk::DescriptorPoolCreateInfo{
+            .flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+            .maxSets = kMaxFramesInFlight,
+            .poolSizeCount = 1,
+            .pPoolSizes = &poolSize,
+        });
+
+    uploader = Uploader(vulkanInvariants, kStagingCapacity);
+    // The ring is empty, so the placeholder fits.
+    textures.push_back(*uploader.UploadTexture(assets::GetPlaceholder()));
+    uploader.Flush();
+
+    const vk::Extent2D offscreenExtent{.width = static_cast<std::uint32_t>(createInfo.size.x), .height = static_cast<std::uint32_t>(createInfo.size.y)};
+    for (std::uint32_t i = 0; i < kMaxFramesInFlight; ++i)
+    {
+        FrameResources& frame = frames.emplace_back();
+        frame.commands = FrameCommandPools(vulkanInvariants, Singleton<jobs::JobSystem>::Get().GetThreadCount());
+        frame.submitFinished = vulkanInvariants.device.createFence(vk::FenceCreateInfo{.flags = vk::FenceCreateFlagBits::eSignaled});
+        frame.instances = Buffer(
+            vulkanInvariants,
+            kInitialInstanceCapacity * sizeof(Instance),
+            vk::BufferUsageFlagBits::eVertexBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        frame.textureSet = std::move(vulkanInvariants.device.allocateDescriptorSets(
+            vk::DescriptorSetAllocateInfo{
+                .descriptorPool = *descriptorPool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &*batchPipelines.descriptorSetLayout,
+            })[0]);
+        WriteTextureSlots(frame);
+
+        if (!headless)
+            continue;
+        frame.target = Texture(vulkanInvariants, offscreenExtent, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc);
+        frame.framebuffer = vulkanInvariants.device.createFramebuffer(
+            vk::FramebufferCreateInfo{
+                .renderPass = *renderPass,
+                .attachmentCount = 1,
+                .pAttachments = &*frame.target.view,
+                .width = offscreenExtent.width,
+                .height = offscreenExtent.height,
+                .layers = 1,
+            });
+        if (readback)
+            frame.readback = Buffer(
+                vulkanInvariants,
+                vk::DeviceSize{offscreenExtent.width} * offscreenExtent.height * 4,
+                vk::BufferUsageFlagBits::eTransferDst,
+                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    }
+
+    // Software devices like lavapipe support timestamps too, so GPU timings are available on build agents.
+    const std::uint32_t graphicsFamily = vulkanInvariants.queuesInfo.GetQueueInfo(QueueTypeFlagBits::Graphics).familyIndex;
+    const std::uint32_t timestampValidBits = vulkanInvariants.physicalDevice.getQueueFamilyProperties()[graphicsFamily].timestampValidBits;
+    if (timestampValidBits != 0)
+    {
+        timestampQueries = vulkanInvariants.device.createQueryPool(
+            vk::QueryPoolCreateInfo{.queryType = vk::QueryType::eTimestamp, .queryCount = kTimestampsPerFrame * kMaxFramesInFlight});
+        timestampPeriodNs = vulkanInvariants.physicalDevice.getProperties().limits.timestampPeriod;
+        timestampMask = timestampValidBits >= 64 ? std::numeric_limits<std::uint64_t>::max() : (std::uint64_t{1} << timestampValidBits) - 1;
+    }
+}
+
+Renderer::~Renderer()
 {
+    if (*vulkanInvariants.device)
+        vulkanInvariants.device.waitIdle();
+}
+
+void Renderer::DrawBatch(std::chrono::steady_clock::time_point cpuStart)
+{
+    if (!headless && !*swapchainWrapper.swapchain)
+    {
+        RecreateSwapchain();
+        if (!*swapchainWrapper.swapchain)
+            return;
+    }
+
+    FrameResources& frame = frames[frameIndex];
+    const auto waitStart = std::chrono::steady_clock::now();
+    // No timeout, the command pools are reset right after, which is only valid once the device finished the frame.
+    static_cast<void>(vulkanInvariants.device.waitForFences(*frame.submitFinished, true, std::numeric_limits<std::uint64_t>::max()));
+    const auto waited = std::chrono::steady_clock::now() - waitStart;
+    ReadGpuTime(frame);
+    frame.commands.Reset();
+
+    // The frame is not in use by the device anymore, so its resources may be written.
+    UpdateTextures();
+    WriteTextureSlots(frame);
+    UploadInstances(frame);
+
+    if (headless)
+        DrawOffscreen(frame);
+    else
+        DrawToSwapchain(frame);
+
+    latestTimings.cpu = std::chrono::steady_clock::now() - cpuStart - waited;
+}
+
+void Renderer::DrawOffscreen(FrameResources& frame)
+{
+    vulkanInvariants.device.resetFences(*frame.submitFinished);
+    const Uploader::GraphicsHandoff uploads = uploader.TakeGraphicsHandoff();
+    RecordFrame(frame, *frame.framebuffer, frame.target.extent, uploads.acquires);
+
+    const bool waitForUploads = uploads.waitValue != 0;
+    static constexpr vk::PipelineStageFlags kUploadWaitStage = vk::PipelineStageFlagBits::eFragmentShader;
+    const vk::TimelineSemaphoreSubmitInfo timelineInfo{.waitSemaphoreValueCount = 1, .pWaitSemaphoreValues = &uploads.waitValue};
+    vulkanInvariants.queues.graphics.submit(
+        vk::SubmitInfo{
+            .pNext = waitForUploads ? &timelineInfo : nullptr,
+            .waitSemaphoreCount = waitForUploads ? 1u : 0u,
+            .pWaitSemaphores = &*uploader.GetTimeline(),
+            .pWaitDstStageMask = &kUploadWaitStage,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &*frame.commands.primary,
+        },
+        *frame.submitFinished);
+
+    frame.submitted = true;
+    frameIndex = (frameIndex + 1) % kMaxFramesInFlight;
+}
+
+void Renderer::DrawToSwapchain(FrameResources& frame)
+{
+    try
+    {
+        const auto [acquireResult, imageIndex] =
+            swapchainWrapper.swapchain.acquireNextImage(kAcquireTimeoutNs, swapchainWrapper.acquiredImageSemaphores[frameIndex]);
+        // Nothing was acquired and the semaphore stays unsignaled, the frame is tried again on the next draw.
+        if (acquireResult == vk::Result::eTimeout || acquireResult == vk::Result::eNotReady)
+        {
+            Singleton<Logger>::Get().Log<LogLevel::Warning>("No swapchain image was available in time, skipping the frame.");
+            return;
+        }
+        // Reset only once an image was acquired, so an out of date swapchain does not leave the fence unsignaled.
+        vulkanInvariants.device.resetFences(*frame.submitFinished);
+
+        const Uploader::GraphicsHandoff uploads = uploader.TakeGraphicsHandoff();
+        RecordFrame(frame, *swapchainWrapper.framebuffers[imageIndex], swapchainWrapper.extent, uploads.acquires);
+
+        // The value of the binary semaphore is ignored.
+        const std::array waitSemaphores{*swapchainWrapper.acquiredImageSemaphores[frameIndex], *uploader.GetTimeline()};
+        static constexpr std::array<vk::PipelineStageFlags, 2> kWaitStages{
+            vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eFragmentShader};
+        const std::array<std::uint64_t, 2> waitValues{0, uploads.waitValue};
+        const std::uint32_t waitCount = uploads.waitValue != 0 ? 2 : 1;
+        const vk::TimelineSemaphoreSubmitInfo timelineInfo{.waitSemaphoreValueCount = waitCount, .pWaitSemaphoreValues = waitValues.data()};
+        vulkanInvariants.queues.graphics.submit(
+            vk::SubmitInfo{
+                .pNext = &timelineInfo,
+                .waitSemaphoreCount = waitCount,
+                .pWaitSemaphores = waitSemaphores.data(),
+                .pWaitDstStageMask = kWaitStages.data(),
+                .commandBufferCount = 1,
+                .pCommandBuffers = &*frame.commands.primary,
+                .signalSemaphoreCount = 1,
+                .pSignalSemaphores = &*swapchainWrapper.submitFinishedSemaphores[imageIndex],
+            },
+            *frame.submitFinished);
+        frame.submitted = true;
+
+        const vk::Result presentResult = vulkanInvariants.queues.graphics.presentKHR(
+            vk::PresentInfoKHR{
+                .waitSemaphoreCount = 1,
+                .pWaitSemaphores = &*swapchainWrapper.submitFinishedSemaphores[imageIndex],
+                .swapchainCount = 1,
+                .pSwapchains = &*swapchainWrapper.swapchain,
+                .pImageIndices = &imageIndex,
+            });
+
+        frameIndex = (frameIndex + 1) % kMaxFramesInFlight;
+
+        // A suboptimal image was still drawn and presented, so nothing waits on its semaphores anymore.
+        if (acquireResult == vk::Result::eSuboptimalKHR || presentResult == vk::Result::eSuboptimalKHR)
+            RecreateSwapchain();
+    }
+    catch (const vk::OutOfDateKHRError&)
+    {
+        Singleton<Logger>::Get().Log("Swapchain is out of date.");
+        RecreateSwapchain();
+    }
+}
+
+void Renderer::RecordFrame(
+    FrameResources& frame, vk::Framebuffer framebuffer, vk::Extent2D extent, const std::vector<vk::ImageMemoryBarrier>& uploadAcquires)
+{
+    const std::vector<vk::CommandBuffer> secondaries = RecordBatch(frame, framebuffer, extent);
+
+    const vk::raii::CommandBuffer& commandBuffer = frame.commands.primary;
+    commandBuffer.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+
+    const std::uint32_t firstTimestamp = frameIndex * kTimestampsPerFrame;
+    if (*timestampQueries)
+    {
+        commandBuffer.resetQueryPool(*timestampQueries, firstTimestamp, kTimestampsPerFrame);
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *timestampQueries, firstTimestamp);
+    }
+
+    // Ordered after the wait for the uploads, which happens at the same stage.
+    if (!uploadAcquires.empty())
+        commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eFragmentShader, {}, {}, {}, uploadAcquires);
+
+    const vk::ClearValue clearValue = vk::ClearValue(vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f));
+    commandBuffer.beginRenderPass(
+        vk::RenderPassBeginInfo{
+            .renderPass = *renderPass,
+            .framebuffer = framebuffer,
+            .renderArea = vk::Rect2D{.offset = vk::Offset2D{0, 0}, .extent = extent},
+            .clearValueCount = 1,
+            .pClearValues = &clearValue,
+    },
+        vk::SubpassContents::eSecondaryCommandBuffers);
+    if (!secondaries.empty())
+        commandBuffer.executeCommands(secondaries);
+    commandBuffer.endRenderPass();
+
+    if (readback)
+    {
+        // The render pass leaves the target in transfer source layout.
+        commandBuffer.copyImageToBuffer(
+            *frame.target.image,
+            vk::ImageLayout::eTransferSrcOptimal,
+            *frame.readback.buffer,
+            vk::BufferImageCopy{
+                .imageSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .layerCount = 1},
+                .imageExtent = vk::Extent3D{.width = extent.width, .height = extent.height, .depth = 1},
+        });
+        commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eHost,
+            {},
+            vk::MemoryBarrier{.srcAccessMask = vk::AccessFlagBits::eTransferWrite, .dstAccessMask = vk::AccessFlagBits::eHostRead},
+            {},
+            {});
+    }
+
+    if (*timestampQueries)
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *timestampQueries, firstTimestamp + 1);
+    commandBuffer.end();
+}
+
+void Renderer::ReadGpuTime(const FrameResources& frame)
+{
+    if (!*timestampQueries || !frame.submitted)
+        return;
+
+    const auto [result, timestamps] = timestampQueries.getResults<std::uint64_t>(
+        frameIndex * kTimestampsPerFrame,
+        kTimestampsPerFrame,
+        kTimestampsPerFrame * sizeof(std::uint64_t),
+        sizeof(std::uint64_t),
+        vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess)
+        return;
+
+    const std::uint64_t ticks = (timestamps[1] - timestamps[0]) & timestampMask;
+    latestTimings.gpu = std::chrono::duration<double, std::nano>(static_cast<double>(ticks) * timestampPeriodNs);
+}
+
+assets::Image Renderer::ReadbackLastFrame()
+{
+    ASSUMERT(readback);
+    const FrameResources& frame = frames[(frameIndex + kMaxFramesInFlight - 1) % kMaxFramesInFlight];
+    ASSUMERT(frame.submitted);
+
+    static_cast<void>(vulkanInvariants.device.waitForFences(*frame.submitFinished, true, std::numeric_limits<std::uint64_t>::max()));
+
+    assets::Image image{.width = frame.target.extent.width, .height = frame.target.extent.height};
+    image.pixels.assign(frame.readback.mapped, frame.readback.mapped + frame.readback.size);
+    return image;
+}
+
+std::vector<vk::CommandBuffer> Renderer::RecordBatch(FrameResources& frame, vk::Framebuffer framebuffer, vk::Extent2D extent) const
+{
+    const glm::vec2 scale = glm::vec2(2.0f, -2.0f) * view.pixelsPerUnit / glm::vec2(extent.width, extent.height);
+    const ViewConstants viewConstants{.scale = scale, .offset = -view.center * scale};
+    const vk::CommandBufferInheritanceInfo inheritance{.renderPass = *renderPass, .subpass = 0, .framebuffer = framebuffer};
+
+    // The instances are sorted by material. Every thread records a secondary buffer for an equal slice of them, with one draw
+    // per material in the slice, and the slices are executed in order.
+    jobs::JobSystem& jobSystem = Singleton<jobs::JobSystem>::Get();
+    const std::size_t instanceCount = batch.GetInstances().size();
+    const std::size_t sliceCount = (instanceCount + kMinInstancesPerSecondary - 1) / kMinInstancesPerSecondary;
+    const std::size_t secondaryCount = std::min(sliceCount, jobSystem.GetThreadCount());
+    std::vector<vk::CommandBuffer> secondaries(secondaryCount);
+    jobSystem.ParallelFor(
+        secondaryCount,
+        1,
+        [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t index = begin; index < end; ++index)
+            {
+                const std::size_t sliceBegin = instanceCount * index / secondaryCount;
+                const std::size_t sliceEnd = instanceCount * (index + 1) / secondaryCount;
+                const vk::raii::CommandBuffer& commandBuffer = frame.commands.BeginSecondary(inheritance);
+
+                // Secondary buffers inherit no state from the primary one.
+                commandBuffer.setViewport(
+                    0,
+                    vk::Viewport{
+                        .x = 0.0f, .y = 0.0f, .width = static_cast<float>(extent.width), .height = static_cast<float>(extent.height), .maxDepth = 1.0f});
+                commandBuffer.setScissor(0, vk::Rect2D{.offset = vk::Offset2D{0, 0}, .extent = extent});
+                commandBuffer.pushConstants<ViewConstants>(*batchPipelines.pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, viewConstants);
+                commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *batchPipelines.pipelineLayout, 0, *frame.textureSet, {});
+                commandBuffer.bindVertexBuffers(0, *frame.instances.buffer, vk::DeviceSize{0});
+                for (std::size_t material = 0; material < kMaterialCount; ++material)
+                {
+                    const InstanceBatch::Range range = batch.GetRange(static_cast<Material>(material));
+                    const std::size_t first = std::max<std::size_t>(sliceBegin, range.first);
+                    const std::size_t last = std::min<std::size_t>(sliceEnd, std::size_t{range.first} + range.count);
+                    if (first >= last)
+                        continue;
+                    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *batchPipelines.pipelines[material]);
+                    commandBuffer.draw(6, static_cast<std::uint32_t>(last - first), 0, static_cast<std::uint32_t>(first));
+                }
+                commandBuffer.end();
+
+                secondaries[index] = *commandBuffer;
+            }
+        });
+
+    return secondaries;
+}
+
+void Renderer::UploadInstances(FrameResources& frame)
+{
+    const std::span<const Instance> instances = batch.GetInstances();
+    if (instances.size_bytes() > frame.instances.size)
+        frame.instances = Buffer(
+            vulkanInvariants,
+            std::bit_ceil(instances.size_bytes()),
+            vk::BufferUsageFlagBits::eVertexBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+    if (!instances.empty())
+        std::memcpy(frame.instances.mapped, instances.data(), instances.size_bytes());
 }
 
-VulkanInvariants::VulkanInvariants(vulkan::util::RaiiWindowWrapper& windowWrapper)
-    : instance(CreateInstance()),
-      surface(instance, windowWrapper),
+void Renderer::UpdateTextures()
+{
+    assets::AssetManager& assetManager = Singleton<assets::AssetManager>::Get();
+    for (const InternedString path : batch.TakeNewTextures())
+        pendingTextures.push_back(assetManager.Request(path));
+
+    // The pixels of handled images live on the device now, the cache may evict them.
+    std::erase_if(pendingTextures, [this](const assets::ImageHandle& image) { return TryUploadTexture(image); });
+    uploader.Flush();
+}
+
+bool Renderer::TryUploadTexture(const assets::ImageHandle& image)
+{
+    switch (image.GetState())
+    {
+        case assets::AssetState::Loading:
+            return false;
+        case assets::AssetState::Failed:
+            return true;
+        case assets::AssetState::Ready:
+            break;
+    }
+
+    if (textures.size() == kMaxTextures)
+    {
+        Singleton<Logger>::Get().Log<LogLevel::Warning>(std::format("All {} texture slots are used, '{}' shows the placeholder.", kMaxTextures, image.GetPath()));
+        return true;
+    }
+    if (image.Get().pixels.size() > uploader.GetCapacity())
+    {
+        Singleton<Logger>::Get().Log<LogLevel::Warning>(std::format("'{}' does not fit the staging buffer and shows the placeholder.", image.GetPath()));
+        return true;
+    }
+
+    // Retried next frame, once earlier uploads freed their staging space.
+    std::optional<Texture> texture = uploader.UploadTexture(image.Get());
+    if (!texture)
+        return false;
+
+    batch.SetTextureSlot(image.GetPath(), static_cast<std::uint32_t>(textures.size()));
+    textures.push_back(std::move(*texture));
+    return true;
+}
+
+void Renderer::WriteTextureSlots(FrameResources& frame) const
+{
+    const std::uint32_t textureCount = static_cast<std::uint32_t>(textures.size());
+    if (frame.writtenTextureCount == textureCount)
+        return;
+
+    // Every slot of the array must be valid, the first write fills unused ones with the placeholder.
+    const std::uint32_t first = frame.writtenTextureCount;
+    const std::uint32_t end = first == 0 ? kMaxTextures : textureCount;
+    std::vector<vk::DescriptorImageInfo> imageInfos{};
+    imageInfos.reserve(end - first);
+    for (std::uint32_t slot = first; slot < end; ++slot)
+        imageInfos.push_back(
+            vk::DescriptorImageInfo{
+                .sampler = *batchPipelines.sampler,
+                .imageView = *textures[slot < textureCount ? slot : InstanceBatch::kPlaceholderSlot].view,
+                .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+            });
+
+    vulkanInvariants.device.updateDescriptorSets(
+        vk::WriteDescriptorSet{
+            .dstSet = *frame.textureSet,
+            .dstBinding = 0,
+            .dstArrayElement = first,
+            .descriptorCount = static_cast<std::uint32_t>(imageInfos.size()),
+            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+            .pImageInfo = imageInfos.data(),
+        },
+        {});
+    frame.writtenTextureCount = textureCount;
+}
+
+void Renderer::RecreateSwapchain()
+{
+    vulkanInvariants.device.waitIdle();
+
+    util::MoveDelete(swapchainWrapper);
+
+    vk::Extent2D extent = vulkanInvariants.physicalDevice.getSurfaceCapabilitiesKHR(*vulkanInvariants.surface).currentExtent;
+    // The surface size is determined by the swapchain, use the window size.
+    if (extent.width == kInvalidIndex<std::uint32_t>)
+    {
+        int width = 0;
+        int height = 0;
+        SDL_GetWindowSizeInPixels(*window, &width, &height);
+        extent = vk::Extent2D{.width = static_cast<std::uint32_t>(width), .height = static_cast<std::uint32_t>(height)};
+    }
+    // Minimized windows have no size to draw to.
+    if (extent.width == 0 || extent.height == 0)
+        return;
+
+    swapchainWrapper = CreateSwapchainWrapper(vulkanInvariants, surfaceFormat, renderPass, extent);
+}
+
+FrameCommandPools::FrameCommandPools(const VulkanInvariants& vulkan, std::size_t threadCount) : device(&vulkan.device)
+{
+    ASSUMERT(threadCount > 0);
+
+    const std::uint32_t graphicsFamily = vulkan.queuesInfo.GetQueueInfo(QueueTypeFlagBits::Graphics).familyIndex;
+    for (std::size_t thread = 0; thread < threadCount; ++thread)
+        threadPools.push_back(
+            ThreadPool{
+                .pool = vulkan.device.createCommandPool(
+                    vk::CommandPoolCreateInfo{.flags = vk::CommandPoolCreateFlagBits::eTransient, .queueFamilyIndex = graphicsFamily}),
+        });
+
+    primary = std::move(vulkan.device.allocateCommandBuffers(
+        vk::CommandBufferAllocateInfo{.commandPool = *threadPools[0].pool, .level = vk::CommandBufferLevel::ePrimary, .commandBufferCount = 1})[0]);
+}
+
+void FrameCommandPools::Reset()
+{
+    for (ThreadPool& threadPool : threadPools)
+    {
+        threadPool.pool.reset();
+        threadPool.usedSecondaries = 0;
+    }
+}
+
+const vk::raii::CommandBuffer& FrameCommandPools::BeginSecondary(const vk::CommandBufferInheritanceInfo& inheritance)
+{
+    const std::optional<std::size_t> threadIndex = Singleton<jobs::JobSystem>::Get().GetThreadIndex();
+    ASSUMERT(threadIndex.has_value() && *threadIndex < threadPools.size());
+
+    ThreadPool& threadPool = threadPools[*threadIndex];
+    if (threadPool.usedSecondaries == threadPool.secondaries.size())
+        threadPool.secondaries.push_back(std::move(device->allocateCommandBuffers(
+            vk::CommandBufferAllocateInfo{.commandPool = *threadPool.pool, .level = vk::CommandBufferLevel::eSecondary, .commandBufferCount = 1})[0]));
+
+    const vk::raii::CommandBuffer& commandBuffer = threadPool.secondaries[threadPool.usedSecondaries++];
+    commandBuffer.begin(
+        vk::CommandBufferBeginInfo{
+            .flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+            .pInheritanceInfo = &inheritance,
+        });
+    return commandBuffer;
+}
+
+Uploader::Uploader(const VulkanInvariants& vulkan, vk::DeviceSize capacity)
+    : vulkan(&vulkan),
+      transferFamily(vulkan.queuesInfo.GetQueueInfo(QueueTypeFlagBits::Transfer).familyIndex),
+      graphicsFamily(vulkan.queuesInfo.GetQueueInfo(QueueTypeFlagBits::Graphics).familyIndex),
+      staging(vulkan, capacity, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent)
+{
+    vk::SemaphoreTypeCreateInfo timelineInfo{.semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0};
+    timeline = vulkan.device.createSemaphore(vk::SemaphoreCreateInfo{.pNext = &timelineInfo});
+    // Command buffers are reused one by one, as batches finish in order but not all at once.
+    commandPool = vulkan.device.createCommandPool(
+        vk::CommandPoolCreateInfo{.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer, .queueFamilyIndex = transferFamily});
+}
+
+std::optional<Texture> Uploader::UploadTexture(const assets::Image& image)
+{
+    const std::optional<vk::DeviceSize> offset = Allocate(image.pixels.size());
+    if (!offset)
+        return std::nullopt;
+    std::memcpy(staging.mapped + *offset, image.pixels.data(), image.pixels.size());
+
+    if (!*recording.commandBuffer)
+    {
+        if (freeCommandBuffers.empty())
+            recording.commandBuffer = std::move(vulkan->device.allocateCommandBuffers(
+                vk::CommandBufferAllocateInfo{.commandPool = *commandPool, .level = vk::CommandBufferLevel::ePrimary, .commandBufferCount = 1})[0]);
+        else
+        {
+            recording.commandBuffer = std::move(freeCommandBuffers.back());
+            freeCommandBuffers.pop_back();
+        }
+        recording.commandBuffer.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    }
+
+    Texture texture(*vulkan, vk::Extent2D{.width = image.width, .height = image.height});
+    TransitionImage(
+        recording.commandBuffer,
+        *texture.image,
+        vk::ImageLayout::eUndefined,
+        vk::ImageLayout::eTransferDstOptimal,
+        vk::PipelineStageFlagBits::eTopOfPipe,
+        {},
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::AccessFlagBits::eTransferWrite);
+    recording.commandBuffer.copyBufferToImage(
+        *staging.buffer,
+        *texture.image,
+        vk::ImageLayout::eTransferDstOptimal,
+        vk::BufferImageCopy{
+            .bufferOffset = *offset,
+            .imageSubresource = vk::ImageSubresourceLayers{.aspectMask = vk::ImageAspectFlagBits::eColor, .layerCount = 1},
+            .imageExtent = vk::Extent3D{.width = image.width, .height = image.height, .depth = 1},
+    });
+
+    // A dedicated family releases the image here and graphics acquires it. A shared family needs only the transition, done by
+    // graphics too, so every later frame sampling the image is ordered after it. The timeline semaphore makes the copy visible.
+    const bool sharedFamily = transferFamily == graphicsFamily;
+    vk::ImageMemoryBarrier barrier{
+        .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+        .dstAccessMask = {},
+        .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+        .newLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        .srcQueueFamilyIndex = sharedFamily ? vk::QueueFamilyIgnored : transferFamily,
+        .dstQueueFamilyIndex = sharedFamily ? vk::QueueFamilyIgnored : graphicsFamily,
+        .image = *texture.image,
+        .subresourceRange = vk::ImageSubresourceRange{.aspectMask = vk::ImageAspectFlagBits::eColor, .levelCount = 1, .layerCount = 1},
+    };
+    if (!sharedFamily)
+        recording.commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {}, barrier);
+
+    barrier.srcAccessMask = {};
+    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+    handoff.acquires.push_back(barrier);
+    return texture;
+}
+
+void Uploader::Flush()
+{
+    if (!*recording.commandBuffer)
+        return;
+
+    recording.commandBuffer.end();
+    recording.value = ++submittedValue;
+    const vk::TimelineSemaphoreSubmitInfo timelineInfo{.signalSemaphoreValueCount = 1, .pSignalSemaphoreValues = &recording.value};
+    vulkan->queues.transfer.submit(
+        vk::SubmitInfo{
+            .pNext = &timelineInfo,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &*recording.commandBuffer,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &*timeline,
+        });
+
+    handoff.waitValue = recording.value;
+    inFlight.push_back(std::exchange(recording, Batch{}));
+}
+
+void Uploader::Retire()
+{
+    const std::uint64_t finishedValue = timeline.getCounterValue();
+    while (!inFlight.empty() && inFlight.front().value <= finishedValue)
+    {
+        usedSize -= inFlight.front().size;
+        freeCommandBuffers.push_back(std::move(inFlight.front().commandBuffer));
+        inFlight.pop_front();
+    }
+
+    // Allocations may start anywhere once nothing is in use, so start over for the most contiguous room.
+    if (usedSize == 0)
+        head = 0;
+}
+
+std::optional<vk::DeviceSize> Uploader::Allocate(vk::DeviceSize size)
+{
+    Retire();
+
+    const vk::DeviceSize alignedSize = (size + kStagingAlignment - 1) / kStagingAlignment * kStagingAlignment;
+    // Allocations are contiguous, the end of the ring is skipped when the allocation does not fit there.
+    const bool wrap = head + alignedSize > staging.size;
+    const vk::DeviceSize skipped = wrap ? staging.size - head : 0;
+    if (usedSize + skipped + alignedSize > staging.size)
+        return std::nullopt;
+
+    const vk::DeviceSize offset = wrap ? 0 : head;
+    head = offset + alignedSize;
+    usedSize += skipped + alignedSize;
+    recording.size += skipped + alignedSize;
+    return offset;
+}
+
+Buffer::Buffer(const VulkanInvariants& vulkan, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties)
+    : buffer(vulkan.device.createBuffer(vk::BufferCreateInfo{.size = size, .usage = usage, .sharingMode = vk::SharingMode::eExclusive})), size(size)
+{
+    const vk::MemoryRequirements requirements = buffer.getMemoryRequirements();
+    memory = vulkan.device.allocateMemory(
+        vk::MemoryAllocateInfo{
+            .allocationSize = requirements.size,
+            .memoryTypeIndex = vulkan::util::FindMemoryType(vulkan.physicalDevice, requirements.memoryTypeBits, properties),
+        });
+    buffer.bindMemory(*memory, 0);
+
+    if (properties & vk::MemoryPropertyFlagBits::eHostVisible)
+        mapped = static_cast<std::byte*>(memory.mapMemory(0, vk::WholeSize));
+}
+
+Texture::Texture(const VulkanInvariants& vulkan, vk::Extent2D extent, vk::ImageUsageFlags usage) : extent(extent)
+{
+    image = vulkan.device.createImage(
+        vk::ImageCreateInfo{
+            .imageType = vk::ImageType::e2D,
+            .format = vk::Format::eR8G8B8A8Unorm,
+            .extent = vk::Extent3D{.width = extent.width, .height = extent.height, .depth = 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = usage,
+            .sharingMode = vk::SharingMode::eExclusive,
+            .initialLayout = vk::ImageLayout::eUndefined,
+        });
+
+    const vk::MemoryRequirements requirements = image.getMemoryRequirements();
+    memory = vulkan.device.allocateMemory(
+        vk::MemoryAllocateInfo{
+            .allocationSize = requirements.size,
+            .memoryTypeIndex =
+                vulkan::util::FindMemoryType(vulkan.physicalDevice, requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal),
+        });
+    image.bindMemory(*memory, 0);
+    view = CreateImageView(vulkan.device, *image, vk::Format::eR8G8B8A8Unorm);
+}
+
+BatchPipelines::BatchPipelines(const VulkanInvariants& vulkan, const vk::raii::RenderPass& renderPass)
+{
+    const vk::raii::Device& device = vulkan.device;
+
+    sampler = device.createSampler(
+        vk::SamplerCreateInfo{
+            .magFilter = vk::Filter::eLinear,
+            .minFilter = vk::Filter::eLinear,
+            .mipmapMode = vk::SamplerMipmapMode::eNearest,
+            .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+            .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+        });
+
+    const vk::DescriptorSetLayoutBinding textureBinding{
+        .binding = 0,
+        .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+        .descriptorCount = kMaxTextures,
+        .stageFlags = vk::ShaderStageFlagBits::eFragment,
+    };
+    descriptorSetLayout = device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo{.bindingCount = 1, .pBindings = &textureBinding});
+
+    const vk::PushConstantRange pushConstantRange{.stageFlags = vk::ShaderStageFlagBits::eVertex, .offset = 0, .size = sizeof(ViewConstants)};
+    pipelineLayout = device.createPipelineLayout(
+        vk::PipelineLayoutCreateInfo{
+            .setLayoutCount = 1,
+            .pSetLayouts = &*descriptorSetLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+        });
+
+    const vk::raii::ShaderModule vertexShader =
+        device.createShaderModule(vk::ShaderModuleCreateInfo{.codeSize = sizeof(kBatchVertexShader), .pCode = kBatchVertexShader});
+    const vk::raii::ShaderModule fragmentShader =
+        device.createShaderModule(vk::ShaderModuleCreateInfo{.codeSize = sizeof(kBatchFragmentShader), .pCode = kBatchFragmentShader});
+
+    // One instance per quad, the corners come from the vertex index.
+    const vk::VertexInputBindingDescription instanceBinding{.binding = 0, .stride = sizeof(Instance), .inputRate = vk::VertexInputRate::eInstance};
+    const std::array instanceAttributes{
+        vk::VertexInputAttributeDescription{.location = 0, .binding = 0, .format = vk::Format::eR32G32Sfloat, .offset = offsetof(Instance, position)},
+        vk::VertexInputAttributeDescription{.location = 1, .binding = 0, .format = vk::Format::eR32G32Sfloat, .offset = offsetof(Instance, size)},
+        vk::VertexInputAttributeDescription{.location = 2, .binding = 0, .format = vk::Format::eR32Sfloat, .offset = offsetof(Instance, rotation)},
+        vk::VertexInputAttributeDescription{.location = 3, .binding = 0, .format = vk::Format::eR32Uint, .offset = offsetof(Instance, textureSlot)},
+        vk::VertexInputAttributeDescription{.location = 4, .binding = 0, .format = vk::Format::eR32G32B32A32Sfloat, .offset = offsetof(Instance, color)},
+    };
+    const vk::PipelineVertexInputStateCreateInfo vertexInputState{
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &instanceBinding,
+        .vertexAttributeDescriptionCount = static_cast<std::uint32_t>(instanceAttributes.size()),
+        .pVertexAttributeDescriptions = instanceAttributes.data(),
+    };
+    const vk::PipelineInputAssemblyStateCreateInfo inputAssemblyState{.topology = vk::PrimitiveTopology::eTriangleList};
+    // Set when recording, so the pipelines survive swapchain recreation.
+    const vk::PipelineViewportStateCreateInfo viewportState{.viewportCount = 1, .scissorCount = 1};
+    const std::array dynamicStates{vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    const vk::PipelineDynamicStateCreateInfo dynamicState{
+        .dynamicStateCount = static_cast<std::uint32_t>(dynamicStates.size()),
+        .pDynamicStates = dynamicStates.data(),
+    };
+    const vk::PipelineRasterizationStateCreateInfo rasterizationState{
+        .polygonMode = vk::PolygonMode::eFill,
+        .cullMode = vk::CullModeFlagBits::eNone,
+        .frontFace = vk::FrontFace::eCounterClockwise,
+        .lineWidth = 1.0f,
+    };
+    const vk::PipelineMultisampleStateCreateInfo multisampleState{.rasterizationSamples = vk::SampleCountFlagBits::e1};
+    const vk::PipelineColorBlendAttachmentState blendAttachment{
+        .blendEnable = true,
+        .srcColorBlendFactor = vk::BlendFactor::eSrcAlpha,
+        .dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+        .colorBlendOp = vk::BlendOp::eAdd,
+        .srcAlphaBlendFactor = vk::BlendFactor::eOne,
+        .dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+        .alphaBlendOp = vk::BlendOp::eAdd,
+        .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
+    };
+    const vk::PipelineColorBlendStateCreateInfo colorBlendState{.attachmentCount = 1, .pAttachments = &blendAttachment};
+
+    // The fragment shader branches on the material at pipeline creation, not per fragment.
+    const vk::SpecializationMapEntry materialEntry{.constantID = 0, .offset = 0, .size = sizeof(std::uint32_t)};
+    for (std::uint32_t material = 0; material < kMaterialCount; ++material)
+    {
+        const vk::SpecializationInfo specialization{.mapEntryCount = 1, .pMapEntries = &materialEntry, .dataSize = sizeof(material), .pData = &material};
+        const std::array stages{
+            vk::PipelineShaderStageCreateInfo{.stage = vk::ShaderStageFlagBits::eVertex, .module = *vertexShader, .pName = "main"},
+            vk::PipelineShaderStageCreateInfo{
+                                              .stage = vk::ShaderStageFlagBits::eFragment,
+                                              .module = *fragmentShader,
+                                              .pName = "main",
+                                              .pSpecializationInfo = &specialization,
+                                              },
+        };
+
+        pipelines.push_back(device.createGraphicsPipeline(
+            nullptr,
+            vk::GraphicsPipelineCreateInfo{
+                .stageCount = static_cast<std::uint32_t>(stages.size()),
+                .pStages = stages.data(),
+                .pVertexInputState = &vertexInputState,
+                .pInputAssemblyState = &inputAssemblyState,
+                .pViewportState = &viewportState,
+                .pRasterizationState = &rasterizationState,
+                .pMultisampleState = &multisampleState,
+                .pColorBlendState = &colorBlendState,
+                .pDynamicState = &dynamicState,
+                .layout = *pipelineLayout,
+                .renderPass = *renderPass,
+                .subpass = 0,
+            }));
+    }
+}
+
+VulkanInvariants::VulkanInvariants(vulkan::util::RaiiWindowWrapper* windowWrapper)
+    : instance(CreateInstance(windowWrapper != nullptr)),
+      surface(CreateSurface(windowWrapper)),
       physicalDevice(ChoosePhysicalDevice()),
       queuesInfo(physicalDevice, surface, physicalDevice.getQueueFamilyProperties()),
       device(CreateDevice()),
-      queues(RetrieveQueues())
+      queues(RetrieveQueues()),
+      commandPool(CreateCommandPool())
 {
 }
 
-vk::raii::Instance VulkanInvariants::CreateInstance()
+vk::raii::Instance VulkanInvariants::CreateInstance(bool presentable)
 {
     vk::ApplicationInfo applicationInfo{
         .pApplicationName = "Renderer",
@@ -38,10 +1018,11 @@ vk::raii::Instance VulkanInvariants::CreateInstance()
         .apiVersion = vulkan::kVulkanApiVersion_1_4,
     };
 
+    // Without a window SDL is not asked, as its video subsystem needs a display.
     uint32_t extensionCount = 0;
-    auto extensions = SDL_Vulkan_GetInstanceExtensions(&extensionCount);
+    const char* const* extensions = presentable ? SDL_Vulkan_GetInstanceExtensions(&extensionCount) : nullptr;
 
-    if (!vulkan::util::AreInstanceExtensionsSupported(context, std::span(extensions, extensionCount)))
+    if (presentable && !vulkan::util::AreInstanceExtensionsSupported(context, std::span(extensions, extensionCount)))
         throw std::runtime_error("Necessary SDL extensions are not supported.");
 
     const std::vector<const char*> validationLayers = {"VK_LAYER_KHRONOS_validation"};
@@ -57,6 +1038,13 @@ vk::raii::Instance VulkanInvariants::CreateInstance()
         });
 }
 
+vulkan::util::RaiiSurfaceWrapper VulkanInvariants::CreateSurface(vulkan::util::RaiiWindowWrapper* windowWrapper)
+{
+    if (windowWrapper == nullptr)
+        return vulkan::util::RaiiSurfaceWrapper();
+    return vulkan::util::RaiiSurfaceWrapper(instance, *windowWrapper);
+}
+
 vk::raii::PhysicalDevice VulkanInvariants::ChoosePhysicalDevice()
 {
     std::vector<vk::raii::PhysicalDevice> physicalDevices = instance.enumeratePhysicalDevices();
@@ -84,9 +1072,15 @@ vk::raii::Device VulkanInvariants::CreateDevice()
 
     auto deviceQueueCreateInfos = queuesInfo.GetDeviceQueueCreateInfos();
 
-    const std::vector<const char*> deviceExtensions = {"VK_KHR_swapchain"};
+    std::vector<const char*> deviceExtensions{};
+    if (*surface)
+        deviceExtensions.push_back("VK_KHR_swapchain");
+
+    // Sprites index the texture array with a slot per instance, uploads are tracked with a timeline semaphore.
+    vk::PhysicalDeviceVulkan12Features vulkan12Features{.shaderSampledImageArrayNonUniformIndexing = true, .timelineSemaphore = true};
 
     vk::DeviceCreateInfo deviceCreateInfo{
+        .pNext = &vulkan12Features,
         .queueCreateInfoCount = static_cast<uint32_t>(deviceQueueCreateInfos.size()),
         .pQueueCreateInfos = deviceQueueCreateInfos.data(),
         .enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()),
@@ -100,7 +1094,7 @@ VulkanInvariants::Queues VulkanInvariants::RetrieveQueues()
 {
     auto retrieveQueue = [this](QueueTypeFlagBits qt)
     {
-        QueuesInfo::QueueInfo info = queuesInfo.GetQueueInfo(QueueTypeFlagBits::Present);
+        QueuesInfo::QueueInfo info = queuesInfo.GetQueueInfo(qt);
         return device.getQueue(info.familyIndex, info.queueIndex);
     };
 
@@ -108,9 +1102,20 @@ VulkanInvariants::Queues VulkanInvariants::RetrieveQueues()
         .graphics = retrieveQueue(QueueTypeFlagBits::Graphics),
         .compute = retrieveQueue(QueueTypeFlagBits::Compute),
         .transfer = retrieveQueue(QueueTypeFlagBits::Transfer),
+        .dedicatedTransfer = queuesInfo.HasDedicatedTransferQueue(),
+        .dedicatedCompute = queuesInfo.HasDedicatedComputeQueue(),
     };
 }
 
+vk::raii::CommandPool VulkanInvariants::CreateCommandPool()
+{
+    return device.createCommandPool(
+        vk::CommandPoolCreateInfo{
+            .flags = vk::CommandPoolCreateFlagBits::eTransient,
+            .queueFamilyIndex = queuesInfo.GetQueueInfo(QueueTypeFlagBits::Graphics).familyIndex,
+        });
+}
+
 QueuesInfo::QueuesInfo(
     const vk::raii::PhysicalDevice& physicalDevice,
     const vulkan::util::RaiiSurfaceWrapper& surface,
@@ -119,7 +1124,9 @@ QueuesInfo::QueuesInfo(
     const auto GetFamilyCapabilities = [&](const std::uint64_t familyIndex, const vk::QueueFamilyProperties& familyProperties) -> QueueType
     {
         QueueType result{};
-        if (physicalDevice.getSurfaceSupportKHR(familyIndex, *surface))
+        const bool present = *surface ? static_cast<bool>(physicalDevice.getSurfaceSupportKHR(familyIndex, *surface))
+                                       : static_cast<bool>(familyProperties.queueFlags & vk::QueueFlagBits::eGraphics);
+        if (present)
             result |= QueueTypeFlagBits::Present;
         if (familyProperties.queueFlags & vk::QueueFlagBits::eGraphics)
             result |= QueueTypeFlagBits::Graphics;
@@ -307,6 +1314,14 @@ PhysicalDeviceCandidate::PhysicalDeviceCandidate(vk::raii::PhysicalDevice& physi
     auto queueFamiliesProperties = physicalDevice.getQueueFamilyProperties();
     queuesInfo = QueuesInfo(physicalDevice, surface, queueFamiliesProperties);
 
+    if (properties.apiVersion >= vulkan::MakeApiVersion(0, 1, 2, 0))
+    {
+        const vk::PhysicalDeviceVulkan12Features vulkan12Features =
+            physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>().get<vk::PhysicalDeviceVulkan12Features>();
+        supportsNonUniformTextureIndexing = vulkan12Features.shaderSampledImageArrayNonUniformIndexing;
+        supportsTimelineSemaphores = vulkan12Features.timelineSemaphore;
+    }
+
     if (!*printPhysicalDeviceDetails)
         return;
 
@@ -322,7 +1337,7 @@ PhysicalDeviceCandidate::PhysicalDeviceCandidate(vk::raii::PhysicalDevice& physi
                 "    {}. Flags: {}, Surface support: {}, Count: {}",
                 index,
                 vk::to_string(queueFamily.queueFlags),
-                static_cast<bool>(physicalDevice.getSurfaceSupportKHR(index, *surface)),
+                *surface && static_cast<bool>(physicalDevice.getSurfaceSupportKHR(index, *surface)),
                 queueFamily.queueCount));
 
     Singleton<Logger>::Get().Log(queuesInfo.ToString());
@@ -330,7 +1345,7 @@ PhysicalDeviceCandidate::PhysicalDeviceCandidate(vk::raii::PhysicalDevice& physi
 
 bool PhysicalDeviceCandidate::IsUsable() const noexcept
 {
-    return queuesInfo.IsValid();
+    return queuesInfo.IsValid() && supportsNonUniformTextureIndexing && supportsTimelineSemaphores;
 }
 
 std::weak_ordering PhysicalDeviceCandidate::operator<=>(const PhysicalDeviceCandidate& other) const noexcept
@@ -4,20 +4,35 @@ module;
 module runtime;
 
 import test;
+import benchmark;
 import logger;
 import singleton;
 import util;
 import concepts;
 import config_renderer;
+import jobs;
+import assets;
+import renderer;
+import ecs;
+import components;
+import glm;
+import std;
 
 namespace tektonik
 {
 
 void Runtime::Init()
 {
-    auto argMap = util::string::ParseCommandLineArgumentsToMap(runOptions.argc, runOptions.argv);
+    auto argMap = ParseConfigOverrides(runOptions);
     Singleton<Logger>::Get().Log(std::format("Loaded command line arguments: {}", argMap));
 
+    // Without a window there are no events to wait for, so the loop below would spin.
+    if (*headless)
+    {
+        RunHeadless();
+        return;
+    }
+
     SDL_Event event;
 
     bool running = true;
@@ -31,16 +46,68 @@ void Runtime::Init()
                 break;
             }
 
-            configRenderer.HandleEvent(event);
+            if (configRenderer)
+                configRenderer->HandleEvent(event);
         }
 
-        configRenderer.Tick();
+        Singleton<jobs::JobSystem>::Get().PumpMainThread();
+        Singleton<assets::AssetManager>::Get().Update();
+        if (configRenderer)
+            configRenderer->Tick();
     }
 }
 
+void Runtime::RunHeadless()
+{
+    static config::ConfigU32 frameCount("HeadlessFrameCount", 100);
+
+    using namespace components;
+    using Manager = ecs::ComponentManager<Transform2D, Box2D, Circle2D, Sprite, Color>;
+    ecs::World<Manager> world{};
+    // A grid of boxes and circles that covers the default 800x600 offscreen image at one pixel per world unit.
+    for (int x = -360; x <= 360; x += 40)
+    {
+        for (int y = -260; y <= 260; y += 40)
+        {
+            const Transform2D transform{.position = {static_cast<float>(x), static_cast<float>(y)}};
+            if ((x + y) % 80 == 0)
+                world.CreateEntities(1, transform, Box2D{.size = {24.0f, 24.0f}}, Color{.color = glm::vec4(1.0f, 0.5f, 0.0f, 1.0f)});
+            else
+                world.CreateEntities(1, transform, Circle2D{.radius = 12.0f}, Color{.color = glm::vec4(0.0f, 0.5f, 1.0f, 1.0f)});
+        }
+    }
+
+    std::chrono::duration<double, std::milli> cpuTotal{};
+    for (std::uint32_t frame = 0; frame < *frameCount; ++frame)
+    {
+        for (float& rotation : world.GetComponentManager().GetFieldColumn<Transform2D, 1>())
+            rotation += 0.01f;
+
+        Singleton<jobs::JobSystem>::Get().PumpMainThread();
+        Singleton<assets::AssetManager>::Get().Update();
+        renderer.Render(world);
+        cpuTotal += renderer.GetLatestTimings().cpu;
+    }
+
+    const renderer::Renderer::FrameTimings timings = renderer.GetLatestTimings();
+    Singleton<Logger>::Get().Log(std::format(
+        "Rendered {} headless frames, average cpu {:.3f} ms, latest cpu {:.3f} ms, latest gpu {:.3f} ms",
+        *frameCount,
+        *frameCount > 0 ? cpuTotal.count() / *frameCount : 0.0,
+        timings.cpu.count(),
+        timings.gpu.count()));
+}
+
 void Runtime::Test() const
 {
     test::RunAll();
 }
 
+void Runtime::Benchmark() const
+{
+    static config::ConfigBool runBenchmarks("RunBenchmarks", false);
+    if (*runBenchmarks)
+        benchmark::RunAll();
+}
+
 }  // namespace tektonik
@@ -0,0 +1,141 @@
+module;
+#include "common-defines.hpp"
+module snapshot;
+
+import assert;
+
+namespace tektonik::snapshot
+{
+
+std::size_t BlobReader::ReadSize()
+{
+    std::uint64_t size = 0;
+    ReadBytes(&size, sizeof(size));
+    if (size > bytes.size() - position)
+        throw SnapshotError(std::format("Size {} exceeds the remaining {} bytes.", size, bytes.size() - position));
+    return static_cast<std::size_t>(size);
+}
+
+void BlobReader::ReadBytes(void* data, std::size_t size)
+{
+    if (size > bytes.size() - position)
+        throw SnapshotError(std::format("Reading {} bytes past the end of the blob.", size - (bytes.size() - position)));
+    if (size > 0)
+        std::memcpy(data, bytes.data() + position, size);
+    position += size;
+}
+
+SnapshotView::SnapshotView(std::span<const std::byte> bytes) : bytes(bytes)
+{
+    if (reinterpret_cast<std::uintptr_t>(bytes.data()) % alignof(std::max_align_t) != 0)
+        throw SnapshotError("Snapshot memory is not sufficiently aligned.");
+    if (bytes.size() < sizeof(Header))
+        throw SnapshotError(std::format("Snapshot of {} bytes is too small for its header.", bytes.size()));
+
+    std::memcpy(&header, bytes.data(), sizeof(Header));
+    if (header.magic != kMagic)
+        throw SnapshotError("Not a snapshot.");
+    if (header.version != kVersion)
+        throw SnapshotError(std::format("Snapshot version {} is not supported, expected {}.", header.version, kVersion));
+    if (header.signatureWordCount != (header.componentTypeCount + 63) / 64)
+        throw SnapshotError("Signature word count does not match the component type count.");
+
+    CheckSection(header.generationsOffset, header.generationCount, sizeof(std::uint32_t), alignof(std::uint32_t));
+    CheckSection(header.entitiesOffset, header.entityCount, sizeof(ecs::Entity), alignof(ecs::Entity));
+    if (header.signatureWordCount > 0 && header.entityCount > std::numeric_limits<std::uint64_t>::max() / header.signatureWordCount)
+        throw SnapshotError("Signature section is too large.");
+    CheckSection(header.signaturesOffset, header.entityCount * header.signatureWordCount, sizeof(std::uint64_t), alignof(std::uint64_t));
+    CheckSection(header.columnsOffset, header.componentTypeCount, sizeof(Column), alignof(Column));
+    CheckSection(header.blobOffset, header.blobSize, 1, 1);
+
+    for (std::size_t typeIndex = 0; typeIndex < header.componentTypeCount; ++typeIndex)
+    {
+        const Column& column = GetColumn(typeIndex);
+        CheckSection(column.entitiesOffset, column.count, sizeof(ecs::Entity), alignof(ecs::Entity));
+        if (column.isTriviallyCopyable)
+        {
+            if (column.elementAlignment == 0 || !std::has_single_bit(column.elementAlignment) || column.elementAlignment > kSectionAlignment)
+                throw SnapshotError(std::format("Column {} has an invalid alignment of {}.", typeIndex, column.elementAlignment));
+            CheckSection(column.dataOffset, column.count, column.elementSize, column.elementAlignment);
+        }
+        else if (column.dataOffset > header.blobSize || column.dataSize > header.blobSize - column.dataOffset)
+            throw SnapshotError(std::format("Column {} is outside of the blob section.", typeIndex));
+    }
+}
+
+const Column& SnapshotView::GetColumn(std::size_t typeIndex) const
+{
+    ASSUMERT(typeIndex < header.componentTypeCount);
+    return GetArray<Column>(header.columnsOffset, header.componentTypeCount)[typeIndex];
+}
+
+std::span<const ecs::Entity> SnapshotView::GetColumnEntities(std::size_t typeIndex) const
+{
+    const Column& column = GetColumn(typeIndex);
+    return GetArray<ecs::Entity>(column.entitiesOffset, column.count);
+}
+
+std::span<const std::byte> SnapshotView::GetBlob(const Column& column) const
+{
+    ASSUMERT(!column.isTriviallyCopyable);
+    return bytes.subspan(header.blobOffset + column.dataOffset, column.dataSize);
+}
+
+void SnapshotView::ValidateEntities() const
+{
+    const std::span<const std::uint32_t> generations = GetGenerations();
+    const std::span<const ecs::Entity> entities = GetEntities();
+
+    // Alive entities have odd generations, see ecs::EntityManager.
+    const auto isAlive = [&](ecs::Entity entity) { return entity < generations.size() && generations[entity] % 2 == 1; };
+    for (std::size_t i = 0; i < entities.size(); ++i)
+    {
+        if (!isAlive(entities[i]))
+            throw SnapshotError(std::format("Entity {} is listed, but not alive.", entities[i]));
+        if (i > 0 && entities[i] <= entities[i - 1])
+            throw SnapshotError("Entities are not in strictly ascending order.");
+    }
+    if (static_cast<std::size_t>(std::ranges::count_if(generations, [](std::uint32_t generation) { return generation % 2 == 1; })) != entities.size())
+        throw SnapshotError("Not every alive entity is listed.");
+
+    const std::span<const std::uint64_t> signatureWords = GetSignatureWords();
+    std::vector<bool> listed(entities.size());
+    for (std::size_t typeIndex = 0; typeIndex < header.componentTypeCount; ++typeIndex)
+    {
+        const auto hasComponent = [&](std::size_t row)
+        { return (signatureWords[row * header.signatureWordCount + typeIndex / 64] >> (typeIndex % 64)) & 1; };
+
+        listed.assign(entities.size(), false);
+        for (const ecs::Entity entity : GetColumnEntities(typeIndex))
+        {
+            const auto found = std::ranges::lower_bound(entities, entity);
+            if (found == entities.end() || *found != entity)
+                throw SnapshotError(std::format("Column {} has entity {}, which is not alive.", typeIndex, entity));
+            const std::size_t row = static_cast<std::size_t>(found - entities.begin());
+            if (listed[row])
+                throw SnapshotError(std::format("Column {} has entity {} more than once.", typeIndex, entity));
+            if (!hasComponent(row))
+                throw SnapshotError(std::format("Column {} has entity {}, whose signature lacks the component.", typeIndex, entity));
+            listed[row] = true;
+        }
+
+        // Every listed entity has the bit, so equal counts mean every entity with the bit is listed.
+        std::size_t signatureCount = 0;
+        for (std::size_t row = 0; row < entities.size(); ++row)
+            signatureCount += hasComponent(row);
+        if (signatureCount != GetColumn(typeIndex).count)
+            throw SnapshotError(std::format("Column {} lacks entities whose signature has the component.", typeIndex));
+    }
+}
+
+void SnapshotView::CheckSection(std::uint64_t offset, std::uint64_t count, std::uint64_t elementSize, std::uint64_t alignment) const
+{
+    if (offset % alignment != 0)
+        throw SnapshotError(std::format("Section at {} is not aligned to {}.", offset, alignment));
+    if (elementSize > 0 && count > std::numeric_limits<std::uint64_t>::max() / elementSize)
+        throw SnapshotError(std::format("Section at {} is too large.", offset));
+    if (offset > bytes.size() || count * elementSize > bytes.size() - offset)
+        throw SnapshotError(std::format("Section at {} with {} bytes is outside of the snapshot.", offset, count * elementSize));
+}
+
+}  // namespace tektonik::snapshot
@@ -0,0 +1,779 @@
+module;
+#include "common-defines.hpp"
+module spatial;
+
+import transform;
+import assert;
+
+namespace tektonik::spatial
+{
+
+namespace
+{
+
+// Cell coordinates are clamped, so far away points share border cells instead of overflowing.
+constexpr float kMaxCellCoordinate = static_cast<float>(1 << 30);
+
+// Parameters at which the ray enters and leaves the aabb, clipped to [0, maxDistance].
+std::optional<std::pair<float, float>> IntersectRange(const Ray& ray, const Aabb& aabb, float maxDistance)
+{
+    float entry = 0;
+    float exit = maxDistance;
+    for (glm::length_t axis = 0; axis < 2; ++axis)
+    {
+        if (ray.direction[axis] == 0)
+        {
+            if (ray.origin[axis] < aabb.min[axis] || ray.origin[axis] > aabb.max[axis])
+                return std::nullopt;
+            continue;
+        }
+
+        const float inverseDirection = 1.0f / ray.direction[axis];
+        float near = (aabb.min[axis] - ray.origin[axis]) * inverseDirection;
+        float far = (aabb.max[axis] - ray.origin[axis]) * inverseDirection;
+        if (near > far)
+            std::swap(near, far);
+        entry = std::max(entry, near);
+        exit = std::min(exit, far);
+        if (entry > exit)
+            return std::nullopt;
+    }
+    return std::pair{entry, exit};
+}
+
+// Keeps the closest candidate within the squared distance or ray parameter limit.
+struct ClosestHit
+{
+    std::optional<Hit> hit{};
+    float limit = 0;
+
+    void Consider(Entity entity, float distance)
+    {
+        if (distance > limit || (hit && distance == limit))
+            return;
+        hit = Hit{.entity = entity, .distance = distance};
+        limit = distance;
+    }
+};
+
+// Fixed size stack for tree traversals, deeper than a balanced tree of any realistic size.
+class NodeStack
+{
+  public:
+    void Push(std::int32_t node)
+    {
+        ASSUMERT(size < nodes.size());
+        nodes[size++] = node;
+    }
+    std::int32_t Pop() { return nodes[--size]; }
+    bool IsEmpty() const { return size == 0; }
+
+  private:
+    std::array<std::int32_t, 256> nodes;
+    size_t size = 0;
+};
+
+}  // namespace
+
+Aabb Union(const Aabb& first, const Aabb& second)
+{
+    return Aabb{
+        .min = {std::min(first.min.x, second.min.x), std::min(first.min.y, second.min.y)},
+        .max = {std::max(first.max.x, second.max.x), std::max(first.max.y, second.max.y)},
+    };
+}
+
+Aabb Fatten(const Aabb& aabb, float margin)
+{
+    return Aabb{.min = {aabb.min.x - margin, aabb.min.y - margin}, .max = {aabb.max.x + margin, aabb.max.y + margin}};
+}
+
+float GetPerimeter(const Aabb& aabb)
+{
+    return 2.0f * ((aabb.max.x - aabb.min.x) + (aabb.max.y - aabb.min.y));
+}
+
+float GetDistanceSquared(const Aabb& aabb, glm::vec2 point)
+{
+    const float x = std::max({aabb.min.x - point.x, 0.0f, point.x - aabb.max.x});
+    const float y = std::max({aabb.min.y - point.y, 0.0f, point.y - aabb.max.y});
+    return x * x + y * y;
+}
+
+Aabb GetBounds(const components::Transform2D& transform, const components::Box2D& box)
+{
+    const auto [sin, cos] = transform::SinCos(transform.rotation);
+    const float halfWidth = std::abs(box.size.x * transform.scale.x) * 0.5f;
+    const float halfHeight = std::abs(box.size.y * transform.scale.y) * 0.5f;
+    const float extentX = std::abs(cos) * halfWidth + std::abs(sin) * halfHeight;
+    const float extentY = std::abs(sin) * halfWidth + std::abs(cos) * halfHeight;
+    return Aabb{
+        .min = {transform.position.x - extentX, transform.position.y - extentY},
+        .max = {transform.position.x + extentX, transform.position.y + extentY},
+    };
+}
+
+Aabb GetBounds(const components::Transform2D& transform, const components::Circle2D& circle)
+{
+    const float radius = circle.radius * std::max(std::abs(transform.scale.x), std::abs(transform.scale.y));
+    return Aabb{
+        .min = {transform.position.x - radius, transform.position.y - radius},
+        .max = {transform.position.x + radius, transform.position.y + radius},
+    };
+}
+
+std::optional<float> Intersect(const Ray& ray, const Aabb& aabb, float maxDistance)
+{
+    const auto range = IntersectRange(ray, aabb, maxDistance);
+    return range ? std::optional(range->first) : std::nullopt;
+}
+
+HashGrid::HashGrid(float cellSize) : cellSize(cellSize), inverseCellSize(1.0f / cellSize)
+{
+    ASSUMERT(cellSize > 0);
+}
+
+void HashGrid::Update(Entity entity, const Aabb& aabb)
+{
+    const CellRange range = GetCellRange(aabb);
+    if (CellRange* current = proxies.TryGet(entity))
+    {
+        if (*current != range)
+        {
+            Erase(entity, *current);
+            *current = range;
+            Insert(entity, aabb, range);
+            return;
+        }
+
+        for (std::int32_t y = range.min.y; y <= range.max.y; ++y)
+            for (std::int32_t x = range.min.x; x <= range.max.x; ++x)
+            {
+                std::vector<CellEntry>& entries = cells.find(GetKey({x, y}))->second;
+                std::ranges::find(entries, entity, &CellEntry::entity)->aabb = aabb;
+            }
+        return;
+    }
+
+    proxies.Add(entity, range);
+    Insert(entity, aabb, range);
+}
+
+void HashGrid::Remove(Entity entity)
+{
+    Erase(entity, proxies.Get(entity));
+    proxies.Remove(entity);
+}
+
+void HashGrid::GetEntities(std::vector<Entity>& results) const
+{
+    for (auto it = proxies.cbegin(); it != proxies.cend(); ++it)
+        results.push_back(it->index);
+}
+
+void HashGrid::QueryRegion(const Aabb& region, std::vector<Entity>& results) const
+{
+    CellRange range = GetCellRange(region);
+    range.min = {std::max(range.min.x, occupied.min.x), std::max(range.min.y, occupied.min.y)};
+    range.max = {std::min(range.max.x, occupied.max.x), std::min(range.max.y, occupied.max.y)};
+    if (range.min.x > range.max.x || range.min.y > range.max.y)
+        return;
+
+    // An entity in several cells is reported from the first cell it shares with the region only.
+    const auto visitCell = [&](Cell cell, const std::vector<CellEntry>& entries)
+    {
+        for (const CellEntry& entry : entries)
+        {
+            if (!entry.aabb.Overlaps(region))
+                continue;
+            const Cell entryMin = GetCell(entry.aabb.min);
+            if (std::max(range.min.x, entryMin.x) == cell.x && std::max(range.min.y, entryMin.y) == cell.y)
+                results.push_back(entry.entity);
+        }
+    };
+
+    // Large regions walk the stored cells instead of looking up every cell of the region.
+    const std::uint64_t regionCellCount =
+        static_cast<std::uint64_t>(range.max.x - range.min.x + 1) * static_cast<std::uint64_t>(range.max.y - range.min.y + 1);
+    if (regionCellCount > cells.size())
+    {
+        for (const auto& [key, entries] : cells)
+        {
+            const Cell cell{.x = static_cast<std::int32_t>(key >> 32), .y = static_cast<std::int32_t>(key)};
+            if (cell.x >= range.min.x && cell.x <= range.max.x && cell.y >= range.min.y && cell.y <= range.max.y)
+                visitCell(cell, entries);
+        }
+        return;
+    }
+
+    for (std::int32_t y = range.min.y; y <= range.max.y; ++y)
+        for (std::int32_t x = range.min.x; x <= range.max.x; ++x)
+            if (const std::vector<CellEntry>* entries = FindCell({x, y}))
+                visitCell({x, y}, *entries);
+}
+
+std::optional<Hit> HashGrid::QueryNearest(glm::vec2 point, float maxDistance) const
+{
+    if (proxies.empty())
+        return std::nullopt;
+
+    ClosestHit closest{.limit = maxDistance * maxDistance};
+    const auto visitCell = [&](std::int64_t x, std::int64_t y)
+    {
+        if (const std::vector<CellEntry>* entries = FindCell({static_cast<std::int32_t>(x), static_cast<std::int32_t>(y)}))
+            for (const CellEntry& entry : *entries)
+                closest.Consider(entry.entity, GetDistanceSquared(entry.aabb, point));
+    };
+    const auto visitRow = [&](std::int64_t y, std::int64_t fromX, std::int64_t toX)
+    {
+        if (y >= occupied.min.y && y <= occupied.max.y)
+            for (std::int64_t x = std::max<std::int64_t>(fromX, occupied.min.x); x <= std::min<std::int64_t>(toX, occupied.max.x); ++x)
+                visitCell(x, y);
+    };
+    const auto visitColumn = [&](std::int64_t x, std::int64_t fromY, std::int64_t toY)
+    {
+        if (x >= occupied.min.x && x <= occupied.max.x)
+            for (std::int64_t y = std::max<std::int64_t>(fromY, occupied.min.y); y <= std::min<std::int64_t>(toY, occupied.max.y); ++y)
+                visitCell(x, y);
+    };
+
+    // Visits square rings of cells around the point's cell. Entities in ring r are at least (r - 1) cells away,
+    // so the search stops once that exceeds the closest hit. Rings before the occupied cells are skipped.
+    const Cell center = GetCell(point);
+    const std::int64_t distanceToOccupied = std::max({std::int64_t{0},
+                                                      std::int64_t{occupied.min.x} - center.x,
+                                                      std::int64_t{center.x} - occupied.max.x,
+                                                      std::int64_t{occupied.min.y} - center.y,
+                                                      std::int64_t{center.y} - occupied.max.y});
+    const std::int64_t lastRing = std::max({std::int64_t{center.x} - occupied.min.x,
+                                            std::int64_t{occupied.max.x} - center.x,
+                                            std::int64_t{center.y} - occupied.min.y,
+                                            std::int64_t{occupied.max.y} - center.y});
+    for (std::int64_t ring = distanceToOccupied; ring <= lastRing; ++ring)
+    {
+        const float ringDistance = static_cast<float>(std::max<std::int64_t>(0, ring - 1)) * cellSize;
+        if (ringDistance * ringDistance > closest.limit)
+            break;
+
+        if (ring == 0)
+        {
+            visitCell(center.x, center.y);
+            continue;
+        }
+        visitRow(center.y - ring, center.x - ring, center.x + ring);
+        visitRow(center.y + ring, center.x - ring, center.x + ring);
+        visitColumn(center.x - ring, center.y - ring + 1, center.y + ring - 1);
+        visitColumn(center.x + ring, center.y - ring + 1, center.y + ring - 1);
+    }
+
+    if (closest.hit)
+        closest.hit->distance = std::sqrt(closest.hit->distance);
+    return closest.hit;
+}
+
+std::optional<Hit> HashGrid::RayCast(const Ray& ray) const
+{
+    if (proxies.empty())
+        return std::nullopt;
+
+    // Walks the cells along the ray through the occupied area with a 2D DDA.
+    const Aabb occupiedArea{
+        .min = {static_cast<float>(occupied.min.x) * cellSize, static_cast<float>(occupied.min.y) * cellSize},
+        .max = {static_cast<float>(occupied.max.x + 1) * cellSize, static_cast<float>(occupied.max.y + 1) * cellSize},
+    };
+    const auto clipped = IntersectRange(ray, occupiedArea, ray.maxDistance);
+    if (!clipped)
+        return std::nullopt;
+    const auto [entry, exit] = *clipped;
+
+    const glm::vec2 start{ray.origin.x + ray.direction.x * entry, ray.origin.y + ray.direction.y * entry};
+    Cell cell = GetCell(start);
+    cell.x = std::clamp(cell.x, occupied.min.x, occupied.max.x);
+    cell.y = std::clamp(cell.y, occupied.min.y, occupied.max.y);
+
+    std::array<std::int32_t, 2> step{};
+    std::array<float, 2> nextBoundary{};
+    std::array<float, 2> boundaryDelta{};
+    const std::array<std::int32_t, 2> startCell{cell.x, cell.y};
+    for (glm::length_t axis = 0; axis < 2; ++axis)
+    {
+        const float direction = ray.direction[axis];
+        if (direction == 0)
+        {
+            nextBoundary[axis] = std::numeric_limits<float>::infinity();
+            continue;
+        }
+        step[axis] = direction > 0 ? 1 : -1;
+        const float boundary = static_cast<float>(startCell[axis] + (direction > 0 ? 1 : 0)) * cellSize;
+        nextBoundary[axis] = (boundary - ray.origin[axis]) / direction;
+        boundaryDelta[axis] = cellSize / std::abs(direction);
+    }
+
+    ClosestHit closest{.limit = ray.maxDistance};
+    while (true)
+    {
+        if (const std::vector<CellEntry>* entries = FindCell(cell))
+            for (const CellEntry& cellEntry : *entries)
+                if (const std::optional<float> distance = Intersect(ray, cellEntry.aabb, closest.limit))
+                    closest.Consider(cellEntry.entity, *distance);
+
+        // Later cells only hold hits beyond this cell. A zero or denormal direction never reaches the next cell,
+        // and the ray can not leave the occupied cells without leaving the occupied area.
+        const float cellExit = std::min(nextBoundary[0], nextBoundary[1]);
+        if ((closest.hit && closest.limit <= cellExit) || cellExit > exit || !std::isfinite(cellExit))
+            break;
+
+        const glm::length_t axis = nextBoundary[0] < nextBoundary[1] ? 0 : 1;
+        (axis == 0 ? cell.x : cell.y) += step[axis];
+        nextBoundary[axis] += boundaryDelta[axis];
+        if (cell.x < occupied.min.x || cell.x > occupied.max.x || cell.y < occupied.min.y || cell.y > occupied.max.y)
+            break;
+    }
+    return closest.hit;
+}
+
+void HashGrid::GeneratePairs(std::vector<std::pair<Entity, Entity>>& pairs) const
+{
+    pairs.clear();
+    for (const auto& [key, entries] : cells)
+    {
+        const Cell cell{.x = static_cast<std::int32_t>(key >> 32), .y = static_cast<std::int32_t>(key)};
+        for (size_t first = 0; first < entries.size(); ++first)
+        {
+            const Cell firstMin = GetCell(entries[first].aabb.min);
+            for (size_t second = first + 1; second < entries.size(); ++second)
+            {
+                if (!entries[first].aabb.Overlaps(entries[second].aabb))
+                    continue;
+                // Reported from the first cell both share only.
+                const Cell secondMin = GetCell(entries[second].aabb.min);
+                if (std::max(firstMin.x, secondMin.x) != cell.x || std::max(firstMin.y, secondMin.y) != cell.y)
+                    continue;
+                pairs.push_back(std::minmax(entries[first].entity, entries[second].entity));
+            }
+        }
+    }
+}
+
+HashGrid::Cell HashGrid::GetCell(glm::vec2 point) const
+{
+    const auto toCoordinate = [this](float value)
+    { return static_cast<std::int32_t>(std::clamp(std::floor(value * inverseCellSize), -kMaxCellCoordinate, kMaxCellCoordinate)); };
+    return Cell{.x = toCoordinate(point.x), .y = toCoordinate(point.y)};
+}
+
+HashGrid::CellRange HashGrid::GetCellRange(const Aabb& aabb) const
+{
+    return CellRange{.min = GetCell(aabb.min), .max = GetCell(aabb.max)};
+}
+
+std::uint64_t HashGrid::GetKey(Cell cell)
+{
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(cell.x)) << 32) | static_cast<std::uint32_t>(cell.y);
+}
+
+const std::vector<HashGrid::CellEntry>* HashGrid::FindCell(Cell cell) const
+{
+    const auto found = cells.find(GetKey(cell));
+    return found == cells.end() ? nullptr : &found->second;
+}
+
+void HashGrid::Insert(Entity entity, const Aabb& aabb, const CellRange& range)
+{
+    for (std::int32_t y = range.min.y; y <= range.max.y; ++y)
+        for (std::int32_t x = range.min.x; x <= range.max.x; ++x)
+        {
+            std::vector<CellEntry>& entries = cells[GetKey({x, y})];
+            if (entries.empty())
+                CountCell({x, y}, true);
+            entries.push_back(CellEntry{.aabb = aabb, .entity = entity});
+        }
+    UpdateOccupied();
+}
+
+void HashGrid::Erase(Entity entity, const CellRange& range)
+{
+    for (std::int32_t y = range.min.y; y <= range.max.y; ++y)
+        for (std::int32_t x = range.min.x; x <= range.max.x; ++x)
+        {
+            const auto cell = cells.find(GetKey({x, y}));
+            std::vector<CellEntry>& entries = cell->second;
+            const auto found = std::ranges::find(entries, entity, &CellEntry::entity);
+            ASSUMERT(found != entries.end());
+            *found = entries.back();
+            entries.pop_back();
+            if (entries.empty())
+            {
+                cells.erase(cell);
+                CountCell({x, y}, false);
+            }
+        }
+    UpdateOccupied();
+}
+
+void HashGrid::CountCell(Cell cell, bool occupiedNow)
+{
+    for (auto [counts, coordinate] : {std::pair{&occupiedColumns, cell.x}, std::pair{&occupiedRows, cell.y}})
+    {
+        std::uint32_t& count = (*counts)[coordinate];
+        occupiedNow ? ++count : --count;
+        if (count == 0)
+            counts->erase(coordinate);
+    }
+}
+
+void HashGrid::UpdateOccupied()
+{
+    if (cells.empty())
+    {
+        occupied = kNoCells;
+        return;
+    }
+    occupied = CellRange{
+        .min = {occupiedColumns.begin()->first, occupiedRows.begin()->first},
+        .max = {occupiedColumns.rbegin()->first, occupiedRows.rbegin()->first},
+    };
+}
+
+AabbTree::AabbTree(float margin) : margin(margin)
+{
+    ASSUMERT(margin >= 0);
+}
+
+void AabbTree::Update(Entity entity, const Aabb& aabb)
+{
+    if (const std::int32_t* leaf = proxies.TryGet(entity))
+    {
+        nodes[*leaf].aabb = aabb;
+        if (nodes[*leaf].fatAabb.Contains(aabb))
+            return;
+
+        RemoveLeaf(*leaf);
+        nodes[*leaf].fatAabb = Fatten(aabb, margin);
+        InsertLeaf(*leaf);
+        return;
+    }
+
+    const std::int32_t leaf = AllocateNode();
+    nodes[leaf].fatAabb = Fatten(aabb, margin);
+    nodes[leaf].aabb = aabb;
+    nodes[leaf].entity = entity;
+    proxies.Add(entity, leaf);
+    InsertLeaf(leaf);
+}
+
+void AabbTree::Remove(Entity entity)
+{
+    const std::int32_t leaf = proxies.Get(entity);
+    RemoveLeaf(leaf);
+    FreeNode(leaf);
+    proxies.Remove(entity);
+}
+
+void AabbTree::QueryLeaves(const Aabb& region, auto&& func) const
+{
+    if (root == kNullNode)
+        return;
+
+    NodeStack stack{};
+    stack.Push(root);
+    while (!stack.IsEmpty())
+    {
+        const Node& node = nodes[stack.Pop()];
+        if (!node.fatAabb.Overlaps(region))
+            continue;
+
+        if (node.IsLeaf())
+            func(node);
+        else
+        {
+            stack.Push(node.left);
+            stack.Push(node.right);
+        }
+    }
+}
+
+void AabbTree::GetEntities(std::vector<Entity>& results) const
+{
+    for (auto it = proxies.cbegin(); it != proxies.cend(); ++it)
+        results.push_back(it->index);
+}
+
+void AabbTree::QueryRegion(const Aabb& region, std::vector<Entity>& results) const
+{
+    QueryLeaves(region,
+                [&](const Node& leaf)
+                {
+                    if (leaf.aabb.Overlaps(region))
+                        results.push_back(leaf.entity);
+                });
+}
+
+std::optional<Hit> AabbTree::QueryNearest(glm::vec2 point, float maxDistance) const
+{
+    if (root == kNullNode)
+        return std::nullopt;
+
+    // Depth first, nearer child first, skipping subtrees farther than the closest hit.
+    ClosestHit closest{.limit = maxDistance * maxDistance};
+    NodeStack stack{};
+    stack.Push(root);
+    while (!stack.IsEmpty())
+    {
+        const Node& node = nodes[stack.Pop()];
+        if (GetDistanceSquared(node.fatAabb, point) > closest.limit)
+            continue;
+
+        if (node.IsLeaf())
+        {
+            closest.Consider(node.entity, GetDistanceSquared(node.aabb, point));
+            continue;
+        }
+
+        const bool leftNearer = GetDistanceSquared(nodes[node.left].fatAabb, point) <= GetDistanceSquared(nodes[node.right].fatAabb, point);
+        stack.Push(leftNearer ? node.right : node.left);
+        stack.Push(leftNearer ? node.left : node.right);
+    }
+
+    if (closest.hit)
+        closest.hit->distance = std::sqrt(closest.hit->distance);
+    return closest.hit;
+}
+
+std::optional<Hit> AabbTree::RayCast(const Ray& ray) const
+{
+    if (root == kNullNode)
+        return std::nullopt;
+
+    ClosestHit closest{.limit = ray.maxDistance};
+    NodeStack stack{};
+    stack.Push(root);
+    while (!stack.IsEmpty())
+    {
+        const Node& node = nodes[stack.Pop()];
+        if (!Intersect(ray, node.fatAabb, closest.limit))
+            continue;
+
+        if (node.IsLeaf())
+        {
+            if (const std::optional<float> distance = Intersect(ray, node.aabb, closest.limit))
+                closest.Consider(node.entity, *distance);
+            continue;
+        }
+
+        stack.Push(node.left);
+        stack.Push(node.right);
+    }
+    return closest.hit;
+}
+
+void AabbTree::GeneratePairs(std::vector<std::pair<Entity, Entity>>& pairs) const
+{
+    pairs.clear();
+    for (const Node& node : nodes)
+    {
+        if (node.height != 0)
+            continue;
+
+        QueryLeaves(node.aabb,
+                    [&](const Node& other)
+                    {
+                        if (other.entity > node.entity && other.aabb.Overlaps(node.aabb))
+                            pairs.emplace_back(node.entity, other.entity);
+                    });
+    }
+}
+
+std::int32_t AabbTree::GetHeight() const
+{
+    return root == kNullNode ? 0 : nodes[root].height;
+}
+
+bool AabbTree::IsValid() const
+{
+    if (root != kNullNode && nodes[root].parent != kNullNode)
+        return false;
+
+    size_t leafCount = 0;
+    for (std::int32_t index = 0; index < static_cast<std::int32_t>(nodes.size()); ++index)
+    {
+        const Node& node = nodes[index];
+        if (node.height < 0)
+            continue;
+
+        if (node.IsLeaf())
+        {
+            ++leafCount;
+            if (node.height != 0 || node.right != kNullNode || !node.fatAabb.Contains(node.aabb) || proxies.Get(node.entity) != index)
+                return false;
+            continue;
+        }
+
+        const Node& left = nodes[node.left];
+        const Node& right = nodes[node.right];
+        const Aabb children = Union(left.fatAabb, right.fatAabb);
+        if (left.parent != index || right.parent != index || node.height != 1 + std::max(left.height, right.height) ||
+            node.fatAabb.min != children.min || node.fatAabb.max != children.max)
+            return false;
+    }
+    return leafCount == proxies.size();
+}
+
+std::int32_t AabbTree::AllocateNode()
+{
+    if (freeList == kNullNode)
+    {
+        nodes.emplace_back();
+        return static_cast<std::int32_t>(nodes.size() - 1);
+    }
+
+    const std::int32_t node = freeList;
+    freeList = nodes[node].parent;
+    nodes[node] = Node{};
+    return node;
+}
+
+void AabbTree::FreeNode(std::int32_t node)
+{
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+    freeList = node;
+}
+
+void AabbTree::InsertLeaf(std::int32_t leaf)
+{
+    if (root == kNullNode)
+    {
+        root = leaf;
+        nodes[leaf].parent = kNullNode;
+        return;
+    }
+
+    // Branch and bound search for the sibling that adds the least perimeter to the tree, the surface area heuristic of 2D
+    // (Bittner et al., Fast Insertion-Based Optimization of Bounding Volume Hierarchies). The cost of a sibling is
+    // the perimeter of the new parent plus the growth of all its ancestors, subtrees that can not beat the best are skipped.
+    const Aabb leafAabb = nodes[leaf].fatAabb;
+    const float leafPerimeter = GetPerimeter(leafAabb);
+    std::int32_t sibling = root;
+    float bestCost = std::numeric_limits<float>::infinity();
+
+    std::array<std::pair<std::int32_t, float>, 256> candidates;
+    size_t candidateCount = 0;
+    candidates[candidateCount++] = {root, 0.0f};
+    while (candidateCount > 0)
+    {
+        const auto [candidate, inheritedCost] = candidates[--candidateCount];
+        const Node& node = nodes[candidate];
+        const float directCost = GetPerimeter(Union(node.fatAabb, leafAabb));
+        if (directCost + inheritedCost < bestCost)
+        {
+            bestCost = directCost + inheritedCost;
+            sibling = candidate;
+        }
+
+        if (node.IsLeaf())
+            continue;
+        const float childInheritedCost = inheritedCost + directCost - GetPerimeter(node.fatAabb);
+        if (leafPerimeter + childInheritedCost < bestCost && candidateCount + 2 <= candidates.size())
+        {
+            candidates[candidateCount++] = {node.left, childInheritedCost};
+            candidates[candidateCount++] = {node.right, childInheritedCost};
+        }
+    }
+
+    const std::int32_t oldParent = nodes[sibling].parent;
+    const std::int32_t newParent = AllocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].fatAabb = Union(leafAabb, nodes[sibling].fatAabb);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].left = sibling;
+    nodes[newParent].right = leaf;
+    ReplaceChild(oldParent, sibling, newParent);
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    FixUpwards(oldParent);
+}
+
+void AabbTree::RemoveLeaf(std::int32_t leaf)
+{
+    if (leaf == root)
+    {
+        root = kNullNode;
+        return;
+    }
+
+    const std::int32_t parent = nodes[leaf].parent;
+    const std::int32_t grandParent = nodes[parent].parent;
+    const std::int32_t sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+    ReplaceChild(grandParent, parent, sibling);
+    nodes[sibling].parent = grandParent;
+    FreeNode(parent);
+    FixUpwards(grandParent);
+}
+
+void AabbTree::ReplaceChild(std::int32_t parent, std::int32_t oldChild, std::int32_t newChild)
+{
+    if (parent == kNullNode)
+        root = newChild;
+    else if (nodes[parent].left == oldChild)
+        nodes[parent].left = newChild;
+    else
+        nodes[parent].right = newChild;
+}
+
+void AabbTree::FixUpwards(std::int32_t node)
+{
+    while (node != kNullNode)
+    {
+        node = Balance(node);
+        Node& current = nodes[node];
+        current.height = 1 + std::max(nodes[current.left].height, nodes[current.right].height);
+        current.fatAabb = Union(nodes[current.left].fatAabb, nodes[current.right].fatAabb);
+        node = current.parent;
+    }
+}
+
+// Rotates the taller child up when the heights of the children differ by more than one. Returns the node now at the position.
+std::int32_t AabbTree::Balance(std::int32_t top)
+{
+    Node& topNode = nodes[top];
+    if (topNode.IsLeaf() || topNode.height < 2)
+        return top;
+
+    const std::int32_t left = topNode.left;
+    const std::int32_t right = topNode.right;
+    const std::int32_t balance = nodes[right].height - nodes[left].height;
+    if (balance >= -1 && balance <= 1)
+        return top;
+
+    // The taller child replaces top, which takes the place of the child's taller child.
+    // The child's shorter child moves to top, in place of the risen child.
+    const bool rightIsTaller = balance > 1;
+    const std::int32_t risen = rightIsTaller ? right : left;
+    const std::int32_t staying = rightIsTaller ? left : right;
+    Node& risenNode = nodes[risen];
+    const std::int32_t grandChildLeft = risenNode.left;
+    const std::int32_t grandChildRight = risenNode.right;
+    const bool leftGrandChildTaller = nodes[grandChildLeft].height > nodes[grandChildRight].height;
+    const std::int32_t tallerGrandChild = leftGrandChildTaller ? grandChildLeft : grandChildRight;
+    const std::int32_t shorterGrandChild = leftGrandChildTaller ? grandChildRight : grandChildLeft;
+
+    risenNode.left = top;
+    risenNode.right = tallerGrandChild;
+    risenNode.parent = topNode.parent;
+    ReplaceChild(topNode.parent, top, risen);
+    topNode.parent = risen;
+
+    (rightIsTaller ? topNode.right : topNode.left) = shorterGrandChild;
+    nodes[shorterGrandChild].parent = top;
+
+    topNode.fatAabb = Union(nodes[staying].fatAabb, nodes[shorterGrandChild].fatAabb);
+    topNode.height = 1 + std::max(nodes[staying].height, nodes[shorterGrandChild].height);
+    risenNode.fatAabb = Union(topNode.fatAabb, nodes[tallerGrandChild].fatAabb);
+    risenNode.height = 1 + std::max(topNode.height, nodes[tallerGrandChild].height);
+    return risen;
+}
+
+}  // namespace tektonik::spatial
@@ -0,0 +1,131 @@
+module;
+#include "common-defines.hpp"
+module string_table;
+
+import singleton;
+import assert;
+
+namespace tektonik
+{
+
+InternedString::InternedString(std::string_view string) : handle(Singleton<StringTable>::Get().Intern(string).handle) {}
+
+std::string_view InternedString::View() const
+{
+    return Singleton<StringTable>::Get().Resolve(*this);
+}
+
+StringTable::StringTable()
+{
+    // Handle 0 is the empty string, so default constructed handles need no lookup.
+    ownedSlots.push_back(std::make_unique<Slots>(kFirstChunkSize));
+    slots.store(ownedSlots.back().get(), std::memory_order_release);
+    AddEntry(0) = std::string_view{};
+    Insert(*ownedSlots.back(), std::hash<std::string_view>{}(std::string_view{}), 0);
+    count.store(1, std::memory_order_release);
+}
+
+StringTable::~StringTable()
+{
+    for (std::atomic<std::string_view*>& chunk : chunks)
+        delete[] chunk.load(std::memory_order_relaxed);
+}
+
+InternedString StringTable::Intern(std::string_view string)
+{
+    if (const std::optional<InternedString> found = Find(string))
+        return *found;
+
+    std::scoped_lock lock(mutex);
+    // Another thread may have interned it meanwhile.
+    if (const std::optional<InternedString> found = Find(string))
+        return *found;
+
+    const std::uint32_t handle = count.load(std::memory_order_relaxed);
+    ASSUMERT(handle < std::numeric_limits<std::uint32_t>::max() - 1);
+    char* const copy = static_cast<char*>(characters.allocate(string.size(), alignof(char)));
+    std::ranges::copy(string, copy);
+    AddEntry(handle) = std::string_view(copy, string.size());
+    count.store(handle + 1, std::memory_order_release);
+
+    // Kept at most half full, so probe sequences stay short.
+    if ((handle + 1) * 2 > ownedSlots.back()->values.size())
+        Grow();
+    else
+        Insert(*ownedSlots.back(), std::hash<std::string_view>{}(string), handle);
+
+    InternedString interned{};
+    interned.handle = handle;
+    return interned;
+}
+
+std::optional<InternedString> StringTable::Find(std::string_view string) const
+{
+    const std::uint64_t hash = std::hash<std::string_view>{}(string);
+    const std::vector<std::atomic<std::uint64_t>>& values = slots.load(std::memory_order_acquire)->values;
+    const std::size_t mask = values.size() - 1;
+    for (std::size_t index = hash & mask;; index = (index + 1) & mask)
+    {
+        const std::uint64_t slot = values[index].load(std::memory_order_acquire);
+        if (slot == 0)
+            return std::nullopt;
+
+        const std::uint32_t handle = static_cast<std::uint32_t>(slot) - 1;
+        if ((slot & kSlotHashMask) == (hash & kSlotHashMask) && GetEntry(handle) == string)
+        {
+            InternedString interned{};
+            interned.handle = handle;
+            return interned;
+        }
+    }
+}
+
+std::string_view StringTable::Resolve(InternedString string) const
+{
+    ASSUMERT(string.handle < GetCount());
+    return GetEntry(string.handle);
+}
+
+const std::string_view& StringTable::GetEntry(std::uint32_t handle) const
+{
+    const std::size_t position = std::size_t{handle} + kFirstChunkSize;
+    const std::size_t chunk = std::bit_width(position) - 1 - kFirstChunkBits;
+    return chunks[chunk].load(std::memory_order_acquire)[position - (kFirstChunkSize << chunk)];
+}
+
+std::string_view& StringTable::AddEntry(std::uint32_t handle)
+{
+    const std::size_t position = std::size_t{handle} + kFirstChunkSize;
+    const std::size_t chunk = std::bit_width(position) - 1 - kFirstChunkBits;
+    std::string_view* entries = chunks[chunk].load(std::memory_order_relaxed);
+    if (entries == nullptr)
+    {
+        entries = new std::string_view[kFirstChunkSize << chunk];
+        chunks[chunk].store(entries, std::memory_order_release);
+    }
+    return entries[position - (kFirstChunkSize << chunk)];
+}
+
+void StringTable::Insert(Slots& slots, std::uint64_t hash, std::uint32_t handle)
+{
+    const std::size_t mask = slots.values.size() - 1;
+    std::size_t index = hash & mask;
+    while (slots.values[index].load(std::memory_order_relaxed) != 0)
+        index = (index + 1) & mask;
+    // Publishes the entry written before to lock-free readers.
+    slots.values[index].store((hash & kSlotHashMask) | (std::uint64_t{handle} + 1), std::memory_order_release);
+}
+
+void StringTable::Grow()
+{
+    // Readers keep probing the old slots until the new ones are complete.
+    auto grown = std::make_unique<Slots>(ownedSlots.back()->values.size() * 2);
+    const std::uint32_t entryCount = count.load(std::memory_order_relaxed);
+    for (std::uint32_t handle = 0; handle < entryCount; ++handle)
+        Insert(*grown, std::hash<std::string_view>{}(GetEntry(handle)), handle);
+
+    slots.store(grown.get(), std::memory_order_release);
+    ownedSlots.push_back(std::move(grown));
+}
+
+}  // namespace tektonik
@@ -5,6 +5,21 @@ module test;
 
 import sparse_set;
 import ecs;
+import components;
+import memory;
+import archetype;
+import snapshot;
+import delta;
+import transform;
+import spatial;
+import string_table;
+import collision;
+import render_batch;
+import renderer;
+import assets;
+import config;
+import glm;
+import jobs;
 import singleton;
 import logger;
 import util;
@@ -123,6 +138,162 @@ ADD_TEST_FUNC(TestSparseSetModifyingLastElement)
     checkValidity();
 }
 
+ADD_TEST_FUNC(TestSparseSetPaging)
+{
+    auto sparseSet = SparseSet<std::string, uint32_t>();
+
+    // A single high index must not allocate the whole sparse range.
+    sparseSet.Add(10'000'000, "High element");
+    TestAssert(sparseSet.GetSparsePageCount() == 1, "High index should allocate a single page.");
+    sparseSet.Add(4, "Low element");
+    TestAssert(sparseSet.GetSparsePageCount() == 2);
+    TestAssert(sparseSet.IsValid(), "Sparse set is not valid.");
+
+    // Pages are released once they are empty.
+    sparseSet.Remove(10'000'000);
+    TestAssert(sparseSet.GetSparsePageCount() == 1, "Empty page should be released.");
+    TestAssert(sparseSet.Contains(4) && sparseSet.Get(4) == "Low element");
+    sparseSet.Remove(4);
+    TestAssert(sparseSet.GetSparsePageCount() == 0, "All pages should be released.");
+    TestAssert(sparseSet.IsValid(), "Sparse set is not valid.");
+}
+
+ADD_TEST_FUNC(TestSparseSetBulkAddGrowth)
+{
+    auto sparseSet = SparseSet<uint32_t, uint32_t>();
+
+    // Many small bulk adds must grow the dense array geometrically, not by exactly the added count.
+    uint32_t reallocationCount = 0;
+    const void* data = nullptr;
+    for (uint32_t index = 0; index < 4096; index += 2)
+    {
+        const std::array<uint32_t, 2> indexes{index, index + 1};
+        sparseSet.Add(indexes, index);
+        if (const void* newData = &*sparseSet.begin(); newData != data)
+        {
+            data = newData;
+            ++reallocationCount;
+        }
+    }
+    TestAssert(sparseSet.size() == 4096 && sparseSet.IsValid());
+    TestAssert(reallocationCount <= 16, "Bulk adds should reallocate the dense array a logarithmic number of times.");
+}
+
+ADD_TEST_FUNC(TestMemory)
+{
+    // Counts what reaches the global heap.
+    class CountingResource : public std::pmr::memory_resource
+    {
+      public:
+        size_t allocationCount = 0;
+        size_t allocatedBytes = 0;
+
+      private:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            ++allocationCount;
+            allocatedBytes += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override
+        {
+            allocatedBytes -= bytes;
+            std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    };
+    CountingResource heap{};
+
+    {
+        memory::FrameArena arena(1024, &heap);
+        for (size_t frame = 0; frame < 3; ++frame)
+        {
+            const size_t allocationCount = heap.allocationCount;
+            {
+                std::pmr::vector<std::uint64_t> values(&arena);
+                for (std::uint64_t value = 0; value < 1000; ++value)
+                    values.push_back(value);
+                TestAssert(reinterpret_cast<std::uintptr_t>(arena.allocate(3, 64)) % 64 == 0, "Allocations should be aligned.");
+            }
+            TestAssert(frame == 0 || heap.allocationCount == allocationCount, "Frames that fit the previous ones should not allocate.");
+            arena.Reset();
+        }
+        TestAssert(arena.GetUsedBytes() == 0 && arena.GetPeakUsedBytes() >= 1000 * sizeof(std::uint64_t));
+    }
+    TestAssert(heap.allocatedBytes == 0);
+
+    {
+        // Blocks are large enough for set nodes.
+        memory::BlockPool pool(48, 16, &heap);
+        std::pmr::set<std::uint32_t> set(&pool);
+        for (size_t round = 0; round < 2; ++round)
+        {
+            const size_t allocationCount = heap.allocationCount;
+            for (std::uint32_t value = 0; value < 100; ++value)
+                set.insert(value);
+            TestAssert(pool.GetUsedBlockCount() == 100, "Set nodes should come from the pool.");
+            set.clear();
+            TestAssert(pool.GetUsedBlockCount() == 0);
+            TestAssert(round == 0 || heap.allocationCount == allocationCount, "Freed blocks should be reused.");
+        }
+
+        // Too large for a block.
+        const size_t allocationCount = heap.allocationCount;
+        void* large = pool.allocate(100);
+        TestAssert(heap.allocationCount == allocationCount + 1);
+        pool.deallocate(large, 100);
+    }
+    TestAssert(heap.allocatedBytes == 0);
+
+    {
+        // Allocations get at least the alignment of the resource and are returned with it.
+        memory::AlignedResource aligned(64, &heap);
+        std::pmr::vector<std::uint32_t> values(&aligned);
+        for (std::uint32_t value = 0; value < 100; ++value)
+        {
+            values.push_back(value);
+            TestAssert(reinterpret_cast<std::uintptr_t>(values.data()) % 64 == 0, "Arrays should start on a cache line.");
+        }
+    }
+    TestAssert(heap.allocatedBytes == 0);
+
+    struct NameComponent
+    {
+        std::string name;
+
+        auto Tie() const { return std::tie(name); }
+    };
+
+    struct ValueComponent
+    {
+        uint32_t value;
+
+        auto Tie() const { return std::tie(value); }
+    };
+
+    // Storage comes from heap, command playback from the arena.
+    {
+        using Manager = ecs::ComponentManager<NameComponent, ValueComponent>;
+        memory::FrameArena arena(1024, &heap);
+        ecs::World<Manager> world(&heap, &arena);
+        world.CreateEntities(100, ValueComponent{0});
+        TestAssert(heap.allocationCount > 0 && arena.GetUsedBytes() == 0);
+
+        ecs::CommandBuffer<Manager> commandBuffer{};
+        world.Each<ValueComponent>([&](ecs::Entity entity, ValueComponent&) { commandBuffer.AddComponent(entity, NameComponent{"named"}); });
+        world.PlaybackCommands(commandBuffer);
+        TestAssert(arena.GetUsedBytes() > 0, "Playback should use the scratch resource.");
+        arena.Reset();
+
+        size_t namedCount = 0;
+        world.Each<const NameComponent, const ValueComponent>([&](ecs::Entity, const NameComponent&, const ValueComponent&) { ++namedCount; });
+        TestAssert(namedCount == 100);
+    }
+    TestAssert(heap.allocatedBytes == 0, "Everything should be returned to the resource.");
+}
+
 ADD_TEST_FUNC(TestComponentManager)
 {
     struct NameComponent
@@ -143,6 +314,43 @@ ADD_TEST_FUNC(TestComponentManager)
     static_assert(componentManager.kComponentTypeCount == 2);
     componentManager.AddComponent(5, ValueComponent{.value = 5});
     componentManager.RemoveComponent<ValueComponent>(5);
+
+    // The entity set nodes have to fit the pooled blocks.
+    class LargestAllocationResource : public std::pmr::memory_resource
+    {
+      public:
+        size_t largestAllocation = 0;
+
+      private:
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            largestAllocation = std::max(largestAllocation, bytes);
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override
+        {
+            std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    };
+    LargestAllocationResource resource{};
+    {
+        std::pmr::set<ecs::Entity> entities(&resource);
+        entities.insert(1);
+    }
+    TestAssert(resource.largestAllocation <= decltype(componentManager)::kNodeBlockSize, "Entity set nodes should fit the pooled blocks.");
+
+    // Moving keeps the components, signatures and the tick.
+    componentManager.AddComponent(7, ValueComponent{.value = 7});
+    componentManager.AddComponent(7, NameComponent{.name = "seven"});
+    const ecs::Tick tick = componentManager.GetCurrentTick();
+    auto movedManager = std::move(componentManager);
+    TestAssert(movedManager.GetComponent<ValueComponent>(7).value == 7 && movedManager.GetComponent<NameComponent>(7).name == "seven");
+    TestAssert(movedManager.GetCurrentTick() == tick);
+    movedManager.RemoveComponent<NameComponent>(7);
+    TestAssert(movedManager.GetSignature(7).count() == 1);
 }
 
 ADD_TEST_FUNC(TestWorld)
@@ -182,6 +390,1561 @@ ADD_TEST_FUNC(TestWorld)
     }
 }
 
+ADD_TEST_FUNC(TestEntityHandles)
+{
+    using namespace ecs;
+
+    EntityManager entityManager{};
+    Entity first = entityManager.NewEntity();
+    Entity second = entityManager.NewEntity();
+    Entity third = entityManager.NewEntity();
+    EntityHandle secondHandle = entityManager.GetHandle(second);
+    TestAssert(entityManager.IsAlive(secondHandle));
+
+    entityManager.DeleteEntity(third);
+    entityManager.DeleteEntity(second);
+    TestAssert(!entityManager.IsAlive(secondHandle), "Handle of a deleted entity must not be alive.");
+    TestAssert(!entityManager.IsAlive(second));
+    TestAssert(entityManager.IsAlive(first));
+
+    // The lowest free index is reused, but with a new generation.
+    Entity reused = entityManager.NewEntity();
+    TestAssert(reused == second, "Lowest deleted entity should be reused first.");
+    TestAssert(!entityManager.IsAlive(secondHandle), "Stale handle must not alias the reused entity.");
+    TestAssert(entityManager.IsAlive(entityManager.GetHandle(reused)));
+}
+
+ADD_TEST_FUNC(TestBulkEntities)
+{
+    using namespace ecs;
+
+    struct NameComponent
+    {
+        std::string name;
+
+        auto Tie() const { return std::tie(name); }
+    };
+
+    struct ValueComponent
+    {
+        uint32_t value;
+
+        auto Tie() const { return std::tie(value); }
+    };
+
+    World<ComponentManager<NameComponent, ValueComponent>> world{};
+    std::vector<Entity> projectiles = world.CreateEntities(1000, ValueComponent{7}, NameComponent{"projectile"});
+    TestAssert(projectiles.size() == 1000 && std::ranges::is_sorted(projectiles));
+    TestAssert(std::ranges::distance(world.GetComponentManager().GetEntitiesWithComponents<NameComponent, ValueComponent>()) == 1000);
+
+    // Destroy every other projectile, their indexes get reused by the clones.
+    std::vector<Entity> destroyed{};
+    for (size_t i = 0; i < projectiles.size(); i += 2)
+        destroyed.push_back(projectiles[i]);
+    world.DestroyEntities(destroyed);
+    TestAssert(std::ranges::none_of(destroyed, [&](Entity entity) { return world.IsAlive(entity); }));
+
+    std::vector<Entity> clones = world.CloneEntity(projectiles[1], 600);
+    TestAssert(std::ranges::equal(clones | std::views::take(500), destroyed), "Clones should reuse the lowest free entities first.");
+
+    size_t cloneCount = 0;
+    world.Each<NameComponent, ValueComponent>(
+        [&](Entity, NameComponent& name, ValueComponent& value)
+        {
+            TestAssert(name.name == "projectile" && value.value == 7);
+            ++cloneCount;
+        });
+    TestAssert(cloneCount == 1100, "Survivors and clones should all have both components.");
+}
+
+ADD_TEST_FUNC(TestCommandBuffer)
+{
+    using namespace ecs;
+
+    struct NameComponent
+    {
+        std::string name;
+
+        auto Tie() const { return std::tie(name); }
+    };
+
+    struct ValueComponent
+    {
+        uint32_t value;
+
+        auto Tie() const { return std::tie(value); }
+    };
+
+    using Manager = ComponentManager<NameComponent, ValueComponent>;
+    World<Manager> world{};
+    world.CreateEntities(1000, ValueComponent{0});
+
+    // Structural changes while iterating, recorded from several threads.
+    CommandBuffer<Manager> commandBuffer{};
+    world.ParallelForEach<ValueComponent>(
+        [&](Entity entity, ValueComponent&)
+        {
+            if (entity % 2 == 0)
+                commandBuffer.DestroyEntity(entity);
+            else
+                commandBuffer.AddComponent(entity, NameComponent{"odd"});
+
+            if (entity % 100 == 0)
+            {
+                Entity spawned = commandBuffer.CreateEntity();
+                commandBuffer.AddComponent(spawned, ValueComponent{entity});
+                commandBuffer.AddComponent(spawned, NameComponent{"spawned"});
+                commandBuffer.RemoveComponent<ValueComponent>(spawned);
+            }
+        },
+        64);
+    TestAssert(!commandBuffer.IsEmpty());
+
+    world.PlaybackCommands(commandBuffer);
+    TestAssert(commandBuffer.IsEmpty(), "Playback should clear the buffer.");
+    TestAssert(!world.IsAlive(0) && world.IsAlive(1));
+
+    size_t oddCount = 0;
+    size_t spawnedCount = 0;
+    world.Each<NameComponent>(
+        [&](Entity entity, NameComponent& name)
+        {
+            if (name.name == "odd")
+                oddCount += entity % 2;
+            else if (name.name == "spawned")
+                spawnedCount += !world.GetComponentManager().GetSignature(entity)[Manager::kTypeIndex<ValueComponent>];
+        });
+    TestAssert(oddCount == 500, "Odd entities should have got a name.");
+    TestAssert(spawnedCount == 10, "Spawned entities should have only the name left.");
+
+    // Replacing a component keeps the entity where it is, leaving a group still works.
+    Manager& componentManager = world.GetComponentManager();
+    componentManager.RegisterGroup<NameComponent, ValueComponent>();
+    commandBuffer.RemoveComponent<ValueComponent>(1);
+    commandBuffer.AddComponent(1, ValueComponent{7});
+    commandBuffer.RemoveComponent<NameComponent>(3);
+    commandBuffer.RemoveComponent<NameComponent>(5);
+    world.PlaybackCommands(commandBuffer);
+    TestAssert(componentManager.GetComponent<ValueComponent>(1).value == 7);
+    TestAssert(componentManager.GetGroupSize<NameComponent, ValueComponent>() == 498);
+
+    size_t groupedCount = 0;
+    world.Each<NameComponent, ValueComponent>([&](Entity entity, NameComponent&, ValueComponent&) { groupedCount += entity % 2; });
+    size_t queriedCount = 0;
+    for (const Entity entity : componentManager.GetEntitiesWithComponents<NameComponent, ValueComponent>())
+        queriedCount += entity % 2;
+    TestAssert(groupedCount == 498 && queriedCount == 498, "Entities should have moved to their new signature sets.");
+}
+
+ADD_TEST_FUNC(TestChangeTicks)
+{
+    using namespace ecs;
+
+    struct NameComponent
+    {
+        std::string name;
+
+        auto Tie() const { return std::tie(name); }
+    };
+
+    struct ValueComponent
+    {
+        uint32_t value;
+
+        auto Tie() const { return std::tie(value); }
+    };
+
+    using Manager = ComponentManager<NameComponent, ValueComponent>;
+    World<Manager> world{};
+    Manager& componentManager = world.GetComponentManager();
+    std::vector<Entity> entities = world.CreateEntities(100, ValueComponent{0});
+
+    // Like an incremental system, which only looks at what changed since its last run.
+    Tick lastRun = 0;
+    const auto countChanged = [&]()
+    {
+        const Tick thisRun = componentManager.AdvanceTick();
+        size_t changedCount = 0;
+        world.Each<const ValueComponent>([&](Entity, const ValueComponent&) { ++changedCount; }, Changed<ValueComponent>{lastRun});
+        lastRun = thisRun;
+        return changedCount;
+    };
+
+    TestAssert(countChanged() == 100, "Added components should count as changed.");
+    TestAssert(countChanged() == 0, "Const access must not mark components as changed.");
+
+    // Other systems advance the tick at their start as well.
+    componentManager.AdvanceTick();
+    componentManager.GetComponent<ValueComponent>(entities[3]).value = 3;
+    // Removal moves the last component into the gap, its ticks have to move along.
+    componentManager.RemoveComponent<ValueComponent>(entities[0]);
+    TestAssert(countChanged() == 1, "Only the mutably accessed component should have changed.");
+
+    componentManager.AdvanceTick();
+    world.ParallelForEach<ValueComponent>([](Entity, ValueComponent& value) { ++value.value; }, 16);
+    TestAssert(countChanged() == 99, "Mutable iteration should mark every visited component.");
+
+    // Writes of the system itself during its run are not matched on its next run.
+    lastRun = componentManager.AdvanceTick();
+    componentManager.GetComponent<ValueComponent>(entities[5]).value = 5;
+    TestAssert(countChanged() == 0, "A system should not see its own writes again.");
+
+    componentManager.AdvanceTick();
+    componentManager.AddComponent(entities[7], NameComponent{"seven"});
+    size_t addedCount = 0;
+    world.Each<const ValueComponent>([&](Entity, const ValueComponent&) { ++addedCount; }, Added<NameComponent>{lastRun});
+    TestAssert(addedCount == 1, "Filters should also work on components that are not selected.");
+
+    // Ticks stay ordered across the wraparound of the counter.
+    static_assert(IsNewerTick(1, std::numeric_limits<Tick>::max()) && !IsNewerTick(std::numeric_limits<Tick>::max(), 1));
+    componentManager.ClampTicks();
+    TestAssert(countChanged() == 0, "Clamping should leave recent ticks alone.");
+}
+
+ADD_TEST_FUNC(TestSystemChangeTicks)
+{
+    using namespace ecs;
+
+    struct ValueComponent
+    {
+        uint32_t value;
+
+        auto Tie() const { return std::tie(value); }
+    };
+
+    using Manager = ComponentManager<ValueComponent>;
+    using Mode = SystemManager<Manager>::ExecutionMode;
+
+    for (Mode mode : {Mode::Parallel, Mode::Serial})
+    {
+        World<Manager> world{};
+        std::vector<Entity> entities = world.CreateEntities(100, ValueComponent{0});
+
+        const auto countChanged = [](Manager& manager)
+        {
+            size_t changedCount = 0;
+            manager.Each<const ValueComponent>(
+                [&](Entity, const ValueComponent&) { ++changedCount; }, Changed<ValueComponent>{manager.GetLastRunTick()});
+            return changedCount;
+        };
+
+        uint32_t frame = 0;
+        std::vector<size_t> watchedCounts{};
+        std::vector<size_t> writerCounts{};
+        auto& systemManager = world.GetSystemManager();
+        systemManager.SetExecutionMode(mode);
+        systemManager.AddSystem(
+            "Watch", Reads<ValueComponent>{}, Writes<>{}, [&](Manager& manager) { watchedCounts.push_back(countChanged(manager)); });
+        // Runs after Watch, which only sees these writes on its next run.
+        systemManager.AddSystem(
+            "Write",
+            Reads<>{},
+            Writes<ValueComponent>{},
+            [&](Manager& manager)
+            {
+                writerCounts.push_back(countChanged(manager));
+                if (frame == 1)
+                    manager.ParallelForEach<ValueComponent>([](Entity, ValueComponent& value) { ++value.value; }, 1);
+            });
+
+        for (; frame < 3; ++frame)
+            world.RunSystems();
+        // Writes between frames are seen by every system.
+        world.GetComponentManager().GetComponent<ValueComponent>(entities[5]).value = 5;
+        world.RunSystems();
+
+        TestAssert(watchedCounts == std::vector<size_t>{100, 0, 100, 1}, "Writes of later systems should be seen on the next run.");
+        TestAssert(writerCounts == std::vector<size_t>{100, 0, 0, 1}, "A system should not see its own writes again.");
+    }
+}
+
+ADD_TEST_FUNC(TestOwningGroup)
+{
+    using namespace ecs;
+
+    struct NameComponent
+    {
+        std::string name;
+
+        auto Tie() const { return std::tie(name); }
+    };
+
+    struct ValueComponent
+    {
+        uint32_t value;
+
+        auto Tie() const { return std::tie(value); }
+    };
+
+    using Manager = ComponentManager<NameComponent, ValueComponent>;
+    World<Manager> world{};
+    Manager& componentManager = world.GetComponentManager();
+    std::vector<Entity> entities = world.CreateEntities(100, ValueComponent{0});
+    for (Entity entity : entities)
+        if (entity % 3 == 0)
+            componentManager.AddComponent(entity, NameComponent{std::to_string(entity)});
+
+    // Existing entities are adopted, later changes keep the group up to date.
+    componentManager.RegisterGroup<NameComponent, ValueComponent>();
+    TestAssert(componentManager.GetGroupSize<NameComponent, ValueComponent>() == 34);
+
+    componentManager.AddComponent(entities[1], NameComponent{"1"});
+    componentManager.RemoveComponent<ValueComponent>(entities[3]);
+    world.DeleteEntity(entities[6]);
+    world.CloneEntity(entities[9], 5);
+    TestAssert(componentManager.GetGroupSize<NameComponent, ValueComponent>() == 38);
+
+    size_t memberCount = 0;
+    bool namesMatch = true;
+    world.Each<const NameComponent, ValueComponent>(
+        [&](Entity entity, const NameComponent& name, ValueComponent& value)
+        {
+            value.value = entity;
+            namesMatch &= name.name == std::to_string(entity) || name.name == "9";
+            ++memberCount;
+        });
+    TestAssert(memberCount == 38 && namesMatch, "Grouped iteration should visit every member with its own components.");
+    TestAssert(componentManager.GetComponent<ValueComponent>(entities[1]).value == entities[1]);
+}
+
+ADD_TEST_FUNC(TestSnapshot)
+{
+    using namespace ecs;
+
+    struct NameComponent
+    {
+        std::string name;
+        std::vector<std::string> tags;
+
+        auto Tie() const { return std::tie(name, tags); }
+    };
+
+    struct ValueComponent
+    {
+        uint32_t value;
+
+        auto Tie() const { return std::tie(value); }
+    };
+
+    using Manager = ComponentManager<NameComponent, ValueComponent>;
+    World<Manager> world{};
+    std::vector<Entity> entities = world.CreateEntities(100, ValueComponent{0});
+    for (Entity entity : entities)
+    {
+        world.GetComponentManager().GetComponent<ValueComponent>(entity).value = entity;
+        if (entity % 4 == 0)
+            world.GetComponentManager().AddComponent(entity, NameComponent{std::to_string(entity), {"tag"}});
+    }
+    // Freed slots and their generations must survive the round trip.
+    world.DeleteEntity(entities[8]);
+    world.DeleteEntity(entities[9]);
+    world.NewEntity();
+
+    const std::vector<std::byte> bytes = snapshot::Save(world);
+    const snapshot::SnapshotView view(bytes);
+    TestAssert(view.GetHeader().entityCount == 99);
+    TestAssert(view.GetComponents<ValueComponent>(Manager::kTypeIndex<ValueComponent>).size() == 98, "Trivial columns should be usable in place.");
+
+    World<Manager> loaded{};
+    snapshot::Load(bytes, loaded);
+    TestAssert(loaded.GetHandle(entities[7]) == world.GetHandle(entities[7]));
+    TestAssert(!loaded.IsAlive(entities[9]) && loaded.NewEntity() == world.NewEntity(), "Free entities should be reused in the same order.");
+
+    size_t valueCount = 0;
+    loaded.Each<const ValueComponent>([&](Entity entity, const ValueComponent& value) { valueCount += value.value == entity; });
+    size_t nameCount = 0;
+    loaded.Each<const NameComponent, const ValueComponent>(
+        [&](Entity entity, const NameComponent& name, const ValueComponent&) { nameCount += name.name == std::to_string(entity) && name.tags.size() == 1; });
+    TestAssert(valueCount == 98 && nameCount == 24, "Loaded components should match the saved ones.");
+
+    bool threw = false;
+    try
+    {
+        snapshot::SnapshotView(std::span(bytes).first(sizeof(snapshot::Header) - 1));
+    }
+    catch (const snapshot::SnapshotError&)
+    {
+        threw = true;
+    }
+    TestAssert(threw, "Truncated snapshots should be rejected.");
+
+    // Invalid snapshots are rejected before the world is touched.
+    const auto loadFails = [](std::span<const std::byte> corrupted, World<Manager>& target)
+    {
+        try
+        {
+            snapshot::Load(corrupted, target);
+        }
+        catch (const snapshot::SnapshotError&)
+        {
+            return true;
+        }
+        return false;
+    };
+    TestAssert(loadFails(bytes, loaded), "Loading into a world with entities should be rejected.");
+
+    snapshot::Header header{};
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    const auto corruptColumn = [&](size_t typeIndex, const auto& corrupt)
+    {
+        std::vector<std::byte> corrupted = bytes;
+        snapshot::Column column{};
+        const size_t columnOffset = header.columnsOffset + typeIndex * sizeof(snapshot::Column);
+        std::memcpy(&column, corrupted.data() + columnOffset, sizeof(column));
+        corrupt(corrupted, column);
+        std::memcpy(corrupted.data() + columnOffset, &column, sizeof(column));
+        return corrupted;
+    };
+    const size_t valueIndex = Manager::kTypeIndex<ValueComponent>;
+    const std::vector<std::byte> duplicated = corruptColumn(
+        valueIndex, [](std::vector<std::byte>& corrupted, const snapshot::Column& column)
+        { std::memcpy(corrupted.data() + column.entitiesOffset + sizeof(Entity), corrupted.data() + column.entitiesOffset, sizeof(Entity)); });
+    const std::vector<std::byte> misaligned =
+        corruptColumn(valueIndex, [](std::vector<std::byte>&, snapshot::Column& column) { column.elementAlignment = 1; });
+    const std::vector<std::byte> missing = corruptColumn(Manager::kTypeIndex<NameComponent>, [](std::vector<std::byte>&, snapshot::Column& column) { --column.count; });
+
+    World<Manager> empty{};
+    TestAssert(loadFails(duplicated, empty), "Entities listed twice in a column should be rejected.");
+    TestAssert(loadFails(misaligned, empty), "Columns with a different alignment should be rejected.");
+    TestAssert(loadFails(missing, empty), "Columns must have every entity whose signature has the component.");
+    TestAssert(empty.GetEntityManager().GetGenerations().empty(), "Failed loads should leave the world untouched.");
+}
+
+ADD_TEST_FUNC(TestDelta)
+{
+    using namespace ecs;
+
+    struct NameComponent
+    {
+        std::string name;
+
+        auto Tie() const { return std::tie(name); }
+    };
+
+    struct ValueComponent
+    {
+        int32_t value;
+        float scale;
+
+        auto Tie() const { return std::tie(value, scale); }
+    };
+
+    using Manager = ComponentManager<NameComponent, ValueComponent>;
+    World<Manager> simulation{};
+    World<Manager> spectator{};
+    Manager& componentManager = simulation.GetComponentManager();
+    std::vector<Entity> entities = simulation.CreateEntities(10, ValueComponent{-1, 1.0f});
+    const Tick lastSent = componentManager.AdvanceTick();
+    delta::Apply(delta::Encode(spectator, simulation), spectator);
+
+    componentManager.AdvanceTick();
+    simulation.DeleteEntity(entities[2]);
+    const Entity spawned = simulation.NewEntity();
+    componentManager.AddComponent(spawned, NameComponent{"spawned"});
+    componentManager.RemoveComponent<ValueComponent>(entities[5]);
+    componentManager.GetComponent<ValueComponent>(entities[7]).scale = 2.0f;
+    // Accessed but unchanged, so it is compared and skipped.
+    (void)componentManager.GetComponent<ValueComponent>(entities[8]);
+
+    const std::vector<std::byte> bytes = delta::Encode(spectator, simulation, lastSent);
+    delta::Apply(bytes, spectator);
+    TestAssert(spectator.GetHandle(spawned) == simulation.GetHandle(spawned), "Reused entity should have the same generation.");
+    TestAssert(spectator.GetComponentManager().GetSignature(spawned) == componentManager.GetSignature(spawned));
+    TestAssert(!spectator.GetComponentManager().GetSignature(entities[5])[Manager::kTypeIndex<ValueComponent>]);
+
+    const Manager& spectatorManager = spectator.GetComponentManager();
+    TestAssert(spectatorManager.GetComponent<ValueComponent>(entities[7]).scale == 2.0f);
+    TestAssert(spectatorManager.GetComponent<ValueComponent>(entities[7]).value == -1);
+    TestAssert(delta::Encode(spectator, simulation).size() < 16, "Applied delta should leave nothing to send.");
+
+    const auto applyFails = [&](std::span<const std::byte> invalid)
+    {
+        try
+        {
+            delta::Apply(invalid, spectator);
+        }
+        catch (const delta::DeltaError&)
+        {
+            return true;
+        }
+        return false;
+    };
+    TestAssert(applyFails(bytes), "Applying a delta twice should not match the world.");
+    TestAssert(applyFails(std::span(bytes).first(bytes.size() - 1)), "Truncated deltas should be rejected.");
+    TestAssert(delta::Encode(spectator, simulation).size() < 16, "Rejected deltas should leave the world unchanged.");
+}
+
+ADD_TEST_FUNC(TestStringTable)
+{
+    StringTable& table = Singleton<StringTable>::Get();
+    TestAssert(InternedString().View().empty() && InternedString("") == InternedString(), "The default handle should be the empty string.");
+
+    const InternedString player("textures/player.bmp");
+    TestAssert(player == InternedString(std::string("textures/player.bmp")) && player.View() == "textures/player.bmp");
+    TestAssert(player != InternedString("textures/enemy.bmp"));
+    TestAssert(table.Find("textures/player.bmp") == player && !table.Find("textures/missing.bmp"));
+    TestAssert(std::format("{}", player) == "textures/player.bmp", "Formatting should show the string.");
+
+    // Interned concurrently while the table grows, every string is interned once.
+    constexpr size_t kStringCount = 3000;
+    const size_t countBefore = table.GetCount();
+    std::vector<InternedString> strings(kStringCount * 2);
+    Singleton<jobs::JobSystem>::Get().ParallelFor(
+        strings.size(),
+        64,
+        [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                strings[i] = InternedString(std::format("texture {}", i % kStringCount));
+        });
+    TestAssert(table.GetCount() == countBefore + kStringCount);
+    for (size_t i = 0; i < kStringCount; ++i)
+        TestAssert(strings[i] == strings[i + kStringCount] && strings[i].View() == std::format("texture {}", i));
+
+    // Snapshots store the characters, so they stay valid in other processes.
+    using Manager = ecs::ComponentManager<components::Sprite>;
+    ecs::World<Manager> world{};
+    world.CreateEntities(10, components::Sprite{.path = player});
+    const std::vector<std::byte> bytes = snapshot::Save(world);
+    const std::string_view characters(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    TestAssert(characters.find("textures/player.bmp") != std::string_view::npos);
+    ecs::World<Manager> loaded{};
+    snapshot::Load(bytes, loaded);
+    size_t loadedCount = 0;
+    loaded.Each<const components::Sprite>([&](ecs::Entity, const components::Sprite& sprite) { loadedCount += sprite.path == player; });
+    TestAssert(loadedCount == 10);
+}
+
+ADD_TEST_FUNC(TestAssets)
+{
+    using namespace assets;
+    AssetManager& manager = Singleton<AssetManager>::Get();
+    // Registers the budget config variable on first use.
+    manager.GetBudgetBytes();
+    config::ConfigU32& budgetKiB = *std::get<config::ConfigU32*>(Singleton<config::Manager>::Get().GetVariables().at("AssetCacheBudgetKiB"));
+    const std::uint32_t previousBudgetKiB = *budgetKiB;
+    // 32x32 RGBA images take 4 KiB, two of them fit.
+    *budgetKiB = 8;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "tektonik-test-assets";
+    std::filesystem::create_directories(directory);
+    std::vector<InternedString> paths{};
+    for (std::uint8_t i = 0; i < 3; ++i)
+    {
+        SDL_Surface* surface = SDL_CreateSurface(32, 32, SDL_PIXELFORMAT_RGBA32);
+        TestAssert(surface && SDL_FillSurfaceRect(surface, nullptr, SDL_MapSurfaceRGBA(surface, i, 2, 3, 255)));
+        paths.push_back(InternedString((directory / std::format("image{}.bmp", i)).string()));
+        TestAssert(SDL_SaveBMP(surface, std::string(paths.back().View()).c_str()), SDL_GetError());
+        SDL_DestroySurface(surface);
+    }
+
+    ImageHandle first = manager.Request(paths[0]);
+    ImageHandle second = manager.Request(paths[1]);
+    TestAssert(manager.Request(paths[0]) == first, "Requests for the same path should share the entry.");
+    TestAssert(first.IsReady() || &first.Get() == &GetPlaceholder(), "Loading images should show the placeholder.");
+    manager.WaitIdle();
+    manager.Update();
+    TestAssert(first.IsReady() && first.Get().width == 32 && first.Get().height == 32);
+    TestAssert(first.Get().pixels[0] == std::byte{0} && second.Get().pixels[0] == std::byte{1} && second.Get().pixels[1] == std::byte{2});
+
+    // Images with handles stay over the budget, once released the least recently requested one goes first.
+    ImageHandle third = manager.Request(paths[2]);
+    manager.Request(paths[0]);
+    manager.WaitIdle();
+    manager.Update();
+    TestAssert(manager.GetCachedBytes() == 3 * 4096 && third.IsReady());
+    const size_t entryCount = manager.GetEntryCount();
+    first = {};
+    second = {};
+    manager.Update();
+    TestAssert(manager.GetCachedBytes() == 2 * 4096 && manager.GetEntryCount() == entryCount - 1);
+    TestAssert(manager.Request(paths[0]).IsReady(), "The most recently requested image should stay cached.");
+
+    // Failed images leave the cache, so the next request retries.
+    const InternedString missingPath((directory / "missing.bmp").string());
+    ImageHandle missing = manager.Request(missingPath);
+    manager.WaitIdle();
+    TestAssert(missing.GetState() == AssetState::Failed && &missing.Get() == &GetPlaceholder() && !missing.GetError().empty());
+    const size_t entryCountWithMissing = manager.GetEntryCount();
+    manager.Update();
+    TestAssert(manager.GetEntryCount() == entryCountWithMissing - 1);
+    SDL_Surface* surface = SDL_CreateSurface(32, 32, SDL_PIXELFORMAT_RGBA32);
+    TestAssert(surface && SDL_SaveBMP(surface, std::string(missingPath.View()).c_str()), SDL_GetError());
+    SDL_DestroySurface(surface);
+    ImageHandle retried = manager.Request(missingPath);
+    manager.WaitIdle();
+    manager.Update();
+    TestAssert(retried.IsReady() && missing.GetState() == AssetState::Failed);
+    retried = {};
+
+    // Custom decoders report their own errors.
+    {
+        AssetManager failing([](std::string_view) -> Image { throw std::runtime_error("Unsupported format."); });
+        ImageHandle failed = failing.Request(paths[0]);
+        failing.WaitIdle();
+        TestAssert(failed.GetState() == AssetState::Failed && failed.GetError() == "Unsupported format.");
+    }
+
+    *budgetKiB = previousBudgetKiB;
+    std::filesystem::remove_all(directory);
+}
+
+ADD_TEST_FUNC(TestPng)
+{
+    const assets::Image image{.width = 2, .height = 1, .pixels = std::vector<std::byte>(8, std::byte{0x7F})};
+    const std::vector<std::byte> png = assets::EncodePng(image);
+    const auto bytesAt = [&](std::size_t offset, std::size_t count) { return std::span(png).subspan(offset, count); };
+    const auto equals = [](std::span<const std::byte> bytes, std::initializer_list<std::uint8_t> expected)
+    { return std::ranges::equal(bytes, expected, {}, {}, [](std::uint8_t value) { return std::byte{value}; }); };
+
+    TestAssert(equals(bytesAt(0, 8), {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'}), "Signature should match.");
+    // Width 2, height 1, 8 bit RGBA.
+    TestAssert(equals(bytesAt(8, 8), {0, 0, 0, 13, 'I', 'H', 'D', 'R'}) && equals(bytesAt(16, 10), {0, 0, 0, 2, 0, 0, 0, 1, 8, 6}));
+    // The empty IEND chunk always has the same CRC.
+    TestAssert(equals(bytesAt(png.size() - 12, 12), {0, 0, 0, 0, 'I', 'E', 'N', 'D', 0xAE, 0x42, 0x60, 0x82}));
+}
+
+ADD_TEST_FUNC(TestSplitComponent)
+{
+    using namespace ecs;
+
+    struct TransformComponent
+    {
+        float x = 0;
+        float y = 0;
+        float rotation = 0;
+
+        using Layout = SplitFields;
+
+        auto Tie() const { return std::tie(x, y, rotation); }
+    };
+
+    struct NameComponent
+    {
+        std::string name;
+
+        auto Tie() const { return std::tie(name); }
+    };
+
+    using Manager = ComponentManager<TransformComponent, NameComponent>;
+    static_assert(SplitComponent<TransformComponent> && !SplitComponent<NameComponent>);
+    World<Manager> world{};
+    Manager& componentManager = world.GetComponentManager();
+    std::vector<Entity> entities = world.CreateEntities(100, TransformComponent{.x = 1, .y = 2, .rotation = 3});
+    componentManager.RemoveComponent<TransformComponent>(entities[0]);
+
+    // References write through to the columns and convert from and to the component.
+    componentManager.GetComponent<TransformComponent>(entities[1]) = TransformComponent{.x = 5};
+    componentManager.GetComponent<TransformComponent>(entities[2]).Get<2>() = 7;
+    const TransformComponent transform = componentManager.GetComponent<TransformComponent>(entities[2]);
+    TestAssert(transform.x == 1 && transform.rotation == 7);
+
+    // A kernel touching only x streams only the x column.
+    for (float& x : componentManager.GetFieldColumn<TransformComponent, 0>())
+        x += 1;
+    TestAssert(componentManager.GetEntityColumn<TransformComponent>().size() == 99);
+
+    size_t matching = 0;
+    world.Each<const TransformComponent>(
+        [&](Entity entity, FieldsReference<TransformComponent, true> transform)
+        { matching += transform.Get<0>() == (entity == entities[1] ? 6 : 2) && transform.Get<1>() == (entity == entities[1] ? 0 : 2); });
+    TestAssert(matching == 99, "Columns should stay parallel through removal.");
+
+    // Split components can name the fields of their references.
+    World<ComponentManager<components::Transform2D>> transformWorld{};
+    const Entity entity = transformWorld.CreateEntities(1, components::Transform2D{.rotation = 2})[0];
+    auto& transformManager = transformWorld.GetComponentManager();
+    transformManager.GetComponent<components::Transform2D>(entity).Position() = {3, 4};
+    const auto reference = std::as_const(transformManager).GetComponent<components::Transform2D>(entity);
+    TestAssert(reference.Position() == glm::vec2(3, 4) && reference.Rotation() == 2 && reference.Scale() == glm::vec2(1, 1));
+}
+
+ADD_TEST_FUNC(TestTransformKernels)
+{
+    using namespace transform;
+
+    // Odd count so the vector paths also run their scalar tails.
+    constexpr size_t count = 1003;
+    std::vector<glm::vec2> positions(count), scales(count), velocities(count);
+    std::vector<float> rotations(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float value = static_cast<float>(i);
+        positions[i] = {value * 0.5f, -value};
+        rotations[i] = value * 0.37f - 150.0f;
+        scales[i] = {1.0f + value * 0.01f, 2.0f};
+        velocities[i] = {1.0f, value * 0.25f};
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto [sin, cos] = SinCos(rotations[i]);
+        TestAssert(std::abs(sin - std::sin(rotations[i])) < 1e-6f && std::abs(cos - std::cos(rotations[i])) < 1e-6f);
+    }
+
+    const InstructionSet supported = GetSupportedInstructionSet();
+    std::vector<glm::mat4> expected{};
+    for (InstructionSet instructionSet : {InstructionSet::Scalar, InstructionSet::Sse42, InstructionSet::Avx2})
+    {
+        if (instructionSet > supported)
+            break;
+        SetInstructionSet(instructionSet);
+
+        std::vector<glm::vec2> integrated = positions;
+        Integrate(integrated, velocities, 0.5f);
+        std::vector<glm::vec2> composedPositions = integrated;
+        std::vector<float> composedRotations = rotations;
+        std::vector<glm::vec2> composedScales = scales;
+        const TransformColumns composed{composedPositions, composedRotations, composedScales};
+        Compose(ConstTransformColumns{positions, rotations, scales}, composed, composed);
+        std::vector<glm::mat4> matrices(count);
+        ToMatrices(composed, matrices);
+
+        if (instructionSet == InstructionSet::Scalar)
+        {
+            expected = matrices;
+            const float sin = std::sin(composedRotations[3]);
+            const float cos = std::cos(composedRotations[3]);
+            TestAssert(std::abs(matrices[3][0][0] - cos * composedScales[3].x) < 1e-4f && std::abs(matrices[3][1][0] + sin * composedScales[3].y) < 1e-4f);
+            TestAssert(matrices[3][3][0] == composedPositions[3].x && matrices[3][3][3] == 1);
+        }
+        else
+            TestAssert(std::memcmp(matrices.data(), expected.data(), count * sizeof(glm::mat4)) == 0, "Every instruction set should give the same bits.");
+    }
+    SetInstructionSet(supported);
+}
+
+ADD_TEST_FUNC(TestSpatialIndex)
+{
+    using namespace spatial;
+
+    std::mt19937 random(7);
+    const auto randomFloat = [&](float from, float to) { return std::uniform_real_distribution<float>(from, to)(random); };
+    const auto randomAabb = [&](float size)
+    {
+        const glm::vec2 min{randomFloat(-100, 100), randomFloat(-100, 100)};
+        return Aabb{.min = min, .max = {min.x + randomFloat(0, size), min.y + randomFloat(0, size)}};
+    };
+
+    HashGrid grid(8.0f);
+    AabbTree tree(1.0f);
+    for (SpatialIndex* index : std::initializer_list<SpatialIndex*>{&grid, &tree})
+    {
+        // Compared against brute force while entities are inserted, moved and removed.
+        std::map<Entity, Aabb> bounds{};
+        for (size_t round = 0; round < 10; ++round)
+        {
+            for (size_t i = 0; i < 100; ++i)
+            {
+                const Entity entity = random() % 300;
+                if (random() % 5 == 0 && index->Contains(entity))
+                {
+                    index->Remove(entity);
+                    bounds.erase(entity);
+                    continue;
+                }
+                bounds[entity] = randomAabb(random() % 10 == 0 ? 40.0f : 6.0f);
+                index->Update(entity, bounds[entity]);
+            }
+            TestAssert(index->GetCount() == bounds.size());
+
+            const Aabb region = randomAabb(30.0f);
+            std::vector<Entity> found{};
+            index->QueryRegion(region, found);
+            std::ranges::sort(found);
+            std::vector<Entity> expected{};
+            for (const auto& [entity, aabb] : bounds)
+                if (aabb.Overlaps(region))
+                    expected.push_back(entity);
+            TestAssert(found == expected, "Region queries should report every overlapping entity once.");
+
+            const glm::vec2 point{randomFloat(-150, 150), randomFloat(-150, 150)};
+            float nearest = std::numeric_limits<float>::infinity();
+            for (const auto& [entity, aabb] : bounds)
+                nearest = std::min(nearest, std::sqrt(GetDistanceSquared(aabb, point)));
+            const std::optional<Hit> nearestHit = index->QueryNearest(point, std::numeric_limits<float>::infinity());
+            TestAssert(nearestHit && std::abs(nearestHit->distance - nearest) < 1e-3f);
+
+            const float angle = randomFloat(0, 6.28f);
+            const Ray ray{.origin = point, .direction = {std::cos(angle), std::sin(angle)}, .maxDistance = 200.0f};
+            float first = std::numeric_limits<float>::infinity();
+            for (const auto& [entity, aabb] : bounds)
+                if (const std::optional<float> distance = Intersect(ray, aabb, ray.maxDistance))
+                    first = std::min(first, *distance);
+            const std::optional<Hit> rayHit = index->RayCast(ray);
+            TestAssert(rayHit ? std::abs(rayHit->distance - first) < 1e-3f : first == std::numeric_limits<float>::infinity());
+
+            std::vector<std::pair<Entity, Entity>> pairs{};
+            index->GeneratePairs(pairs);
+            std::ranges::sort(pairs);
+            std::vector<std::pair<Entity, Entity>> expectedPairs{};
+            for (auto first = bounds.begin(); first != bounds.end(); ++first)
+                for (auto second = std::next(first); second != bounds.end(); ++second)
+                    if (first->second.Overlaps(second->second))
+                        expectedPairs.emplace_back(first->first, second->first);
+            TestAssert(pairs == expectedPairs, "Pairs should be reported once each.");
+        }
+
+        // Rays that never leave their cell must still end.
+        for (const glm::vec2 direction : {glm::vec2(0, 0), glm::vec2(std::numeric_limits<float>::denorm_min(), 0)})
+            static_cast<void>(index->RayCast(Ray{.origin = {randomFloat(-100, 100), randomFloat(-100, 100)}, .direction = direction}));
+    }
+    TestAssert(tree.IsValid());
+
+    // Emptied cells are released.
+    for (Entity entity = 0; entity < 300; ++entity)
+        if (grid.Contains(entity))
+            grid.Remove(entity);
+    TestAssert(grid.GetCellCount() == 0 && !grid.QueryNearest({0, 0}, std::numeric_limits<float>::infinity()));
+
+    // Only changed transforms are visited.
+    using Manager = ecs::ComponentManager<components::Transform2D, components::Box2D, components::Circle2D>;
+    ecs::World<Manager> world{};
+    Manager& componentManager = world.GetComponentManager();
+    const std::vector<Entity> boxes = world.CreateEntities(10, components::Transform2D{}, components::Box2D{.size = {2, 4}});
+    world.CreateEntities(5, components::Transform2D{.position = {10, 0}}, components::Circle2D{});
+    AabbTree index(0.5f);
+    const ecs::Tick lastUpdate = componentManager.AdvanceTick();
+    UpdateIndex(index, componentManager, 0);
+    TestAssert(index.GetCount() == 15);
+
+    componentManager.AdvanceTick();
+    componentManager.GetComponent<components::Transform2D>(boxes[3]) = components::Transform2D{.position = {50, 50}};
+    UpdateIndex(index, componentManager, lastUpdate);
+    std::vector<Entity> found{};
+    index.QueryRegion(Aabb{.min = {49, 49}, .max = {51, 51}}, found);
+    TestAssert(found == std::vector<Entity>{boxes[3]});
+
+    // An entity with both shapes is indexed with the box bounds, like collision::GetShape.
+    componentManager.AdvanceTick();
+    const Entity both = world.CreateEntities(1, components::Transform2D{.position = {-50, -50}}, components::Box2D{}, components::Circle2D{.radius = 5})[0];
+    UpdateIndex(index, componentManager, lastUpdate);
+    found.clear();
+    index.QueryRegion(Aabb{.min = {-54, -54}, .max = {-52, -52}}, found);
+    TestAssert(found.empty(), "The circle should not overwrite the box bounds.");
+    index.QueryRegion(Aabb{.min = {-51, -51}, .max = {-49, -49}}, found);
+    TestAssert(found == std::vector<Entity>{both});
+
+    // Destroyed and shapeless entities are removed.
+    world.DeleteEntity(both);
+    componentManager.RemoveComponent<components::Box2D>(boxes[3]);
+    RemoveStale(index, componentManager);
+    TestAssert(index.GetCount() == 14 && !index.Contains(both) && !index.Contains(boxes[3]));
+    found.clear();
+    index.QueryRegion(Aabb{.min = {-100, -100}, .max = {100, 100}}, found);
+    TestAssert(found.size() == 14 && std::ranges::find(found, boxes[3]) == found.end());
+
+    // Incremental updates end up with the same index as a rebuild, also after writes through field columns.
+    const std::vector<Entity> circles = world.CreateEntities(200, components::Transform2D{}, components::Circle2D{});
+    HashGrid incrementalGrid(4.0f);
+    AabbTree incrementalTree(0.5f);
+    ecs::Tick lastIncrementalUpdate = 0;
+    for (size_t round = 0; round < 5; ++round)
+    {
+        componentManager.AdvanceTick();
+        for (size_t i = 0; i < 20; ++i)
+        {
+            const Entity entity = circles[random() % circles.size()];
+            componentManager.GetComponent<components::Transform2D>(entity).Position() = {randomFloat(-50, 50), randomFloat(-50, 50)};
+            componentManager.GetComponent<components::Circle2D>(circles[random() % circles.size()]).radius = randomFloat(0.5f, 3);
+        }
+        if (round % 2 == 1)
+            for (glm::vec2& position : componentManager.GetFieldColumn<components::Transform2D, 0>())
+                position.x += 1;
+
+        const ecs::Tick thisUpdate = componentManager.AdvanceTick();
+        UpdateIndex(incrementalGrid, componentManager, lastIncrementalUpdate);
+        UpdateIndex(incrementalTree, componentManager, lastIncrementalUpdate);
+        lastIncrementalUpdate = thisUpdate;
+
+        AabbTree rebuilt(0.5f);
+        UpdateIndex(rebuilt, componentManager, 0);
+        std::vector<std::pair<Entity, Entity>> expectedPairs{};
+        rebuilt.GeneratePairs(expectedPairs);
+        std::ranges::sort(expectedPairs);
+        for (const SpatialIndex* incremental : std::initializer_list<const SpatialIndex*>{&incrementalGrid, &incrementalTree})
+        {
+            std::vector<std::pair<Entity, Entity>> pairs{};
+            incremental->GeneratePairs(pairs);
+            std::ranges::sort(pairs);
+            TestAssert(pairs == expectedPairs, "Incrementally updated indexes should match a rebuilt one.");
+        }
+    }
+}
+
+ADD_TEST_FUNC(TestCollision)
+{
+    using namespace collision;
+
+    std::mt19937 random(5);
+    const auto randomFloat = [&](float from, float to) { return std::uniform_real_distribution<float>(from, to)(random); };
+    const auto randomShape = [&](float range) -> Shape
+    {
+        const glm::vec2 center{randomFloat(-range, range), randomFloat(-range, range)};
+        if (random() % 2)
+            return Circle{.center = center, .radius = randomFloat(0.2f, 2)};
+        return Box{.center = center, .halfExtents = {randomFloat(0.2f, 2), randomFloat(0.2f, 2)}, .rotation = randomFloat(-4, 4)};
+    };
+    const auto moved = [](const Shape& shape, glm::vec2 offset)
+    {
+        return std::visit(
+            [&](auto moved) -> Shape
+            {
+                moved.center.x += offset.x;
+                moved.center.y += offset.y;
+                return moved;
+            },
+            shape);
+    };
+
+    // Moving the second shape along the normal by the depth separates the shapes.
+    for (size_t i = 0; i < 10000; ++i)
+    {
+        const Shape a = randomShape(3);
+        const Shape b = randomShape(3);
+        const std::optional<Contact> contact = Collide(1, a, 2, b);
+        if (!contact)
+            continue;
+        TestAssert(std::abs(std::hypot(contact->normal.x, contact->normal.y) - 1) < 1e-4f, "Normals should be unit vectors.");
+        const Shape& first = contact->first == 1 ? a : b;
+        const Shape& second = contact->first == 1 ? b : a;
+        const float apart = contact->depth + 2e-3f;
+        TestAssert(!Collide(1, first, 2, moved(second, {contact->normal.x * apart, contact->normal.y * apart})));
+        const float together = contact->depth - 2e-3f;
+        if (together > 2e-3f)
+            TestAssert(Collide(1, first, 2, moved(second, {contact->normal.x * together, contact->normal.y * together})).has_value());
+    }
+
+    // Batches give exactly the contacts of single pair tests, the buffer is reusable.
+    std::vector<Shape> shapes{};
+    for (size_t i = 0; i < 1000; ++i)
+        shapes.push_back(randomShape(15));
+    ContactBuffer buffer{};
+    for (size_t round = 0; round < 2; ++round)
+    {
+        buffer.Clear();
+        std::vector<std::tuple<Entity, Entity, float, float, float>> expected{};
+        for (size_t i = 0; i < 5000; ++i)
+        {
+            const Entity first = random() % shapes.size();
+            const Entity second = random() % shapes.size();
+            buffer.Add(first, shapes[first], second, shapes[second]);
+            if (const std::optional<Contact> contact = Collide(first, shapes[first], second, shapes[second]))
+                expected.emplace_back(contact->first, contact->second, contact->normal.x, contact->normal.y, contact->depth);
+        }
+        buffer.Collide();
+        std::vector<std::tuple<Entity, Entity, float, float, float>> found{};
+        for (const Contact& contact : buffer.GetContacts())
+            found.emplace_back(contact.first, contact.second, contact.normal.x, contact.normal.y, contact.depth);
+        std::ranges::sort(expected);
+        std::ranges::sort(found);
+        TestAssert(!found.empty() && found == expected);
+    }
+
+    using Manager = ecs::ComponentManager<components::Transform2D, components::Box2D, components::Circle2D>;
+    ecs::World<Manager> world{};
+    Manager& componentManager = world.GetComponentManager();
+    const std::vector<Entity> boxes = world.CreateEntities(2, components::Transform2D{}, components::Box2D{.size = {2, 2}});
+    componentManager.GetComponent<components::Transform2D>(boxes[1]) = components::Transform2D{.position = {1.5f, 0}};
+    const Entity circle = world.CreateEntities(1, components::Transform2D{.position = {0, 1.5f}}, components::Circle2D{.radius = 1})[0];
+    const Entity unplaced = world.CreateEntities(1, components::Box2D{})[0];
+    const std::vector<std::pair<Entity, Entity>> pairs{{boxes[0], boxes[1]}, {boxes[0], circle}, {circle, unplaced}};
+    GenerateContacts(componentManager, std::span(pairs), buffer);
+    TestAssert(buffer.GetContacts().size() == 2);
+    for (const Contact& contact : buffer.GetContacts())
+    {
+        TestAssert(std::abs(contact.depth - 0.5f) < 1e-5f);
+        if (contact.first == circle)
+            TestAssert(contact.second == boxes[0] && std::abs(contact.normal.y + 1) < 1e-5f, "Circles come first.");
+        else
+            TestAssert(contact.first == boxes[0] && contact.second == boxes[1] && std::abs(contact.normal.x - 1) < 1e-5f);
+    }
+}
+
+ADD_TEST_FUNC(TestRenderBatch)
+{
+    using namespace components;
+    using Manager = ecs::ComponentManager<Transform2D, Box2D, Circle2D, Sprite, Color>;
+    ecs::World<Manager> world{};
+    const InternedString player("textures/player.bmp");
+    world.CreateEntities(3, Transform2D{.position = {1.0f, 2.0f}, .scale = {2.0f, 3.0f}}, Box2D{.size = {4.0f, 5.0f}}, Color{});
+    world.CreateEntities(2, Transform2D{}, Circle2D{.radius = 2.0f}, Color{});
+    world.CreateEntities(4, Transform2D{}, Sprite{.path = player}, Color{});
+    // Entities without a Color are not drawn.
+    world.CreateEntities(5, Transform2D{}, Box2D{});
+
+    renderer::InstanceBatch batch{};
+    batch.Extract(world);
+    TestAssert(batch.GetInstances().size() == 9);
+    const auto box = batch.GetRange(renderer::Material::Box);
+    const auto circle = batch.GetRange(renderer::Material::Circle);
+    const auto sprite = batch.GetRange(renderer::Material::Sprite);
+    TestAssert(box.first == 0 && box.count == 3 && circle.first == 3 && circle.count == 2 && sprite.first == 5 && sprite.count == 4);
+    TestAssert(batch.GetInstances()[0].position == glm::vec2(1.0f, 2.0f) && batch.GetInstances()[0].size == glm::vec2(8.0f, 15.0f));
+    TestAssert(batch.GetInstances()[circle.first].size == glm::vec2(4.0f, 4.0f));
+    TestAssert(batch.GetInstances()[sprite.first].size == glm::vec2(1.0f, 1.0f), "Sprites should be sized in world units.");
+
+    // New textures are reported once and show the placeholder until they get a slot.
+    TestAssert(batch.GetInstances()[sprite.first].textureSlot == renderer::InstanceBatch::kPlaceholderSlot);
+    TestAssert(batch.TakeNewTextures() == std::vector{player} && batch.TakeNewTextures().empty());
+    batch.SetTextureSlot(player, 7);
+    batch.Extract(world);
+    for (const renderer::Instance& instance : batch.GetInstances().subspan(sprite.first, sprite.count))
+        TestAssert(instance.textureSlot == 7);
+    TestAssert(batch.TakeNewTextures().empty());
+}
+
+ADD_TEST_FUNC(TestHeadlessRenderer)
+{
+    using namespace components;
+    using Manager = ecs::ComponentManager<Transform2D, Box2D, Circle2D, Sprite, Color>;
+    ecs::World<Manager> world{};
+    // One pixel per world unit, so the box covers the left half of the image and the sprite the right half.
+    world.CreateEntities(1, Transform2D{.position = {-16.0f, 0.0f}}, Box2D{.size = {32.0f, 64.0f}}, Color{.color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f)});
+    const std::filesystem::path texturePath = std::filesystem::temp_directory_path() / "tektonik-test-green.bmp";
+    SDL_Surface* surface = SDL_CreateSurface(2, 2, SDL_PIXELFORMAT_RGBA32);
+    TestAssert(surface && SDL_FillSurfaceRect(surface, nullptr, SDL_MapSurfaceRGBA(surface, 0, 255, 0, 255)));
+    TestAssert(SDL_SaveBMP(surface, texturePath.string().c_str()), SDL_GetError());
+    SDL_DestroySurface(surface);
+    world.CreateEntities(
+        1, Transform2D{.position = {16.0f, 0.0f}, .scale = {32.0f, 64.0f}}, Sprite{.path = InternedString(texturePath.string())}, Color{.color = glm::vec4(1.0f)});
+
+    renderer::Renderer renderer(renderer::Renderer::CreateInfo{.headless = true, .size = {64, 64}, .readback = true});
+    // The first frame requests the texture, the next ones upload it and draw the sprite with it.
+    renderer.Render(world);
+    Singleton<assets::AssetManager>::Get().WaitIdle();
+    for (int frame = 0; frame < 3; ++frame)
+        renderer.Render(world);
+    const assets::Image image = renderer.ReadbackLastFrame();
+    TestAssert(image.width == 64 && image.height == 64 && image.pixels.size() == 64 * 64 * 4);
+    const auto channel = [&](std::size_t x, std::size_t y, std::size_t component) { return image.pixels[(y * image.width + x) * 4 + component]; };
+    TestAssert(channel(8, 32, 0) == std::byte{255} && channel(8, 32, 1) == std::byte{0}, "The left half should be red.");
+    TestAssert(channel(56, 32, 0) == std::byte{0} && channel(56, 32, 1) == std::byte{255}, "The right half should show the uploaded texture.");
+    TestAssert(renderer.GetLatestTimings().cpu.count() > 0.0);
+
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "tektonik-test-headless.png";
+    assets::WritePng(image, path);
+    TestAssert(std::filesystem::file_size(path) == assets::EncodePng(image).size());
+    std::filesystem::remove(path);
+    std::filesystem::remove(texturePath);
+}
+
+ADD_TEST_FUNC(TestHeadlessBatch)
+{
+    using namespace components;
+    using Manager = ecs::ComponentManager<Transform2D, Box2D, Circle2D, Sprite, Color>;
+    ecs::World<Manager> world{};
+    // One pixel per world unit. A box per pixel fills the top half with red and blue columns, enough instances for several
+    // secondary buffers. A circle in the bottom half is drawn after them.
+    constexpr std::uint32_t kSize = 128;
+    const auto pixelCenter = [](std::uint32_t x, std::uint32_t y) { return glm::vec2(x + 0.5f - kSize / 2, kSize / 2 - (y + 0.5f)); };
+    for (std::uint32_t y = 0; y < kSize / 2; ++y)
+        for (std::uint32_t x = 0; x < kSize; ++x)
+        {
+            const glm::vec4 color = x % 2 ? glm::vec4(0.0f, 0.0f, 1.0f, 1.0f) : glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+            world.CreateEntities(1, Transform2D{.position = pixelCenter(x, y)}, Box2D{}, Color{.color = color});
+        }
+    world.CreateEntities(1, Transform2D{.position = {0.0f, -32.0f}}, Circle2D{.radius = 16.0f}, Color{.color = glm::vec4(0.0f, 1.0f, 0.0f, 1.0f)});
+
+    renderer::Renderer renderer(renderer::Renderer::CreateInfo{.headless = true, .size = {kSize, kSize}, .readback = true});
+    renderer.Render(world);
+    const assets::Image image = renderer.ReadbackLastFrame();
+    TestAssert(image.width == kSize && image.height == kSize);
+    const auto pixel = [&](std::uint32_t x, std::uint32_t y)
+    {
+        const auto channels = std::span(image.pixels).subspan((std::size_t{y} * image.width + x) * 4, 3);
+        return std::array{std::to_integer<int>(channels[0]), std::to_integer<int>(channels[1]), std::to_integer<int>(channels[2])};
+    };
+    using Rgb = std::array<int, 3>;
+    for (std::uint32_t y : {0u, 31u, 63u})
+        for (std::uint32_t x : {0u, 1u, 64u, 127u})
+            TestAssert(pixel(x, y) == (x % 2 ? Rgb{0, 0, 255} : Rgb{255, 0, 0}), "Every box should cover its pixel.");
+    TestAssert(pixel(64, 96) == Rgb{0, 255, 0}, "The circle should be drawn.");
+    TestAssert(pixel(64 + 20, 96) == Rgb{0, 0, 0} && pixel(0, 127) == Rgb{0, 0, 0}, "Outside the circle should stay clear.");
+}
+
+ADD_TEST_FUNC(TestRegisteredQuery)
+{
+    using namespace ecs;
+
+    struct NameComponent
+    {
+        std::string name;
+
+        auto Tie() const { return std::tie(name); }
+    };
+
+    struct ValueComponent
+    {
+        uint32_t value;
+
+        auto Tie() const { return std::tie(value); }
+    };
+
+    struct FlagComponent
+    {
+        bool flag;
+
+        auto Tie() const { return std::tie(flag); }
+    };
+
+    ComponentManager<NameComponent, ValueComponent, FlagComponent> componentManager{};
+    QueryHandle valueQuery = componentManager.RegisterQuery<ValueComponent>();
+    TestAssert(valueQuery.index == componentManager.RegisterQuery<ValueComponent>().index, "Same query should be registered once.");
+
+    // Signatures appearing after the registration must be picked up by the query.
+    for (Entity entity = 0; entity < 10; ++entity)
+    {
+        componentManager.AddComponent(entity, ValueComponent{entity});
+        if (entity % 2 == 1)
+            componentManager.AddComponent(entity, NameComponent{"named"});
+    }
+
+    size_t valueCount = 0;
+    for (Entity entity : componentManager.GetEntities(valueQuery))
+    {
+        TestAssert(componentManager.GetComponent<ValueComponent>(entity).value == entity);
+        ++valueCount;
+    }
+    TestAssert(valueCount == 10, "All entities have a value component.");
+
+    size_t bothCount = std::ranges::distance(componentManager.GetEntitiesWithComponents<NameComponent, ValueComponent>());
+    TestAssert(bothCount == 5, "Only odd entities have a name component.");
+
+    // Ranges taken before a new signature appears see its set, and so do their copies.
+    EntityRange nameRange = componentManager.GetEntitiesWithComponents<NameComponent>();
+    componentManager.AddComponent(10, NameComponent{"only named"});
+    EntityRange copiedRange = nameRange;
+    TestAssert(std::ranges::distance(nameRange) == 6 && std::ranges::distance(copiedRange) == 6, "Ranges should include sets added later.");
+
+    // Ranges and their iterators survive the registration of more queries, also from inside a loop over them.
+    componentManager.AddComponent(1, FlagComponent{true});
+    auto nameIterator = nameRange.begin();
+    componentManager.RegisterQuery<FlagComponent>();
+    componentManager.RegisterQuery<FlagComponent, ValueComponent>();
+    componentManager.RegisterQuery<FlagComponent, NameComponent>();
+    TestAssert(*nameIterator == *copiedRange.begin() && std::ranges::distance(nameRange) == 6);
+    size_t flaggedCount = 0;
+    for (Entity entity : nameRange)
+    {
+        TestAssert(componentManager.GetSignature(entity)[componentManager.kTypeIndex<NameComponent>]);
+        flaggedCount += std::ranges::distance(componentManager.GetEntitiesWithComponents<FlagComponent, NameComponent, ValueComponent>());
+    }
+    TestAssert(flaggedCount == 6, "Only entity 1 has every component.");
+}
+
+ADD_TEST_FUNC(TestComponentView)
+{
+    using namespace ecs;
+
+    struct NameComponent
+    {
+        std::string name;
+
+        auto Tie() const { return std::tie(name); }
+    };
+
+    struct ValueComponent
+    {
+        uint32_t value;
+
+        auto Tie() const { return std::tie(value); }
+    };
+
+    World<ComponentManager<NameComponent, ValueComponent>> world{};
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        Entity entity = world.NewEntity();
+        world.GetComponentManager().AddComponent(entity, ValueComponent{entity});
+        if (entity % 2 == 1)
+            world.GetComponentManager().AddComponent(entity, NameComponent{std::to_string(entity)});
+    }
+
+    size_t viewCount = 0;
+    for (auto [entity, name, value] : world.View<NameComponent, ValueComponent>())
+    {
+        TestAssert(name.name == std::to_string(value.value), "View yielded components of different entities.");
+        value.value *= 2;
+        ++viewCount;
+    }
+    TestAssert(viewCount == 50, "Only odd entities have both components.");
+
+    size_t eachCount = 0;
+    world.Each<ValueComponent, NameComponent>(
+        [&](Entity entity, ValueComponent& value, NameComponent&)
+        {
+            TestAssert(value.value == entity * 2, "View should have handed out mutable references.");
+            ++eachCount;
+        });
+    TestAssert(eachCount == 50, "Each should visit the same entities as View.");
+}
+
+ADD_TEST_FUNC(TestParallelForEach)
+{
+    using namespace ecs;
+
+    struct PositionComponent
+    {
+        uint32_t position;
+
+        auto Tie() const { return std::tie(position); }
+    };
+
+    struct VelocityComponent
+    {
+        uint32_t velocity;
+
+        auto Tie() const { return std::tie(velocity); }
+    };
+
+    World<ComponentManager<PositionComponent, VelocityComponent>> world{};
+    for (uint32_t i = 0; i < 100'000; ++i)
+    {
+        Entity entity = world.NewEntity();
+        world.GetComponentManager().AddComponent(entity, PositionComponent{entity});
+        if (entity % 3 == 0)
+            world.GetComponentManager().AddComponent(entity, VelocityComponent{2});
+    }
+
+    std::atomic<size_t> visitedCount{0};
+    world.ParallelForEach<PositionComponent, VelocityComponent>(
+        [&](Entity, PositionComponent& position, VelocityComponent& velocity)
+        {
+            position.position += velocity.velocity;
+            ++visitedCount;
+        },
+        1000);
+    TestAssert(visitedCount == 33'334, "ParallelForEach should visit every matching entity exactly once.");
+
+    bool positionsMatch = true;
+    world.Each<PositionComponent>([&](Entity entity, PositionComponent& position)
+                                  { positionsMatch &= position.position == (entity % 3 == 0 ? entity + 2 : entity); });
+    TestAssert(positionsMatch, "Only entities with a velocity should have moved.");
+
+    // Dense arrays start on a cache line, so ranges of whole cache lines start on one too.
+    struct SplitPositionComponent
+    {
+        uint32_t x;
+        uint64_t y;
+
+        using Layout = SplitFields;
+
+        auto Tie() const { return std::tie(x, y); }
+    };
+    ComponentManager<SplitPositionComponent> splitManager{};
+    for (Entity entity = 0; entity < 100; ++entity)
+        splitManager.AddComponent(entity, SplitPositionComponent{});
+    const auto isAligned = [](const auto* data) { return reinterpret_cast<std::uintptr_t>(data) % 64 == 0; };
+    TestAssert(isAligned(std::as_const(splitManager).GetFieldColumn<SplitPositionComponent, 0>().data()) &&
+                   isAligned(std::as_const(splitManager).GetFieldColumn<SplitPositionComponent, 1>().data()),
+               "Component columns should be cache line aligned.");
+}
+
+ADD_TEST_FUNC(TestSystemManager)
+{
+    using namespace ecs;
+
+    struct NameComponent
+    {
+        std::string name;
+
+        auto Tie() const { return std::tie(name); }
+    };
+
+    struct ValueComponent
+    {
+        uint32_t value;
+
+        auto Tie() const { return std::tie(value); }
+    };
+
+    struct CounterComponent
+    {
+        uint32_t count;
+
+        auto Tie() const { return std::tie(count); }
+    };
+
+    using Manager = ComponentManager<NameComponent, ValueComponent, CounterComponent>;
+    using Mode = SystemManager<Manager>::ExecutionMode;
+
+    for (Mode mode : {Mode::Parallel, Mode::Serial})
+    {
+        World<Manager> world{};
+        for (uint32_t i = 0; i < 100; ++i)
+        {
+            Entity entity = world.NewEntity();
+            world.GetComponentManager().AddComponent(entity, NameComponent{});
+            world.GetComponentManager().AddComponent(entity, ValueComponent{entity});
+            world.GetComponentManager().AddComponent(entity, CounterComponent{0});
+        }
+
+        auto& systemManager = world.GetSystemManager();
+        systemManager.SetExecutionMode(mode);
+        systemManager.AddSystem(
+            "Increment", Reads<>{}, Writes<ValueComponent>{}, [](Manager& manager) { manager.Each<ValueComponent>([](Entity, ValueComponent& value) { ++value.value; }); });
+        // Reads what Increment writes, so it must always run after it.
+        systemManager.AddSystem(
+            "Name",
+            Reads<ValueComponent>{},
+            Writes<NameComponent>{},
+            [](Manager& manager)
+            { manager.Each<ValueComponent, NameComponent>([](Entity, ValueComponent& value, NameComponent& name) { name.name = std::to_string(value.value); }); });
+        // Independent of the others.
+        systemManager.AddSystem(
+            "Count", Reads<>{}, Writes<CounterComponent>{}, [](Manager& manager) { manager.Each<CounterComponent>([](Entity, CounterComponent& counter) { ++counter.count; }); });
+
+        constexpr uint32_t kRunCount = 10;
+        for (uint32_t i = 0; i < kRunCount; ++i)
+            world.RunSystems();
+
+        world.Each<NameComponent, ValueComponent, CounterComponent>(
+            [&](Entity entity, NameComponent& name, ValueComponent& value, CounterComponent& counter)
+            {
+                TestAssert(value.value == entity + kRunCount);
+                TestAssert(name.name == std::to_string(value.value), "Name system ran before the system it depends on.");
+                TestAssert(counter.count == kRunCount);
+            });
+    }
+}
+
+ADD_TEST_FUNC(TestArchetypeComponentManager)
+{
+    using namespace ecs;
+
+    struct NameComponent
+    {
+        std::string name;
+
+        auto Tie() const { return std::tie(name); }
+    };
+
+    struct ValueComponent
+    {
+        uint32_t value;
+
+        auto Tie() const { return std::tie(value); }
+    };
+
+    // Enough entities to span several chunks.
+    constexpr Entity kEntityCount = 5000;
+
+    ArchetypeComponentManager<NameComponent, ValueComponent> componentManager{};
+    for (Entity entity = 0; entity < kEntityCount; ++entity)
+    {
+        componentManager.AddComponent(entity, ValueComponent{entity});
+        if (entity % 2 == 1)
+            componentManager.AddComponent(entity, NameComponent{std::to_string(entity)});
+    }
+    for (Entity entity = 0; entity < kEntityCount; entity += 3)
+        componentManager.RemoveComponent<ValueComponent>(entity);
+
+    TestAssert(componentManager.GetArchetypeCount() == 3, "Expected archetypes {Value}, {Name, Value} and {Name}.");
+    TestAssert(componentManager.GetComponent<NameComponent>(3).name == "3", "Row move lost component data.");
+
+    size_t matchingCount = 0;
+    componentManager.Each<NameComponent, ValueComponent>(
+        [&](Entity entity, NameComponent& name, ValueComponent& value)
+        {
+            TestAssert(value.value == entity && name.name == std::to_string(entity), "Row move mixed up components.");
+            ++matchingCount;
+        });
+    TestAssert(matchingCount == 1667, "Odd entities that are not divisible by 3 should have both components.");
+
+    for (Entity entity = 0; entity < kEntityCount; ++entity)
+        componentManager.RemoveAllComponents(entity);
+
+    size_t remainingCount = 0;
+    componentManager.Each<ValueComponent>([&](Entity, ValueComponent&) { ++remainingCount; });
+    TestAssert(remainingCount == 0, "All components should have been removed.");
+}
+
+ADD_TEST_FUNC(TestArchetypeWorld)
+{
+    using namespace ecs;
+
+    struct NameComponent
+    {
+        std::string name;
+
+        auto Tie() const { return std::tie(name); }
+    };
+
+    struct ValueComponent
+    {
+        uint32_t value;
+
+        auto Tie() const { return std::tie(value); }
+    };
+
+    using Manager = ArchetypeComponentManager<NameComponent, ValueComponent>;
+    using Mode = SystemManager<Manager>::ExecutionMode;
+
+    for (Mode mode : {Mode::Parallel, Mode::Serial})
+    {
+        World<Manager> world{};
+        std::vector<Entity> entities = world.CreateEntities(5000, ValueComponent{0});
+        world.CloneEntity(entities[0], 10);
+
+        // Structural changes recorded while iterating in parallel, played back by an exclusive system.
+        CommandBuffer<Manager> commandBuffer{};
+        std::vector<size_t> changedCounts{};
+        auto& systemManager = world.GetSystemManager();
+        systemManager.SetExecutionMode(mode);
+        systemManager.AddSystem(
+            "Increment",
+            Reads<>{},
+            Writes<ValueComponent>{},
+            [](Manager& manager) { manager.ParallelForEach<ValueComponent>([](Entity, ValueComponent& value) { ++value.value; }, 256); });
+        systemManager.AddSystem(
+            "Record",
+            Reads<ValueComponent>{},
+            Writes<>{},
+            [&](Manager& manager)
+            {
+                size_t changedCount = 0;
+                manager.Each<const ValueComponent>(
+                    [&](Entity entity, const ValueComponent& value)
+                    {
+                        ++changedCount;
+                        if (value.value == 1 && entity % 2 == 1)
+                            commandBuffer.AddComponent(entity, NameComponent{std::to_string(entity)});
+                        else if (value.value == 1 && entity % 1000 == 0)
+                        {
+                            const Entity spawned = commandBuffer.CreateEntity();
+                            commandBuffer.AddComponent(spawned, ValueComponent{});
+                            commandBuffer.AddComponent(spawned, NameComponent{"spawned"});
+                            commandBuffer.RemoveComponent<ValueComponent>(spawned);
+                        }
+                        else if (value.value == 2 && entity % 4 == 0)
+                            commandBuffer.DestroyEntity(entity);
+                        else if (value.value == 2 && entity % 4 == 2)
+                            commandBuffer.RemoveComponent<ValueComponent>(entity);
+                    },
+                    Changed<ValueComponent>{manager.GetLastRunTick()});
+                changedCounts.push_back(changedCount);
+            });
+        systemManager.AddExclusiveSystem("Playback", [&](Manager&) { world.PlaybackCommands(commandBuffer); });
+
+        world.RunSystems();
+        world.RunSystems();
+
+        TestAssert(changedCounts == std::vector<size_t>{5010, 5010}, "Record should see the writes of Increment on every run.");
+        TestAssert(world.IsAlive(entities[2]) && !world.IsAlive(entities[4]), "Every fourth entity should have been destroyed.");
+
+        size_t namedCount = 0;
+        for (auto [entity, name, value] : world.View<const NameComponent, ValueComponent>())
+        {
+            TestAssert(name.name == std::to_string(entity) && value.value == 2, "Played back components should keep their values.");
+            ++namedCount;
+        }
+        TestAssert(namedCount == 2505, "Odd entities and clones should have got a name.");
+
+        size_t spawnedCount = 0;
+        world.Each<const NameComponent>([&](Entity, const NameComponent& name) { spawnedCount += name.name == "spawned"; });
+        size_t valueCount = 0;
+        world.Each<const ValueComponent>([&](Entity, const ValueComponent&) { ++valueCount; });
+        TestAssert(spawnedCount == 6 && valueCount == 2505, "Spawned entities should have only the name, removed values should be gone.");
+    }
+}
+
+ADD_TEST_FUNC(TestWorkStealingDeque)
+{
+    jobs::WorkStealingDeque deque(4);
+    jobs::Job first{}, second{}, third{};
+
+    TestAssert(deque.Pop() == nullptr && deque.Steal() == nullptr, "New deque should be empty.");
+    TestAssert(deque.Push(&first) && deque.Push(&second) && deque.Push(&third));
+    // Owner works LIFO, thieves FIFO.
+    TestAssert(deque.Pop() == &third, "Pop should take the newest job.");
+    TestAssert(deque.Steal() == &first, "Steal should take the oldest job.");
+    TestAssert(deque.Pop() == &second);
+    TestAssert(deque.Pop() == nullptr && deque.Steal() == nullptr, "Deque should be empty again.");
+}
+
+ADD_TEST_FUNC(TestJobSystem)
+{
+    jobs::JobSystem& jobSystem = Singleton<jobs::JobSystem>::Get();
+
+    std::vector<uint32_t> values(100'000, 1);
+    std::atomic<uint64_t> sum{0};
+    jobSystem.ParallelFor(
+        values.size(),
+        1000,
+        [&](size_t begin, size_t end) { sum += std::accumulate(values.begin() + begin, values.begin() + end, uint64_t{0}); });
+    TestAssert(sum == values.size(), "ParallelFor should visit every element exactly once.");
+
+    // Jobs scheduling more jobs on the same counter.
+    jobs::Counter counter{};
+    std::atomic<uint32_t> executedCount{0};
+    for (uint32_t i = 0; i < 10; ++i)
+        jobSystem.Schedule(
+            [&]()
+            {
+                for (uint32_t j = 0; j < 10; ++j)
+                    jobSystem.Schedule([&]() { ++executedCount; }, &counter);
+            },
+            &counter);
+
+    bool ranOnMainThread = false;
+    jobSystem.ScheduleOnMainThread([&]() { ranOnMainThread = jobSystem.IsMainThread(); }, &counter);
+
+    jobSystem.Wait(counter);
+    TestAssert(executedCount == 100, "All nested jobs should have finished.");
+    TestAssert(ranOnMainThread, "Main thread job should run on the main thread while it waits.");
+
+    // Every thread executing jobs has its own index, e.g. for per-thread command pools.
+    std::atomic<bool> indicesValid{true};
+    jobSystem.ParallelFor(
+        64,
+        1,
+        [&](size_t, size_t)
+        {
+            const std::optional<size_t> index = jobSystem.GetThreadIndex();
+            if (!index || *index >= jobSystem.GetThreadCount() || (*index == 0) != jobSystem.IsMainThread())
+                indicesValid = false;
+        });
+    TestAssert(indicesValid && jobSystem.GetThreadIndex() == 0);
+    std::optional<size_t> foreignIndex = 0;
+    std::jthread([&]() { foreignIndex = jobSystem.GetThreadIndex(); }).join();
+    TestAssert(!foreignIndex.has_value(), "Threads outside the job system have no index.");
+
+    // Exceptions reach the waiting thread after every job finished.
+    std::atomic<uint32_t> finishedCount{0};
+    bool threw = false;
+    try
+    {
+        jobSystem.ParallelFor(
+            16,
+            1,
+            [&](size_t begin, size_t)
+            {
+                ++finishedCount;
+                if (begin % 4 == 0)
+                    throw std::runtime_error("Job failed.");
+            });
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+    TestAssert(threw, "ParallelFor should rethrow exceptions of its jobs.");
+    TestAssert(finishedCount == 16, "Jobs should keep running after one of them threw.");
+}
+
+ADD_TEST_FUNC(TestJobSystemShutdown)
+{
+    // Idle workers race the destructor into their sleep; a lost wakeup hangs here. A separate thread keeps the
+    // temporary job systems from taking over this thread's identity in the singleton.
+    std::jthread(
+        []()
+        {
+            for (uint32_t i = 0; i < 50; ++i)
+                jobs::JobSystem jobSystem{2};
+        })
+        .join();
+}
+
 ADD_TEST_FUNC(TestTiable)
 {
     struct TestStruct
@@ -0,0 +1,492 @@
+module;
+#include "common-defines.hpp"
+#ifdef ARCH_X64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+module transform;
+
+import assert;
+
+namespace tektonik::transform
+{
+
+namespace
+{
+
+static_assert(sizeof(glm::vec2) == 2 * sizeof(float));
+static_assert(sizeof(glm::mat3) == 9 * sizeof(float) && sizeof(glm::mat4) == 16 * sizeof(float));
+
+// Sine and cosine: the angle is reduced by a Cody-Waite split of pi / 2,
+// then Cephes' minimax polynomials of sinf and cosf are evaluated on [-pi / 4, pi / 4].
+constexpr float kTwoOverPi = 0.636619772367581343f;
+constexpr float kHalfPi1 = 1.5703125f;
+constexpr float kHalfPi2 = 4.837512969970703125e-4f;
+constexpr float kHalfPi3 = 7.54978995489188216e-8f;
+constexpr float kSin0 = -1.6666654611e-1f;
+constexpr float kSin1 = 8.3321608736e-3f;
+constexpr float kSin2 = -1.9515295891e-4f;
+constexpr float kCos0 = 4.166664568298827e-2f;
+constexpr float kCos1 = -1.388731625493765e-3f;
+constexpr float kCos2 = 2.443315711809948e-5f;
+
+// The vector paths below repeat these operations lane by lane.
+std::pair<float, float> SinCosElement(float angle)
+{
+    const float quadrant = std::nearbyint(angle * kTwoOverPi);
+    const float reduced = ((angle - quadrant * kHalfPi1) - quadrant * kHalfPi2) - quadrant * kHalfPi3;
+    const float squared = reduced * reduced;
+    const float sinePolynomial = ((kSin2 * squared + kSin1) * squared + kSin0) * squared * reduced + reduced;
+    const float cosinePolynomial = ((kCos2 * squared + kCos1) * squared + kCos0) * squared * squared - 0.5f * squared + 1.0f;
+
+    const std::int32_t quadrantIndex = static_cast<std::int32_t>(quadrant);
+    const bool swap = (quadrantIndex & 1) != 0;
+    float sine = swap ? cosinePolynomial : sinePolynomial;
+    float cosine = swap ? sinePolynomial : cosinePolynomial;
+    if (quadrantIndex & 2)
+        sine = -sine;
+    if ((quadrantIndex + 1) & 2)
+        cosine = -cosine;
+    return {sine, cosine};
+}
+
+void ComposeElement(const ConstTransformColumns& parents, const ConstTransformColumns& locals, const TransformColumns& results, size_t i)
+{
+    const auto [sine, cosine] = SinCosElement(parents.rotations[i]);
+    const float scaledX = parents.scales[i].x * locals.positions[i].x;
+    const float scaledY = parents.scales[i].y * locals.positions[i].y;
+    const float rotation = parents.rotations[i] + locals.rotations[i];
+    const glm::vec2 scale(parents.scales[i].x * locals.scales[i].x, parents.scales[i].y * locals.scales[i].y);
+
+    results.positions[i] = glm::vec2(parents.positions[i].x + (cosine * scaledX - sine * scaledY), parents.positions[i].y + (sine * scaledX + cosine * scaledY));
+    results.rotations[i] = rotation;
+    results.scales[i] = scale;
+}
+
+// Writes a column major 3x3 or 4x4 matrix with the rotated and scaled axes and the translation.
+// Plain stores that inline into the vector paths, calls from there would mix SSE and AVX code.
+inline void WriteMatrix(float* matrix, bool homogeneous, float xAxisX, float xAxisY, float yAxisX, float yAxisY, glm::vec2 position)
+{
+    if (homogeneous)
+    {
+        matrix[0] = xAxisX;
+        matrix[1] = xAxisY;
+        matrix[2] = 0;
+        matrix[3] = 0;
+        matrix[4] = yAxisX;
+        matrix[5] = yAxisY;
+        matrix[6] = 0;
+        matrix[7] = 0;
+        matrix[8] = 0;
+        matrix[9] = 0;
+        matrix[10] = 1;
+        matrix[11] = 0;
+        matrix[12] = position.x;
+        matrix[13] = position.y;
+        matrix[14] = 0;
+        matrix[15] = 1;
+    }
+    else
+    {
+        matrix[0] = xAxisX;
+        matrix[1] = xAxisY;
+        matrix[2] = 0;
+        matrix[3] = yAxisX;
+        matrix[4] = yAxisY;
+        matrix[5] = 0;
+        matrix[6] = position.x;
+        matrix[7] = position.y;
+        matrix[8] = 1;
+    }
+}
+
+void ToMatrixElement(const ConstTransformColumns& transforms, float* matrices, bool homogeneous, size_t i)
+{
+    const auto [sine, cosine] = SinCosElement(transforms.rotations[i]);
+    const glm::vec2 scale = transforms.scales[i];
+    WriteMatrix(matrices + i * (homogeneous ? 16 : 9), homogeneous, cosine * scale.x, sine * scale.x, -(sine * scale.y), cosine * scale.y, transforms.positions[i]);
+}
+
+struct ScalarKernels
+{
+    static void SinCos(const float* angles, float* sines, float* cosines, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+            std::tie(sines[i], cosines[i]) = SinCosElement(angles[i]);
+    }
+
+    static void Integrate(float* values, const float* rates, size_t count, float deltaTime)
+    {
+        for (size_t i = 0; i < count; ++i)
+            values[i] += rates[i] * deltaTime;
+    }
+
+    static void Compose(const ConstTransformColumns& parents, const ConstTransformColumns& locals, const TransformColumns& results)
+    {
+        for (size_t i = 0; i < results.rotations.size(); ++i)
+            ComposeElement(parents, locals, results, i);
+    }
+
+    static void ToMatrices(const ConstTransformColumns& transforms, float* matrices, bool homogeneous)
+    {
+        for (size_t i = 0; i < transforms.rotations.size(); ++i)
+            ToMatrixElement(transforms, matrices, homogeneous, i);
+    }
+};
+
+#ifdef ARCH_X64
+
+const float* Floats(std::span<const glm::vec2> vectors) { return reinterpret_cast<const float*>(vectors.data()); }
+float* Floats(std::span<glm::vec2> vectors) { return reinterpret_cast<float*>(vectors.data()); }
+
+struct Sse42Kernels
+{
+    static constexpr size_t kWidth = 4;
+
+    TARGET_ISA("sse4.2") static void SinCos(__m128 angle, __m128& sine, __m128& cosine)
+    {
+        const __m128 quadrant = _mm_round_ps(_mm_mul_ps(angle, _mm_set1_ps(kTwoOverPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        const __m128 reduced = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(angle, _mm_mul_ps(quadrant, _mm_set1_ps(kHalfPi1))), _mm_mul_ps(quadrant, _mm_set1_ps(kHalfPi2))),
+                                          _mm_mul_ps(quadrant, _mm_set1_ps(kHalfPi3)));
+        const __m128 squared = _mm_mul_ps(reduced, reduced);
+
+        __m128 sinePolynomial = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(kSin2), squared), _mm_set1_ps(kSin1));
+        sinePolynomial = _mm_add_ps(_mm_mul_ps(sinePolynomial, squared), _mm_set1_ps(kSin0));
+        sinePolynomial = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinePolynomial, squared), reduced), reduced);
+
+        __m128 cosinePolynomial = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(kCos2), squared), _mm_set1_ps(kCos1));
+        cosinePolynomial = _mm_add_ps(_mm_mul_ps(cosinePolynomial, squared), _mm_set1_ps(kCos0));
+        cosinePolynomial = _mm_mul_ps(_mm_mul_ps(cosinePolynomial, squared), squared);
+        cosinePolynomial = _mm_add_ps(_mm_sub_ps(cosinePolynomial, _mm_mul_ps(_mm_set1_ps(0.5f), squared)), _mm_set1_ps(1.0f));
+
+        const __m128i quadrantIndex = _mm_cvtps_epi32(quadrant);
+        const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrantIndex, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+        const __m128 sineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrantIndex, _mm_set1_epi32(2)), 30));
+        const __m128 cosineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrantIndex, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+        sine = _mm_xor_ps(_mm_blendv_ps(sinePolynomial, cosinePolynomial, swap), sineSign);
+        cosine = _mm_xor_ps(_mm_blendv_ps(cosinePolynomial, sinePolynomial, swap), cosineSign);
+    }
+
+    TARGET_ISA("sse4.2") static void SinCos(const float* angles, float* sines, float* cosines, size_t count)
+    {
+        size_t i = 0;
+        for (; i + kWidth <= count; i += kWidth)
+        {
+            __m128 sine, cosine;
+            SinCos(_mm_loadu_ps(angles + i), sine, cosine);
+            _mm_storeu_ps(sines + i, sine);
+            _mm_storeu_ps(cosines + i, cosine);
+        }
+        ScalarKernels::SinCos(angles + i, sines + i, cosines + i, count - i);
+    }
+
+    // Splits 4 interleaved vec2 into their x and y.
+    TARGET_ISA("sse4.2") static void LoadVectors(const float* vectors, __m128& x, __m128& y)
+    {
+        const __m128 first = _mm_loadu_ps(vectors);
+        const __m128 second = _mm_loadu_ps(vectors + 4);
+        x = _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0));
+        y = _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1));
+    }
+
+    TARGET_ISA("sse4.2") static void StoreVectors(float* vectors, __m128 x, __m128 y)
+    {
+        _mm_storeu_ps(vectors, _mm_unpacklo_ps(x, y));
+        _mm_storeu_ps(vectors + 4, _mm_unpackhi_ps(x, y));
+    }
+
+    TARGET_ISA("sse4.2") static void Integrate(float* values, const float* rates, size_t count, float deltaTime)
+    {
+        const __m128 delta = _mm_set1_ps(deltaTime);
+        size_t i = 0;
+        for (; i + kWidth <= count; i += kWidth)
+            _mm_storeu_ps(values + i, _mm_add_ps(_mm_loadu_ps(values + i), _mm_mul_ps(_mm_loadu_ps(rates + i), delta)));
+        ScalarKernels::Integrate(values + i, rates + i, count - i, deltaTime);
+    }
+
+    TARGET_ISA("sse4.2") static void Compose(const ConstTransformColumns& parents, const ConstTransformColumns& locals, const TransformColumns& results)
+    {
+        const size_t count = results.rotations.size();
+        size_t i = 0;
+        for (; i + kWidth <= count; i += kWidth)
+        {
+            __m128 parentX, parentY, parentScaleX, parentScaleY, localX, localY, localScaleX, localScaleY;
+            LoadVectors(Floats(parents.positions) + 2 * i, parentX, parentY);
+            LoadVectors(Floats(parents.scales) + 2 * i, parentScaleX, parentScaleY);
+            LoadVectors(Floats(locals.positions) + 2 * i, localX, localY);
+            LoadVectors(Floats(locals.scales) + 2 * i, localScaleX, localScaleY);
+            const __m128 parentRotation = _mm_loadu_ps(parents.rotations.data() + i);
+            const __m128 localRotation = _mm_loadu_ps(locals.rotations.data() + i);
+
+            __m128 sine, cosine;
+            SinCos(parentRotation, sine, cosine);
+            const __m128 scaledX = _mm_mul_ps(parentScaleX, localX);
+            const __m128 scaledY = _mm_mul_ps(parentScaleY, localY);
+
+            StoreVectors(Floats(results.positions) + 2 * i,
+                         _mm_add_ps(parentX, _mm_sub_ps(_mm_mul_ps(cosine, scaledX), _mm_mul_ps(sine, scaledY))),
+                         _mm_add_ps(parentY, _mm_add_ps(_mm_mul_ps(sine, scaledX), _mm_mul_ps(cosine, scaledY))));
+            _mm_storeu_ps(results.rotations.data() + i, _mm_add_ps(parentRotation, localRotation));
+            StoreVectors(Floats(results.scales) + 2 * i, _mm_mul_ps(parentScaleX, localScaleX), _mm_mul_ps(parentScaleY, localScaleY));
+        }
+        for (; i < count; ++i)
+            ComposeElement(parents, locals, results, i);
+    }
+
+    // The axes are computed in vectors, the strided matrices are written per element.
+    TARGET_ISA("sse4.2") static void ToMatrices(const ConstTransformColumns& transforms, float* matrices, bool homogeneous)
+    {
+        const size_t count = transforms.rotations.size();
+        alignas(16) std::array<std::array<float, kWidth>, 4> axes{};
+        size_t i = 0;
+        for (; i + kWidth <= count; i += kWidth)
+        {
+            __m128 scaleX, scaleY, sine, cosine;
+            LoadVectors(Floats(transforms.scales) + 2 * i, scaleX, scaleY);
+            SinCos(_mm_loadu_ps(transforms.rotations.data() + i), sine, cosine);
+            _mm_store_ps(axes[0].data(), _mm_mul_ps(cosine, scaleX));
+            _mm_store_ps(axes[1].data(), _mm_mul_ps(sine, scaleX));
+            _mm_store_ps(axes[2].data(), _mm_xor_ps(_mm_mul_ps(sine, scaleY), _mm_set1_ps(-0.0f)));
+            _mm_store_ps(axes[3].data(), _mm_mul_ps(cosine, scaleY));
+
+            for (size_t lane = 0; lane < kWidth; ++lane)
+                WriteMatrix(matrices + (i + lane) * (homogeneous ? 16 : 9), homogeneous, axes[0][lane], axes[1][lane], axes[2][lane], axes[3][lane],
+                            transforms.positions[i + lane]);
+        }
+        for (; i < count; ++i)
+            ToMatrixElement(transforms, matrices, homogeneous, i);
+    }
+};
+
+struct Avx2Kernels
+{
+    static constexpr size_t kWidth = 8;
+
+    TARGET_ISA("avx2") static void SinCos(__m256 angle, __m256& sine, __m256& cosine)
+    {
+        const __m256 quadrant = _mm256_round_ps(_mm256_mul_ps(angle, _mm256_set1_ps(kTwoOverPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        const __m256 reduced = _mm256_sub_ps(
+            _mm256_sub_ps(_mm256_sub_ps(angle, _mm256_mul_ps(quadrant, _mm256_set1_ps(kHalfPi1))), _mm256_mul_ps(quadrant, _mm256_set1_ps(kHalfPi2))),
+            _mm256_mul_ps(quadrant, _mm256_set1_ps(kHalfPi3)));
+        const __m256 squared = _mm256_mul_ps(reduced, reduced);
+
+        __m256 sinePolynomial = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(kSin2), squared), _mm256_set1_ps(kSin1));
+        sinePolynomial = _mm256_add_ps(_mm256_mul_ps(sinePolynomial, squared), _mm256_set1_ps(kSin0));
+        sinePolynomial = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sinePolynomial, squared), reduced), reduced);
+
+        __m256 cosinePolynomial = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(kCos2), squared), _mm256_set1_ps(kCos1));
+        cosinePolynomial = _mm256_add_ps(_mm256_mul_ps(cosinePolynomial, squared), _mm256_set1_ps(kCos0));
+        cosinePolynomial = _mm256_mul_ps(_mm256_mul_ps(cosinePolynomial, squared), squared);
+        cosinePolynomial = _mm256_add_ps(_mm256_sub_ps(cosinePolynomial, _mm256_mul_ps(_mm256_set1_ps(0.5f), squared)), _mm256_set1_ps(1.0f));
+
+        const __m256i quadrantIndex = _mm256_cvtps_epi32(quadrant);
+        const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrantIndex, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+        const __m256 sineSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrantIndex, _mm256_set1_epi32(2)), 30));
+        const __m256 cosineSign =
+            _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrantIndex, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+        sine = _mm256_xor_ps(_mm256_blendv_ps(sinePolynomial, cosinePolynomial, swap), sineSign);
+        cosine = _mm256_xor_ps(_mm256_blendv_ps(cosinePolynomial, sinePolynomial, swap), cosineSign);
+    }
+
+    TARGET_ISA("avx2") static void SinCos(const float* angles, float* sines, float* cosines, size_t count)
+    {
+        size_t i = 0;
+        for (; i + kWidth <= count; i += kWidth)
+        {
+            __m256 sine, cosine;
+            SinCos(_mm256_loadu_ps(angles + i), sine, cosine);
+            _mm256_storeu_ps(sines + i, sine);
+            _mm256_storeu_ps(cosines + i, cosine);
+        }
+        ScalarKernels::SinCos(angles + i, sines + i, cosines + i, count - i);
+    }
+
+    // Splits 8 interleaved vec2 into their x and y. The shuffle works per 128 bit lane, the permute restores the order.
+    TARGET_ISA("avx2") static void LoadVectors(const float* vectors, __m256& x, __m256& y)
+    {
+        const __m256 first = _mm256_loadu_ps(vectors);
+        const __m256 second = _mm256_loadu_ps(vectors + 8);
+        x = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+        y = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+
+    TARGET_ISA("avx2") static void StoreVectors(float* vectors, __m256 x, __m256 y)
+    {
+        const __m256 low = _mm256_unpacklo_ps(x, y);
+        const __m256 high = _mm256_unpackhi_ps(x, y);
+        _mm256_storeu_ps(vectors, _mm256_permute2f128_ps(low, high, 0x20));
+        _mm256_storeu_ps(vectors + 8, _mm256_permute2f128_ps(low, high, 0x31));
+    }
+
+    TARGET_ISA("avx2") static void Integrate(float* values, const float* rates, size_t count, float deltaTime)
+    {
+        const __m256 delta = _mm256_set1_ps(deltaTime);
+        size_t i = 0;
+        for (; i + kWidth <= count; i += kWidth)
+            _mm256_storeu_ps(values + i, _mm256_add_ps(_mm256_loadu_ps(values + i), _mm256_mul_ps(_mm256_loadu_ps(rates + i), delta)));
+        ScalarKernels::Integrate(values + i, rates + i, count - i, deltaTime);
+    }
+
+    TARGET_ISA("avx2") static void Compose(const ConstTransformColumns& parents, const ConstTransformColumns& locals, const TransformColumns& results)
+    {
+        const size_t count = results.rotations.size();
+        size_t i = 0;
+        for (; i + kWidth <= count; i += kWidth)
+        {
+            __m256 parentX, parentY, parentScaleX, parentScaleY, localX, localY, localScaleX, localScaleY;
+            LoadVectors(Floats(parents.positions) + 2 * i, parentX, parentY);
+            LoadVectors(Floats(parents.scales) + 2 * i, parentScaleX, parentScaleY);
+            LoadVectors(Floats(locals.positions) + 2 * i, localX, localY);
+            LoadVectors(Floats(locals.scales) + 2 * i, localScaleX, localScaleY);
+            const __m256 parentRotation = _mm256_loadu_ps(parents.rotations.data() + i);
+            const __m256 localRotation = _mm256_loadu_ps(locals.rotations.data() + i);
+
+            __m256 sine, cosine;
+            SinCos(parentRotation, sine, cosine);
+            const __m256 scaledX = _mm256_mul_ps(parentScaleX, localX);
+            const __m256 scaledY = _mm256_mul_ps(parentScaleY, localY);
+
+            StoreVectors(Floats(results.positions) + 2 * i,
+                         _mm256_add_ps(parentX, _mm256_sub_ps(_mm256_mul_ps(cosine, scaledX), _mm256_mul_ps(sine, scaledY))),
+                         _mm256_add_ps(parentY, _mm256_add_ps(_mm256_mul_ps(sine, scaledX), _mm256_mul_ps(cosine, scaledY))));
+            _mm256_storeu_ps(results.rotations.data() + i, _mm256_add_ps(parentRotation, localRotation));
+            StoreVectors(Floats(results.scales) + 2 * i, _mm256_mul_ps(parentScaleX, localScaleX), _mm256_mul_ps(parentScaleY, localScaleY));
+        }
+        for (; i < count; ++i)
+            ComposeElement(parents, locals, results, i);
+    }
+
+    TARGET_ISA("avx2") static void ToMatrices(const ConstTransformColumns& transforms, float* matrices, bool homogeneous)
+    {
+        const size_t count = transforms.rotations.size();
+        alignas(32) std::array<std::array<float, kWidth>, 4> axes{};
+        size_t i = 0;
+        for (; i + kWidth <= count; i += kWidth)
+        {
+            __m256 scaleX, scaleY, sine, cosine;
+            LoadVectors(Floats(transforms.scales) + 2 * i, scaleX, scaleY);
+            SinCos(_mm256_loadu_ps(transforms.rotations.data() + i), sine, cosine);
+            _mm256_store_ps(axes[0].data(), _mm256_mul_ps(cosine, scaleX));
+            _mm256_store_ps(axes[1].data(), _mm256_mul_ps(sine, scaleX));
+            _mm256_store_ps(axes[2].data(), _mm256_xor_ps(_mm256_mul_ps(sine, scaleY), _mm256_set1_ps(-0.0f)));
+            _mm256_store_ps(axes[3].data(), _mm256_mul_ps(cosine, scaleY));
+
+            for (size_t lane = 0; lane < kWidth; ++lane)
+                WriteMatrix(matrices + (i + lane) * (homogeneous ? 16 : 9), homogeneous, axes[0][lane], axes[1][lane], axes[2][lane], axes[3][lane],
+                            transforms.positions[i + lane]);
+        }
+        for (; i < count; ++i)
+            ToMatrixElement(transforms, matrices, homogeneous, i);
+    }
+};
+
+#endif
+
+InstructionSet& SelectedInstructionSet()
+{
+    static InstructionSet selected = GetSupportedInstructionSet();
+    return selected;
+}
+
+// Calls func with the kernels of the selected instruction set.
+void WithKernels(const auto& func)
+{
+#ifdef ARCH_X64
+    switch (SelectedInstructionSet())
+    {
+        case InstructionSet::Avx2:
+            func(Avx2Kernels{});
+            return;
+        case InstructionSet::Sse42:
+            func(Sse42Kernels{});
+            return;
+        case InstructionSet::Scalar:
+            break;
+    }
+#endif
+    func(ScalarKernels{});
+}
+
+bool HaveSameSize(const ConstTransformColumns& columns, size_t size)
+{
+    return columns.positions.size() == size && columns.rotations.size() == size && columns.scales.size() == size;
+}
+
+}  // namespace
+
+InstructionSet GetSupportedInstructionSet()
+{
+#if defined(ARCH_X64) && defined(_MSC_VER)
+    std::array<int, 4> info{};
+    __cpuid(info.data(), 1);
+    const bool sse42 = (info[2] & (1 << 20)) != 0;
+    // AVX needs OS support for saving the ymm registers.
+    const bool avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(info.data(), 7, 0);
+    const bool avx2 = avx && (info[1] & (1 << 5)) != 0;
+#elif defined(ARCH_X64)
+    __builtin_cpu_init();
+    const bool sse42 = __builtin_cpu_supports("sse4.2");
+    const bool avx2 = __builtin_cpu_supports("avx2");
+#else
+    const bool sse42 = false;
+    const bool avx2 = false;
+#endif
+
+    if (avx2)
+        return InstructionSet::Avx2;
+    if (sse42)
+        return InstructionSet::Sse42;
+    return InstructionSet::Scalar;
+}
+
+InstructionSet GetInstructionSet() { return SelectedInstructionSet(); }
+
+void SetInstructionSet(InstructionSet instructionSet)
+{
+    ASSUMERT(instructionSet <= GetSupportedInstructionSet());
+    SelectedInstructionSet() = instructionSet;
+}
+
+std::pair<float, float> SinCos(float angle) { return SinCosElement(angle); }
+
+void SinCos(std::span<const float> angles, std::span<float> sines, std::span<float> cosines)
+{
+    ASSUMERT(sines.size() == angles.size() && cosines.size() == angles.size());
+    WithKernels([&](auto kernels) { kernels.SinCos(angles.data(), sines.data(), cosines.data(), angles.size()); });
+}
+
+void Integrate(std::span<glm::vec2> values, std::span<const glm::vec2> rates, float deltaTime)
+{
+    ASSUMERT(values.size() == rates.size());
+    WithKernels([&](auto kernels) { kernels.Integrate(reinterpret_cast<float*>(values.data()), reinterpret_cast<const float*>(rates.data()), 2 * values.size(), deltaTime); });
+}
+
+void Integrate(std::span<float> values, std::span<const float> rates, float deltaTime)
+{
+    ASSUMERT(values.size() == rates.size());
+    WithKernels([&](auto kernels) { kernels.Integrate(values.data(), rates.data(), values.size(), deltaTime); });
+}
+
+void Compose(const ConstTransformColumns& parents, const ConstTransformColumns& locals, const TransformColumns& results)
+{
+    const size_t count = results.rotations.size();
+    ASSUMERT(HaveSameSize(parents, count) && HaveSameSize(locals, count) && HaveSameSize(results, count));
+    WithKernels([&](auto kernels) { kernels.Compose(parents, locals, results); });
+}
+
+void ToMatrices(const ConstTransformColumns& transforms, std::span<glm::mat3> matrices)
+{
+    ASSUMERT(HaveSameSize(transforms, matrices.size()));
+    WithKernels([&](auto kernels) { kernels.ToMatrices(transforms, reinterpret_cast<float*>(matrices.data()), false); });
+}
+
+void ToMatrices(const ConstTransformColumns& transforms, std::span<glm::mat4> matrices)
+{
+    ASSUMERT(HaveSameSize(transforms, matrices.size()));
+    WithKernels([&](auto kernels) { kernels.ToMatrices(transforms, reinterpret_cast<float*>(matrices.data()), true); });
+}
+
+}  // namespace tektonik::transform
@@ -0,0 +1,710 @@
+module;
+#include "common-defines.hpp"
+export module archetype;
+
+import ecs;
+import sparse_set;
+import jobs;
+import singleton;
+import std;
+import assert;
+
+export namespace tektonik::ecs
+{
+
+// Alternative component storage to ComponentManager, a World can use either.
+// Entities with the same signature (an archetype) are stored together in fixed-size chunks.
+// Each chunk is SoA: an entity column followed by one tightly packed column per component and one of its ticks.
+// Components are stored whole, so split components (see SplitFields) need a ComponentManager.
+template <Component... ComponentTypes>
+class ArchetypeComponentManager : public TickSource
+{
+  public:
+    static constexpr size_t kComponentTypeCount = sizeof...(ComponentTypes);
+    template <Component ComponentType>
+    static constexpr size_t kTypeIndex = kComponentTypeIndex<ComponentType, ComponentTypes...>;
+    // Default number of entities processed by a single ParallelForEach job.
+    static constexpr size_t kDefaultGrainSize = 4096;
+    // Targeted byte size of a single chunk.
+    static constexpr size_t kChunkByteSize = 16 * 1024;
+    // Chunks start at a cache line, columns inside them are only aligned to their component.
+    static constexpr size_t kChunkAlignment = 64;
+    static_assert(((alignof(ComponentTypes) <= kChunkAlignment) && ...), "Components must not be aligned stricter than chunks.");
+    static_assert((!SplitComponent<ComponentTypes> && ...), "Chunks store whole components, split components need a ComponentManager.");
+
+    ArchetypeComponentManager() = default;
+
+    ArchetypeComponentManager(const ArchetypeComponentManager&) = delete;
+    ArchetypeComponentManager& operator=(const ArchetypeComponentManager&) = delete;
+
+    template <Component ComponentType>
+    void AddComponent(Entity entity, ComponentType&& component)
+    {
+        constexpr size_t typeIndex = GetTypeIndex<ComponentType>();
+        const EntityLocation location = entityLocations.Get(entity);
+
+        size_t destinationIndex = kInvalidIndex;
+        size_t row = kInvalidIndex;
+        // Entity without components just gets a row in the destination archetype.
+        if (location.archetype == kInvalidIndex)
+        {
+            ComponentSignature signature{};
+            signature[typeIndex] = true;
+            destinationIndex = GetOrCreateArchetype(signature);
+            row = AddRow(entity, destinationIndex);
+        }
+        else
+        {
+            ASSUMERT(!archetypes[location.archetype]->signature[typeIndex]);
+
+            destinationIndex = archetypes[location.archetype]->addEdges[typeIndex];
+            if (destinationIndex == kInvalidIndex)
+            {
+                ComponentSignature signature = archetypes[location.archetype]->signature;
+                signature[typeIndex] = true;
+                destinationIndex = GetOrCreateArchetype(signature);
+                archetypes[location.archetype]->addEdges[typeIndex] = destinationIndex;
+            }
+            row = MoveRow(entity, location, destinationIndex);
+        }
+
+        Archetype& destination = *archetypes[destinationIndex];
+        std::construct_at(static_cast<ComponentType*>(destination.GetCell(typeIndex, row)), std::move(component));
+        *destination.GetTicks(typeIndex, row) = ComponentTicks{.added = GetCurrentTick(), .changed = GetCurrentTick()};
+    }
+
+    // Adds a copy of components to every entity. The entities must not have any components yet.
+    // They all land in the same archetype, so the rows are appended in one go.
+    template <Component... SelectedComponents>
+    void AddComponents(std::span<const Entity> entities, const SelectedComponents&... components)
+    {
+        const size_t archetypeIndex = GetOrCreateArchetype(GetSignatureFromComponents<SelectedComponents...>());
+        Archetype& archetype = *archetypes[archetypeIndex];
+        const ComponentTicks ticks{.added = GetCurrentTick(), .changed = GetCurrentTick()};
+        for (const Entity entity : entities)
+        {
+            ASSUMERT(entityLocations.Get(entity).archetype == kInvalidIndex);
+            const size_t row = AddRow(entity, archetypeIndex);
+            ((std::construct_at(static_cast<SelectedComponents*>(archetype.GetCell(kTypeIndex<SelectedComponents>, row)), components),
+              *archetype.GetTicks(kTypeIndex<SelectedComponents>, row) = ticks),
+             ...);
+        }
+    }
+
+    // Gives every clone a copy of all components of prototype. The clones must not have any components yet.
+    void CloneComponents(Entity prototype, std::span<const Entity> clones)
+    {
+        const EntityLocation location = entityLocations.Get(prototype);
+        if (location.archetype == kInvalidIndex)
+            return;
+
+        Archetype& archetype = *archetypes[location.archetype];
+        const ComponentTicks ticks{.added = GetCurrentTick(), .changed = GetCurrentTick()};
+        for (const Entity clone : clones)
+        {
+            ASSUMERT(entityLocations.Get(clone).archetype == kInvalidIndex);
+            const size_t row = AddRow(clone, location.archetype);
+            for (size_t typeIndex = 0; typeIndex < kComponentTypeCount; ++typeIndex)
+            {
+                if (!archetype.signature[typeIndex])
+                    continue;
+                ASSUMERT(kComponentTypeInfos[typeIndex].copyConstruct != nullptr && "Cloned components must be copyable.");
+                kComponentTypeInfos[typeIndex].copyConstruct(archetype.GetCell(typeIndex, row), archetype.GetCell(typeIndex, location.row));
+                *archetype.GetTicks(typeIndex, row) = ticks;
+            }
+        }
+    }
+
+    template <Component ComponentType>
+    void RemoveComponent(Entity entity)
+    {
+        constexpr size_t typeIndex = GetTypeIndex<ComponentType>();
+
+        const EntityLocation location = entityLocations.Get(entity);
+        ASSUMERT(location.archetype != kInvalidIndex);
+        ASSUMERT(archetypes[location.archetype]->signature[typeIndex]);
+
+        size_t destinationIndex = archetypes[location.archetype]->removeEdges[typeIndex];
+        if (destinationIndex == kInvalidIndex)
+        {
+            ComponentSignature signature = archetypes[location.archetype]->signature;
+            signature[typeIndex] = false;
+            // Entities without any components are not stored at all.
+            if (signature == ComponentSignature{})
+            {
+                RemoveAllComponents(entity);
+                return;
+            }
+            destinationIndex = GetOrCreateArchetype(signature);
+            archetypes[location.archetype]->removeEdges[typeIndex] = destinationIndex;
+        }
+
+        MoveRow(entity, location, destinationIndex);
+    }
+
+    // Mutable access, marks the component as changed.
+    template <Component ComponentType>
+    ComponentType& GetComponent(Entity entity)
+    {
+        const EntityLocation location = GetLocation<ComponentType>(entity);
+        return Access<ComponentType>(*archetypes[location.archetype], location.row, GetCurrentTick());
+    }
+
+    template <Component ComponentType>
+    const ComponentType& GetComponent(Entity entity) const
+    {
+        const EntityLocation location = GetLocation<ComponentType>(entity);
+        return *static_cast<const ComponentType*>(archetypes[location.archetype]->GetCell(kTypeIndex<ComponentType>, location.row));
+    }
+
+    template <Component ComponentType>
+    const ComponentTicks& GetComponentTicks(Entity entity) const
+    {
+        const EntityLocation location = GetLocation<ComponentType>(entity);
+        return *archetypes[location.archetype]->GetTicks(kTypeIndex<ComponentType>, location.row);
+    }
+
+    // See ComponentManager::ClampTicks.
+    void ClampTicks()
+    {
+        const Tick oldestTick = GetCurrentTick() - kMaxTickAge;
+        for (const std::unique_ptr<Archetype>& archetype : archetypes)
+            for (size_t typeIndex = 0; typeIndex < kComponentTypeCount; ++typeIndex)
+            {
+                if (!archetype->signature[typeIndex])
+                    continue;
+                for (size_t chunkIndex = 0; chunkIndex < archetype->chunks.size(); ++chunkIndex)
+                {
+                    ComponentTicks* ticks = archetype->GetTicksColumn(typeIndex, chunkIndex);
+                    for (size_t row = 0; row < archetype->GetChunkRowCount(chunkIndex); ++row)
+                    {
+                        if (IsNewerTick(oldestTick, ticks[row].added))
+                            ticks[row].added = oldestTick;
+                        if (IsNewerTick(oldestTick, ticks[row].changed))
+                            ticks[row].changed = oldestTick;
+                    }
+                }
+            }
+    }
+
+    void RemoveAllComponents(Entity entity)
+    {
+        const EntityLocation location = entityLocations.Get(entity);
+        if (location.archetype == kInvalidIndex)
+            return;
+
+        RemoveRow(*archetypes[location.archetype], location.row);
+        entityLocations.Set(entity, EntityLocation{});
+    }
+
+    void RemoveAllComponents(std::span<const Entity> entities)
+    {
+        for (const Entity entity : entities)
+            RemoveAllComponents(entity);
+    }
+
+    // Gives entities the signature targetSignature, see ComponentManager::ChangeSignatures. Every entity moves its row
+    // to the target archetype first, components new to it are default constructed there and count as added, so
+    // StoreComponent only assigns and EraseComponent has nothing left to do.
+    void ChangeSignatures(std::span<const Entity> entities, const std::bitset<kComponentTypeCount>& targetSignature, auto&& changeComponents)
+    {
+        const size_t targetIndex = targetSignature == ComponentSignature{} ? kInvalidIndex : GetOrCreateArchetype(targetSignature);
+        const ComponentTicks ticks{.added = GetCurrentTick(), .changed = GetCurrentTick()};
+
+        for (const Entity entity : entities)
+        {
+            const EntityLocation location = entityLocations.Get(entity);
+            if (location.archetype != targetIndex)
+            {
+                if (targetIndex == kInvalidIndex)
+                    RemoveAllComponents(entity);
+                else
+                {
+                    const ComponentSignature signature = GetSignature(entity);
+                    const size_t row = location.archetype == kInvalidIndex ? AddRow(entity, targetIndex) : MoveRow(entity, location, targetIndex);
+                    Archetype& target = *archetypes[targetIndex];
+                    for (size_t typeIndex = 0; typeIndex < kComponentTypeCount; ++typeIndex)
+                    {
+                        if (!targetSignature[typeIndex] || signature[typeIndex])
+                            continue;
+                        kComponentTypeInfos[typeIndex].defaultConstruct(target.GetCell(typeIndex, row));
+                        *target.GetTicks(typeIndex, row) = ticks;
+                    }
+                }
+            }
+
+            changeComponents(entity);
+        }
+    }
+
+    // Only for ChangeSignatures. Replaces the component in place, it counts as newly added.
+    template <Component ComponentType>
+    void StoreComponent(Entity entity, ComponentType&& component)
+    {
+        const EntityLocation location = GetLocation<ComponentType>(entity);
+        Archetype& archetype = *archetypes[location.archetype];
+        *static_cast<ComponentType*>(archetype.GetCell(kTypeIndex<ComponentType>, location.row)) = std::move(component);
+        *archetype.GetTicks(kTypeIndex<ComponentType>, location.row) = ComponentTicks{.added = GetCurrentTick(), .changed = GetCurrentTick()};
+    }
+
+    // Only for ChangeSignatures. The row move already destroyed the component.
+    template <Component ComponentType>
+    void EraseComponent(Entity entity)
+    {
+        ASSUMERT(!GetSignature(entity)[GetTypeIndex<ComponentType>()]);
+    }
+
+  private:
+    class Archetype;
+
+  public:
+    // Range over entities that have all SelectedComponents, yielding std::tuple<Entity, SelectedComponents&...>.
+    // Walks the rows of the matching archetypes. Dereferencing marks the non-const SelectedComponents as changed.
+    template <Component... SelectedComponents>
+    class ComponentView
+    {
+      public:
+        static_assert(sizeof...(SelectedComponents) > 0);
+
+        using Value = std::tuple<Entity, SelectedComponents&...>;
+
+        class Iterator
+        {
+          public:
+            using value_type = Value;
+            using difference_type = std::ptrdiff_t;
+
+            Iterator() = default;
+            Iterator(const ComponentView* view) : view(view) { SkipEmpty(); }
+
+            Value operator*() const
+            {
+                Archetype& archetype = *view->archetypes[archetypePosition];
+                return Value(archetype.GetEntity(row), Access<SelectedComponents>(archetype, row, view->tick)...);
+            }
+
+            Iterator& operator++()
+            {
+                ++row;
+                SkipEmpty();
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+
+            bool operator==(std::default_sentinel_t) const { return archetypePosition >= view->archetypes.size(); }
+
+          private:
+            // Moves on to the next archetype once the rows of the current one are exhausted.
+            void SkipEmpty()
+            {
+                for (; archetypePosition < view->archetypes.size() && row >= view->archetypes[archetypePosition]->rowCount; ++archetypePosition)
+                    row = 0;
+            }
+
+            const ComponentView* view = nullptr;
+            size_t archetypePosition = 0;
+            size_t row = 0;
+        };
+
+        ComponentView(ArchetypeComponentManager& componentManager) : tick(componentManager.GetCurrentTick())
+        {
+            const ComponentSignature wantedSignature = GetSignatureFromComponents<SelectedComponents...>();
+            for (const std::unique_ptr<Archetype>& archetype : componentManager.archetypes)
+                if (ContainsAll(archetype->signature, wantedSignature))
+                    archetypes.push_back(archetype.get());
+        }
+
+        Iterator begin() const { return Iterator(this); }
+        std::default_sentinel_t end() const { return std::default_sentinel; }
+
+      private:
+        std::vector<Archetype*> archetypes{};
+        Tick tick;
+    };
+
+    template <Component... SelectedComponents>
+    ComponentView<SelectedComponents...> View()
+    {
+        return ComponentView<SelectedComponents...>(*this);
+    }
+
+    // Calls func(Entity, SelectedComponents&...) for every entity that has all SelectedComponents and passes all filters.
+    // The iteration is a linear scan over the packed columns of the matching archetypes.
+    // Non-const SelectedComponents are marked as changed, select const components for read-only access.
+    template <Component... SelectedComponents>
+    void Each(auto&& func, const ChangeFilter auto&... filters)
+    {
+        static_assert(sizeof...(SelectedComponents) > 0);
+
+        const Tick tick = GetCurrentTick();
+        for (const std::unique_ptr<Archetype>& archetype : archetypes)
+            if (Matches<SelectedComponents...>(*archetype, filters...))
+                for (size_t chunkIndex = 0; chunkIndex < archetype->chunks.size(); ++chunkIndex)
+                    EachInChunk<SelectedComponents...>(func, *archetype, chunkIndex, tick, filters...);
+    }
+
+    // Like Each, but the matching chunks are split into jobs of about grainSize entities, which run in parallel on the
+    // job system. Jobs take whole chunks, so they never share a cache line. func must only write components of the
+    // entity it is called with. Runs serially when there is no job system.
+    template <Component... SelectedComponents>
+    void ParallelForEach(auto&& func, size_t grainSize = kDefaultGrainSize, const ChangeFilter auto&... filters)
+    {
+        static_assert(sizeof...(SelectedComponents) > 0);
+
+        struct ChunkReference
+        {
+            Archetype* archetype;
+            size_t chunkIndex;
+        };
+        std::vector<ChunkReference> chunks{};
+        size_t rowCount = 0;
+        for (const std::unique_ptr<Archetype>& archetype : archetypes)
+            if (Matches<SelectedComponents...>(*archetype, filters...))
+            {
+                for (size_t chunkIndex = 0; chunkIndex < archetype->chunks.size(); ++chunkIndex)
+                    chunks.push_back(ChunkReference{.archetype = archetype.get(), .chunkIndex = chunkIndex});
+                rowCount += archetype->rowCount;
+            }
+
+        // Taken on this thread, the jobs run on others.
+        const Tick tick = GetCurrentTick();
+        const auto eachInChunks = [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+                EachInChunk<SelectedComponents...>(func, *chunks[i].archetype, chunks[i].chunkIndex, tick, filters...);
+        };
+
+        if (!Singleton<jobs::JobSystem>::IsInitialized() || rowCount <= grainSize)
+        {
+            eachInChunks(0, chunks.size());
+            return;
+        }
+
+        const size_t chunksPerJob = std::max<size_t>(1, grainSize * chunks.size() / rowCount);
+        Singleton<jobs::JobSystem>::Get().ParallelFor(chunks.size(), chunksPerJob, eachInChunks);
+    }
+
+    // Components the entity has, indexed by kTypeIndex.
+    std::bitset<kComponentTypeCount> GetSignature(Entity entity) const
+    {
+        const EntityLocation location = entityLocations.Get(entity);
+        return location.archetype == kInvalidIndex ? std::bitset<kComponentTypeCount>{} : archetypes[location.archetype]->signature;
+    }
+
+    size_t GetArchetypeCount() const { return archetypes.size(); }
+
+  private:
+    using ComponentSignature = std::bitset<kComponentTypeCount>;
+    static constexpr size_t kInvalidIndex = std::numeric_limits<size_t>::max();
+
+    template <Component ComponentType>
+    static constexpr size_t GetTypeIndex()
+    {
+        constexpr size_t typeIndex = kTypeIndex<ComponentType>;
+        static_assert(typeIndex < kComponentTypeCount, "Component type is not managed.");
+        return typeIndex;
+    }
+
+    // Operations needed to move type-erased components around.
+    struct ComponentTypeInfo
+    {
+        size_t size;
+        size_t alignment;
+        void (*defaultConstruct)(void* destination);
+        // Null for components that can not be copied.
+        void (*copyConstruct)(void* destination, const void* source);
+        void (*moveConstruct)(void* destination, void* source);
+        void (*destroy)(void* object);
+    };
+
+    template <Component ComponentType>
+    static constexpr ComponentTypeInfo MakeComponentTypeInfo()
+    {
+        ComponentTypeInfo info{
+            .size = sizeof(ComponentType),
+            .alignment = alignof(ComponentType),
+            .defaultConstruct = [](void* destination) { std::construct_at(static_cast<ComponentType*>(destination)); },
+            .copyConstruct = nullptr,
+            .moveConstruct = [](void* destination, void* source)
+            { std::construct_at(static_cast<ComponentType*>(destination), std::move(*static_cast<ComponentType*>(source))); },
+            .destroy = [](void* object) { std::destroy_at(static_cast<ComponentType*>(object)); },
+        };
+        if constexpr (std::is_copy_constructible_v<ComponentType>)
+            info.copyConstruct = [](void* destination, const void* source)
+            { std::construct_at(static_cast<ComponentType*>(destination), *static_cast<const ComponentType*>(source)); };
+        return info;
+    }
+
+    static constexpr std::array<ComponentTypeInfo, kComponentTypeCount> kComponentTypeInfos{MakeComponentTypeInfo<ComponentTypes>()...};
+
+    template <Component... SelectedComponentTypes>
+    static constexpr ComponentSignature GetSignatureFromComponents()
+    {
+        auto signature = ComponentSignature{};
+        ((signature[GetTypeIndex<SelectedComponentTypes>()] = true), ...);
+        return signature;
+    }
+
+    static bool ContainsAll(const ComponentSignature& signature, const ComponentSignature& wantedSignature)
+    {
+        return (signature & wantedSignature) == wantedSignature;
+    }
+
+    // Fixed-size block of memory holding the columns of up to chunkCapacity rows.
+    class Chunk
+    {
+      public:
+        Chunk(size_t byteSize) : storage(std::make_unique_for_overwrite<CacheLine[]>((byteSize + sizeof(CacheLine) - 1) / sizeof(CacheLine))) {}
+
+        std::byte* GetData() const { return storage[0].bytes; }
+
+      private:
+        struct alignas(kChunkAlignment) CacheLine
+        {
+            std::byte bytes[kChunkAlignment];
+        };
+
+        std::unique_ptr<CacheLine[]> storage;
+    };
+
+    class Archetype
+    {
+      public:
+        Archetype(const ComponentSignature& signature) : signature(signature)
+        {
+            addEdges.fill(kInvalidIndex);
+            removeEdges.fill(kInvalidIndex);
+            columnOffsets.fill(kInvalidIndex);
+            ticksOffsets.fill(kInvalidIndex);
+
+            // Estimate the capacity, leaving space for worst case alignment padding.
+            size_t rowByteSize = sizeof(Entity);
+            size_t paddingReserve = 0;
+            for (size_t typeIndex = 0; typeIndex < kComponentTypeCount; ++typeIndex)
+            {
+                if (!signature[typeIndex])
+                    continue;
+                rowByteSize += kComponentTypeInfos[typeIndex].size + sizeof(ComponentTicks);
+                paddingReserve += kComponentTypeInfos[typeIndex].alignment + alignof(ComponentTicks);
+            }
+            chunkCapacity = std::max<size_t>(1, (kChunkByteSize - std::min(paddingReserve, kChunkByteSize)) / rowByteSize);
+
+            // Entity column goes first, then the component columns, each followed by its ticks.
+            size_t offset = chunkCapacity * sizeof(Entity);
+            const auto placeColumn = [&](size_t size, size_t alignment)
+            {
+                offset = (offset + alignment - 1) / alignment * alignment;
+                const size_t columnOffset = offset;
+                offset += chunkCapacity * size;
+                return columnOffset;
+            };
+            for (size_t typeIndex = 0; typeIndex < kComponentTypeCount; ++typeIndex)
+            {
+                if (!signature[typeIndex])
+                    continue;
+                columnOffsets[typeIndex] = placeColumn(kComponentTypeInfos[typeIndex].size, kComponentTypeInfos[typeIndex].alignment);
+                ticksOffsets[typeIndex] = placeColumn(sizeof(ComponentTicks), alignof(ComponentTicks));
+            }
+            chunkByteSize = offset;
+        }
+
+        ~Archetype()
+        {
+            for (size_t row = 0; row < rowCount; ++row)
+                for (size_t typeIndex = 0; typeIndex < kComponentTypeCount; ++typeIndex)
+                    if (signature[typeIndex])
+                        kComponentTypeInfos[typeIndex].destroy(GetCell(typeIndex, row));
+        }
+
+        Archetype(const Archetype&) = delete;
+        Archetype& operator=(const Archetype&) = delete;
+
+        // Reserves a row at the end, component cells and ticks are left uninitialized.
+        size_t AllocateRow(Entity entity)
+        {
+            const size_t row = rowCount++;
+            if (row / chunkCapacity == chunks.size())
+                chunks.emplace_back(chunkByteSize);
+
+            GetEntityColumn(row / chunkCapacity)[row % chunkCapacity] = entity;
+            return row;
+        }
+
+        void* GetCell(size_t typeIndex, size_t row) const
+        {
+            ASSUMERT(columnOffsets[typeIndex] != kInvalidIndex);
+            ASSUMERT(row < rowCount);
+            const size_t size = kComponentTypeInfos[typeIndex].size;
+            return chunks[row / chunkCapacity].GetData() + columnOffsets[typeIndex] + (row % chunkCapacity) * size;
+        }
+
+        ComponentTicks* GetTicks(size_t typeIndex, size_t row) const { return GetTicksColumn(typeIndex, row / chunkCapacity) + row % chunkCapacity; }
+
+        Entity GetEntity(size_t row) const { return GetEntityColumn(row / chunkCapacity)[row % chunkCapacity]; }
+
+        Entity* GetEntityColumn(size_t chunkIndex) const { return reinterpret_cast<Entity*>(chunks[chunkIndex].GetData()); }
+
+        template <Component ComponentType>
+        ComponentType* GetColumn(size_t chunkIndex) const
+        {
+            constexpr size_t typeIndex = kTypeIndex<ComponentType>;
+            ASSUMERT(columnOffsets[typeIndex] != kInvalidIndex);
+            return reinterpret_cast<std::remove_const_t<ComponentType>*>(chunks[chunkIndex].GetData() + columnOffsets[typeIndex]);
+        }
+
+        ComponentTicks* GetTicksColumn(size_t typeIndex, size_t chunkIndex) const
+        {
+            ASSUMERT(ticksOffsets[typeIndex] != kInvalidIndex);
+            return reinterpret_cast<ComponentTicks*>(chunks[chunkIndex].GetData() + ticksOffsets[typeIndex]);
+        }
+
+        size_t GetChunkRowCount(size_t chunkIndex) const { return std::min(chunkCapacity, rowCount - chunkIndex * chunkCapacity); }
+
+        const ComponentSignature signature;
+        // Cached archetype indexes reached by adding or removing a component type.
+        std::array<size_t, kComponentTypeCount> addEdges{};
+        std::array<size_t, kComponentTypeCount> removeEdges{};
+        std::array<size_t, kComponentTypeCount> columnOffsets{};
+        std::array<size_t, kComponentTypeCount> ticksOffsets{};
+        size_t chunkCapacity = 0;
+        size_t chunkByteSize = 0;
+        size_t rowCount = 0;
+        std::vector<Chunk> chunks{};
+    };
+
+    struct EntityLocation
+    {
+        size_t archetype = kInvalidIndex;
+        size_t row = kInvalidIndex;
+
+        bool operator==(const EntityLocation&) const = default;
+    };
+
+    // Location of an entity that has the component.
+    template <Component ComponentType>
+    EntityLocation GetLocation(Entity entity) const
+    {
+        const EntityLocation location = entityLocations.Get(entity);
+        ASSUMERT(location.archetype != kInvalidIndex);
+        ASSUMERT(archetypes[location.archetype]->signature[GetTypeIndex<ComponentType>()]);
+        return location;
+    }
+
+    // Mutable access marks the component as changed, const access does not.
+    template <Component ComponentType>
+    static ComponentType& Access(const Archetype& archetype, size_t row, Tick tick)
+    {
+        constexpr size_t typeIndex = kTypeIndex<ComponentType>;
+        if constexpr (!std::is_const_v<ComponentType>)
+            archetype.GetTicks(typeIndex, row)->changed = tick;
+        return *static_cast<std::remove_const_t<ComponentType>*>(archetype.GetCell(typeIndex, row));
+    }
+
+    // Whether the entities of the archetype have all SelectedComponents and the components the filters look at.
+    template <Component... SelectedComponents>
+    static bool Matches(const Archetype& archetype, const ChangeFilter auto&... filters)
+    {
+        return ContainsAll(archetype.signature,
+                           GetSignatureFromComponents<SelectedComponents..., typename std::remove_cvref_t<decltype(filters)>::ComponentType...>());
+    }
+
+    // Calls func for the rows of a chunk that pass the filters. Column pointers are resolved once per chunk.
+    template <Component... SelectedComponents>
+    static void EachInChunk(auto& func, const Archetype& archetype, size_t chunkIndex, Tick tick, const auto&... filters)
+    {
+        const size_t rowCount = archetype.GetChunkRowCount(chunkIndex);
+        const Entity* entities = archetype.GetEntityColumn(chunkIndex);
+        const std::tuple<SelectedComponents*...> columns{archetype.template GetColumn<SelectedComponents>(chunkIndex)...};
+        const std::array<ComponentTicks*, sizeof...(SelectedComponents)> ticks{archetype.GetTicksColumn(kTypeIndex<SelectedComponents>, chunkIndex)...};
+        const std::array<const ComponentTicks*, sizeof...(filters)> filterTicks{
+            archetype.GetTicksColumn(kTypeIndex<typename std::remove_cvref_t<decltype(filters)>::ComponentType>, chunkIndex)...};
+
+        [&]<size_t... SelectedIndexes, size_t... FilterIndexes>(std::index_sequence<SelectedIndexes...>, std::index_sequence<FilterIndexes...>)
+        {
+            for (size_t row = 0; row < rowCount; ++row)
+            {
+                if (!(filters.Matches(filterTicks[FilterIndexes][row]) && ...))
+                    continue;
+                ((std::is_const_v<SelectedComponents> ? void() : void(ticks[SelectedIndexes][row].changed = tick)), ...);
+                func(entities[row], std::get<SelectedIndexes>(columns)[row]...);
+            }
+        }(std::index_sequence_for<SelectedComponents...>{}, std::make_index_sequence<sizeof...(filters)>{});
+    }
+
+    size_t GetOrCreateArchetype(const ComponentSignature& signature)
+    {
+        auto [iterator, inserted] = signatureArchetypes.try_emplace(signature, archetypes.size());
+        if (inserted)
+            archetypes.push_back(std::make_unique<Archetype>(signature));
+
+        return iterator->second;
+    }
+
+    // Gives an entity without components a row in the archetype and returns it.
+    size_t AddRow(Entity entity, size_t archetypeIndex)
+    {
+        const size_t row = archetypes[archetypeIndex]->AllocateRow(entity);
+        entityLocations.Set(entity, EntityLocation{.archetype = archetypeIndex, .row = row});
+        return row;
+    }
+
+    // Moves the shared components of the entity and their ticks into a new row of the destination archetype.
+    // Components missing in the destination are destroyed. Returns the new row.
+    size_t MoveRow(Entity entity, const EntityLocation& location, size_t destinationIndex)
+    {
+        Archetype& source = *archetypes[location.archetype];
+        Archetype& destination = *archetypes[destinationIndex];
+        const size_t destinationRow = destination.AllocateRow(entity);
+
+        const ComponentSignature shared = source.signature & destination.signature;
+        for (size_t typeIndex = 0; typeIndex < kComponentTypeCount; ++typeIndex)
+            if (shared[typeIndex])
+            {
+                kComponentTypeInfos[typeIndex].moveConstruct(destination.GetCell(typeIndex, destinationRow), source.GetCell(typeIndex, location.row));
+                *destination.GetTicks(typeIndex, destinationRow) = *source.GetTicks(typeIndex, location.row);
+            }
+
+        RemoveRow(source, location.row);
+        entityLocations.Set(entity, EntityLocation{.archetype = destinationIndex, .row = destinationRow});
+        return destinationRow;
+    }
+
+    // Destroys the row and fills the hole with the last row of the archetype.
+    void RemoveRow(Archetype& archetype, size_t row)
+    {
+        const size_t lastRow = archetype.rowCount - 1;
+        for (size_t typeIndex = 0; typeIndex < kComponentTypeCount; ++typeIndex)
+        {
+            if (!archetype.signature[typeIndex])
+                continue;
+
+            const ComponentTypeInfo& info = kComponentTypeInfos[typeIndex];
+            info.destroy(archetype.GetCell(typeIndex, row));
+            if (row != lastRow)
+            {
+                info.moveConstruct(archetype.GetCell(typeIndex, row), archetype.GetCell(typeIndex, lastRow));
+                info.destroy(archetype.GetCell(typeIndex, lastRow));
+                *archetype.GetTicks(typeIndex, row) = *archetype.GetTicks(typeIndex, lastRow);
+            }
+        }
+
+        if (row != lastRow)
+        {
+            const Entity movedEntity = archetype.GetEntity(lastRow);
+            archetype.GetEntityColumn(row / archetype.chunkCapacity)[row % archetype.chunkCapacity] = movedEntity;
+            entityLocations.Set(movedEntity, EntityLocation{.archetype = entityLocations.Get(movedEntity).archetype, .row = row});
+        }
+
+        --archetype.rowCount;
+        // Release the last chunk once it becomes empty.
+        if (archetype.rowCount % archetype.chunkCapacity == 0 && archetype.chunks.size() > archetype.rowCount / archetype.chunkCapacity)
+            archetype.chunks.pop_back();
+    }
+
+    std::vector<std::unique_ptr<Archetype>> archetypes{};
+    std::unordered_map<ComponentSignature, size_t> signatureArchetypes{};
+    // Tracks where each entity is stored.
+    PagedArray<EntityLocation> entityLocations{};
+};
+
+}  // namespace tektonik::ecs
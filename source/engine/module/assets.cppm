@@ -0,0 +1,125 @@
+module;
+#include "common-defines.hpp"
+export module assets;
+
+import string_table;
+import std;
+
+namespace tektonik::assets
+{
+
+// Shared by the cache and the handles, defined in the implementation.
+struct ImageEntry;
+
+}  // namespace tektonik::assets
+
+export namespace tektonik::assets
+{
+
+// Decoded image, 8 bit RGBA pixels in rows without padding.
+struct Image
+{
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::vector<std::byte> pixels{};
+};
+
+enum class AssetState : std::uint8_t
+{
+    Loading,
+    Ready,
+    Failed
+};
+
+// Reads and decodes the image at the path, throws std::runtime_error on failure. Called on loader threads.
+using Decoder = std::function<Image(std::string_view path)>;
+
+// Decodes BMP files with SDL.
+Image DecodeBmp(std::string_view path);
+
+// 1x1 magenta image, shown while images load and in place of images that failed to.
+const Image& GetPlaceholder();
+
+// Encodes the image as an uncompressed PNG, which needs no zlib and is fast to write, e.g. for frame captures.
+std::vector<std::byte> EncodePng(const Image& image);
+// Throws std::runtime_error when the file cannot be written.
+void WritePng(const Image& image, const std::filesystem::path& path);
+
+// Ref-counted reference to a cached image. The cache keeps the image while any handle to it exists.
+// Handles may outlive the AssetManager.
+class ImageHandle
+{
+  public:
+    ImageHandle() = default;
+
+    // Empty handles are Failed.
+    AssetState GetState() const;
+    bool IsReady() const { return GetState() == AssetState::Ready; }
+    // The image once it is ready, the placeholder until then.
+    const Image& Get() const;
+    InternedString GetPath() const;
+    // Why the image failed to load, empty unless Failed.
+    std::string_view GetError() const;
+
+    bool operator==(const ImageHandle&) const = default;
+
+  private:
+    friend class AssetManager;
+
+    explicit ImageHandle(std::shared_ptr<const ImageEntry> entry) : entry(std::move(entry)) {}
+
+    std::shared_ptr<const ImageEntry> entry{};
+};
+
+// Loads images on its own threads, so slow reads never end up in frame jobs the main thread waits for.
+// Requests for a path that is cached or still loading share one entry. Once the cache exceeds its budget,
+// images without handles are evicted, least recently requested first. Images that failed to load leave the cache
+// once Update reported them, so requesting them again retries.
+// Request may be called from any thread, everything else from the main thread only.
+class AssetManager
+{
+  public:
+    explicit AssetManager(Decoder decoder = DecodeBmp);
+    ~AssetManager();
+
+    AssetManager(const AssetManager&) = delete;
+    AssetManager& operator=(const AssetManager&) = delete;
+
+    // Never blocks on loading, the handle shows the placeholder until the image is ready.
+    ImageHandle Request(InternedString path);
+
+    // Accounts the images loaded since the last call and evicts unused ones over the budget. Call once per frame.
+    void Update();
+    // Blocks until all requested images finished loading, e.g. behind a loading screen.
+    void WaitIdle();
+
+    // Bytes of the images accounted by Update, which may exceed the budget while their handles are alive.
+    std::size_t GetCachedBytes() const { return cachedBytes; }
+    std::size_t GetBudgetBytes() const;
+    std::size_t GetEntryCount() const;
+
+  private:
+    void LoaderLoop(std::stop_token stopToken);
+    void Evict();
+
+    const Decoder decoder;
+    std::size_t cachedBytes = 0;
+
+    // Guards everything below, except the loaders.
+    mutable std::mutex mutex{};
+    std::unordered_map<InternedString, std::shared_ptr<ImageEntry>> entries{};
+    // Most recently requested first.
+    std::list<InternedString> recentlyRequested{};
+    std::deque<std::shared_ptr<ImageEntry>> queue{};
+    // Loaded since the last Update.
+    std::vector<std::shared_ptr<ImageEntry>> finished{};
+    // Queued or being decoded.
+    std::size_t loadingCount = 0;
+    std::condition_variable_any queueChanged{};
+    std::condition_variable_any idle{};
+
+    // Must be last, so loaders are joined before anything else is destroyed.
+    std::vector<std::jthread> loaders{};
+};
+
+}  // namespace tektonik::assets
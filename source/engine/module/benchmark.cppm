@@ -0,0 +1,9 @@
+export module benchmark;
+
+namespace tektonik::benchmark
+{
+
+// Runs every registered benchmark and logs its timings, only meaningful in optimized builds.
+export void RunAll();
+
+}  // namespace tektonik::benchmark
@@ -0,0 +1,169 @@
+module;
+#include "common-defines.hpp"
+export module collision;
+
+import glm;
+import ecs;
+import components;
+import std;
+
+// Narrow phase for candidate pairs, e.g. from spatial::SpatialIndex::GeneratePairs.
+export namespace tektonik::collision
+{
+
+using ecs::Entity;
+
+struct Circle
+{
+    glm::vec2 center{};
+    float radius = 0;
+};
+
+// Oriented box.
+struct Box
+{
+    glm::vec2 center{};
+    glm::vec2 halfExtents{};
+    float rotation = 0;
+};
+
+using Shape = std::variant<Circle, Box>;
+
+// World space shapes of the components, the circle radius is scaled by the larger scale axis.
+Circle MakeShape(const components::Transform2D& transform, const components::Circle2D& circle);
+Box MakeShape(const components::Transform2D& transform, const components::Box2D& box);
+
+// Shape of an entity with a Transform2D and a Box2D or Circle2D, the box wins when it has both.
+template <typename ComponentManagerType>
+std::optional<Shape> GetShape(const ComponentManagerType& componentManager, Entity entity)
+{
+    constexpr size_t kTransformIndex = ComponentManagerType::template kTypeIndex<components::Transform2D>;
+    constexpr size_t kBoxIndex = ComponentManagerType::template kTypeIndex<components::Box2D>;
+    constexpr size_t kCircleIndex = ComponentManagerType::template kTypeIndex<components::Circle2D>;
+    constexpr size_t kTypeCount = ComponentManagerType::kComponentTypeCount;
+
+    const auto signature = componentManager.GetSignature(entity);
+    if constexpr (kTransformIndex < kTypeCount)
+    {
+        if (!signature[kTransformIndex])
+            return std::nullopt;
+        const components::Transform2D transform = componentManager.template GetComponent<components::Transform2D>(entity);
+
+        if constexpr (kBoxIndex < kTypeCount)
+            if (signature[kBoxIndex])
+                return MakeShape(transform, componentManager.template GetComponent<components::Box2D>(entity));
+        if constexpr (kCircleIndex < kTypeCount)
+            if (signature[kCircleIndex])
+                return MakeShape(transform, componentManager.template GetComponent<components::Circle2D>(entity));
+    }
+    return std::nullopt;
+}
+
+// Overlap of two shapes. The normal is a unit vector pointing from first towards second,
+// moving second by normal * depth separates them. Circles are always first in contacts with boxes.
+struct Contact
+{
+    Entity first = 0;
+    Entity second = 0;
+    glm::vec2 normal{};
+    float depth = 0;
+};
+
+// Single pair test, the entities may be swapped in the contact so a circle comes first.
+std::optional<Contact> Collide(Entity first, const Shape& firstShape, Entity second, const Shape& secondShape);
+
+// Sorts pairs by shape combination into batches of float columns, which are tested four pairs at a time
+// once kBatchSize pairs are gathered, while the columns are still in cache. Collects the contacts of all of them.
+// Meant to be reused every frame, it only allocates when the contacts outgrow it.
+class ContactBuffer
+{
+  public:
+    static constexpr size_t kBatchSize = 256;
+
+    // Forgets the pairs and contacts, keeping the memory.
+    void Clear();
+    void Add(Entity first, const Shape& firstShape, Entity second, const Shape& secondShape);
+    // Tests the pairs of the partially filled batches. Contacts are in no particular order.
+    void Collide();
+
+    std::span<const Contact> GetContacts() const { return contacts; }
+
+  private:
+    struct CircleColumns
+    {
+        std::vector<float> x, y, radius;
+
+        void Push(const Circle& circle);
+        void Clear();
+    };
+
+    // The cosine and sine of the rotations are computed for the whole batch at once.
+    struct BoxColumns
+    {
+        std::vector<float> x, y, rotation, halfWidth, halfHeight, cos, sin;
+
+        void Push(const Box& box);
+        void Clear();
+        void ComputeAxes();
+    };
+
+    template <typename FirstColumns, typename SecondColumns>
+    struct Batch
+    {
+        std::vector<Entity> firsts;
+        std::vector<Entity> seconds;
+        FirstColumns firstShapes;
+        SecondColumns secondShapes;
+
+        void Push(Entity first, const auto& firstShape, Entity second, const auto& secondShape)
+        {
+            firsts.push_back(first);
+            seconds.push_back(second);
+            firstShapes.Push(firstShape);
+            secondShapes.Push(secondShape);
+        }
+
+        void Clear()
+        {
+            firsts.clear();
+            seconds.clear();
+            firstShapes.Clear();
+            secondShapes.Clear();
+        }
+    };
+
+    // Kernel output, one element per pair of a batch. Pairs overlap when depth is positive.
+    struct Results
+    {
+        std::array<float, kBatchSize> normalX, normalY, depth;
+    };
+
+    // Tests the pairs of the batch, appends their contacts and clears it.
+    void Collide(Batch<CircleColumns, CircleColumns>& batch);
+    void Collide(Batch<CircleColumns, BoxColumns>& batch);
+    void Collide(Batch<BoxColumns, BoxColumns>& batch);
+    void AppendContacts(std::span<const Entity> firsts, std::span<const Entity> seconds);
+
+    Batch<CircleColumns, CircleColumns> circleCircle{};
+    Batch<CircleColumns, BoxColumns> circleBox{};
+    Batch<BoxColumns, BoxColumns> boxBox{};
+    Results results{};
+    std::vector<Contact> contacts{};
+};
+
+// Clears the buffer and fills it with the contacts of the pairs. Pairs of entities without shapes are skipped.
+template <typename ComponentManagerType>
+void GenerateContacts(const ComponentManagerType& componentManager, std::span<const std::pair<Entity, Entity>> pairs, ContactBuffer& buffer)
+{
+    buffer.Clear();
+    for (const auto& [first, second] : pairs)
+    {
+        const std::optional<Shape> firstShape = GetShape(componentManager, first);
+        const std::optional<Shape> secondShape = GetShape(componentManager, second);
+        if (firstShape && secondShape)
+            buffer.Add(first, *firstShape, second, *secondShape);
+    }
+    buffer.Collide();
+}
+
+}  // namespace tektonik::collision
@@ -4,6 +4,7 @@ export module components;
 
 import glm;
 import ecs;
+import string_table;
 import std;
 
 // A collection of "default" components.
@@ -16,6 +17,18 @@ export struct Transform2D
     float rotation = 0;
     glm::vec2 scale = glm::gtc::one<glm::vec2>();
 
+    // Stored as separate position, rotation and scale columns.
+    using Layout = ecs::SplitFields;
+
+    // Named fields of the FieldsReference that ecs::ComponentManager::GetComponent returns instead of a Transform2D&.
+    template <typename Reference>
+    struct FieldAccessors
+    {
+        auto& Position() const { return static_cast<const Reference&>(*this).template Get<0>(); }
+        auto& Rotation() const { return static_cast<const Reference&>(*this).template Get<1>(); }
+        auto& Scale() const { return static_cast<const Reference&>(*this).template Get<2>(); }
+    };
+
     auto Tie() const { return std::tie(position, rotation, scale); }
 };
 static_assert(ecs::Component<Transform2D>);
@@ -44,9 +57,11 @@ export struct Color
 };
 static_assert(ecs::Component<Color>);
 
+// Drawn as a quad of Transform2D::scale world units, the texture is stretched over it whatever its size or aspect.
+// Sizing by the texture would resize sprites once their texture finished loading.
 export struct Sprite
 {
-    std::string path = "";
+    InternedString path{};
 
     auto Tie() const { return std::tie(path); }
 };
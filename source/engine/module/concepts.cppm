@@ -54,6 +54,15 @@ concept Tiable = requires(T obj) {
     { obj.Tie() } -> InstantiatedFrom<std::tuple>;
 };
 
+// Mutable references to the fields of value, e.g. to deserialize into them. Tie() only hands out const references,
+// but they refer to value, which is not const here.
+export template <Tiable T>
+    requires(!std::is_const_v<T>)
+auto TieMutable(T& value)
+{
+    return std::apply([](const auto&... fields) { return std::tie(const_cast<std::remove_cvref_t<decltype(fields)>&>(fields)...); }, value.Tie());
+}
+
 export template <typename T>
 concept Pointer = std::is_pointer_v<T>;
 
@@ -76,10 +76,21 @@ export using ConfigEnum = Variable<ConfigurableEnum>;
 export class Manager
 {
   public:
+    Manager() = default;
+    /// Overrides are loaded into variables of the same name once they register, e.g. parsed command line arguments.
+    explicit Manager(const std::unordered_map<std::string_view, std::string_view>& overrides)
+    {
+        for (const auto& [name, value] : overrides)
+            this->overrides.emplace(name, value);
+    }
+
     void RegisterVariable(const std::string_view& name, auto* variable)
     {
         ASSUMERT(!variables.contains(name));
         variables.insert({name, variable});
+
+        if (const auto found = overrides.find(name); found != overrides.end())
+            variable->LoadFromStringView(found->second);
     }
 
     void UnregisterVariable(const std::string_view& name)
@@ -92,6 +103,7 @@ export class Manager
 
   private:
     std::map<std::string_view, std::variant<ConfigString*, ConfigI32*, ConfigU32*, ConfigFloat*, ConfigBool*, ConfigEnum*>> variables;
+    std::map<std::string, std::string, std::less<>> overrides;
 };
 
 template <typename T>
@@ -155,7 +167,8 @@ void Variable<bool>::LoadFromStringView(const std::string_view& input)
 {
     std::string inputLower = util::string::ToCase<util::string::Case::Lower>(input);
 
-    if (inputLower == "true" || inputLower == "1")
+    // Empty for command line flags without a value, like --Headless.
+    if (inputLower == "true" || inputLower == "1" || inputLower.empty())
         value = true;
     else if (inputLower == "false" || inputLower == "0")
         value = false;
@@ -0,0 +1,421 @@
+module;
+#include "common-defines.hpp"
+export module delta;
+
+import ecs;
+import concepts;
+import string_table;
+import std;
+import assert;
+
+// Deltas between two World states, e.g. to stream a simulation to spectators.
+// A delta holds the entity count of the encoded world, the entities whose generation changed, and per component type
+// the removed components, the added components and the changed fields of the others. Integers are varints, entities are delta coded.
+export namespace tektonik::delta
+{
+
+class DeltaError : public std::runtime_error
+{
+  public:
+    DeltaError(const std::string& message) : std::runtime_error(message) {}
+};
+
+inline constexpr std::uint8_t kVersion = 2;
+
+// Compares fields through Tie() when a type has no operator==.
+template <typename T>
+bool FieldEquals(const T& first, const T& second)
+{
+    if constexpr (concepts::InstantiatedFrom<T, std::vector>)
+        return std::ranges::equal(first, second, [](const auto& a, const auto& b) { return FieldEquals(a, b); });
+    else if constexpr (std::equality_comparable<T>)
+        return first == second;
+    else if constexpr (concepts::Tiable<T>)
+    {
+        return [&]<size_t... FieldIndexes>(std::index_sequence<FieldIndexes...>)
+        {
+            const auto firstFields = first.Tie();
+            const auto secondFields = second.Tie();
+            return (FieldEquals(std::get<FieldIndexes>(firstFields), std::get<FieldIndexes>(secondFields)) && ...);
+        }(std::make_index_sequence<std::tuple_size_v<decltype(first.Tie())>>());
+    }
+    else
+        static_assert(!sizeof(T*), "Type can not be compared.");
+}
+
+// Integers and enums are written as varints (signed ones zigzag encoded), strings (also interned ones) and vectors are size prefixed,
+// Tiable types are written field by field and other trivially copyable types as they are.
+class DeltaWriter
+{
+  public:
+    explicit DeltaWriter(std::vector<std::byte>& bytes) : bytes(bytes) {}
+
+    void WriteVarint(std::uint64_t value);
+
+    template <typename T>
+    void Write(const T& value)
+    {
+        if constexpr (std::is_enum_v<T>)
+            Write(std::to_underlying(value));
+        else if constexpr (std::unsigned_integral<T>)
+            WriteVarint(value);
+        else if constexpr (std::signed_integral<T>)
+            WriteVarint((static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(static_cast<std::int64_t>(value) >> 63));
+        else if constexpr (concepts::Tiable<T>)
+            std::apply([this](const auto&... fields) { (Write(fields), ...); }, value.Tie());
+        else if constexpr (std::is_same_v<T, std::string>)
+        {
+            WriteVarint(value.size());
+            WriteBytes(value.data(), value.size());
+        }
+        else if constexpr (std::is_same_v<T, InternedString>)
+        {
+            const std::string_view string = value.View();
+            WriteVarint(string.size());
+            WriteBytes(string.data(), string.size());
+        }
+        else if constexpr (concepts::InstantiatedFrom<T, std::vector>)
+        {
+            WriteVarint(value.size());
+            for (const auto& element : value)
+                Write(element);
+        }
+        else if constexpr (std::is_trivially_copyable_v<T>)
+            WriteBytes(&value, sizeof(T));
+        else
+            static_assert(!sizeof(T*), "Type can not be serialized.");
+    }
+
+  private:
+    void WriteBytes(const void* data, size_t size);
+
+    std::vector<std::byte>& bytes;
+};
+
+// Counterpart of DeltaWriter. Throws DeltaError on truncated or malformed input.
+class DeltaReader
+{
+  public:
+    explicit DeltaReader(std::span<const std::byte> bytes) : bytes(bytes) {}
+
+    std::uint64_t ReadVarint();
+    bool IsAtEnd() const { return position == bytes.size(); }
+
+    template <typename T>
+    void Read(T& value)
+    {
+        if constexpr (std::is_enum_v<T>)
+        {
+            std::underlying_type_t<T> underlying{};
+            Read(underlying);
+            value = static_cast<T>(underlying);
+        }
+        else if constexpr (std::unsigned_integral<T>)
+            value = static_cast<T>(ReadVarint());
+        else if constexpr (std::signed_integral<T>)
+        {
+            const std::uint64_t zigzag = ReadVarint();
+            value = static_cast<T>(static_cast<std::int64_t>(zigzag >> 1) ^ -static_cast<std::int64_t>(zigzag & 1));
+        }
+        else if constexpr (concepts::Tiable<T>)
+        {
+            std::apply([this](auto&... fields) { (Read(fields), ...); }, concepts::TieMutable(value));
+        }
+        else if constexpr (std::is_same_v<T, std::string>)
+        {
+            value.resize(ReadSize());
+            ReadBytes(value.data(), value.size());
+        }
+        else if constexpr (std::is_same_v<T, InternedString>)
+        {
+            std::string string{};
+            Read(string);
+            value = InternedString(string);
+        }
+        else if constexpr (concepts::InstantiatedFrom<T, std::vector>)
+        {
+            value.resize(ReadSize());
+            for (auto& element : value)
+                Read(element);
+        }
+        else if constexpr (std::is_trivially_copyable_v<T>)
+            ReadBytes(&value, sizeof(T));
+        else
+            static_assert(!sizeof(T*), "Type can not be deserialized.");
+    }
+
+  private:
+    // Sizes are bounded by the remaining bytes, so malformed input can not cause huge allocations.
+    size_t ReadSize();
+    void ReadBytes(void* data, size_t size);
+
+    std::span<const std::byte> bytes;
+    size_t position = 0;
+};
+
+// Encodes the changes from previous to current. Both worlds keep their own entities, an entity
+// is matched by its index and generation. Components that were not mutably accessed after lastSentTick
+// (see ComponentTicks and ecs::Changed) are assumed unchanged without comparing them, 0 compares everything.
+// A sender typically keeps a world with the last sent state and applies each delta to it as well.
+template <ecs::Component... ComponentTypes>
+std::vector<std::byte> Encode(ecs::World<ecs::ComponentManager<ComponentTypes...>>& previous,
+                              ecs::World<ecs::ComponentManager<ComponentTypes...>>& current,
+                              ecs::Tick lastSentTick = 0)
+{
+    using Manager = ecs::ComponentManager<ComponentTypes...>;
+    Manager& previousManager = previous.GetComponentManager();
+    Manager& currentManager = current.GetComponentManager();
+
+    std::vector<std::byte> bytes{};
+    DeltaWriter writer(bytes);
+    writer.Write(kVersion);
+    writer.WriteVarint(sizeof...(ComponentTypes));
+    writer.WriteVarint(current.GetEntityManager().GetGenerations().size());
+
+    // Ascending entities are written as differences to the previous one.
+    const auto writeEntities = [&writer](std::span<const ecs::Entity> entities, const auto& writeEntity)
+    {
+        writer.WriteVarint(entities.size());
+        ecs::Entity last = 0;
+        for (const ecs::Entity entity : entities)
+        {
+            writer.WriteVarint(entity - last);
+            last = entity;
+            writeEntity(entity);
+        }
+    };
+
+    const std::span<const std::uint32_t> previousGenerations = previous.GetEntityManager().GetGenerations();
+    const std::span<const std::uint32_t> currentGenerations = current.GetEntityManager().GetGenerations();
+    const auto getGeneration = [](std::span<const std::uint32_t> generations, ecs::Entity entity)
+    { return entity < generations.size() ? generations[entity] : 0; };
+
+    std::vector<ecs::Entity> entities{};
+    for (ecs::Entity entity = 0; entity < std::max(previousGenerations.size(), currentGenerations.size()); ++entity)
+        if (getGeneration(previousGenerations, entity) != getGeneration(currentGenerations, entity))
+            entities.push_back(entity);
+    writeEntities(entities, [&](ecs::Entity entity) { writer.WriteVarint(getGeneration(currentGenerations, entity)); });
+
+    // Entities whose generation changed lost all their components, so only the others can remove or change them.
+    const auto isSameEntity = [&](ecs::Entity entity)
+    { return previous.IsAlive(entity) && getGeneration(previousGenerations, entity) == getGeneration(currentGenerations, entity); };
+
+    const auto encodeType = [&]<ecs::Component ComponentType>()
+    {
+        constexpr size_t typeIndex = Manager::template kTypeIndex<ComponentType>;
+        constexpr size_t fieldCount = std::tuple_size_v<decltype(std::declval<ComponentType>().Tie())>;
+        static_assert(fieldCount <= 64, "Changed fields are tracked in a 64 bit mask.");
+
+        entities.clear();
+        previousManager.template Each<const ComponentType>(
+            [&](ecs::Entity entity, const ComponentType&)
+            {
+                if (current.IsAlive(entity) && isSameEntity(entity) && !currentManager.GetSignature(entity)[typeIndex])
+                    entities.push_back(entity);
+            });
+        std::ranges::sort(entities);
+        writeEntities(entities, [](ecs::Entity) {});
+
+        std::vector<ecs::Entity> addedEntities{};
+        std::vector<std::pair<ecs::Entity, std::uint64_t>> changedEntities{};
+        currentManager.template Each<const ComponentType>(
+            [&](ecs::Entity entity, const ComponentType& component)
+            {
+                if (!isSameEntity(entity) || !previousManager.GetSignature(entity)[typeIndex])
+                {
+                    addedEntities.push_back(entity);
+                    return;
+                }
+                const ecs::Tick changedTick = currentManager.template GetComponentTicks<ComponentType>(entity).changed;
+                if (lastSentTick != 0 && !ecs::IsNewerTick(changedTick, lastSentTick))
+                    return;
+
+                const auto previousFields = std::as_const(previousManager).template GetComponent<ComponentType>(entity).Tie();
+                const auto currentFields = component.Tie();
+                std::uint64_t changedFields = 0;
+                [&]<size_t... FieldIndexes>(std::index_sequence<FieldIndexes...>)
+                {
+                    ((changedFields |= std::uint64_t{!FieldEquals(std::get<FieldIndexes>(previousFields), std::get<FieldIndexes>(currentFields))}
+                                       << FieldIndexes),
+                     ...);
+                }(std::make_index_sequence<fieldCount>());
+                if (changedFields != 0)
+                    changedEntities.emplace_back(entity, changedFields);
+            });
+
+        std::ranges::sort(addedEntities);
+        writeEntities(addedEntities, [&](ecs::Entity entity) { writer.Write(std::as_const(currentManager).template GetComponent<ComponentType>(entity)); });
+
+        std::ranges::sort(changedEntities);
+        entities.clear();
+        std::ranges::transform(changedEntities, std::back_inserter(entities), [](const auto& changed) { return changed.first; });
+        auto changedFields = changedEntities.begin();
+        writeEntities(entities,
+                      [&](ecs::Entity entity)
+                      {
+                          const std::uint64_t fieldMask = (changedFields++)->second;
+                          writer.WriteVarint(fieldMask);
+                          const auto fields = std::as_const(currentManager).template GetComponent<ComponentType>(entity).Tie();
+                          [&]<size_t... FieldIndexes>(std::index_sequence<FieldIndexes...>)
+                          {
+                              ((fieldMask >> FieldIndexes & 1 ? writer.Write(std::get<FieldIndexes>(fields)) : void()), ...);
+                          }(std::make_index_sequence<fieldCount>());
+                      });
+    };
+    (encodeType.template operator()<ComponentTypes>(), ...);
+
+    return bytes;
+}
+
+// Changes of one component type decoded by Apply, before they are applied.
+template <ecs::Component ComponentType>
+struct DecodedChanges
+{
+    std::vector<ecs::Entity> removedEntities{};
+    std::vector<ecs::Entity> addedEntities{};
+    std::vector<ComponentType> addedComponents{};
+    std::vector<ecs::Entity> changedEntities{};
+    std::vector<std::uint64_t> changedFieldMasks{};
+    // Only the fields in the mask are set.
+    std::vector<ComponentType> changedFields{};
+};
+
+// Applies a delta to a world that is in the previous state of Encode.
+// Throws DeltaError when the delta is malformed or does not match the world. The whole delta is decoded and checked
+// before the world is modified, so a failed delta leaves the world unchanged.
+template <ecs::Component... ComponentTypes>
+void Apply(std::span<const std::byte> bytes, ecs::World<ecs::ComponentManager<ComponentTypes...>>& world)
+{
+    using Manager = ecs::ComponentManager<ComponentTypes...>;
+    Manager& componentManager = world.GetComponentManager();
+
+    DeltaReader reader(bytes);
+    std::uint8_t version = 0;
+    reader.Read(version);
+    if (version != kVersion)
+        throw DeltaError(std::format("Delta version {} is not supported, expected {}.", version, kVersion));
+    if (reader.ReadVarint() != sizeof...(ComponentTypes))
+        throw DeltaError("Delta was encoded with different component types.");
+    const std::uint64_t generationCount = reader.ReadVarint();
+
+    // Entities are strictly ascending and below the entity count of the encoded world.
+    const auto readEntities = [&reader, generationCount](const auto& readEntity)
+    {
+        const std::uint64_t count = reader.ReadVarint();
+        std::uint64_t entity = 0;
+        for (std::uint64_t i = 0; i < count; ++i)
+        {
+            const std::uint64_t difference = reader.ReadVarint();
+            if (i > 0 && difference == 0)
+                throw DeltaError(std::format("Entity {} is listed twice.", entity));
+            if (difference >= generationCount - entity)
+                throw DeltaError(std::format("Entity {} is out of range.", entity + difference));
+            entity += difference;
+            readEntity(static_cast<ecs::Entity>(entity));
+        }
+    };
+
+    std::vector<ecs::Entity> restoredEntities{};
+    std::vector<std::uint32_t> restoredGenerations{};
+    readEntities(
+        [&](ecs::Entity entity)
+        {
+            restoredEntities.push_back(entity);
+            restoredGenerations.push_back(static_cast<std::uint32_t>(reader.ReadVarint()));
+        });
+    // Entities the world does not have yet are created by the delta, so they are all listed.
+    if (generationCount > world.GetEntityManager().GetGenerations().size() + restoredEntities.size())
+        throw DeltaError(std::format("Delta adds more than the {} entities it lists.", restoredEntities.size()));
+
+    // State of an entity once the generations are restored. Restored entities lose all their components.
+    const auto findRestored = [&](ecs::Entity entity) -> std::optional<std::uint32_t>
+    {
+        const auto found = std::ranges::lower_bound(restoredEntities, entity);
+        if (found == restoredEntities.end() || *found != entity)
+            return std::nullopt;
+        return restoredGenerations[found - restoredEntities.begin()];
+    };
+    const auto isAlive = [&](ecs::Entity entity)
+    {
+        const std::optional<std::uint32_t> generation = findRestored(entity);
+        return generation ? *generation % 2 == 1 : world.IsAlive(entity);
+    };
+    const auto hasComponent = [&](ecs::Entity entity, std::size_t typeIndex)
+    { return !findRestored(entity) && world.IsAlive(entity) && componentManager.GetSignature(entity)[typeIndex]; };
+
+    std::tuple<DecodedChanges<ComponentTypes>...> decodedChanges{};
+    const auto decodeType = [&]<ecs::Component ComponentType>()
+    {
+        constexpr size_t typeIndex = Manager::template kTypeIndex<ComponentType>;
+        constexpr size_t fieldCount = std::tuple_size_v<decltype(std::declval<ComponentType>().Tie())>;
+        DecodedChanges<ComponentType>& changes = std::get<typeIndex>(decodedChanges);
+        const auto checkComponent = [&](ecs::Entity entity, bool shouldHave)
+        {
+            if (!isAlive(entity) || hasComponent(entity, typeIndex) != shouldHave)
+                throw DeltaError(std::format("Delta does not match the component {} of entity {}.", typeIndex, entity));
+        };
+
+        readEntities(
+            [&](ecs::Entity entity)
+            {
+                checkComponent(entity, true);
+                changes.removedEntities.push_back(entity);
+            });
+        readEntities(
+            [&](ecs::Entity entity)
+            {
+                checkComponent(entity, false);
+                changes.addedEntities.push_back(entity);
+                reader.Read(changes.addedComponents.emplace_back());
+            });
+        readEntities(
+            [&](ecs::Entity entity)
+            {
+                checkComponent(entity, true);
+                if (std::ranges::binary_search(changes.removedEntities, entity))
+                    throw DeltaError(std::format("Component {} of entity {} is both removed and changed.", typeIndex, entity));
+                const std::uint64_t fieldMask = reader.ReadVarint();
+                if (fieldMask >> fieldCount != 0)
+                    throw DeltaError(std::format("Field mask of component {} has unknown fields.", typeIndex));
+                changes.changedEntities.push_back(entity);
+                changes.changedFieldMasks.push_back(fieldMask);
+                const auto fields = concepts::TieMutable(changes.changedFields.emplace_back());
+                [&]<size_t... FieldIndexes>(std::index_sequence<FieldIndexes...>)
+                { ((fieldMask >> FieldIndexes & 1 ? reader.Read(std::get<FieldIndexes>(fields)) : void()), ...); }(std::make_index_sequence<fieldCount>());
+            });
+    };
+    (decodeType.template operator()<ComponentTypes>(), ...);
+
+    if (!reader.IsAtEnd())
+        throw DeltaError("Delta has trailing bytes.");
+
+    world.RestoreEntities(restoredEntities, restoredGenerations);
+
+    const auto applyType = [&]<ecs::Component ComponentType>()
+    {
+        constexpr size_t typeIndex = Manager::template kTypeIndex<ComponentType>;
+        constexpr size_t fieldCount = std::tuple_size_v<decltype(std::declval<ComponentType>().Tie())>;
+        DecodedChanges<ComponentType>& changes = std::get<typeIndex>(decodedChanges);
+
+        for (const ecs::Entity entity : changes.removedEntities)
+            componentManager.template RemoveComponent<ComponentType>(entity);
+        for (size_t i = 0; i < changes.addedEntities.size(); ++i)
+            componentManager.AddComponent(changes.addedEntities[i], std::move(changes.addedComponents[i]));
+        for (size_t i = 0; i < changes.changedEntities.size(); ++i)
+        {
+            const ecs::Entity entity = changes.changedEntities[i];
+            const std::uint64_t fieldMask = changes.changedFieldMasks[i];
+            const auto fields = concepts::TieMutable(changes.changedFields[i]);
+            [&]<size_t... FieldIndexes>(std::index_sequence<FieldIndexes...>)
+            {
+                ((fieldMask >> FieldIndexes & 1
+                      ? void(componentManager.template GetComponentField<ComponentType, FieldIndexes>(entity) = std::move(std::get<FieldIndexes>(fields)))
+                      : void()),
+                 ...);
+            }(std::make_index_sequence<fieldCount>());
+        }
+    };
+    (applyType.template operator()<ComponentTypes>(), ...);
+}
+
+}  // namespace tektonik::delta
@@ -3,7 +3,10 @@ module;
 export module ecs;
 
 import sparse_set;
+import memory;
 import concepts;
+import jobs;
+import singleton;
 import std;
 import assert;
 
@@ -13,53 +16,200 @@ export namespace tektonik::ecs
 // Basically just an ID.
 using Entity = std::uint32_t;
 
+// Entity together with the generation it was created in.
+// Unlike a bare Entity, it can be held across frames and checked for liveness,
+// because the entity index may get reused after deletion.
+struct EntityHandle
+{
+    Entity entity = 0;
+    std::uint32_t generation = 0;
+
+    bool operator==(const EntityHandle&) const = default;
+};
+
 class EntityManager
 {
   public:
+    // Entities stay below it, CommandBuffer uses the values above for its placeholders.
+    static constexpr Entity kEntityLimit = Entity{1} << 31;
+
+    explicit EntityManager(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : generations(resource), unusedEntities(resource) {}
+
     Entity NewEntity()
     {
+        Entity entity{};
         if (unusedEntities.empty())
         {
-            return nextMaxCreatedEntity++;
+            ASSUMERT(generations.size() < kEntityLimit);
+            entity = static_cast<Entity>(generations.size());
+            generations.push_back(0);
         }
         else
         {
-            Entity unusedEntity = unusedEntities.back();
+            // Reuse the lowest index first, so arrays indexed by entities stay compact.
+            std::ranges::pop_heap(unusedEntities, std::greater{});
+            entity = unusedEntities.back();
+            unusedEntities.pop_back();
+        }
+
+        ++generations[entity];
+        ASSUMERT(IsAlive(entity));
+        return entity;
+    }
+
+    // Creates count entities in ascending order. Reuses the lowest deleted entities first, like NewEntity.
+    std::vector<Entity> NewEntities(size_t count)
+    {
+        std::vector<Entity> entities{};
+        NewEntities(count, entities);
+        return entities;
+    }
+
+    // Like NewEntities, but appends to entities, e.g. a vector allocated from a memory::FrameArena.
+    void NewEntities(size_t count, auto& entities)
+    {
+        const size_t targetSize = entities.size() + count;
+        entities.reserve(targetSize);
+
+        const size_t firstIndex = entities.size();
+        while (entities.size() < targetSize && !unusedEntities.empty())
+        {
+            std::ranges::pop_heap(unusedEntities, std::greater{});
+            entities.push_back(unusedEntities.back());
             unusedEntities.pop_back();
-            return unusedEntity;
         }
+
+        const Entity firstNewEntity = static_cast<Entity>(generations.size());
+        ASSUMERT(generations.size() + (targetSize - entities.size()) <= kEntityLimit);
+        generations.resize(generations.size() + (targetSize - entities.size()), 0);
+        for (Entity entity = firstNewEntity; entity < generations.size(); ++entity)
+            entities.push_back(entity);
+
+        for (size_t i = firstIndex; i < entities.size(); ++i)
+            ++generations[entities[i]];
     }
 
     void DeleteEntity(Entity entity)
     {
-        ASSUMERT(entity < nextMaxCreatedEntity);
+        ASSUMERT(IsAlive(entity));
+        ++generations[entity];
         unusedEntities.push_back(entity);
+        std::ranges::push_heap(unusedEntities, std::greater{});
+    }
+
+    // Like DeleteEntity, but rebuilds the heap once for the whole batch.
+    void DeleteEntities(std::span<const Entity> entities)
+    {
+        for (const Entity entity : entities)
+        {
+            ASSUMERT(IsAlive(entity));
+            ++generations[entity];
+        }
+        unusedEntities.insert(unusedEntities.end(), entities.begin(), entities.end());
+        std::ranges::make_heap(unusedEntities, std::greater{});
+    }
+
+    EntityHandle GetHandle(Entity entity) const
+    {
+        ASSUMERT(IsAlive(entity));
+        return EntityHandle{.entity = entity, .generation = generations[entity]};
+    }
+
+    // Generation of every once created entity, indexed by entity.
+    std::span<const std::uint32_t> GetGenerations() const { return generations; }
+
+    // Replaces all entities by the ones described by GetGenerations, e.g. when loading a snapshot.
+    void RestoreGenerations(std::span<const std::uint32_t> savedGenerations)
+    {
+        ASSUMERT(savedGenerations.size() <= kEntityLimit);
+        generations.assign(savedGenerations.begin(), savedGenerations.end());
+        unusedEntities.clear();
+        for (Entity entity = 0; entity < generations.size(); ++entity)
+            if (!IsAlive(entity))
+                unusedEntities.push_back(entity);
+        std::ranges::make_heap(unusedEntities, std::greater{});
+    }
+
+    // Sets the generations of some entities, e.g. when applying a delta. Entities past the end are added.
+    void RestoreGenerations(std::span<const Entity> entities, std::span<const std::uint32_t> savedGenerations)
+    {
+        ASSUMERT(entities.size() == savedGenerations.size());
+        bool revived = false;
+        for (size_t i = 0; i < entities.size(); ++i)
+        {
+            const Entity entity = entities[i];
+            ASSUMERT(entity < kEntityLimit);
+            // Skipped entities were never created here, but can be reused like deleted ones.
+            for (Entity skipped = static_cast<Entity>(generations.size()); skipped <= entity; ++skipped)
+            {
+                generations.push_back(0);
+                unusedEntities.push_back(skipped);
+            }
+
+            const bool wasAlive = IsAlive(entity);
+            generations[entity] = savedGenerations[i];
+            if (wasAlive && !IsAlive(entity))
+                unusedEntities.push_back(entity);
+            revived |= !wasAlive && IsAlive(entity);
+        }
+
+        if (revived)
+            std::erase_if(unusedEntities, [this](Entity entity) { return IsAlive(entity); });
+        std::ranges::make_heap(unusedEntities, std::greater{});
     }
 
+    // Alive entities have an odd generation.
+    bool IsAlive(Entity entity) const { return entity < generations.size() && generations[entity] % 2 == 1; }
+    bool IsAlive(EntityHandle handle) const { return handle.entity < generations.size() && generations[handle.entity] == handle.generation; }
+
   private:
-    // Already once created entities that were deleted.
-    std::vector<Entity> unusedEntities{};
-    Entity nextMaxCreatedEntity = 0;
+    // Generation of every once created entity, incremented on both creation and deletion.
+    std::pmr::vector<std::uint32_t> generations;
+    // Min-heap of once created entities that were deleted.
+    std::pmr::vector<Entity> unusedEntities;
 };
 
 class EntityRange
 {
+    static std::pmr::set<Entity>& TransformFunc(std::pmr::set<Entity>* entitySet) { return *entitySet; }
+
   public:
-    using InputRange = std::vector<std::set<Entity>*>;
+    using InputRange = std::pmr::vector<std::pmr::set<Entity>*>;
 
-    EntityRange(InputRange&& entitySets)
-        : entitySets(std::move(entitySets)), view(std::views::join(std::views::transform(this->entitySets, TransformFunc)))
-    {
-    }
+    // Refers to a list of entity sets kept alive elsewhere, e.g. by a registered query. The list is only read by begin(),
+    // so sets appended to it in the meantime are iterated too. The sets must not change while iterating.
+    explicit EntityRange(const InputRange& entitySets) : view(std::views::join(std::views::transform(std::ranges::ref_view(entitySets), TransformFunc))) {}
 
     auto begin() { return view.begin(); }
     auto end() { return view.end(); }
 
   private:
-    static std::set<Entity>& TransformFunc(std::set<Entity>* entitySet) { return *entitySet; }
+    // Holds a pointer to the list instead of its elements, so copies of the range stay valid when the list grows.
+    decltype(std::views::join(std::views::transform(std::ranges::ref_view(std::declval<const InputRange&>()), TransformFunc))) view;
+};
+
+// Refers to a query registered in a ComponentManager.
+struct QueryHandle
+{
+    size_t index = std::numeric_limits<size_t>::max();
+};
+
+// Value of the change tick counter of a ComponentManager.
+// The counter wraps around, so ticks are only ordered relative to each other, see IsNewerTick.
+using Tick = std::uint32_t;
+
+// Whether tick is after otherTick, assuming they are less than half the tick range apart.
+// ComponentManager::ClampTicks keeps stored ticks within that distance.
+constexpr bool IsNewerTick(Tick tick, Tick otherTick)
+{
+    return static_cast<std::make_signed_t<Tick>>(tick - otherTick) > 0;
+}
 
-    InputRange entitySets;
-    decltype(std::views::join(std::views::transform(entitySets, TransformFunc))) view;
+// When a component was added and when it was last accessed mutably.
+struct ComponentTicks
+{
+    Tick added = 0;
+    Tick changed = 0;
 };
 
 template <typename T>
@@ -71,21 +221,193 @@ struct DummyComponent
 };
 static_assert(Component<DummyComponent>);
 
+// Components opt in with `using Layout = SplitFields;` to store each field in its own column, see SplitSparseSet.
+// Accessing such a component yields a FieldsReference instead of a plain reference.
+struct SplitFields
+{
+};
+
+template <typename T>
+concept SplitComponent = Component<T> && std::is_same_v<typename std::remove_const_t<T>::Layout, SplitFields>;
+
+// What accessing a possibly const component yields.
+template <Component ComponentType>
+using ComponentReference = std::conditional_t<SplitComponent<ComponentType>,
+                                              FieldsReference<std::remove_const_t<ComponentType>, std::is_const_v<ComponentType>>,
+                                              ComponentType&>;
+
+// Position of ComponentType inside ComponentTypes, resolved at compile time.
+template <Component ComponentType, Component... ComponentTypes>
+constexpr size_t kComponentTypeIndex = []()
+{
+    constexpr std::array<bool, sizeof...(ComponentTypes)> matches{std::is_same_v<std::remove_const_t<ComponentType>, ComponentTypes>...};
+    const auto found = std::ranges::find(matches, true);
+    return found == matches.end() ? std::numeric_limits<size_t>::max() : static_cast<size_t>(std::distance(matches.begin(), found));
+}();
+
+// Query filters matching entities whose FilteredComponent was added or mutably accessed after lastRunTick.
+// A system run by a SystemManager passes TickSource::GetLastRunTick of its storage. Code running outside of one calls
+// TickSource::AdvanceTick at the start of every run and passes the tick it got on its previous run instead.
+// 0 before the first run matches everything. Own writes of the previous run are not matched again.
+template <Component FilteredComponent>
+struct Added
+{
+    using ComponentType = FilteredComponent;
+    Tick lastRunTick = 0;
+
+    bool Matches(const ComponentTicks& ticks) const { return lastRunTick == 0 || IsNewerTick(ticks.added, lastRunTick); }
+};
+
+template <Component FilteredComponent>
+struct Changed
+{
+    using ComponentType = FilteredComponent;
+    Tick lastRunTick = 0;
+
+    bool Matches(const ComponentTicks& ticks) const { return lastRunTick == 0 || IsNewerTick(ticks.changed, lastRunTick); }
+};
+
+template <typename T>
+concept ChangeFilter = Component<typename T::ComponentType> && requires(const T filter, const ComponentTicks& ticks) {
+    { filter.Matches(ticks) } -> std::same_as<bool>;
+};
+
+// Change tick counter of a component storage, together with the system running on the calling thread.
+// Component storages derive from it, so SystemManager can give every system run its own tick.
+class TickSource
+{
+  public:
+    // Tick that components added or mutably accessed by the calling thread get. Inside a system run by a SystemManager,
+    // the tick of that run, otherwise the latest one.
+    Tick GetCurrentTick() const
+    {
+        if (runningSystem.tickSource == this)
+            return runningSystem.thisRunTick;
+        return currentTick.value.load(std::memory_order_relaxed);
+    }
+
+    // Inside a system run by a SystemManager, the tick of its previous run, 0 before the first one.
+    // Passed to Added and Changed, they match what changed since then, no matter which system changed it.
+    Tick GetLastRunTick() const
+    {
+        ASSUMERT(runningSystem.tickSource == this);
+        return runningSystem.lastRunTick;
+    }
+
+  private:
+    // Without default member initializers, those could not be used before TickSource is complete.
+    struct RunningSystem
+    {
+        const TickSource* tickSource;
+        Tick thisRunTick;
+        Tick lastRunTick;
+    };
+    // System running on the calling thread, see SystemScope. Value initialized, no system.
+    inline static thread_local RunningSystem runningSystem{};
+
+  public:
+    // While alive, the calling thread stamps writes with thisRunTick and GetLastRunTick returns lastRunTick.
+    // SystemManager runs every system in one. Scopes nest, e.g. when a system waiting for jobs runs another system.
+    // Jobs a system schedules itself run outside of its scope, Each and ParallelForEach pass the tick on.
+    class SystemScope
+    {
+      public:
+        SystemScope(const TickSource& tickSource, Tick thisRunTick, Tick lastRunTick)
+            : previous(std::exchange(runningSystem, RunningSystem{.tickSource = &tickSource, .thisRunTick = thisRunTick, .lastRunTick = lastRunTick}))
+        {
+        }
+        ~SystemScope() { runningSystem = previous; }
+
+        SystemScope(const SystemScope&) = delete;
+        SystemScope& operator=(const SystemScope&) = delete;
+
+      private:
+        RunningSystem previous;
+    };
+
+    // Starts a new tick and returns it. Components added or mutably accessed from now on get this tick or a later one.
+    // Never returns 0, which filters treat as a system that never ran.
+    Tick AdvanceTick()
+    {
+        Tick tick = currentTick.value.fetch_add(1, std::memory_order_relaxed) + 1;
+        while (tick == 0)
+            tick = currentTick.value.fetch_add(1, std::memory_order_relaxed) + 1;
+        return tick;
+    }
+
+  protected:
+    // Age ClampTicks of the storages limits component ticks to, a quarter of the tick range leaves room for ticks between clamps.
+    static constexpr Tick kMaxTickAge = std::numeric_limits<Tick>::max() / 4;
+
+  private:
+    // std::atomic is not movable, moving the storage moves the tick it reached.
+    struct TickCounter
+    {
+        std::atomic<Tick> value{1};
+
+        TickCounter() = default;
+        TickCounter(TickCounter&& other) noexcept : value(other.value.load(std::memory_order_relaxed)) {}
+    };
+
+    // Stamped into the ticks of added and mutably accessed components outside of systems.
+    TickCounter currentTick{};
+};
+
+// Anything a World can use to store components of its entities, e.g. ComponentManager or ArchetypeComponentManager.
+// World, SystemManager and CommandBuffer also use the member templates kTypeIndex, AddComponents, View, Each,
+// ParallelForEach, StoreComponent and EraseComponent, which can not be checked without knowing the component types.
+template <typename T>
+concept ComponentStorage = std::is_default_constructible_v<T> && std::derived_from<T, TickSource> &&
+                           requires(T storage, const T constStorage, Entity entity, std::span<const Entity> entities, void (*changeComponents)(Entity)) {
+                               { T::kComponentTypeCount } -> std::convertible_to<size_t>;
+                               { T::kDefaultGrainSize } -> std::convertible_to<size_t>;
+                               { constStorage.GetSignature(entity) } -> std::same_as<std::bitset<T::kComponentTypeCount>>;
+                               { storage.RemoveAllComponents(entity) } -> std::same_as<void>;
+                               { storage.RemoveAllComponents(entities) } -> std::same_as<void>;
+                               { storage.CloneComponents(entity, entities) } -> std::same_as<void>;
+                               { storage.ChangeSignatures(entities, constStorage.GetSignature(entity), changeComponents) } -> std::same_as<void>;
+                               { storage.ClampTicks() } -> std::same_as<void>;
+                           };
+
 template <Component... ComponentTypes>
-class ComponentManager
+class ComponentManager : public TickSource
 {
   public:
     static constexpr size_t kComponentTypeCount = sizeof...(ComponentTypes);
+    template <Component ComponentType>
+    static constexpr size_t kTypeIndex = kComponentTypeIndex<ComponentType, ComponentTypes...>;
+    // Default number of entities processed by a single ParallelForEach job.
+    static constexpr size_t kDefaultGrainSize = 4096;
 
-    ComponentManager() { (InitComponent<ComponentTypes>(), ...); }
+    // Size of the pooled nodes of the entity sets, std::set<Entity> nodes fit with common standard libraries.
+    static constexpr size_t kNodeBlockSize = 48;
+    // Red-black tree nodes hold three links, the color padded to a pointer and the value.
+    static_assert(4 * sizeof(void*) + sizeof(Entity) <= kNodeBlockSize, "Entity set nodes no longer fit the pooled blocks.");
+
+    ComponentManager() : ComponentManager(std::pmr::get_default_resource()) {}
+
+    // Component arrays (aligned to cache lines) and the bookkeeping of signatures and queries allocate from resource, which must outlive the manager.
+    // Nodes of the entity sets come from a pool on top of it, so structural changes rarely reach resource.
+    explicit ComponentManager(std::pmr::memory_resource* resource)
+        : resource(resource),
+          nodePool(std::make_unique<memory::BlockPool>(kNodeBlockSize, 1024, resource)),
+          arrayResource(std::make_unique<memory::AlignedResource>(kCacheLineSize, resource)),
+          signaturesHaveEntities(nodePool.get()),
+          entitiesHaveComponents(kNullComponentSignature, resource),
+          queries(resource),
+          signaturesQueries(resource),
+          groups(resource)
+    {
+        (InitComponent<ComponentTypes>(), ...);
+    }
 
     template <Component ComponentType>
     void AddComponent(Entity entity, ComponentType&& component)
     {
         // Simply add to the array.
-        GetComponentArray<ComponentType>().Add(entity, std::move(component));
+        GetComponentArray<ComponentType>().Add(entity, std::move(component), GetCurrentTick());
         // Get current signature.
-        ComponentSignature& signature = GetEntityComponentSignature(entity);
+        ComponentSignature signature = GetEntityComponentSignature(entity);
         // Remove from current entity set if currently had any components.
         if (signature != ComponentSignature{})
         {
@@ -97,18 +419,54 @@ class ComponentManager
         size_t componentBit = GetComponentTypeIndex<ComponentType>();
         ASSUMERT(componentBit < signature.size());
         // Adjust the signature.
+        const ComponentSignature oldSignature = signature;
         signature[componentBit] = true;
+        entitiesHaveComponents.Set(entity, signature);
         // Add to the adjusted entity set.
-        signaturesHaveEntities[signature].insert(entity);
+        GetSignatureEntities(signature).insert(entity);
+        EnterGroups(entity, oldSignature, signature);
+    }
+
+    // Adds a copy of components to every entity. The entities must not have any components yet.
+    // Each component array grows once and the whole batch is inserted into its signature set at once.
+    template <Component... SelectedComponents>
+    void AddComponents(std::span<const Entity> entities, const SelectedComponents&... components)
+    {
+        (GetComponentArray<SelectedComponents>().Add(entities, components, GetCurrentTick()), ...);
+        SetSignature(entities, GetSignatureFromComponents<SelectedComponents...>());
+    }
+
+    // Gives every clone a copy of all components of prototype. The clones must not have any components yet.
+    void CloneComponents(Entity prototype, std::span<const Entity> clones)
+    {
+        const ComponentSignature signature = GetEntityComponentSignature(prototype);
+        if (signature == kNullComponentSignature)
+            return;
+
+        size_t typeIndex = 0;
+        const auto cloneComponent = [&]<Component ComponentType>()
+        {
+            if (signature[typeIndex++])
+            {
+                // Copied first, the reference would dangle once the array grows.
+                const ComponentType component = GetComponentArray<ComponentType>().Get(prototype);
+                GetComponentArray<ComponentType>().Add(clones, component, GetCurrentTick());
+            }
+        };
+        (cloneComponent.template operator()<ComponentTypes>(), ...);
+
+        SetSignature(clones, signature);
     }
 
     template <Component ComponentType>
     void RemoveComponent(Entity entity)
     {
+        // Get current signature.
+        ComponentSignature signature = GetEntityComponentSignature(entity);
+        // Groups are left while the component is still there.
+        LeaveGroups(entity, signature, ComponentSignature(signature).reset(GetComponentTypeIndex<ComponentType>()));
         // Simply remove from the array.
         GetComponentArray<ComponentType>().Remove(entity);
-        // Get current signature.
-        ComponentSignature& signature = GetEntityComponentSignature(entity);
         // Remove from current entity set.
         ASSUMERT(signaturesHaveEntities.contains(signature));
         ASSUMERT(signaturesHaveEntities[signature].contains(entity));
@@ -118,20 +476,86 @@ class ComponentManager
         ASSUMERT(componentBit < signature.size());
         // Adjust the signature.
         signature[componentBit] = false;
+        entitiesHaveComponents.Set(entity, signature);
         // Add to the adjusted entity set if not zero.
         if (signature != ComponentSignature{})
-            signaturesHaveEntities[signature].insert(entity);
+            GetSignatureEntities(signature).insert(entity);
+    }
+
+    // Mutable access, marks the component as changed.
+    template <Component ComponentType>
+    ComponentReference<ComponentType> GetComponent(Entity entity)
+    {
+        const auto entry = GetComponentArray<ComponentType>().TryGetEntry(entity);
+        ASSUMERT(entry.ticks != nullptr);
+        return Access<ComponentType>(entry, GetCurrentTick());
     }
 
     template <Component ComponentType>
-    Component auto& GetComponent(Entity entity)
+    ComponentReference<const ComponentType> GetComponent(Entity entity) const
     {
         return GetComponentArray<ComponentType>().Get(entity);
     }
 
+    // Mutable access to the field at FieldIndex in Tie(), marks the component as changed.
+    template <Component ComponentType, size_t FieldIndex>
+    auto& GetComponentField(Entity entity)
+    {
+        if constexpr (SplitComponent<ComponentType>)
+            return GetComponent<ComponentType>(entity).template Get<FieldIndex>();
+        else
+            return std::get<FieldIndex>(concepts::TieMutable(GetComponent<ComponentType>(entity)));
+    }
+
+    // Column of the field at FieldIndex in Tie() of a split component, parallel to GetEntityColumn.
+    // Lets kernels stream a single field. Marks every component of the type as changed, since writes through the
+    // column can not be tracked, use the const overload to only read.
+    template <SplitComponent ComponentType, size_t FieldIndex>
+    auto GetFieldColumn()
+    {
+        ArrayOf<ComponentType>& array = GetComponentArray<ComponentType>();
+        array.MarkAllChanged(GetCurrentTick());
+        return array.template GetColumn<FieldIndex>();
+    }
+
+    template <SplitComponent ComponentType, size_t FieldIndex>
+    auto GetFieldColumn() const
+    {
+        return GetComponentArray<ComponentType>().template GetColumn<FieldIndex>();
+    }
+
+    template <SplitComponent ComponentType>
+    std::span<const Entity> GetEntityColumn() const
+    {
+        return GetComponentArray<ComponentType>().GetIndexes();
+    }
+
+    template <Component ComponentType>
+    const ComponentTicks& GetComponentTicks(Entity entity) const
+    {
+        return GetComponentArray<ComponentType>().GetTicks(entity);
+    }
+
+    // Ticks are compared with wraparound, a component tick more than half the tick range behind the current tick
+    // would look newer than it is. Moves such old ticks forward to kMaxTickAge behind the current tick, so they keep
+    // looking old. Call it from time to time, e.g. once per frame, while no system runs. Filters whose lastRunTick is
+    // older than kMaxTickAge match the clamped components, which errs on the side of a spurious change.
+    void ClampTicks()
+    {
+        const Tick oldestTick = GetCurrentTick() - kMaxTickAge;
+        for (const std::unique_ptr<IComponentArray>& componentArray : componentArrays)
+            componentArray->ClampTicks(oldestTick);
+    }
+
+    // Components the entity has, indexed by kTypeIndex.
+    std::bitset<kComponentTypeCount> GetSignature(Entity entity) const { return GetEntityComponentSignature(entity); }
+
     void RemoveAllComponents(Entity entity)
     {
-        const ComponentSignature& signature = GetEntityComponentSignature(entity);
+        const ComponentSignature signature = GetEntityComponentSignature(entity);
+        if (signature == kNullComponentSignature)
+            return;
+        LeaveGroups(entity, signature, kNullComponentSignature);
 
         // Remove entity from its component arrays.
         size_t typeIndex = 0;
@@ -147,125 +571,1301 @@ class ComponentManager
         ASSUMERT(signaturesHaveEntities[signature].contains(entity));
         signaturesHaveEntities[signature].erase(entity);
 
-        entitiesHaveComponents[entity] = kNullComponentSignature;
+        entitiesHaveComponents.Set(entity, kNullComponentSignature);
     }
 
-    template <Component... SelectedComponents>
-    EntityRange GetEntitiesWithComponents()
+    // Like RemoveAllComponents for every entity, entities without components are skipped.
+    void RemoveAllComponents(std::span<const Entity> entities)
     {
-        std::vector<std::set<Entity>*> entitySets{};
-        ComponentSignature wantedSignature = GetSignatureFromComponents<SelectedComponents...>();
+        // Entities of a batch mostly share a signature, so the set is looked up only when it changes.
+        ComponentSignature setSignature = kNullComponentSignature;
+        std::pmr::set<Entity>* set = nullptr;
 
-        for (auto& [iteratedSignature, set] : signaturesHaveEntities)
+        for (const Entity entity : entities)
         {
-            const bool containsAllWantedBits = ((iteratedSignature & wantedSignature) == wantedSignature);
-            if (containsAllWantedBits)
-                entitySets.push_back(&set);
+            const ComponentSignature signature = GetEntityComponentSignature(entity);
+            if (signature == kNullComponentSignature)
+                continue;
+            LeaveGroups(entity, signature, kNullComponentSignature);
+
+            size_t typeIndex = 0;
+            const auto removeEntityFromArray = [&]<Component ComponentType>()
+            {
+                if (signature[typeIndex++])
+                    GetComponentArray<ComponentType>().Remove(entity);
+            };
+            (removeEntityFromArray.template operator()<ComponentTypes>(), ...);
+
+            if (set == nullptr || signature != setSignature)
+            {
+                ASSUMERT(signaturesHaveEntities.contains(signature));
+                setSignature = signature;
+                set = &signaturesHaveEntities[signature];
+            }
+            ASSUMERT(set->contains(entity));
+            set->erase(entity);
+
+            entitiesHaveComponents.Set(entity, kNullComponentSignature);
         }
+    }
 
-        return EntityRange(std::move(entitySets));
+    // Bulk loading, e.g. from a snapshot. The components are appended without updating signatures,
+    // RestoreSignatures must be called for the loaded entities afterwards.
+    template <Component ComponentType>
+    void LoadComponents(std::span<const Entity> entities, std::span<const ComponentType> components)
+    {
+        GetComponentArray<ComponentType>().Add(entities, components, GetCurrentTick());
     }
 
-  private:
-    using ComponentSignature = std::bitset<kComponentTypeCount>;
-    static constexpr ComponentSignature kNullComponentSignature = ComponentSignature{};
-    static constexpr size_t kInvalidTypeIndex = std::numeric_limits<size_t>::max();
+    template <Component ComponentType>
+    void LoadComponent(Entity entity, ComponentType&& component)
+    {
+        GetComponentArray<ComponentType>().Add(entity, std::move(component), GetCurrentTick());
+    }
 
-    struct IComponentArray
+    // Gives entities the signature targetSignature in one go, e.g. on command playback. For every entity in order,
+    // changeComponents(entity) brings its component arrays in line with targetSignature using StoreComponent and
+    // EraseComponent. Entities leave their old signature sets one by one and enter the target set in a single insertion,
+    // which is cheapest for ascending entities.
+    void ChangeSignatures(std::span<const Entity> entities, const std::bitset<kComponentTypeCount>& targetSignature, auto&& changeComponents)
     {
-      public:
-        virtual ~IComponentArray() = default;
-    };
+        // Entities of a batch mostly come from the same signature, so the set is looked up only when it changes.
+        ComponentSignature setSignature = kNullComponentSignature;
+        std::pmr::set<Entity>* set = nullptr;
+
+        for (const Entity entity : entities)
+        {
+            const ComponentSignature signature = GetEntityComponentSignature(entity);
+            // Groups are left while the removed components are still there.
+            LeaveGroups(entity, signature, targetSignature);
+            changeComponents(entity);
 
+            if (signature != kNullComponentSignature)
+            {
+                if (set == nullptr || signature != setSignature)
+                {
+                    ASSUMERT(signaturesHaveEntities.contains(signature));
+                    setSignature = signature;
+                    set = &signaturesHaveEntities[signature];
+                }
+                ASSUMERT(set->contains(entity));
+                set->erase(entity);
+            }
+
+            entitiesHaveComponents.Set(entity, targetSignature);
+            EnterGroups(entity, signature, targetSignature);
+        }
+
+        if (targetSignature != kNullComponentSignature)
+            GetSignatureEntities(targetSignature).insert(entities.begin(), entities.end());
+    }
+
+    // Only for ChangeSignatures. Adds the component to its array, a component the entity already has is replaced in place,
+    // so its position (e.g. in a group) stays the same. Either way it counts as newly added.
     template <Component ComponentType>
-    class DerivedComponentArray : public IComponentArray, public SparseSet<ComponentType, Entity>
+    void StoreComponent(Entity entity, ComponentType&& component)
     {
-      public:
-        virtual ~DerivedComponentArray() = default;
-    };
+        ArrayOf<ComponentType>& array = GetComponentArray<ComponentType>();
+        const auto entry = array.TryGetEntry(entity);
+        if (entry.ticks == nullptr)
+        {
+            array.Add(entity, std::move(component), GetCurrentTick());
+            return;
+        }
+
+        *entry.ticks = ComponentTicks{.added = GetCurrentTick(), .changed = GetCurrentTick()};
+        array.GetAt(entry.denseIndex) = std::move(component);
+    }
 
+    // Only for ChangeSignatures. Removes the component from its array if the entity has it.
     template <Component ComponentType>
-    void InitComponent()
+    void EraseComponent(Entity entity)
     {
-        auto typeIndex = GetComponentTypeIndex<ComponentType>();
-        ASSUMERT(!componentArrays[typeIndex] && "Components must be unique.");
-        auto derived = std::make_unique<DerivedComponentArray<ComponentType>>();
-        auto base = static_cast<IComponentArray*>(derived.release());
-        componentArrays[typeIndex] = std::unique_ptr<IComponentArray>(base);
+        ArrayOf<ComponentType>& array = GetComponentArray<ComponentType>();
+        if (array.Contains(entity))
+            array.Remove(entity);
     }
 
-    template <Component ComponentType>
-    auto& GetComponentArray()
+    // Sets the signatures of loaded entities, which must not have had any components before loading.
+    // Entities are inserted into the signature sets in runs, so ascending entities are cheapest.
+    void RestoreSignatures(std::span<const Entity> entities, std::span<const std::bitset<kComponentTypeCount>> signatures)
     {
-        auto typeIndex = GetComponentTypeIndex<ComponentType>();
-        return *static_cast<DerivedComponentArray<ComponentType>*>(componentArrays[typeIndex].get());
+        ASSUMERT(entities.size() == signatures.size());
+        std::pmr::set<Entity>* set = nullptr;
+        for (size_t i = 0; i < entities.size(); ++i)
+        {
+            ASSUMERT(GetEntityComponentSignature(entities[i]) == kNullComponentSignature);
+            if (signatures[i] == kNullComponentSignature)
+                continue;
+
+            entitiesHaveComponents.Set(entities[i], signatures[i]);
+            if (set == nullptr || signatures[i] != signatures[i - 1])
+                set = &GetSignatureEntities(signatures[i]);
+            set->insert(set->end(), entities[i]);
+            EnterGroups(entities[i], kNullComponentSignature, signatures[i]);
+        }
+    }
+
+    // Declares an owning group. Entities that have all OwnedComponents are kept packed at the front of the owned arrays,
+    // in the same order in every one of them, so Each and ParallelForEach over exactly these components
+    // walk the arrays linearly without sparse lookups. Entering or leaving the group costs one swap per owned array.
+    // A component type can be owned by a single group only.
+    template <Component... OwnedComponents>
+    void RegisterGroup()
+    {
+        static_assert(sizeof...(OwnedComponents) > 1, "Groups need at least two components.");
+
+        const ComponentSignature signature = GetSignatureFromComponents<OwnedComponents...>();
+        for (const Group& group : groups)
+            ASSUMERT((group.signature & signature).none() && "Component types can be owned by a single group only.");
+
+        const size_t groupIndex = groups.size();
+        groups.push_back(Group{.signature = signature, .size = 0});
+
+        // Adopts entities that already have all the components.
+        for (const auto& [entitySignature, entities] : signaturesHaveEntities)
+            if (ContainsAll(entitySignature, signature))
+                for (const Entity entity : entities)
+                    EnterGroup(groups[groupIndex], entity);
+    }
+
+    template <Component... OwnedComponents>
+    size_t GetGroupSize()
+    {
+        const Group* group = FindGroup(GetSignatureFromComponents<OwnedComponents...>());
+        ASSUMERT(group != nullptr);
+        return group->size;
+    }
+
+    // Registers a persistent query and returns its handle. Registering the same components again returns the same handle.
+    // The matching entity sets are cached and only updated when a new signature first appears.
+    template <Component... SelectedComponents>
+    QueryHandle RegisterQuery()
+    {
+        return RegisterQuery(GetSignatureFromComponents<SelectedComponents...>());
     }
 
-    ComponentSignature& GetEntityComponentSignature(Entity entity)
+    // Entities matching a registered query. Does not allocate nor scan signatures.
+    EntityRange GetEntities(QueryHandle query)
     {
-        if (entity >= entitiesHaveComponents.size())
-            entitiesHaveComponents.resize(entity + 1);
+        ASSUMERT(query.index < queries.size());
+        return EntityRange(queries[query.index]->entitySets);
+    }
 
-        return entitiesHaveComponents[entity];
+    template <Component... SelectedComponents>
+    EntityRange GetEntitiesWithComponents()
+    {
+        return GetEntities(RegisterQuery<SelectedComponents...>());
     }
 
+  private:
     template <Component ComponentType>
-    constexpr size_t GetComponentTypeIndex(bool allowInvalid = false)
+    class DerivedComponentArray;
+    // Array of a possibly const component type.
+    template <Component ComponentType>
+    using ArrayOf = DerivedComponentArray<std::remove_const_t<ComponentType>>;
+
+  public:
+    // Range over entities that have all SelectedComponents, yielding std::tuple<Entity, ComponentReference<SelectedComponents>...>.
+    // Iterates the smallest of the component arrays and looks up the rest once per entity.
+    // Dereferencing marks the non-const SelectedComponents as changed.
+    template <Component... SelectedComponents>
+    class ComponentView
     {
-        size_t result = kInvalidTypeIndex;
-        size_t componentIndex = 0;
+      public:
+        static_assert(sizeof...(SelectedComponents) > 0);
 
-        const auto getResult = [&]<Component IteratedComponentType>()
+        using Value = std::tuple<Entity, ComponentReference<SelectedComponents>...>;
+
+        class Iterator
         {
-            if constexpr (std::is_same_v<IteratedComponentType, ComponentType>)
-                result = componentIndex;
+          public:
+            using value_type = Value;
+            using difference_type = std::ptrdiff_t;
+
+            Iterator() = default;
+            Iterator(const ComponentView* view, size_t position) : view(view), position(position) { SkipIncomplete(); }
 
-            ++componentIndex;
+            Value operator*() const
+            {
+                return [this]<size_t... Indices>(std::index_sequence<Indices...>)
+                { return Value(entity, Access<SelectedComponents>(std::get<Indices>(entries), view->tick)...); }(std::index_sequence_for<SelectedComponents...>{});
+            }
+
+            Iterator& operator++()
+            {
+                ++position;
+                SkipIncomplete();
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+
+            bool operator==(std::default_sentinel_t) const { return position >= view->drivingSize; }
+
+          private:
+            // Moves to the next entity that has all the selected components.
+            void SkipIncomplete()
+            {
+                for (; position < view->drivingSize; ++position)
+                {
+                    entity = view->drivingEntityAt(view->drivingArray, position);
+                    entries = std::apply([this](auto*... arrays) { return std::tuple(arrays->TryGetEntry(entity)...); }, view->arrays);
+                    if (std::apply([](const auto&... entries) { return ((entries.ticks != nullptr) && ...); }, entries))
+                        return;
+                }
+            }
+
+            const ComponentView* view = nullptr;
+            size_t position = 0;
+            Entity entity{};
+            std::tuple<typename ArrayOf<SelectedComponents>::Entry...> entries{};
         };
 
-        (getResult.template operator()<ComponentTypes>(), ...);
-        ASSUMERT(allowInvalid || result != kInvalidTypeIndex);
-        return result;
-    }
+        ComponentView(ComponentManager& componentManager)
+            : arrays(&componentManager.GetComponentArray<SelectedComponents>()...), tick(componentManager.GetCurrentTick())
+        {
+            const auto considerArray = [this]<typename ArrayType>(ArrayType* array)
+            {
+                if (array->size() >= drivingSize)
+                    return;
 
-    template <Component... SelectedComponentTypes>
-    constexpr ComponentSignature GetSignatureFromComponents()
+                drivingSize = array->size();
+                drivingArray = array;
+                drivingEntityAt = [](const void* array, size_t position) { return static_cast<const ArrayType*>(array)->GetIndexAt(position); };
+            };
+            std::apply([&](auto*... arrays) { (considerArray(arrays), ...); }, arrays);
+        }
+
+        Iterator begin() const { return Iterator(this, 0); }
+        std::default_sentinel_t end() const { return std::default_sentinel; }
+
+      private:
+        std::tuple<ArrayOf<SelectedComponents>*...> arrays;
+        Tick tick;
+        const void* drivingArray = nullptr;
+        Entity (*drivingEntityAt)(const void* array, size_t position) = nullptr;
+        size_t drivingSize = std::numeric_limits<size_t>::max();
+    };
+
+    template <Component... SelectedComponents>
+    ComponentView<SelectedComponents...> View()
     {
-        auto signature = ComponentSignature{};
-        ((signature[GetComponentTypeIndex<SelectedComponentTypes>()] = true), ...);
-        return signature;
+        return ComponentView<SelectedComponents...>(*this);
     }
 
-    // An array of component arrays.
-    std::array<std::unique_ptr<IComponentArray>, kComponentTypeCount> componentArrays;
-    // Tracks component signature to entities.
-    std::unordered_map<ComponentSignature, std::set<Entity>> signaturesHaveEntities;
-    // Tracks what components a specific entity has.
-    std::vector<ComponentSignature> entitiesHaveComponents;
-};
+    // Calls func(Entity, ComponentReference<SelectedComponents>...) for every entity that has all SelectedComponents and passes all filters.
+    // Like View, but the smallest component array is iterated directly without any type erasure.
+    // Non-const SelectedComponents are marked as changed, select const components for read-only access.
+    template <Component... SelectedComponents>
+    void Each(auto&& func, const ChangeFilter auto&... filters)
+    {
+        static_assert(sizeof...(SelectedComponents) > 0);
 
-class SystemManager
-{
-};
+        if (const Group* group = FindGroup(GetSignatureFromComponents<SelectedComponents...>()))
+        {
+            EachInGroup<SelectedComponents...>(func, 0, group->size, GetCurrentTick(), filters...);
+            return;
+        }
 
-template <concepts::InstantiatedFrom<ComponentManager> ComponentManagerType>
-class World
-{
-  public:
-    Entity NewEntity() { return entityManager.NewEntity(); }
-    void DeleteEntity(Entity entity)
-    {
-        componentManager.RemoveAllComponents(entity);
-        entityManager.DeleteEntity(entity);
+        const std::array<size_t, sizeof...(SelectedComponents)> sizes{GetComponentArray<SelectedComponents>().size()...};
+        const size_t drivingIndex = std::distance(sizes.begin(), std::ranges::min_element(sizes));
+
+        [&]<size_t... Indices>(std::index_sequence<Indices...>)
+        {
+            ((Indices == drivingIndex ? EachDrivenBy<std::tuple_element_t<Indices, std::tuple<SelectedComponents...>>, SelectedComponents...>(
+                                            func, 0, sizes[Indices], GetCurrentTick(), filters...)
+                                      : void()),
+             ...);
+        }(std::index_sequence_for<SelectedComponents...>{});
+    }
+
+    // Like Each, but the dense array of the smallest component array is split into ranges of about grainSize entities
+    // (rounded up to a multiple of a cache line's worth of elements) which are processed in parallel on the job system.
+    // func must only write components of the entity it is called with. Runs serially when there is no job system.
+    template <Component... SelectedComponents>
+    void ParallelForEach(auto&& func, size_t grainSize = kDefaultGrainSize, const ChangeFilter auto&... filters)
+    {
+        static_assert(sizeof...(SelectedComponents) > 0);
+
+        if (const Group* group = FindGroup(GetSignatureFromComponents<SelectedComponents...>()))
+        {
+            // Taken on this thread, the jobs run on others.
+            const Tick tick = GetCurrentTick();
+            ParallelRanges(
+                group->size,
+                grainSize,
+                std::max({kElementsPerCacheLine<SelectedComponents>...}),
+                [&](size_t begin, size_t end) { EachInGroup<SelectedComponents...>(func, begin, end, tick, filters...); });
+            return;
+        }
+
+        const std::array<size_t, sizeof...(SelectedComponents)> sizes{GetComponentArray<SelectedComponents>().size()...};
+        const size_t drivingIndex = std::distance(sizes.begin(), std::ranges::min_element(sizes));
+
+        [&]<size_t... Indices>(std::index_sequence<Indices...>)
+        {
+            ((Indices == drivingIndex
+                  ? ParallelEachDrivenBy<std::tuple_element_t<Indices, std::tuple<SelectedComponents...>>, SelectedComponents...>(func, grainSize, filters...)
+                  : void()),
+             ...);
+        }(std::index_sequence_for<SelectedComponents...>{});
+    }
+
+  private:
+    using ComponentSignature = std::bitset<kComponentTypeCount>;
+    static constexpr ComponentSignature kNullComponentSignature = ComponentSignature{};
+    static constexpr size_t kInvalidTypeIndex = std::numeric_limits<size_t>::max();
+    static constexpr size_t kCacheLineSize = 64;
+
+    struct IComponentArray
+    {
+      public:
+        virtual ~IComponentArray() = default;
+
+        // Moves ticks before oldestTick to oldestTick.
+        virtual void ClampTicks(Tick oldestTick) = 0;
+    };
+
+    template <Component ComponentType>
+    using SparseSetOf = std::conditional_t<SplitComponent<ComponentType>, SplitSparseSet<ComponentType, Entity>, SparseSet<ComponentType, Entity>>;
+
+    // Sparse set of components with their ticks in a vector parallel to the dense array.
+    template <Component ComponentType>
+    class DerivedComponentArray : public IComponentArray, public SparseSetOf<ComponentType>
+    {
+        using Base = SparseSetOf<ComponentType>;
+
+      public:
+        // Position of a component, empty when ticks is nullptr.
+        struct Entry
+        {
+            DerivedComponentArray* array = nullptr;
+            size_t denseIndex = 0;
+            ComponentTicks* ticks = nullptr;
+        };
+
+        // Smallest count of elements that fills whole cache lines in every dense array written by ParallelForEach, ticks included.
+        // A power of two, since the cache line size is.
+        static constexpr size_t kElementsPerCacheLine = []()
+        {
+            const auto elementsPerCacheLine = [](size_t elementSize) { return kCacheLineSize / std::gcd(kCacheLineSize, elementSize); };
+            size_t result = elementsPerCacheLine(sizeof(ComponentTicks));
+            if constexpr (SplitComponent<ComponentType>)
+            {
+                for (size_t fieldSize : Base::kFieldSizes)
+                    result = std::max(result, elementsPerCacheLine(fieldSize));
+            }
+            else
+                result = std::max(result, elementsPerCacheLine(sizeof(std::ranges::range_value_t<Base>)));
+            return result;
+        }();
+
+        explicit DerivedComponentArray(std::pmr::memory_resource* resource) : Base(resource), ticks(resource) {}
+        virtual ~DerivedComponentArray() = default;
+
+        void Add(Entity entity, ComponentType component, Tick tick)
+        {
+            Base::Add(entity, std::move(component));
+            ticks.push_back(ComponentTicks{.added = tick, .changed = tick});
+        }
+
+        void Add(std::span<const Entity> entities, const ComponentType& component, Tick tick)
+        {
+            Base::Add(entities, component);
+            ticks.resize(Base::size(), ComponentTicks{.added = tick, .changed = tick});
+        }
+
+        void Add(std::span<const Entity> entities, std::span<const ComponentType> components, Tick tick)
+        {
+            Base::Add(entities, components);
+            ticks.resize(Base::size(), ComponentTicks{.added = tick, .changed = tick});
+        }
+
+        void Remove(Entity entity)
+        {
+            ASSUMERT(Base::Contains(entity));
+            const size_t denseIndex = *Base::FindDenseIndex(entity);
+            Base::Remove(entity);
+            // Same swap with the last element as in the dense array.
+            ticks[denseIndex] = ticks.back();
+            ticks.pop_back();
+        }
+
+        void SwapAt(size_t firstDenseIndex, size_t secondDenseIndex)
+        {
+            Base::SwapAt(firstDenseIndex, secondDenseIndex);
+            std::swap(ticks[firstDenseIndex], ticks[secondDenseIndex]);
+        }
+
+        Entry GetEntryAt(size_t denseIndex) { return Entry{.array = this, .denseIndex = denseIndex, .ticks = &ticks[denseIndex]}; }
+
+        // Single sparse lookup, the Entry is empty when not contained.
+        Entry TryGetEntry(Entity entity)
+        {
+            const std::optional<size_t> denseIndex = Base::FindDenseIndex(entity);
+            return denseIndex ? GetEntryAt(*denseIndex) : Entry{};
+        }
+
+        const ComponentTicks& GetTicks(Entity entity) const
+        {
+            ASSUMERT(Base::Contains(entity));
+            return ticks[*Base::FindDenseIndex(entity)];
+        }
+
+        void MarkAllChanged(Tick tick)
+        {
+            for (ComponentTicks& componentTicks : ticks)
+                componentTicks.changed = tick;
+        }
+
+        void ClampTicks(Tick oldestTick) override
+        {
+            for (ComponentTicks& componentTicks : ticks)
+            {
+                if (IsNewerTick(oldestTick, componentTicks.added))
+                    componentTicks.added = oldestTick;
+                if (IsNewerTick(oldestTick, componentTicks.changed))
+                    componentTicks.changed = oldestTick;
+            }
+        }
+
+      private:
+        std::pmr::vector<ComponentTicks> ticks;
+    };
+
+    // Mutable access marks the component as changed, const access does not.
+    template <Component ComponentType>
+    static ComponentReference<ComponentType> Access(const typename ArrayOf<ComponentType>::Entry& entry, Tick tick)
+    {
+        if constexpr (!std::is_const_v<ComponentType>)
+            entry.ticks->changed = tick;
+        return entry.array->GetAt(entry.denseIndex);
+    }
+
+    struct Query
+    {
+        ComponentSignature signature;
+        // Sets of all signatures that contain the query signature.
+        EntityRange::InputRange entitySets;
+    };
+
+    // Queries are allocated one by one, so ranges into their sets survive the registration of more queries.
+    struct QueryDeleter
+    {
+        std::pmr::memory_resource* resource = nullptr;
+
+        void operator()(Query* query) const { std::pmr::polymorphic_allocator<>(resource).delete_object(query); }
+    };
+    using QueryPointer = std::unique_ptr<Query, QueryDeleter>;
+
+    static bool ContainsAll(const ComponentSignature& signature, const ComponentSignature& wantedSignature)
+    {
+        return (signature & wantedSignature) == wantedSignature;
+    }
+
+    QueryHandle RegisterQuery(const ComponentSignature& wantedSignature)
+    {
+        auto [iterator, inserted] = signaturesQueries.try_emplace(wantedSignature, queries.size());
+        if (inserted)
+        {
+            Query& query = *queries.emplace_back(
+                std::pmr::polymorphic_allocator<>(resource).new_object<Query>(Query{.signature = wantedSignature, .entitySets = EntityRange::InputRange(resource)}),
+                QueryDeleter{resource});
+            for (auto& [iteratedSignature, set] : signaturesHaveEntities)
+                if (ContainsAll(iteratedSignature, wantedSignature))
+                    query.entitySets.push_back(&set);
+        }
+
+        return QueryHandle{.index = iterator->second};
+    }
+
+    // Gets the entity set of a signature. Registered queries are updated when the signature is new.
+    std::pmr::set<Entity>& GetSignatureEntities(const ComponentSignature& signature)
+    {
+        auto [iterator, inserted] = signaturesHaveEntities.try_emplace(signature);
+        if (inserted)
+        {
+            for (const QueryPointer& query : queries)
+                if (ContainsAll(signature, query->signature))
+                    query->entitySets.push_back(&iterator->second);
+        }
+
+        return iterator->second;
+    }
+
+    // Calls func for the driving array's dense elements in [begin, end) that have all SelectedComponents and pass the filters.
+    template <Component DrivingComponent, Component... SelectedComponents>
+    void EachDrivenBy(auto& func, size_t begin, size_t end, Tick tick, const auto&... filters)
+    {
+        const std::tuple<ArrayOf<SelectedComponents>&...> arrays{GetComponentArray<SelectedComponents>()...};
+        ArrayOf<DrivingComponent>& drivingArray = GetComponentArray<DrivingComponent>();
+
+        for (size_t denseIndex = begin; denseIndex < end; ++denseIndex)
+        {
+            const Entity entity = drivingArray.GetIndexAt(denseIndex);
+            const auto getEntry = [&]<Component ComponentType>()
+            {
+                if constexpr (std::is_same_v<ArrayOf<ComponentType>, ArrayOf<DrivingComponent>>)
+                    return drivingArray.GetEntryAt(denseIndex);
+                else
+                    return std::get<ArrayOf<ComponentType>&>(arrays).TryGetEntry(entity);
+            };
+
+            const std::tuple<typename ArrayOf<SelectedComponents>::Entry...> entries{getEntry.template operator()<SelectedComponents>()...};
+            if (std::apply([](const auto&... entries) { return ((entries.ticks != nullptr) && ...); }, entries))
+                Visit<SelectedComponents...>(func, entity, entries, tick, filters...);
+        }
+    }
+
+    // Calls func for the group members at positions [begin, end), which are at the same position in every owned array.
+    template <Component... SelectedComponents>
+    void EachInGroup(auto& func, size_t begin, size_t end, Tick tick, const auto&... filters)
+    {
+        const std::tuple<ArrayOf<SelectedComponents>&...> arrays{GetComponentArray<SelectedComponents>()...};
+        const auto& firstArray = std::get<0>(arrays);
+
+        for (size_t denseIndex = begin; denseIndex < end; ++denseIndex)
+        {
+            const std::tuple<typename ArrayOf<SelectedComponents>::Entry...> entries{
+                std::get<ArrayOf<SelectedComponents>&>(arrays).GetEntryAt(denseIndex)...};
+            Visit<SelectedComponents...>(func, firstArray.GetIndexAt(denseIndex), entries, tick, filters...);
+        }
+    }
+
+    // Calls func with the entries of an entity that has all SelectedComponents, if it passes the filters.
+    template <Component... SelectedComponents>
+    void Visit(auto& func, Entity entity, const auto& entries, Tick tick, const auto&... filters)
+    {
+        const auto matches = [&]<ChangeFilter Filter>(const Filter& filter)
+        {
+            using FilteredComponent = typename Filter::ComponentType;
+            constexpr size_t selectedIndex = kComponentTypeIndex<FilteredComponent, std::remove_const_t<SelectedComponents>...>;
+            if constexpr (selectedIndex < sizeof...(SelectedComponents))
+                return filter.Matches(*std::get<selectedIndex>(entries).ticks);
+            else
+            {
+                const auto entry = GetComponentArray<FilteredComponent>().TryGetEntry(entity);
+                return entry.ticks != nullptr && filter.Matches(*entry.ticks);
+            }
+        };
+        if (!(matches(filters) && ...))
+            return;
+
+        [&]<size_t... Indices>(std::index_sequence<Indices...>)
+        { func(entity, Access<SelectedComponents>(std::get<Indices>(entries), tick)...); }(std::index_sequence_for<SelectedComponents...>{});
+    }
+
+    template <Component DrivingComponent, Component... SelectedComponents>
+    void ParallelEachDrivenBy(auto& func, size_t grainSize, const auto&... filters)
+    {
+        // Taken on this thread, the jobs run on others.
+        const Tick tick = GetCurrentTick();
+        ParallelRanges(
+            GetComponentArray<DrivingComponent>().size(),
+            grainSize,
+            kElementsPerCacheLine<DrivingComponent>,
+            [&](size_t begin, size_t end) { EachDrivenBy<DrivingComponent, SelectedComponents...>(func, begin, end, tick, filters...); });
+    }
+
+    template <Component ComponentType>
+    static constexpr size_t kElementsPerCacheLine = ArrayOf<ComponentType>::kElementsPerCacheLine;
+
+    // Calls rangeFunc(begin, end) for ranges of [0, count) on the job system, serially when there is none.
+    // The grain is rounded up to a multiple of elementsPerCacheLine. The dense arrays start on a cache line (see arrayResource),
+    // so every range starts on one too and jobs writing their own range never share a line.
+    // Components of the other selected types are only contiguous in owning groups.
+    void ParallelRanges(size_t count, size_t grainSize, size_t elementsPerCacheLine, const std::function<void(size_t begin, size_t end)>& rangeFunc)
+    {
+        if (!Singleton<jobs::JobSystem>::IsInitialized() || count <= grainSize)
+        {
+            rangeFunc(0, count);
+            return;
+        }
+
+        grainSize = (std::max<size_t>(1, grainSize) + elementsPerCacheLine - 1) / elementsPerCacheLine * elementsPerCacheLine;
+        Singleton<jobs::JobSystem>::Get().ParallelFor(count, grainSize, rangeFunc);
+    }
+
+    struct Group
+    {
+        ComponentSignature signature;
+        // Count of members, they occupy the front of every owned array.
+        size_t size = 0;
+    };
+
+    Group* FindGroup(const ComponentSignature& signature)
+    {
+        const auto found = std::ranges::find(groups, signature, &Group::signature);
+        return found == groups.end() ? nullptr : &*found;
+    }
+
+    // Moves the entity to position denseIndex in every owned array of the group.
+    void MoveInGroup(const Group& group, Entity entity, size_t denseIndex)
+    {
+        size_t typeIndex = 0;
+        const auto move = [&]<Component ComponentType>()
+        {
+            if (group.signature[typeIndex++])
+            {
+                ArrayOf<ComponentType>& array = GetComponentArray<ComponentType>();
+                array.SwapAt(*array.FindDenseIndex(entity), denseIndex);
+            }
+        };
+        (move.template operator()<ComponentTypes>(), ...);
+    }
+
+    void EnterGroup(Group& group, Entity entity) { MoveInGroup(group, entity, group.size++); }
+    void LeaveGroup(Group& group, Entity entity) { MoveInGroup(group, entity, --group.size); }
+
+    // Called after the components were added.
+    void EnterGroups(Entity entity, const ComponentSignature& oldSignature, const ComponentSignature& newSignature)
+    {
+        for (Group& group : groups)
+            if (!ContainsAll(oldSignature, group.signature) && ContainsAll(newSignature, group.signature))
+                EnterGroup(group, entity);
+    }
+
+    // Called before the components are removed.
+    void LeaveGroups(Entity entity, const ComponentSignature& oldSignature, const ComponentSignature& newSignature)
+    {
+        for (Group& group : groups)
+            if (ContainsAll(oldSignature, group.signature) && !ContainsAll(newSignature, group.signature))
+                LeaveGroup(group, entity);
+    }
+
+    // Sets the signature of entities without components and inserts them into its set in one go.
+    void SetSignature(std::span<const Entity> entities, const ComponentSignature& signature)
+    {
+        for (const Entity entity : entities)
+        {
+            ASSUMERT(GetEntityComponentSignature(entity) == kNullComponentSignature);
+            entitiesHaveComponents.Set(entity, signature);
+            EnterGroups(entity, kNullComponentSignature, signature);
+        }
+        GetSignatureEntities(signature).insert(entities.begin(), entities.end());
+    }
+
+    template <Component ComponentType>
+    void InitComponent()
+    {
+        auto typeIndex = GetComponentTypeIndex<ComponentType>();
+        ASSUMERT(!componentArrays[typeIndex] && "Components must be unique.");
+        auto derived = std::make_unique<DerivedComponentArray<ComponentType>>(arrayResource.get());
+        auto base = static_cast<IComponentArray*>(derived.release());
+        componentArrays[typeIndex] = std::unique_ptr<IComponentArray>(base);
+    }
+
+    template <Component ComponentType>
+    ArrayOf<ComponentType>& GetComponentArray()
+    {
+        auto typeIndex = GetComponentTypeIndex<ComponentType>();
+        return *static_cast<ArrayOf<ComponentType>*>(componentArrays[typeIndex].get());
+    }
+
+    template <Component ComponentType>
+    const ArrayOf<ComponentType>& GetComponentArray() const
+    {
+        auto typeIndex = GetComponentTypeIndex<ComponentType>();
+        return *static_cast<const ArrayOf<ComponentType>*>(componentArrays[typeIndex].get());
+    }
+
+    const ComponentSignature& GetEntityComponentSignature(Entity entity) const { return entitiesHaveComponents.Get(entity); }
+
+    template <Component ComponentType>
+    static constexpr size_t GetComponentTypeIndex(bool allowInvalid = false)
+    {
+        constexpr size_t result = kComponentTypeIndex<ComponentType, ComponentTypes...>;
+        ASSUMERT(allowInvalid || result != kInvalidTypeIndex);
+        return result;
+    }
+
+    template <Component... SelectedComponentTypes>
+    constexpr ComponentSignature GetSignatureFromComponents()
+    {
+        auto signature = ComponentSignature{};
+        ((signature[GetComponentTypeIndex<SelectedComponentTypes>()] = true), ...);
+        return signature;
+    }
+
+    std::pmr::memory_resource* resource;
+    // Behind a pointer so the sets keep their resource and the manager stays movable.
+    std::unique_ptr<memory::BlockPool> nodePool;
+    // Cache line aligned resource on top of resource for the component arrays, behind a pointer for the same reason.
+    std::unique_ptr<memory::AlignedResource> arrayResource;
+    // An array of component arrays.
+    std::array<std::unique_ptr<IComponentArray>, kComponentTypeCount> componentArrays;
+    // Tracks component signature to entities.
+    std::pmr::unordered_map<ComponentSignature, std::pmr::set<Entity>> signaturesHaveEntities;
+    // Tracks what components a specific entity has. Paged, so entities without components cost no memory.
+    PagedArray<ComponentSignature> entitiesHaveComponents;
+    // Registered queries and their lookup by signature.
+    std::pmr::vector<QueryPointer> queries;
+    std::pmr::unordered_map<ComponentSignature, size_t> signaturesQueries;
+    // Owning groups, see RegisterGroup.
+    std::pmr::vector<Group> groups;
+};
+
+// Component types a system only reads.
+template <Component... ComponentTypes>
+struct Reads
+{
+};
+
+// Component types a system modifies.
+template <Component... ComponentTypes>
+struct Writes
+{
+};
+
+// Runs systems according to the component types they access.
+// Systems conflict when one writes a component type the other reads or writes.
+// Conflicting systems run in the order they were added, others may run concurrently on the job system.
+// Concurrently running systems must not change the structure of the storage (add/remove components, query registration),
+// use View/Each or pre-registered queries. Structural changes belong to exclusive systems.
+// Every system run gets its own change tick, see TickSource::SystemScope.
+template <ComponentStorage ComponentManagerType>
+class SystemManager
+{
+  public:
+    using System = std::function<void(ComponentManagerType&)>;
+
+    enum class ExecutionMode
+    {
+        // Runs on the job system when it is initialized, serially otherwise.
+        Parallel,
+        // Deterministic, runs systems one by one in the order they were added. Useful for debugging.
+        Serial,
+    };
+
+    SystemManager() = default;
+
+    SystemManager(const SystemManager&) = delete;
+    SystemManager& operator=(const SystemManager&) = delete;
+
+    template <Component... ReadTypes, Component... WriteTypes>
+    void AddSystem(std::string name, Reads<ReadTypes...>, Writes<WriteTypes...>, System system)
+    {
+        AccessSignature reads{};
+        AccessSignature writes{};
+        ((reads[ComponentManagerType::template kTypeIndex<ReadTypes>] = true), ...);
+        ((writes[ComponentManagerType::template kTypeIndex<WriteTypes>] = true), ...);
+        systems.push_back(SystemData{.name = std::move(name), .reads = reads, .writes = writes, .exclusive = false, .system = std::move(system)});
+        graphDirty = true;
+    }
+
+    // Exclusive systems conflict with every other system, so they may change the structure of the storage.
+    void AddExclusiveSystem(std::string name, System system)
+    {
+        systems.push_back(SystemData{.name = std::move(name), .exclusive = true, .system = std::move(system)});
+        graphDirty = true;
+    }
+
+    void SetExecutionMode(ExecutionMode mode) { executionMode = mode; }
+    ExecutionMode GetExecutionMode() const { return executionMode; }
+
+    // Runs every system once. Rethrows the first exception thrown by a system after all systems finished.
+    void Run(ComponentManagerType& componentManager)
+    {
+        if (graphDirty)
+            BuildGraph();
+
+        if (executionMode == ExecutionMode::Serial || !Singleton<jobs::JobSystem>::IsInitialized())
+        {
+            // Registration order is always a valid topological order.
+            for (SystemData& systemData : systems)
+                RunSystem(systemData, componentManager);
+            // Writes between runs are newer than every system's last run.
+            componentManager.AdvanceTick();
+            return;
+        }
+
+        jobs::JobSystem& jobSystem = Singleton<jobs::JobSystem>::Get();
+        currentComponentManager = &componentManager;
+        firstException = nullptr;
+        for (size_t systemIndex = 0; systemIndex < systems.size(); ++systemIndex)
+            remainingDependencies[systemIndex].store(systems[systemIndex].dependencyCount, std::memory_order_relaxed);
+
+        jobs::Counter counter{};
+        for (size_t systemIndex = 0; systemIndex < systems.size(); ++systemIndex)
+            if (systems[systemIndex].dependencyCount == 0)
+                ScheduleSystem(jobSystem, systemIndex, counter);
+
+        // Dependents are scheduled by the systems they wait for, before those finish, so the counter covers them too.
+        jobSystem.Wait(counter);
+
+        currentComponentManager = nullptr;
+        componentManager.AdvanceTick();
+        if (firstException)
+            std::rethrow_exception(firstException);
+    }
+
+  private:
+    using AccessSignature = std::bitset<ComponentManagerType::kComponentTypeCount>;
+
+    struct SystemData
+    {
+        std::string name;
+        AccessSignature reads{};
+        AccessSignature writes{};
+        bool exclusive = false;
+        System system;
+        // Tick of the previous run, 0 before the first one.
+        Tick lastRunTick = 0;
+        // Systems that must wait for this one.
+        std::vector<size_t> dependents{};
+        size_t dependencyCount = 0;
+    };
+
+    static bool Conflicts(const SystemData& first, const SystemData& second)
+    {
+        if (first.exclusive || second.exclusive)
+            return true;
+
+        return (first.writes & (second.reads | second.writes)).any() || (second.writes & first.reads).any();
+    }
+
+    // Builds the dependency DAG. Edges only go from earlier to later added systems.
+    void BuildGraph()
+    {
+        for (SystemData& systemData : systems)
+        {
+            systemData.dependents.clear();
+            systemData.dependencyCount = 0;
+        }
+
+        for (size_t later = 0; later < systems.size(); ++later)
+            for (size_t earlier = 0; earlier < later; ++earlier)
+                if (Conflicts(systems[earlier], systems[later]))
+                {
+                    systems[earlier].dependents.push_back(later);
+                    ++systems[later].dependencyCount;
+                }
+
+        remainingDependencies = std::make_unique<std::atomic<size_t>[]>(systems.size());
+        graphDirty = false;
+    }
+
+    // Runs the system with a new tick, which its writes are stamped with. Its filters see everything written since its
+    // previous run, including the writes of systems that ran after it in the previous frame.
+    static void RunSystem(SystemData& systemData, ComponentManagerType& componentManager)
+    {
+        const Tick tick = componentManager.AdvanceTick();
+        {
+            const typename ComponentManagerType::SystemScope scope(componentManager, tick, systemData.lastRunTick);
+            systemData.system(componentManager);
+        }
+        systemData.lastRunTick = tick;
+    }
+
+    void ScheduleSystem(jobs::JobSystem& jobSystem, size_t systemIndex, jobs::Counter& counter)
+    {
+        jobSystem.Schedule(
+            [this, &jobSystem, &counter, systemIndex]()
+            {
+                try
+                {
+                    RunSystem(systems[systemIndex], *currentComponentManager);
+                }
+                catch (...)
+                {
+                    std::scoped_lock lock(exceptionMutex);
+                    if (!firstException)
+                        firstException = std::current_exception();
+                }
+
+                for (size_t dependent : systems[systemIndex].dependents)
+                    if (remainingDependencies[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                        ScheduleSystem(jobSystem, dependent, counter);
+            },
+            &counter);
+    }
+
+    std::vector<SystemData> systems{};
+    bool graphDirty = false;
+    ExecutionMode executionMode = ExecutionMode::Parallel;
+
+    // State of the current run.
+    std::unique_ptr<std::atomic<size_t>[]> remainingDependencies{};
+    ComponentManagerType* currentComponentManager = nullptr;
+    std::mutex exceptionMutex{};
+    std::exception_ptr firstException = nullptr;
+};
+
+template <ComponentStorage ComponentManagerType>
+class World;
+
+// Records structural changes (entity creation/destruction, adding/removing components) to apply them later
+// with World::PlaybackCommands, e.g. while iterating or from systems running in parallel.
+// Recording is thread-safe, every thread writes to its own buffer. Playback must not overlap with recording.
+template <ComponentStorage ComponentManagerType>
+class CommandBuffer
+{
+  public:
+    CommandBuffer() = default;
+
+    CommandBuffer(const CommandBuffer&) = delete;
+    CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+    // Returns a placeholder that can be used in further commands of this buffer.
+    // The real entity is created on playback.
+    Entity CreateEntity()
+    {
+        ThreadBuffer& threadBuffer = GetThreadBuffer();
+        ASSUMERT(threadBuffer.createdCount <= kPendingLocalMask);
+        return kPendingEntityFlag | (threadBuffer.index << kPendingBufferShift) | threadBuffer.createdCount++;
+    }
+
+    void DestroyEntity(Entity entity) { GetThreadBuffer().commands.push_back(Command{.entity = entity, .type = CommandType::DestroyEntity}); }
+
+    template <Component ComponentType>
+    void AddComponent(Entity entity, ComponentType&& component)
+    {
+        ThreadBuffer& threadBuffer = GetThreadBuffer();
+        ComponentColumn<ComponentType>& column = GetColumn<ComponentType>(threadBuffer);
+        threadBuffer.commands.push_back(Command{
+            .entity = entity,
+            .type = CommandType::AddComponent,
+            .typeIndex = ComponentManagerType::template kTypeIndex<ComponentType>,
+            .column = &column,
+            .componentIndex = column.components.size(),
+        });
+        column.components.push_back(std::move(component));
+    }
+
+    template <Component ComponentType>
+    void RemoveComponent(Entity entity)
+    {
+        ThreadBuffer& threadBuffer = GetThreadBuffer();
+        threadBuffer.commands.push_back(Command{
+            .entity = entity,
+            .type = CommandType::RemoveComponent,
+            .typeIndex = ComponentManagerType::template kTypeIndex<ComponentType>,
+            .column = &GetColumn<ComponentType>(threadBuffer),
+        });
+    }
+
+    bool IsEmpty() const
+    {
+        std::scoped_lock lock(threadBuffersMutex);
+        return std::ranges::all_of(threadBuffers, [](const auto& threadBuffer) { return threadBuffer->commands.empty() && threadBuffer->createdCount == 0; });
+    }
+
+  private:
+    friend class World<ComponentManagerType>;
+
+    // Placeholder entities: flag | thread buffer index | index of the creation within the thread buffer.
+    static constexpr Entity kPendingEntityFlag = EntityManager::kEntityLimit;
+    static constexpr Entity kPendingBufferShift = 24;
+    static constexpr Entity kPendingLocalMask = (Entity{1} << kPendingBufferShift) - 1;
+    static constexpr Entity kMaxThreadBufferCount = kPendingEntityFlag >> kPendingBufferShift;
+
+    enum class CommandType : std::uint8_t
+    {
+        DestroyEntity,
+        AddComponent,
+        RemoveComponent,
+    };
+
+    // Added components of one type, stored by value in their own array instead of in a closure per command.
+    // Also knows how to apply the add and remove commands of its type to the component arrays, see ComponentManager::ChangeSignatures.
+    class ComponentColumnBase
+    {
+      public:
+        virtual ~ComponentColumnBase() = default;
+
+        virtual void Apply(ComponentManagerType& componentManager, CommandType type, Entity entity, size_t componentIndex) = 0;
+        virtual void Clear() = 0;
+    };
+
+    template <Component ComponentType>
+    class ComponentColumn final : public ComponentColumnBase
+    {
+      public:
+        void Apply(ComponentManagerType& componentManager, CommandType type, Entity entity, size_t componentIndex) override
+        {
+            if (type == CommandType::AddComponent)
+                componentManager.StoreComponent(entity, std::move(components[componentIndex]));
+            else
+                componentManager.template EraseComponent<ComponentType>(entity);
+        }
+
+        void Clear() override { components.clear(); }
+
+        std::vector<ComponentType> components{};
+    };
+
+    struct Command
+    {
+        Entity entity;
+        CommandType type;
+        size_t typeIndex = 0;
+        // Null for DestroyEntity.
+        ComponentColumnBase* column = nullptr;
+        // Position of the added component in column.
+        size_t componentIndex = 0;
+    };
+
+    struct ThreadBuffer
+    {
+        Entity index;
+        Entity createdCount = 0;
+        std::vector<Command> commands{};
+        // Indexed by component type index, created on first use.
+        std::array<std::unique_ptr<ComponentColumnBase>, ComponentManagerType::kComponentTypeCount> columns{};
+    };
+
+    template <Component ComponentType>
+    static ComponentColumn<ComponentType>& GetColumn(ThreadBuffer& threadBuffer)
+    {
+        std::unique_ptr<ComponentColumnBase>& column = threadBuffer.columns[ComponentManagerType::template kTypeIndex<ComponentType>];
+        if (!column)
+            column = std::make_unique<ComponentColumn<ComponentType>>();
+        return static_cast<ComponentColumn<ComponentType>&>(*column);
+    }
+
+    ThreadBuffer& GetThreadBuffer()
+    {
+        // Remembers the last used buffer, so recording usually does not lock.
+        thread_local struct
+        {
+            std::uint64_t commandBufferId = 0;
+            ThreadBuffer* threadBuffer = nullptr;
+        } cache{};
+        if (cache.commandBufferId == id)
+            return *cache.threadBuffer;
+
+        std::scoped_lock lock(threadBuffersMutex);
+        auto [iterator, inserted] = threadBufferIndexes.try_emplace(std::this_thread::get_id(), threadBuffers.size());
+        if (inserted)
+        {
+            ASSUMERT(threadBuffers.size() < kMaxThreadBufferCount);
+            threadBuffers.push_back(std::make_unique<ThreadBuffer>(ThreadBuffer{.index = static_cast<Entity>(threadBuffers.size())}));
+        }
+
+        cache = {.commandBufferId = id, .threadBuffer = threadBuffers[iterator->second].get()};
+        return *cache.threadBuffer;
+    }
+
+    // Thread buffers are kept, so cached pointers stay valid.
+    void Clear()
+    {
+        for (const std::unique_ptr<ThreadBuffer>& threadBuffer : threadBuffers)
+        {
+            threadBuffer->commands.clear();
+            threadBuffer->createdCount = 0;
+            for (const std::unique_ptr<ComponentColumnBase>& column : threadBuffer->columns)
+                if (column)
+                    column->Clear();
+        }
+    }
+
+    inline static std::atomic<std::uint64_t> nextId{1};
+
+    const std::uint64_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+    mutable std::mutex threadBuffersMutex{};
+    std::unordered_map<std::thread::id, size_t> threadBufferIndexes{};
+    std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers{};
+};
+
+template <ComponentStorage ComponentManagerType>
+class World
+{
+  public:
+    World() = default;
+
+    // Entities and components are stored in memory from resource. Transient vectors, e.g. of command playback,
+    // come from scratch, like a memory::FrameArena that is reset every frame. Both must outlive the world.
+    World(std::pmr::memory_resource* resource, std::pmr::memory_resource* scratch)
+        requires std::constructible_from<ComponentManagerType, std::pmr::memory_resource*>
+        : entityManager(resource), componentManager(resource), scratch(scratch)
+    {
+    }
+
+    Entity NewEntity() { return entityManager.NewEntity(); }
+    void DeleteEntity(Entity entity)
+    {
+        componentManager.RemoveAllComponents(entity);
+        entityManager.DeleteEntity(entity);
+    }
+
+    // Creates count entities that all get a copy of components.
+    template <Component... SelectedComponents>
+    std::vector<Entity> CreateEntities(size_t count, const SelectedComponents&... components)
+    {
+        std::vector<Entity> entities = entityManager.NewEntities(count);
+        if constexpr (sizeof...(SelectedComponents) > 0)
+            componentManager.AddComponents(std::span<const Entity>(entities), components...);
+        return entities;
+    }
+
+    void DestroyEntities(std::span<const Entity> entities)
+    {
+        componentManager.RemoveAllComponents(entities);
+        entityManager.DeleteEntities(entities);
+    }
+
+    // Creates count entities with copies of all components of prototype.
+    std::vector<Entity> CloneEntity(Entity prototype, size_t count)
+    {
+        ASSUMERT(IsAlive(prototype));
+        std::vector<Entity> clones = entityManager.NewEntities(count);
+        componentManager.CloneComponents(prototype, clones);
+        return clones;
+    }
+
+    EntityHandle GetHandle(Entity entity) const { return entityManager.GetHandle(entity); }
+    const EntityManager& GetEntityManager() const { return entityManager; }
+    // Replaces all entities, see EntityManager::RestoreGenerations. The world must not have any components yet.
+    void RestoreEntities(std::span<const std::uint32_t> generations) { entityManager.RestoreGenerations(generations); }
+    // Sets the generations of some entities. Those that were alive lose their components.
+    void RestoreEntities(std::span<const Entity> entities, std::span<const std::uint32_t> generations)
+    {
+        std::pmr::vector<Entity> aliveEntities(scratch);
+        std::ranges::copy_if(entities, std::back_inserter(aliveEntities), [this](Entity entity) { return IsAlive(entity); });
+        componentManager.RemoveAllComponents(aliveEntities);
+        entityManager.RestoreGenerations(entities, generations);
+    }
+
+    bool IsAlive(Entity entity) const { return entityManager.IsAlive(entity); }
+    bool IsAlive(EntityHandle handle) const { return entityManager.IsAlive(handle); }
+
+    template <Component... SelectedComponents>
+    auto View()
+    {
+        return componentManager.template View<SelectedComponents...>();
+    }
+
+    template <Component... SelectedComponents>
+    void Each(auto&& func, const auto&... filters)
+    {
+        componentManager.template Each<SelectedComponents...>(std::forward<decltype(func)>(func), filters...);
+    }
+
+    template <Component... SelectedComponents>
+    void ParallelForEach(auto&& func, size_t grainSize = ComponentManagerType::kDefaultGrainSize, const auto&... filters)
+    {
+        componentManager.template ParallelForEach<SelectedComponents...>(std::forward<decltype(func)>(func), grainSize, filters...);
     }
 
     auto& GetComponentManager() { return componentManager; }
     const auto& GetComponentManager() const { return componentManager; }
 
+    auto& GetSystemManager() { return systemManager; }
+    void RunSystems() { systemManager.Run(componentManager); }
+
+    // Applies and clears the recorded commands. Commands of an entity run in recording order (per thread), only the last
+    // command per component type matters. Entities are processed in groups of exactly the same resulting signature:
+    // the component data is applied per entity and each group enters its new signature set in one insertion, see
+    // ComponentManager::ChangeSignatures. Entities created and destroyed by the buffer are handled in one batch each.
+    void PlaybackCommands(CommandBuffer<ComponentManagerType>& commandBuffer)
+    {
+        using Buffer = CommandBuffer<ComponentManagerType>;
+        using Command = typename Buffer::Command;
+
+        // Real entities for the placeholders, in one batch.
+        std::pmr::vector<size_t> createdOffsets(scratch);
+        size_t createdCount = 0;
+        for (const auto& threadBuffer : commandBuffer.threadBuffers)
+        {
+            createdOffsets.push_back(createdCount);
+            createdCount += threadBuffer->createdCount;
+        }
+        std::pmr::vector<Entity> createdEntities(scratch);
+        entityManager.NewEntities(createdCount, createdEntities);
+
+        std::pmr::vector<Command> commands(scratch);
+        for (const auto& threadBuffer : commandBuffer.threadBuffers)
+            for (Command& command : threadBuffer->commands)
+            {
+                if (command.entity & Buffer::kPendingEntityFlag)
+                {
+                    const size_t bufferIndex = (command.entity & ~Buffer::kPendingEntityFlag) >> Buffer::kPendingBufferShift;
+                    command.entity = createdEntities[createdOffsets[bufferIndex] + (command.entity & Buffer::kPendingLocalMask)];
+                }
+                commands.push_back(std::move(command));
+            }
+
+        std::ranges::stable_sort(commands, {}, &Command::entity);
+
+        using Signature = decltype(componentManager.GetSignature(Entity{}));
+        struct EntityCommands
+        {
+            size_t groupIndex;
+            std::span<Command> commands;
+        };
+
+        // Destroyed entities skip their other commands.
+        std::pmr::vector<Entity> destroyedEntities(scratch);
+        std::pmr::vector<EntityCommands> changedEntities(scratch);
+        // Groups are numbered by the first appearance of their target signature.
+        std::pmr::unordered_map<Signature, size_t> groupIndexes(scratch);
+        for (auto begin = commands.begin(); begin != commands.end();)
+        {
+            const Entity entity = begin->entity;
+            const auto end = std::find_if(begin, commands.end(), [&](const Command& command) { return command.entity != entity; });
+            const std::span<Command> entityCommands(begin, end);
+
+            if (std::ranges::any_of(entityCommands, [](const Command& command) { return command.type == Buffer::CommandType::DestroyEntity; }))
+                destroyedEntities.push_back(entity);
+            else
+            {
+                Signature targetSignature = componentManager.GetSignature(entity);
+                for (const Command& command : entityCommands)
+                    targetSignature[command.typeIndex] = command.type == Buffer::CommandType::AddComponent;
+                const size_t groupIndex = groupIndexes.try_emplace(targetSignature, groupIndexes.size()).first->second;
+                changedEntities.push_back(EntityCommands{.groupIndex = groupIndex, .commands = entityCommands});
+            }
+            begin = end;
+        }
+
+        // Equal signatures end up next to each other and stay sorted by entity.
+        std::ranges::stable_sort(changedEntities, {}, &EntityCommands::groupIndex);
+        std::pmr::vector<Signature> groupSignatures(groupIndexes.size(), scratch);
+        for (const auto& [signature, groupIndex] : groupIndexes)
+            groupSignatures[groupIndex] = signature;
+
+        std::pmr::vector<Entity> groupEntities(scratch);
+        for (auto groupBegin = changedEntities.begin(); groupBegin != changedEntities.end();)
+        {
+            const size_t groupIndex = groupBegin->groupIndex;
+            const auto groupEnd = std::find_if(
+                groupBegin, changedEntities.end(), [&](const EntityCommands& entityCommands) { return entityCommands.groupIndex != groupIndex; });
+
+            groupEntities.clear();
+            for (auto iterator = groupBegin; iterator != groupEnd; ++iterator)
+                groupEntities.push_back(iterator->commands.front().entity);
+
+            // Called in the order of groupEntities.
+            auto next = groupBegin;
+            componentManager.ChangeSignatures(
+                groupEntities,
+                groupSignatures[groupIndex],
+                [&](Entity entity)
+                {
+                    ASSUMERT(IsAlive(entity) && next->commands.front().entity == entity);
+                    // Earlier commands of a type are superseded, e.g. a component added and removed again is never stored.
+                    std::array<Command*, ComponentManagerType::kComponentTypeCount> lastCommands{};
+                    for (Command& command : next->commands)
+                        lastCommands[command.typeIndex] = &command;
+                    for (Command* command : lastCommands)
+                        if (command)
+                            command->column->Apply(componentManager, command->type, command->entity, command->componentIndex);
+                    ++next;
+                });
+
+            groupBegin = groupEnd;
+        }
+
+        // Only now, the added components are moved out of the columns above.
+        commandBuffer.Clear();
+        DestroyEntities(destroyedEntities);
+    }
+
   private:
     EntityManager entityManager{};
     ComponentManagerType componentManager{};
-    SystemManager systemManager{};
+    SystemManager<ComponentManagerType> systemManager{};
+    std::pmr::memory_resource* scratch = std::pmr::get_default_resource();
 };
 
 };  // namespace ecs
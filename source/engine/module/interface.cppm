@@ -4,9 +4,21 @@ export module tektonik;
 // Feel free to import only needed modules instead of this one.
 
 export import app;
+export import archetype;
+export import assets;
+export import collision;
 export import components;
+export import delta;
 export import ecs;
+export import jobs;
 export import logger;
+export import memory;
+export import render_batch;
+export import renderer;
 export import runtime;
 export import singleton;
+export import snapshot;
+export import spatial;
+export import string_table;
+export import transform;
 export import util;
@@ -0,0 +1,125 @@
+module;
+#include "common-defines.hpp"
+export module jobs;
+
+import std;
+
+export namespace tektonik::jobs
+{
+
+// Counts unfinished jobs scheduled with it. Must outlive those jobs.
+// Keeps the first exception thrown by one of them, JobSystem::Wait rethrows it.
+class Counter
+{
+  public:
+    Counter() = default;
+    Counter(const Counter&) = delete;
+    Counter& operator=(const Counter&) = delete;
+
+    bool IsDone() const { return value.load(std::memory_order_acquire) == 0; }
+
+  private:
+    friend class JobSystem;
+
+    std::atomic<std::uint32_t> value{0};
+    std::mutex exceptionMutex{};
+    std::exception_ptr firstException = nullptr;
+};
+
+struct Job
+{
+    std::function<void()> function;
+    Counter* counter = nullptr;
+};
+
+// Lock-free work-stealing deque by Chase and Lev, with a fixed power of two capacity.
+// Only the owning thread may Push and Pop (at the bottom), any thread may Steal (from the top).
+class WorkStealingDeque
+{
+  public:
+    WorkStealingDeque(std::size_t capacity = 4096);
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // Returns false when the deque is full.
+    bool Push(Job* job);
+    Job* Pop();
+    Job* Steal();
+
+  private:
+    std::unique_ptr<std::atomic<Job*>[]> buffer;
+    std::int64_t mask;
+    alignas(64) std::atomic<std::int64_t> top{0};
+    alignas(64) std::atomic<std::int64_t> bottom{0};
+};
+
+// Pool of worker threads, each with its own work-stealing deque. The main thread also owns a deque,
+// it executes jobs while it waits. Jobs that must run on the main thread (e.g. SDL calls) have a separate queue.
+class JobSystem
+{
+  public:
+    // Must be constructed on the main thread. Starts as many workers as the JobWorkerCount config variable asks for.
+    JobSystem();
+    explicit JobSystem(std::uint32_t workerCount);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // The counter (if any) is incremented immediately and decremented once the job finishes.
+    // Exceptions of jobs without a counter are only logged.
+    void Schedule(std::function<void()> function, Counter* counter = nullptr);
+    // The job is run by the main thread in PumpMainThread or while it waits.
+    void ScheduleOnMainThread(std::function<void()> function, Counter* counter = nullptr);
+
+    // Blocks until the counter is done. The waiting thread executes other jobs in the meantime.
+    // Rethrows the first exception thrown by a job of the counter, once all of them finished.
+    void Wait(Counter& counter);
+
+    // Runs the jobs scheduled for the main thread. Must be called from the main thread.
+    void PumpMainThread();
+
+    // Calls func(begin, end) on ranges of at most grainSize elements in parallel and waits for all of them.
+    // Rethrows the first exception thrown by func.
+    void ParallelFor(std::size_t count, std::size_t grainSize, const std::function<void(std::size_t begin, std::size_t end)>& func);
+
+    std::size_t GetWorkerCount() const { return workers.size(); }
+    // Workers and the main thread, which may all execute jobs.
+    std::size_t GetThreadCount() const { return deques.size(); }
+    // 0 on the main thread, 1 to GetWorkerCount() on workers, std::nullopt on other threads.
+    // Lets jobs use per-thread resources without locking.
+    std::optional<std::size_t> GetThreadIndex() const;
+    bool IsMainThread() const { return std::this_thread::get_id() == mainThreadId; }
+
+  private:
+    static constexpr std::size_t kNotAWorker = std::numeric_limits<std::size_t>::max();
+
+    void WorkerLoop(std::stop_token stopToken, std::size_t dequeIndex);
+    // Index of the deque owned by the calling thread or kNotAWorker.
+    std::size_t GetOwnDequeIndex() const;
+    Job* FindJob(std::size_t ownDequeIndex);
+    void Execute(Job* job);
+    void Enqueue(Job* job);
+
+    const std::thread::id mainThreadId = std::this_thread::get_id();
+    // Index 0 is owned by the main thread, the rest by workers.
+    std::vector<std::unique_ptr<WorkStealingDeque>> deques{};
+
+    // Jobs scheduled from threads without a deque, or when their deque was full.
+    std::mutex injectedMutex{};
+    std::deque<Job*> injectedJobs{};
+    // Size of injectedJobs, changed under injectedMutex. Lets FindJob skip the lock while nothing was injected.
+    std::atomic<std::size_t> injectedCount{0};
+
+    std::mutex mainThreadMutex{};
+    std::deque<Job*> mainThreadJobs{};
+
+    // Bumped on every new job, sleeping workers wait for it to change.
+    std::atomic<std::uint32_t> workEpoch{0};
+
+    // Must be last, so workers are joined before anything else is destroyed.
+    std::vector<std::jthread> workers{};
+};
+
+}  // namespace tektonik::jobs
@@ -0,0 +1,121 @@
+module;
+#include "common-defines.hpp"
+export module memory;
+
+import std;
+
+// Memory resources for std::pmr containers, so hot paths do not go through the global heap.
+// They are not thread safe, every thread needs its own.
+export namespace tektonik::memory
+{
+
+// Bump allocator for memory that lives until the end of a frame. Deallocation does nothing, Reset frees everything at once.
+// Unlike std::pmr::monotonic_buffer_resource it keeps its memory on Reset and merges the blocks it had to add into one,
+// so frames that fit into the largest frame so far do not allocate at all.
+class FrameArena final : public std::pmr::memory_resource
+{
+  public:
+    explicit FrameArena(std::size_t initialCapacity = 64 * 1024, std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+    ~FrameArena() override;
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Invalidates everything allocated since the last Reset.
+    void Reset();
+
+    // Bytes allocated since the last Reset, including alignment padding.
+    std::size_t GetUsedBytes() const { return usedBytes; }
+    std::size_t GetCapacity() const;
+    // Most bytes used between two Resets so far.
+    std::size_t GetPeakUsedBytes() const { return peakUsedBytes; }
+
+  private:
+    struct Block
+    {
+        std::byte* data = nullptr;
+        std::size_t size = 0;
+    };
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void*, std::size_t, std::size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    void AddBlock(std::size_t size);
+    void FreeBlocks();
+
+    std::pmr::memory_resource* upstream;
+    // Allocations are bumped from the last block, the others are full.
+    std::vector<Block> blocks{};
+    std::byte* current = nullptr;
+    std::byte* end = nullptr;
+    std::size_t usedBytes = 0;
+    std::size_t peakUsedBytes = 0;
+};
+
+// Hands out blocks of up to blockSize bytes from chunks allocated upstream, recycling freed blocks through a free list.
+// Meant for many small objects of about the same size, e.g. the nodes of sets and maps.
+// Larger or over-aligned requests are passed upstream. Chunks are only returned upstream on destruction.
+class BlockPool final : public std::pmr::memory_resource
+{
+  public:
+    static constexpr std::size_t kBlockAlignment = alignof(std::max_align_t);
+
+    explicit BlockPool(std::size_t blockSize, std::size_t blocksPerChunk = 256, std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+    ~BlockPool() override;
+
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+
+    // Requested block size rounded up to kBlockAlignment.
+    std::size_t GetBlockSize() const { return blockSize; }
+    // Blocks currently handed out.
+    std::size_t GetUsedBlockCount() const { return usedBlockCount; }
+    std::size_t GetChunkCount() const { return chunks.size(); }
+
+  private:
+    struct FreeBlock
+    {
+        FreeBlock* next = nullptr;
+    };
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    bool IsPooled(std::size_t bytes, std::size_t alignment) const { return bytes <= blockSize && alignment <= kBlockAlignment; }
+    void AddChunk();
+
+    std::pmr::memory_resource* upstream;
+    std::size_t blockSize;
+    std::size_t blocksPerChunk;
+    FreeBlock* freeList = nullptr;
+    std::vector<std::byte*> chunks{};
+    std::size_t usedBlockCount = 0;
+};
+
+// Passes every allocation upstream with at least alignment, e.g. so the arrays of std::pmr containers start on a cache line.
+// Has no state of its own, so it is as thread safe as upstream.
+class AlignedResource final : public std::pmr::memory_resource
+{
+  public:
+    explicit AlignedResource(std::size_t alignment, std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : upstream(upstream), alignment(alignment)
+    {
+    }
+
+    std::size_t GetAlignment() const { return alignment; }
+
+  private:
+    void* do_allocate(std::size_t bytes, std::size_t requested) override { return upstream->allocate(bytes, std::max(requested, alignment)); }
+    void do_deallocate(void* pointer, std::size_t bytes, std::size_t requested) override
+    {
+        upstream->deallocate(pointer, bytes, std::max(requested, alignment));
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    std::pmr::memory_resource* upstream;
+    std::size_t alignment;
+};
+
+}  // namespace tektonik::memory
@@ -0,0 +1,130 @@
+module;
+#include "common-defines.hpp"
+export module render_batch;
+
+import glm;
+import ecs;
+import components;
+import string_table;
+import std;
+
+export namespace tektonik::renderer
+{
+
+// One element of the instance vertex buffer, matching the inputs of batch.vert.
+struct Instance
+{
+    glm::vec2 position{};
+    glm::vec2 size{};
+    float rotation = 0.0f;
+    // Index into the texture array of the renderer, only read by sprites.
+    std::uint32_t textureSlot = 0;
+    glm::vec4 color{};
+};
+
+// Each material is drawn by one pipeline with one instanced draw call.
+enum class Material : std::uint8_t
+{
+    Box,
+    Circle,
+    Sprite
+};
+constexpr std::size_t kMaterialCount = 3;
+
+// Instances of all drawable entities of a World, contiguous per material.
+// Sprites refer to textures by slot. Textures without a slot use the placeholder and are reported once by TakeNewTextures.
+class InstanceBatch
+{
+  public:
+    static constexpr std::uint32_t kPlaceholderSlot = 0;
+
+    struct Range
+    {
+        std::uint32_t first = 0;
+        std::uint32_t count = 0;
+    };
+
+    // Collects entities with a Transform2D, a Color and a Box2D, Circle2D or Sprite, in one pass per material.
+    // The World must have all of these components.
+    template <typename WorldType>
+    void Extract(WorldType& world);
+
+    std::span<const Instance> GetInstances() const { return instances; }
+    Range GetRange(Material material) const { return ranges[static_cast<std::size_t>(material)]; }
+
+    // Textures of sprites seen for the first time since the last call.
+    std::vector<InternedString> TakeNewTextures() { return std::exchange(newTextures, {}); }
+    void SetTextureSlot(InternedString path, std::uint32_t slot) { GetTextureSlot(path) = slot; }
+
+  private:
+    static constexpr std::uint32_t kNoSlot = std::numeric_limits<std::uint32_t>::max();
+
+    template <typename ShapeType>
+    void ExtractMaterial(auto& world, Material material, auto&& makeInstance);
+
+    std::uint32_t& GetTextureSlot(InternedString path)
+    {
+        // Handles are dense, so slots are looked up by index instead of hashing.
+        const std::uint32_t handle = path.GetHandle();
+        if (handle >= textureSlots.size())
+            textureSlots.resize(std::size_t{handle} + 1, kNoSlot);
+        if (textureSlots[handle] == kNoSlot)
+        {
+            textureSlots[handle] = kPlaceholderSlot;
+            newTextures.push_back(path);
+        }
+        return textureSlots[handle];
+    }
+
+    std::vector<Instance> instances{};
+    std::array<Range, kMaterialCount> ranges{};
+    // Indexed by the handle of the path.
+    std::vector<std::uint32_t> textureSlots{};
+    std::vector<InternedString> newTextures{};
+};
+
+template <typename WorldType>
+void InstanceBatch::Extract(WorldType& world)
+{
+    instances.clear();
+
+    ExtractMaterial<components::Box2D>(
+        world,
+        Material::Box,
+        [](const components::Transform2D& transform, const components::Box2D& box, const components::Color& color)
+        { return Instance{.position = transform.position, .size = box.size * transform.scale, .rotation = transform.rotation, .color = color.color}; });
+    ExtractMaterial<components::Circle2D>(
+        world,
+        Material::Circle,
+        [](const components::Transform2D& transform, const components::Circle2D& circle, const components::Color& color)
+        {
+            return Instance{
+                .position = transform.position, .size = 2.0f * circle.radius * transform.scale, .rotation = transform.rotation, .color = color.color};
+        });
+    ExtractMaterial<components::Sprite>(
+        world,
+        Material::Sprite,
+        [this](const components::Transform2D& transform, const components::Sprite& sprite, const components::Color& color)
+        {
+            return Instance{
+                .position = transform.position,
+                .size = transform.scale,
+                .rotation = transform.rotation,
+                .textureSlot = GetTextureSlot(sprite.path),
+                .color = color.color,
+            };
+        });
+}
+
+template <typename ShapeType>
+void InstanceBatch::ExtractMaterial(auto& world, Material material, auto&& makeInstance)
+{
+    Range& range = ranges[static_cast<std::size_t>(material)];
+    range.first = static_cast<std::uint32_t>(instances.size());
+    world.template Each<const components::Transform2D, const ShapeType, const components::Color>(
+        [&](ecs::Entity, const components::Transform2D& transform, const ShapeType& shape, const components::Color& color)
+        { instances.push_back(makeInstance(transform, shape, color)); });
+    range.count = static_cast<std::uint32_t>(instances.size()) - range.first;
+}
+
+}  // namespace tektonik::renderer
@@ -10,6 +10,10 @@ import std;
 import config;
 import concepts;
 import assert;
+import glm;
+import assets;
+import string_table;
+import render_batch;
 
 namespace tektonik::renderer
 {
@@ -17,6 +21,10 @@ namespace tektonik::renderer
 template <concepts::Numeric T>
 constexpr T kInvalidIndex = std::numeric_limits<T>::max();
 
+constexpr std::uint32_t kMaxFramesInFlight = 2;
+// Size of the texture array sprites sample from, must match batch.frag.
+export constexpr std::uint32_t kMaxTextures = 1024;
+
 /// Structure wrapping swapchain and its related resources.
 class SwapchainWrapper
 {
@@ -34,10 +42,6 @@ class SwapchainWrapper
     // Resources per frame (as in max frames in flight)
 
     std::vector<vk::raii::Semaphore> acquiredImageSemaphores{};
-    std::vector<vk::raii::CommandBuffer> commandBuffers{};
-    std::vector<vk::raii::Fence> submitFinishedFences{};
-
-    size_t currentFrameIndex = 0;
 
   private:
 };
@@ -62,6 +66,7 @@ class QueuesInfo
     };
 
     QueuesInfo() noexcept = default;
+    /// Without a surface, every graphics family counts as present, as frames are only read back.
     QueuesInfo(
         const vk::raii::PhysicalDevice& physicalDevice,
         const vulkan::util::RaiiSurfaceWrapper& surfaceWrapper,
@@ -103,6 +108,10 @@ class PhysicalDeviceCandidate
     vk::PhysicalDevice physicalDevice{nullptr};
     vk::PhysicalDeviceProperties properties{};
     QueuesInfo queuesInfo{};
+    /// Needed to index the texture array with per instance slots.
+    bool supportsNonUniformTextureIndexing = false;
+    /// Needed to track uploads on the transfer queue.
+    bool supportsTimelineSemaphores = false;
 };
 
 /// Members that are invariant during all of rendering.
@@ -110,7 +119,8 @@ class VulkanInvariants
 {
   public:
     VulkanInvariants() noexcept = default;
-    VulkanInvariants(vulkan::util::RaiiWindowWrapper& windowWrapper);
+    /// Without a window there is no surface and no swapchain support, which needs no display.
+    VulkanInvariants(vulkan::util::RaiiWindowWrapper* windowWrapper);
 
     // Members are in order of initialization.
 
@@ -121,7 +131,7 @@ class VulkanInvariants
     QueuesInfo queuesInfo{};
     vk::raii::Device device{nullptr};
 
-    // Different types of queues
+    // Different types of queues, the same queue when types share a family.
     struct Queues
     {
         // Also present queue.
@@ -133,29 +143,275 @@ class VulkanInvariants
         bool dedicatedCompute = false;
     } queues{};
 
+    /// For one-time uploads, frames record with their FrameCommandPools.
     vk::raii::CommandPool commandPool{nullptr};
 
   private:
     // Initialization
 
-    vk::raii::Instance CreateInstance();
+    vk::raii::Instance CreateInstance(bool presentable);
+    vulkan::util::RaiiSurfaceWrapper CreateSurface(vulkan::util::RaiiWindowWrapper* windowWrapper);
     vk::raii::PhysicalDevice ChoosePhysicalDevice();
     vk::raii::Device CreateDevice();
     Queues RetrieveQueues();
+    vk::raii::CommandPool CreateCommandPool();
 };
 
-export class Renderer
+/// Buffer with dedicated memory. Host visible memory stays mapped for the lifetime of the buffer.
+class Buffer
+{
+  public:
+    Buffer() noexcept = default;
+    Buffer(const VulkanInvariants& vulkan, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties);
+
+    // Memory is declared first, so it is freed after the buffer is destroyed.
+    vk::raii::DeviceMemory memory{nullptr};
+    vk::raii::Buffer buffer{nullptr};
+    vk::DeviceSize size = 0;
+    std::byte* mapped = nullptr;
+};
+
+/// RGBA8 image with dedicated memory, sampled by default.
+class Texture
+{
+  public:
+    Texture() noexcept = default;
+    Texture(
+        const VulkanInvariants& vulkan,
+        vk::Extent2D extent,
+        vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
+
+    vk::Extent2D extent{};
+    vk::raii::DeviceMemory memory{nullptr};
+    vk::raii::Image image{nullptr};
+    vk::raii::ImageView view{nullptr};
+};
+
+/// Uploads textures through a persistently mapped staging ring buffer on the transfer queue, dedicated if there is one.
+/// The copies of a frame are batched into one submission, which signals a timeline semaphore. Only the graphics submission
+/// that first samples the textures waits for it, so uploads do not stall the graphics queue.
+class Uploader
+{
+  public:
+    /// What the next graphics submission must do before it samples the uploaded textures.
+    struct GraphicsHandoff
+    {
+        /// Value of the timeline semaphore to wait for, 0 when nothing was submitted since the last handoff.
+        std::uint64_t waitValue = 0;
+        /// Acquiring halves of the queue family ownership transfers, or only layout transitions when transfer and graphics share a family.
+        std::vector<vk::ImageMemoryBarrier> acquires{};
+    };
+
+    Uploader() noexcept = default;
+    Uploader(const VulkanInvariants& vulkan, vk::DeviceSize capacity);
+
+    /// Creates a texture and records the copy of the image into it, std::nullopt while the ring has no room for the image.
+    std::optional<Texture> UploadTexture(const assets::Image& image);
+    /// Submits the copies recorded since the last call.
+    void Flush();
+    GraphicsHandoff TakeGraphicsHandoff() { return std::exchange(handoff, {}); }
+
+    vk::DeviceSize GetCapacity() const { return staging.size; }
+    const vk::raii::Semaphore& GetTimeline() const { return timeline; }
+
+  private:
+    struct Batch
+    {
+        /// Null until the first copy is recorded.
+        vk::raii::CommandBuffer commandBuffer{nullptr};
+        /// Signaled once the copies finished.
+        std::uint64_t value = 0;
+        /// Staging bytes used by the batch, including padding.
+        vk::DeviceSize size = 0;
+    };
+
+    /// Frees the staging space of finished batches.
+    void Retire();
+    /// Offset of size contiguous free bytes, std::nullopt when there is no room.
+    std::optional<vk::DeviceSize> Allocate(vk::DeviceSize size);
+
+    const VulkanInvariants* vulkan = nullptr;
+    std::uint32_t transferFamily = 0;
+    std::uint32_t graphicsFamily = 0;
+    Buffer staging{};
+    vk::raii::Semaphore timeline{nullptr};
+    vk::raii::CommandPool commandPool{nullptr};
+
+    /// Next byte to allocate. Bytes in use end here, so the free ones start here.
+    vk::DeviceSize head = 0;
+    vk::DeviceSize usedSize = 0;
+    Batch recording{};
+    /// Submitted and not known to be finished, oldest first.
+    std::deque<Batch> inFlight{};
+    /// Of retired batches, reused by later ones.
+    std::vector<vk::raii::CommandBuffer> freeCommandBuffers{};
+    std::uint64_t submittedValue = 0;
+    GraphicsHandoff handoff{};
+};
+
+/// Pipelines drawing an InstanceBatch, one per material. They share the layout, so the view and textures are bound once.
+class BatchPipelines
+{
+  public:
+    BatchPipelines() noexcept = default;
+    BatchPipelines(const VulkanInvariants& vulkan, const vk::raii::RenderPass& renderPass);
+
+    vk::raii::Sampler sampler{nullptr};
+    vk::raii::DescriptorSetLayout descriptorSetLayout{nullptr};
+    vk::raii::PipelineLayout pipelineLayout{nullptr};
+    /// Indexed by Material.
+    std::vector<vk::raii::Pipeline> pipelines{};
+};
+
+/// Command pools of a frame in flight, one per job system thread, so jobs record secondary buffers without locking.
+/// All pools are reset at once when the frame is reused, buffers are never reset individually.
+class FrameCommandPools
 {
   public:
-    Renderer();
+    FrameCommandPools() noexcept = default;
+    FrameCommandPools(const VulkanInvariants& vulkan, std::size_t threadCount);
+
+    /// The device must be done with all commands of the frame.
+    void Reset();
+    /// Begins a buffer from the pool of the calling thread, which continues the inherited render pass.
+    const vk::raii::CommandBuffer& BeginSecondary(const vk::CommandBufferInheritanceInfo& inheritance);
+
+    /// From the pool of the main thread.
+    vk::raii::CommandBuffer primary{nullptr};
 
   private:
-    config::ConfigString windowTitle = config::ConfigString("RendererWindowTitle", "Renderer Window");
+    struct ThreadPool
+    {
+        vk::raii::CommandPool pool{nullptr};
+        /// Allocated on demand and kept across resets.
+        std::vector<vk::raii::CommandBuffer> secondaries{};
+        std::size_t usedSecondaries = 0;
+    };
+
+    const vk::raii::Device* device = nullptr;
+    /// Indexed by jobs::JobSystem::GetThreadIndex.
+    std::vector<ThreadPool> threadPools{};
+};
+
+/// Resources of a frame in flight which survive swapchain recreation.
+struct FrameResources
+{
+    FrameCommandPools commands{};
+    vk::raii::Fence submitFinished{nullptr};
+    /// Whether commands were submitted since the frame was created, so its timestamps and readback are valid.
+    bool submitted = false;
+    /// Persistently mapped, grown when the batch does not fit.
+    Buffer instances{};
+    vk::raii::DescriptorSet textureSet{nullptr};
+    /// Slots of the texture array written to textureSet so far.
+    std::uint32_t writtenTextureCount = 0;
+
+    // Only used when headless
+
+    Texture target{};
+    vk::raii::Framebuffer framebuffer{nullptr};
+    /// Copy of the target, only with readback.
+    Buffer readback{};
+};
 
+/// Draws Box2D, Circle2D and Sprite entities as instanced quads, one draw call per material.
+/// A frame costs one pass over the components and a copy into the mapped instance buffer.
+/// Sprite textures are requested from the AssetManager and show the placeholder until they are uploaded.
+/// Headless renderers draw into offscreen images instead of a window, so they run without a display, e.g. on lavapipe.
+export class Renderer
+{
+  public:
+    struct CreateInfo
+    {
+        bool headless = false;
+        /// Size of the window, or of the offscreen images when headless.
+        glm::ivec2 size = {800, 600};
+        /// Copies every headless frame to host memory, see ReadbackLastFrame.
+        bool readback = false;
+    };
+
+    struct FrameTimings
+    {
+        /// Extracting, recording and submitting the latest frame, without waiting for the device.
+        std::chrono::duration<double, std::milli> cpu{};
+        /// Device time of the latest finished frame, which lags up to kMaxFramesInFlight frames behind.
+        /// Stays zero when the graphics queue has no timestamps.
+        std::chrono::duration<double, std::milli> gpu{};
+    };
+
+    /// Where the view is centered in world units and how many pixels a world unit spans. World y points up.
+    struct View
+    {
+        glm::vec2 center = glm::vec2(0.0f);
+        float pixelsPerUnit = 1.0f;
+    };
+
+    /// Due to SDL usage, must be run on main thread.
+    explicit Renderer(const CreateInfo& createInfo = CreateInfo{});
+    ~Renderer();
+
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+
+    /// Draws the entities of the world, see InstanceBatch::Extract.
+    /// Due to SDL usage, must be run on main thread.
+    template <typename WorldType>
+    void Render(WorldType& world)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        batch.Extract(world);
+        DrawBatch(start);
+    }
+
+    void SetView(const View& newView) { view = newView; }
+
+    FrameTimings GetLatestTimings() const { return latestTimings; }
+    /// Waits for the latest headless frame and returns its pixels. Needs readback and at least one rendered frame.
+    assets::Image ReadbackLastFrame();
+
+  private:
+    void DrawBatch(std::chrono::steady_clock::time_point cpuStart);
+    void DrawOffscreen(FrameResources& frame);
+    void DrawToSwapchain(FrameResources& frame);
+    /// Records the render pass and, when headless with readback, the copy of the target.
+    void RecordFrame(
+        FrameResources& frame, vk::Framebuffer framebuffer, vk::Extent2D extent, const std::vector<vk::ImageMemoryBarrier>& uploadAcquires);
+    /// Records the draws into secondary buffers in parallel, returned in draw order.
+    std::vector<vk::CommandBuffer> RecordBatch(FrameResources& frame, vk::Framebuffer framebuffer, vk::Extent2D extent) const;
+    /// Reads the timestamps of a frame whose fence was waited for.
+    void ReadGpuTime(const FrameResources& frame);
+    void UploadInstances(FrameResources& frame);
+    /// Requests textures of new sprites and uploads the ones that finished loading.
+    void UpdateTextures();
+    /// Whether the image needs no further attention, which is the case once it has a slot or keeps the placeholder.
+    bool TryUploadTexture(const assets::ImageHandle& image);
+    void WriteTextureSlots(FrameResources& frame) const;
+    void RecreateSwapchain();
+
+    const bool headless = false;
+    const bool readback = false;
     vulkan::util::RaiiWindowWrapper window{};
     VulkanInvariants vulkanInvariants{};
+    vk::SurfaceFormatKHR surfaceFormat{};
+    vk::raii::RenderPass renderPass{nullptr};
     /// Must be recreated on window resize.
     SwapchainWrapper swapchainWrapper{};
+    BatchPipelines batchPipelines{};
+    vk::raii::DescriptorPool descriptorPool{nullptr};
+    std::vector<FrameResources> frames{};
+    std::uint32_t frameIndex = 0;
+    Uploader uploader{};
+    /// Two timestamps per frame in flight, null when the graphics queue has none.
+    vk::raii::QueryPool timestampQueries{nullptr};
+    double timestampPeriodNs = 0.0;
+    std::uint64_t timestampMask = 0;
+    FrameTimings latestTimings{};
+    /// Indexed by slot, the placeholder first.
+    std::vector<Texture> textures{};
+    /// Requested images that are still loading.
+    std::vector<assets::ImageHandle> pendingTextures{};
+    InstanceBatch batch{};
+    View view{};
 };
 
 }  // namespace tektonik::renderer
@@ -3,9 +3,13 @@ module;
 export module runtime;
 
 import app;
+import util;
 import logger;
 import singleton;
 import config;
+import jobs;
+import string_table;
+import assets;
 import config_renderer;
 import sdl_runtime;
 import renderer;
@@ -23,22 +27,50 @@ class Runtime
         char** argv = nullptr;
     };
 
-    Runtime(const RunOptions& runOptions = RunOptions{}) : runOptions(runOptions), configRenderer(configManager.Get()) {}
+    /// Command line arguments like --Name=value override the config variable Name.
+    Runtime(const RunOptions& runOptions = RunOptions{})
+        : runOptions(runOptions),
+          configManager(std::in_place, ParseConfigOverrides(runOptions)),
+          sdlRuntime(!*headless),
+          renderer(renderer::Renderer::CreateInfo{.headless = *headless})
+    {
+        if (!*headless)
+            configRenderer.emplace(configManager.Get());
+    }
 
     Runtime(const Runtime&) = delete;
     Runtime& operator=(const Runtime&) = delete;
 
+    /// Runs the main loop until the window is closed. Headless runs render HeadlessFrameCount frames instead and log their timings.
     void Init();
 
     /// Runs tests.
     void Test() const;
 
+    /// Runs benchmarks when the config variable RunBenchmarks is set.
+    void Benchmark() const;
+
   private:
+    void RunHeadless();
+
+    static std::unordered_map<std::string_view, std::string_view> ParseConfigOverrides(const RunOptions& runOptions)
+    {
+        if (runOptions.argc < 1)
+            return {};
+        return util::string::ParseCommandLineArgumentsToMap(runOptions.argc, runOptions.argv);
+    }
+
     const RunOptions runOptions;
     Singleton<Logger> logger;
     Singleton<config::Manager> configManager;
+    Singleton<jobs::JobSystem> jobSystem;
+    Singleton<StringTable> stringTable;
+    Singleton<assets::AssetManager> assetManager;
+    /// Renders offscreen without windows, e.g. on build agents without a display.
+    config::ConfigBool headless = config::ConfigBool("Headless", false);
     SdlRuntime sdlRuntime;
-    config::Renderer configRenderer;
+    /// Not created when headless.
+    std::optional<config::Renderer> configRenderer{};
     renderer::Renderer renderer;
 };
 
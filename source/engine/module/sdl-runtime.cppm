@@ -12,10 +12,11 @@ namespace tektonik
 export class SdlRuntime
 {
   public:
-    SdlRuntime()
+    /// Without video only events are initialized, which needs no display.
+    explicit SdlRuntime(bool video = true)
     {
         Singleton<Logger>::Get().Log("Initializing SDL...");
-        if (!SDL_Init(SDL_INIT_VIDEO))
+        if (!SDL_Init(video ? SDL_INIT_VIDEO : SDL_INIT_EVENTS))
         {
             Singleton<Logger>::Get().Log<LogLevel::Error>(std::format("SDL_Init failed with: '{}'", SDL_GetError()));
             throw std::runtime_error("SDL could not be initialized.");
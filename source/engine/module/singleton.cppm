@@ -18,6 +18,12 @@ class Singleton
 {
   public:
     Singleton() { GetContained().emplace(); }
+    // For non default initialization.
+    template <typename... Args>
+    explicit Singleton(std::in_place_t, Args&&... args)
+    {
+        GetContained().emplace(std::forward<Args>(args)...);
+    }
     ~Singleton()
     {
         ASSUMERT(GetContained().has_value());
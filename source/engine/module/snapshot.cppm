@@ -0,0 +1,393 @@
+module;
+#include "common-defines.hpp"
+export module snapshot;
+
+import ecs;
+import concepts;
+import string_table;
+import std;
+import assert;
+
+// Binary World snapshots. The layout is a Header followed by sections, each aligned to kSectionAlignment:
+// generations, alive entities, their signatures, component data of plain data columns and column entities,
+// the Column table and a blob section for components that need serialization.
+// Plain data columns are stored as arrays, so a memory mapped snapshot can be used in place.
+export namespace tektonik::snapshot
+{
+
+class SnapshotError : public std::runtime_error
+{
+  public:
+    SnapshotError(const std::string& message) : std::runtime_error(message) {}
+};
+
+inline constexpr std::array<char, 4> kMagic = {'T', 'K', 'S', 'N'};
+inline constexpr std::uint32_t kVersion = 1;
+inline constexpr std::size_t kSectionAlignment = 64;
+
+// All offsets are in bytes from the start of the snapshot.
+struct Header
+{
+    std::array<char, 4> magic = kMagic;
+    std::uint32_t version = kVersion;
+    std::uint32_t componentTypeCount = 0;
+    // Count of std::uint64_t words per signature.
+    std::uint32_t signatureWordCount = 0;
+    std::uint64_t generationCount = 0;
+    std::uint64_t entityCount = 0;
+    // std::uint32_t[generationCount], see EntityManager::GetGenerations.
+    std::uint64_t generationsOffset = 0;
+    // Entity[entityCount], the alive entities in ascending order.
+    std::uint64_t entitiesOffset = 0;
+    // std::uint64_t[entityCount * signatureWordCount], signature bits of the alive entities.
+    std::uint64_t signaturesOffset = 0;
+    // Column[componentTypeCount], indexed by ComponentManager::kTypeIndex.
+    std::uint64_t columnsOffset = 0;
+    std::uint64_t blobOffset = 0;
+    std::uint64_t blobSize = 0;
+};
+static_assert(std::is_trivially_copyable_v<Header>);
+
+struct Column
+{
+    std::uint32_t elementSize = 0;
+    std::uint32_t elementAlignment = 0;
+    // Set for plain data, see IsPlainData.
+    std::uint32_t isTriviallyCopyable = 0;
+    std::uint32_t reserved = 0;
+    std::uint64_t count = 0;
+    // Entity[count], in the order of the components.
+    std::uint64_t entitiesOffset = 0;
+    // Component[count] for plain data, otherwise relative to the blob section.
+    std::uint64_t dataOffset = 0;
+    std::uint64_t dataSize = 0;
+};
+static_assert(std::is_trivially_copyable_v<Column>);
+
+template <typename T>
+consteval bool IsPlainData();
+
+template <typename... Fields>
+consteval bool ArePlainData(std::type_identity<std::tuple<Fields...>>)
+{
+    return (IsPlainData<std::remove_cvref_t<Fields>>() && ...);
+}
+
+// Whether values can be copied as bytes. Interned strings are trivially copyable,
+// but their handles are only valid within a process, so they and types containing them are serialized.
+template <typename T>
+consteval bool IsPlainData()
+{
+    if constexpr (std::is_same_v<T, InternedString> || !std::is_trivially_copyable_v<T>)
+        return false;
+    else if constexpr (concepts::Tiable<T>)
+        return ArePlainData(std::type_identity<decltype(std::declval<const T&>().Tie())>{});
+    else
+        return true;
+}
+
+// Writes fields through Tie(). Plain data fields are copied as they are, strings and vectors are size prefixed.
+// Interned strings are written as their characters.
+class BlobWriter
+{
+  public:
+    explicit BlobWriter(std::vector<std::byte>& bytes) : bytes(bytes) {}
+
+    template <typename T>
+    void Write(const T& value)
+    {
+        if constexpr (std::is_same_v<T, InternedString>)
+        {
+            const std::string_view string = value.View();
+            Write(static_cast<std::uint64_t>(string.size()));
+            WriteBytes(string.data(), string.size());
+        }
+        else if constexpr (IsPlainData<T>())
+            WriteBytes(&value, sizeof(T));
+        else if constexpr (concepts::Tiable<T>)
+            std::apply([this](const auto&... fields) { (Write(fields), ...); }, value.Tie());
+        else if constexpr (std::is_same_v<T, std::string>)
+        {
+            Write(static_cast<std::uint64_t>(value.size()));
+            WriteBytes(value.data(), value.size());
+        }
+        else if constexpr (concepts::InstantiatedFrom<T, std::vector>)
+        {
+            Write(static_cast<std::uint64_t>(value.size()));
+            for (const auto& element : value)
+                Write(element);
+        }
+        else
+            static_assert(!sizeof(T*), "Type can not be serialized.");
+    }
+
+  private:
+    void WriteBytes(const void* data, std::size_t size)
+    {
+        const auto* begin = static_cast<const std::byte*>(data);
+        bytes.insert(bytes.end(), begin, begin + size);
+    }
+
+    std::vector<std::byte>& bytes;
+};
+
+// Counterpart of BlobWriter. Throws SnapshotError when reading past the end.
+class BlobReader
+{
+  public:
+    explicit BlobReader(std::span<const std::byte> bytes) : bytes(bytes) {}
+
+    template <typename T>
+    void Read(T& value)
+    {
+        if constexpr (std::is_same_v<T, InternedString>)
+        {
+            std::string string{};
+            Read(string);
+            value = InternedString(string);
+        }
+        else if constexpr (IsPlainData<T>())
+            ReadBytes(&value, sizeof(T));
+        else if constexpr (concepts::Tiable<T>)
+        {
+            std::apply([this](auto&... fields) { (Read(fields), ...); }, concepts::TieMutable(value));
+        }
+        else if constexpr (std::is_same_v<T, std::string>)
+        {
+            value.resize(ReadSize());
+            ReadBytes(value.data(), value.size());
+        }
+        else if constexpr (concepts::InstantiatedFrom<T, std::vector>)
+        {
+            value.resize(ReadSize());
+            for (auto& element : value)
+                Read(element);
+        }
+        else
+            static_assert(!sizeof(T*), "Type can not be deserialized.");
+    }
+
+  private:
+    // Sizes are bounded by the remaining bytes, so corrupted data can not cause huge allocations.
+    std::size_t ReadSize();
+    void ReadBytes(void* data, std::size_t size);
+
+    std::span<const std::byte> bytes;
+    std::size_t position = 0;
+};
+
+// Read-only access to a snapshot without copying it, e.g. of a memory mapped file.
+// The memory must outlive the view and be aligned to at least alignof(std::max_align_t).
+class SnapshotView
+{
+  public:
+    // Throws SnapshotError when the header is invalid or a section is out of bounds.
+    explicit SnapshotView(std::span<const std::byte> bytes);
+
+    const Header& GetHeader() const { return header; }
+    std::span<const std::uint32_t> GetGenerations() const { return GetArray<std::uint32_t>(header.generationsOffset, header.generationCount); }
+    std::span<const ecs::Entity> GetEntities() const { return GetArray<ecs::Entity>(header.entitiesOffset, header.entityCount); }
+    std::span<const std::uint64_t> GetSignatureWords() const
+    {
+        return GetArray<std::uint64_t>(header.signaturesOffset, header.entityCount * header.signatureWordCount);
+    }
+
+    const Column& GetColumn(std::size_t typeIndex) const;
+    std::span<const ecs::Entity> GetColumnEntities(std::size_t typeIndex) const;
+
+    // Components of a plain data column, used in place.
+    template <ecs::Component ComponentType>
+    std::span<const ComponentType> GetComponents(std::size_t typeIndex) const
+    {
+        static_assert(IsPlainData<ComponentType>());
+        const Column& column = GetColumn(typeIndex);
+        ASSUMERT(column.isTriviallyCopyable && column.elementSize == sizeof(ComponentType));
+        return GetArray<ComponentType>(column.dataOffset, column.count);
+    }
+
+    // Serialized components of a column that is not plain data.
+    std::span<const std::byte> GetBlob(const Column& column) const;
+
+    // Throws SnapshotError unless the entity table lists exactly the alive entities of the generations in ascending
+    // order, and every column lists each entity whose signature has the column's bit exactly once.
+    // Not done by the constructor, since it touches every entity.
+    void ValidateEntities() const;
+
+  private:
+    // Throws when [offset, offset + count * elementSize) is not inside the snapshot or offset is misaligned.
+    void CheckSection(std::uint64_t offset, std::uint64_t count, std::uint64_t elementSize, std::uint64_t alignment) const;
+
+    template <typename T>
+    std::span<const T> GetArray(std::uint64_t offset, std::uint64_t count) const
+    {
+        // Bounds were checked by the constructor.
+        const std::byte* begin = bytes.data() + offset;
+        ASSUMERT(reinterpret_cast<std::uintptr_t>(begin) % alignof(T) == 0);
+        return std::span(reinterpret_cast<const T*>(begin), count);
+    }
+
+    std::span<const std::byte> bytes;
+    Header header{};
+};
+
+// Writes all entities and components of the world.
+template <ecs::Component... ComponentTypes>
+std::vector<std::byte> Save(ecs::World<ecs::ComponentManager<ComponentTypes...>>& world)
+{
+    using Manager = ecs::ComponentManager<ComponentTypes...>;
+    Manager& componentManager = world.GetComponentManager();
+
+    std::vector<std::byte> bytes(sizeof(Header));
+    // Appends a section at the next aligned offset and returns the offset.
+    const auto appendSection = [&bytes](std::span<const std::byte> section)
+    {
+        const std::size_t offset = (bytes.size() + kSectionAlignment - 1) / kSectionAlignment * kSectionAlignment;
+        bytes.resize(offset);
+        bytes.insert(bytes.end(), section.begin(), section.end());
+        return static_cast<std::uint64_t>(offset);
+    };
+
+    Header header{.componentTypeCount = sizeof...(ComponentTypes), .signatureWordCount = (sizeof...(ComponentTypes) + 63) / 64};
+
+    const std::span<const std::uint32_t> generations = world.GetEntityManager().GetGenerations();
+    header.generationCount = generations.size();
+    header.generationsOffset = appendSection(std::as_bytes(generations));
+
+    std::vector<ecs::Entity> entities{};
+    for (ecs::Entity entity = 0; entity < generations.size(); ++entity)
+        if (world.IsAlive(entity))
+            entities.push_back(entity);
+    header.entityCount = entities.size();
+    header.entitiesOffset = appendSection(std::as_bytes(std::span(entities)));
+
+    std::vector<std::uint64_t> signatureWords(entities.size() * header.signatureWordCount, 0);
+    for (std::size_t i = 0; i < entities.size(); ++i)
+    {
+        const auto signature = componentManager.GetSignature(entities[i]);
+        for (std::size_t typeIndex = 0; typeIndex < signature.size(); ++typeIndex)
+            if (signature[typeIndex])
+                signatureWords[i * header.signatureWordCount + typeIndex / 64] |= std::uint64_t{1} << (typeIndex % 64);
+    }
+    header.signaturesOffset = appendSection(std::as_bytes(std::span(signatureWords)));
+
+    std::array<Column, sizeof...(ComponentTypes)> columns{};
+    std::vector<std::byte> blob{};
+    const auto saveColumn = [&]<ecs::Component ComponentType>()
+    {
+        Column& column = columns[Manager::template kTypeIndex<ComponentType>];
+        column.elementSize = sizeof(ComponentType);
+        column.elementAlignment = alignof(ComponentType);
+        column.isTriviallyCopyable = IsPlainData<ComponentType>();
+
+        std::vector<ecs::Entity> columnEntities{};
+        if constexpr (IsPlainData<ComponentType>())
+        {
+            column.dataOffset = appendSection({});
+            componentManager.template Each<const ComponentType>(
+                [&](ecs::Entity entity, const ComponentType& component)
+                {
+                    columnEntities.push_back(entity);
+                    const std::span<const std::byte> componentBytes = std::as_bytes(std::span(&component, 1));
+                    bytes.insert(bytes.end(), componentBytes.begin(), componentBytes.end());
+                });
+        }
+        else
+        {
+            column.dataOffset = blob.size();
+            BlobWriter writer(blob);
+            componentManager.template Each<const ComponentType>(
+                [&](ecs::Entity entity, const ComponentType& component)
+                {
+                    columnEntities.push_back(entity);
+                    writer.Write(component);
+                });
+        }
+
+        column.count = columnEntities.size();
+        column.dataSize = column.isTriviallyCopyable ? column.count * sizeof(ComponentType) : blob.size() - column.dataOffset;
+        column.entitiesOffset = appendSection(std::as_bytes(std::span(columnEntities)));
+    };
+    (saveColumn.template operator()<ComponentTypes>(), ...);
+
+    header.columnsOffset = appendSection(std::as_bytes(std::span(columns)));
+    header.blobSize = blob.size();
+    header.blobOffset = appendSection(std::as_bytes(std::span(blob)));
+
+    std::memcpy(bytes.data(), &header, sizeof(Header));
+    return bytes;
+}
+
+// Loads a snapshot into a world that has no entities yet. Plain data columns are bulk inserted,
+// other components are deserialized one by one. Signature sets are filled once at the end.
+// Throws SnapshotError when the world has entities, or the snapshot is invalid or was saved with different component types.
+// Everything is validated before the world is touched, so a failed load leaves the world unchanged.
+template <ecs::Component... ComponentTypes>
+void Load(std::span<const std::byte> bytes, ecs::World<ecs::ComponentManager<ComponentTypes...>>& world)
+{
+    using Manager = ecs::ComponentManager<ComponentTypes...>;
+    Manager& componentManager = world.GetComponentManager();
+
+    const std::span<const std::uint32_t> worldGenerations = world.GetEntityManager().GetGenerations();
+    for (ecs::Entity entity = 0; entity < worldGenerations.size(); ++entity)
+        if (world.IsAlive(entity))
+            throw SnapshotError("Snapshots can only be loaded into a world without entities.");
+
+    const SnapshotView view(bytes);
+    const Header& header = view.GetHeader();
+    if (header.componentTypeCount != sizeof...(ComponentTypes))
+        throw SnapshotError(std::format("Snapshot has {} component types instead of {}.", header.componentTypeCount, sizeof...(ComponentTypes)));
+
+    const auto checkColumn = [&]<ecs::Component ComponentType>()
+    {
+        constexpr std::size_t typeIndex = Manager::template kTypeIndex<ComponentType>;
+        const Column& column = view.GetColumn(typeIndex);
+        if (column.elementSize != sizeof(ComponentType) || column.elementAlignment != alignof(ComponentType) ||
+            column.isTriviallyCopyable != IsPlainData<ComponentType>())
+            throw SnapshotError(std::format("Column {} does not match its component type.", typeIndex));
+    };
+    (checkColumn.template operator()<ComponentTypes>(), ...);
+    view.ValidateEntities();
+
+    // Serialized columns are decoded before the world is touched, so a corrupted blob leaves it unchanged.
+    std::tuple<std::vector<ComponentTypes>...> decodedColumns{};
+    const auto decodeColumn = [&]<ecs::Component ComponentType>()
+    {
+        constexpr std::size_t typeIndex = Manager::template kTypeIndex<ComponentType>;
+        if constexpr (!IsPlainData<ComponentType>())
+        {
+            const Column& column = view.GetColumn(typeIndex);
+            std::vector<ComponentType>& components = std::get<typeIndex>(decodedColumns);
+            components.resize(column.count);
+            BlobReader reader(view.GetBlob(column));
+            for (ComponentType& component : components)
+                reader.Read(component);
+        }
+    };
+    (decodeColumn.template operator()<ComponentTypes>(), ...);
+
+    world.RestoreEntities(view.GetGenerations());
+
+    const auto loadColumn = [&]<ecs::Component ComponentType>()
+    {
+        constexpr std::size_t typeIndex = Manager::template kTypeIndex<ComponentType>;
+        const std::span<const ecs::Entity> entities = view.GetColumnEntities(typeIndex);
+        if constexpr (IsPlainData<ComponentType>())
+            componentManager.LoadComponents(entities, view.template GetComponents<ComponentType>(typeIndex));
+        else
+        {
+            std::vector<ComponentType>& components = std::get<typeIndex>(decodedColumns);
+            for (std::size_t i = 0; i < entities.size(); ++i)
+                componentManager.LoadComponent(entities[i], std::move(components[i]));
+        }
+    };
+    (loadColumn.template operator()<ComponentTypes>(), ...);
+
+    const std::span<const std::uint64_t> signatureWords = view.GetSignatureWords();
+    std::vector<std::bitset<sizeof...(ComponentTypes)>> signatures(header.entityCount);
+    for (std::size_t i = 0; i < signatures.size(); ++i)
+        for (std::size_t typeIndex = 0; typeIndex < sizeof...(ComponentTypes); ++typeIndex)
+            signatures[i][typeIndex] = (signatureWords[i * header.signatureWordCount + typeIndex / 64] >> (typeIndex % 64)) & 1;
+    componentManager.RestoreSignatures(view.GetEntities(), signatures);
+}
+
+}  // namespace tektonik::snapshot
@@ -4,53 +4,150 @@ export module sparse_set;
 
 import std;
 import assert;
+import concepts;
 
 namespace tektonik
 {
 
-// Sparse set pagination.
+// Array split into fixed-size pages that are allocated on demand.
+// A page is released once all of its elements are back at the default value,
+// so memory scales with the count of non-default elements instead of the largest index.
+// Pages and the page table are allocated from resource, which must outlive the array.
+export template <typename ValueType, size_t PageSize = 4096>
+class PagedArray
+{
+  public:
+    PagedArray(const ValueType& defaultValue = ValueType{}, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : defaultValue(defaultValue), pages(resource)
+    {
+    }
+
+    // Missing elements read as the default value.
+    const ValueType& Get(size_t index) const
+    {
+        const size_t pageIndex = index / PageSize;
+        if (pageIndex >= pages.size() || !pages[pageIndex])
+            return defaultValue;
+
+        return pages[pageIndex]->values[index % PageSize];
+    }
+
+    void Set(size_t index, const ValueType& value)
+    {
+        const size_t pageIndex = index / PageSize;
+        const bool isDefault = value == defaultValue;
+
+        if (pageIndex >= pages.size() || !pages[pageIndex])
+        {
+            if (isDefault)
+                return;
+
+            if (pageIndex >= pages.size())
+                pages.resize(pageIndex + 1);
+            std::pmr::memory_resource* resource = pages.get_allocator().resource();
+            pages[pageIndex] = PagePointer(std::pmr::polymorphic_allocator<>(resource).new_object<Page>(), PageDeleter{resource});
+            pages[pageIndex]->values.fill(defaultValue);
+        }
+
+        Page& page = *pages[pageIndex];
+        ValueType& element = page.values[index % PageSize];
+        const bool wasDefault = element == defaultValue;
+        element = value;
+
+        if (wasDefault && !isDefault)
+        {
+            ++page.usedCount;
+            ++usedCount;
+        }
+        else if (!wasDefault && isDefault)
+        {
+            --page.usedCount;
+            --usedCount;
+            if (page.usedCount == 0)
+                ReleasePage(pageIndex);
+        }
+    }
+
+    // Reserves the page table for indexes smaller than size, pages themselves are still allocated lazily.
+    void Reserve(size_t size) { pages.reserve((size + PageSize - 1) / PageSize); }
+
+    // Count of elements that are not the default value.
+    size_t GetUsedCount() const { return usedCount; }
+    size_t GetAllocatedPageCount() const { return std::ranges::count_if(pages, [](const auto& page) { return page != nullptr; }); }
+
+  private:
+    struct Page
+    {
+        std::array<ValueType, PageSize> values;
+        size_t usedCount = 0;
+    };
+
+    struct PageDeleter
+    {
+        std::pmr::memory_resource* resource = nullptr;
+
+        void operator()(Page* page) const { std::pmr::polymorphic_allocator<>(resource).delete_object(page); }
+    };
+    using PagePointer = std::unique_ptr<Page, PageDeleter>;
+
+    void ReleasePage(size_t pageIndex)
+    {
+        pages[pageIndex].reset();
+        while (!pages.empty() && !pages.back())
+            pages.pop_back();
+    }
+
+    ValueType defaultValue;
+    std::pmr::vector<PagePointer> pages;
+    size_t usedCount = 0;
+};
+
+// Sparse set with a paged sparse array.
 // TODO restrict IndexType
 export template <typename ContainedType, typename IndexType = size_t>
 class SparseSet
 {
   public:
     SparseSet() = default;
-    SparseSet(size_t initSize) : sparse(initSize, kInvalidIndex) {}
+    SparseSet(size_t initSize) { sparse.Reserve(initSize); }
+    // Both the sparse pages and the dense array are allocated from resource, which must outlive the set.
+    explicit SparseSet(std::pmr::memory_resource* resource) : sparse(kInvalidIndex, resource), dense(resource) {}
     virtual ~SparseSet() = default;
 
-    bool Contains(IndexType index) const
-    {
-        if (!IsAllocated(index))
-            return false;
-
-        return sparse[index] != kInvalidIndex;
-    }
+    bool Contains(IndexType index) const { return sparse.Get(index) != kInvalidIndex; }
 
     void Add(IndexType index, ContainedType element)
     {
-        if (index >= sparse.size())
-            sparse.resize(index + 1, kInvalidIndex);
-
-        ASSUMERT(dense.size() < sparse.size());
-        ASSUMERT(IsAllocated(index));
         ASSUMERT(!Contains(index));
 
-        sparse[index] = dense.size();
+        sparse.Set(index, static_cast<IndexType>(dense.size()));
         dense.push_back(DenseElement{.index = index, .value = std::move(element)});
     }
 
+    // Adds a copy of element for every index, growing the dense array at most once.
+    void Add(std::span<const IndexType> indexes, const ContainedType& element)
+    {
+        ReserveForAdding(indexes.size());
+        for (const IndexType index : indexes)
+        {
+            ASSUMERT(!Contains(index));
+            sparse.Set(index, static_cast<IndexType>(dense.size()));
+            dense.push_back(DenseElement{.index = index, .value = element});
+        }
+    }
+
     void Remove(IndexType index)
     {
-        ASSUMERT(IsAllocated(index));
         ASSUMERT(Contains(index));
 
+        const IndexType removedDenseIndex = sparse.Get(index);
         // Repoint the sparse pointing to the last element to
         // point to the to-be-removed element.
-        sparse[dense.back().index] = sparse[index];
+        sparse.Set(dense.back().index, removedDenseIndex);
         // Swap dense to-be-deleted element to remove with last.
-        std::swap(dense[sparse[index]], dense.back());
+        std::swap(dense[removedDenseIndex], dense.back());
         // Mark the removed item in sparse set as removed.
-        sparse[index] = kInvalidIndex;
+        sparse.Set(index, kInvalidIndex);
         // Pop the unreferenced dense element at the back.
         dense.pop_back();
     }
@@ -58,37 +155,94 @@ class SparseSet
     ContainedType& Get(IndexType index)
     {
         ASSUMERT(Contains(index));
-        return dense[sparse[index]].value;
+        return dense[sparse.Get(index)].value;
     }
 
     const ContainedType& Get(IndexType index) const
     {
         ASSUMERT(Contains(index));
-        return dense[sparse[index]].value;
+        return dense[sparse.Get(index)].value;
+    }
+
+    // Combined Contains and Get with a single sparse lookup. Returns nullptr when not contained.
+    ContainedType* TryGet(IndexType index)
+    {
+        const IndexType denseIndex = sparse.Get(index);
+        if (denseIndex == kInvalidIndex)
+            return nullptr;
+
+        return &dense[denseIndex].value;
+    }
+
+    // Adds elements[i] for indexes[i], growing the dense array at most once.
+    void Add(std::span<const IndexType> indexes, std::span<const ContainedType> elements)
+    {
+        ASSUMERT(indexes.size() == elements.size());
+        ReserveForAdding(indexes.size());
+        for (size_t i = 0; i < indexes.size(); ++i)
+        {
+            ASSUMERT(!Contains(indexes[i]));
+            sparse.Set(indexes[i], static_cast<IndexType>(dense.size()));
+            dense.push_back(DenseElement{.index = indexes[i], .value = elements[i]});
+        }
+    }
+
+    // Swaps two elements of the dense array, e.g. to keep several sets in the same order.
+    void SwapAt(size_t firstDenseIndex, size_t secondDenseIndex)
+    {
+        ASSUMERT(firstDenseIndex < dense.size() && secondDenseIndex < dense.size());
+        if (firstDenseIndex == secondDenseIndex)
+            return;
+
+        std::swap(dense[firstDenseIndex], dense[secondDenseIndex]);
+        sparse.Set(dense[firstDenseIndex].index, static_cast<IndexType>(firstDenseIndex));
+        sparse.Set(dense[secondDenseIndex].index, static_cast<IndexType>(secondDenseIndex));
+    }
+
+    // Position of index in the dense array, std::nullopt when not contained.
+    std::optional<size_t> FindDenseIndex(IndexType index) const
+    {
+        const IndexType denseIndex = sparse.Get(index);
+        if (denseIndex == kInvalidIndex)
+            return std::nullopt;
+
+        return denseIndex;
+    }
+
+    // Index stored at a position of the dense array.
+    IndexType GetIndexAt(size_t denseIndex) const
+    {
+        ASSUMERT(denseIndex < dense.size());
+        return dense[denseIndex].index;
+    }
+
+    // Element stored at a position of the dense array.
+    ContainedType& GetAt(size_t denseIndex)
+    {
+        ASSUMERT(denseIndex < dense.size());
+        return dense[denseIndex].value;
     }
 
     // Checks the validity of the whole data structure.
     // Basically just for debugging, it is not needed for production.
     bool IsValid() const
     {
-        const size_t sparsePointerCount = std::ranges::count_if(sparse, [this](IndexType index) { return index != kInvalidIndex; });
-        if (sparsePointerCount != dense.size())
+        if (sparse.GetUsedCount() != dense.size())
             return false;
 
         // Dense and sparse pointers match
-        for (IndexType i = 0; i < sparse.size(); ++i)
-        {
-            if (sparse[i] == kInvalidIndex)
-                continue;
-
-            const auto& denseElement = dense[sparse[i]];
-            if (denseElement.index != i)
+        for (size_t denseIndex = 0; denseIndex < dense.size(); ++denseIndex)
+            if (sparse.Get(dense[denseIndex].index) != denseIndex)
                 return false;
-        }
 
         return true;
     }
 
+    size_t GetSparsePageCount() const { return sparse.GetAllocatedPageCount(); }
+
+    // Reserves the dense array for count elements.
+    void Reserve(size_t count) { dense.reserve(count); }
+
     auto begin() noexcept { return dense.begin(); }
     auto cbegin() const noexcept { return dense.cbegin(); }
     auto end() noexcept { return dense.end(); }
@@ -103,12 +257,313 @@ class SparseSet
         ContainedType value;
     };
 
-    bool IsAllocated(IndexType index) const { return index >= 0 && index < sparse.size(); }
+    inline static constexpr IndexType kInvalidIndex = std::numeric_limits<IndexType>::max();
+
+    // Makes room for count more elements. Grows geometrically like push_back, an exact reserve per bulk add would make
+    // many small bulk adds quadratic.
+    void ReserveForAdding(size_t count)
+    {
+        if (dense.size() + count > dense.capacity())
+            dense.reserve(std::max(dense.size() + count, dense.capacity() * 2));
+    }
+
+    PagedArray<IndexType> sparse{kInvalidIndex};
+    std::pmr::vector<DenseElement> dense{};
+};
+
+template <typename Tied>
+struct DecayedTuple;
+
+template <typename... Fields>
+struct DecayedTuple<std::tuple<Fields...>>
+{
+    using Type = std::tuple<std::remove_cvref_t<Fields>...>;
+};
+
+// Value types of the fields tied by Tie().
+template <typename T>
+using FieldsOf = typename DecayedTuple<decltype(std::declval<const T&>().Tie())>::Type;
+
+template <typename ContainedType, bool IsConst, typename Fields = FieldsOf<ContainedType>>
+class FieldsReference;
+
+struct NoFieldAccessors
+{
+};
+
+// Base of the FieldsReference to ContainedType. ContainedType can name the fields of its references by declaring
+//     template <typename Reference>
+//     struct FieldAccessors
+//     {
+//         auto& Position() const { return static_cast<const Reference&>(*this).template Get<0>(); }
+//     };
+template <typename ContainedType, typename Reference>
+struct FieldAccessorsOf
+{
+    using Type = NoFieldAccessors;
+};
+
+template <typename ContainedType, typename Reference>
+    requires requires { typename ContainedType::template FieldAccessors<Reference>; }
+struct FieldAccessorsOf<ContainedType, Reference>
+{
+    using Type = typename ContainedType::template FieldAccessors<Reference>;
+};
+
+// Reference to an element of a SplitSparseSet, which has no element object to refer to.
+// Has the same Tie() as the element and converts from and to it. Fields are accessed by index with Get,
+// or by name if the element declares FieldAccessors, see FieldAccessorsOf.
+export template <typename ContainedType, bool IsConst, typename... Fields>
+class FieldsReference<ContainedType, IsConst, std::tuple<Fields...>>
+    : public FieldAccessorsOf<ContainedType, FieldsReference<ContainedType, IsConst, std::tuple<Fields...>>>::Type
+{
+  public:
+    using References = std::tuple<std::conditional_t<IsConst, const Fields&, Fields&>...>;
+
+    explicit FieldsReference(const References& fields) : fields(fields) {}
+
+    auto Tie() const
+    {
+        return std::apply([](const auto&... fields) { return std::tie(fields...); }, fields);
+    }
+
+    // Field at FieldIndex in Tie().
+    template <size_t FieldIndex>
+    auto& Get() const
+    {
+        return std::get<FieldIndex>(fields);
+    }
+
+    operator ContainedType() const
+    {
+        ContainedType element{};
+        const auto tied = concepts::TieMutable(element);
+        [&]<size_t... FieldIndexes>(std::index_sequence<FieldIndexes...>)
+        { ((std::get<FieldIndexes>(tied) = std::get<FieldIndexes>(fields)), ...); }(std::index_sequence_for<Fields...>{});
+        return element;
+    }
+
+    operator FieldsReference<ContainedType, true>() const
+        requires(!IsConst)
+    {
+        return FieldsReference<ContainedType, true>(fields);
+    }
+
+    // Stores all fields of element.
+    const FieldsReference& operator=(const ContainedType& element) const
+        requires(!IsConst)
+    {
+        const auto tied = element.Tie();
+        [&]<size_t... FieldIndexes>(std::index_sequence<FieldIndexes...>)
+        { ((std::get<FieldIndexes>(fields) = std::get<FieldIndexes>(tied)), ...); }(std::index_sequence_for<Fields...>{});
+        return *this;
+    }
+
+  private:
+    References fields;
+};
+
+template <typename ContainedType, typename IndexType = size_t, typename Fields = FieldsOf<ContainedType>>
+class SplitSparseSet;
+
+// Sparse set that stores each field of its elements (as tied by Tie()) in a separate column, next to a column of indexes.
+// Loops over a few fields only stream those columns, and every column is a plain array that can be loaded with SIMD.
+// Elements are accessed through FieldsReference. Same interface as SparseSet otherwise.
+export template <typename ContainedType, typename IndexType, typename... Fields>
+class SplitSparseSet<ContainedType, IndexType, std::tuple<Fields...>>
+{
+    static_assert((!std::is_same_v<Fields, bool> && ...), "std::vector<bool> can not hand out references to its elements.");
+
+  public:
+    using Reference = FieldsReference<ContainedType, false>;
+    using ConstReference = FieldsReference<ContainedType, true>;
+
+    // Bytes per element of every field column.
+    static constexpr std::array<size_t, sizeof...(Fields)> kFieldSizes{sizeof(Fields)...};
+
+    SplitSparseSet() = default;
+    SplitSparseSet(size_t initSize) { sparse.Reserve(initSize); }
+    // All columns are allocated from resource, which must outlive the set.
+    explicit SplitSparseSet(std::pmr::memory_resource* resource)
+        : sparse(kInvalidIndex, resource), indexes(resource), columns(std::pmr::vector<Fields>(resource)...)
+    {
+    }
+    virtual ~SplitSparseSet() = default;
+
+    bool Contains(IndexType index) const { return sparse.Get(index) != kInvalidIndex; }
+
+    void Add(IndexType index, ContainedType element)
+    {
+        ASSUMERT(!Contains(index));
+
+        sparse.Set(index, static_cast<IndexType>(indexes.size()));
+        indexes.push_back(index);
+        const auto tied = concepts::TieMutable(element);
+        ForEachColumn([&]<size_t FieldIndex>(auto& column) { column.push_back(std::move(std::get<FieldIndex>(tied))); });
+    }
+
+    // Adds a copy of element for every index, growing the columns at most once.
+    void Add(std::span<const IndexType> addedIndexes, const ContainedType& element)
+    {
+        ReserveForAdding(addedIndexes.size());
+        for (const IndexType index : addedIndexes)
+            Add(index, element);
+    }
+
+    // Adds elements[i] for indexes[i], growing the columns at most once.
+    void Add(std::span<const IndexType> addedIndexes, std::span<const ContainedType> elements)
+    {
+        ASSUMERT(addedIndexes.size() == elements.size());
+        ReserveForAdding(addedIndexes.size());
+        for (size_t i = 0; i < addedIndexes.size(); ++i)
+            Add(addedIndexes[i], elements[i]);
+    }
+
+    void Remove(IndexType index)
+    {
+        ASSUMERT(Contains(index));
+
+        // Move the last element into the gap, like SparseSet.
+        const IndexType removedDenseIndex = sparse.Get(index);
+        if (removedDenseIndex != indexes.size() - 1)
+        {
+            sparse.Set(indexes.back(), removedDenseIndex);
+            indexes[removedDenseIndex] = indexes.back();
+            ForEachColumn([&]<size_t>(auto& column) { column[removedDenseIndex] = std::move(column.back()); });
+        }
+        sparse.Set(index, kInvalidIndex);
+        indexes.pop_back();
+        ForEachColumn([]<size_t>(auto& column) { column.pop_back(); });
+    }
+
+    Reference Get(IndexType index)
+    {
+        ASSUMERT(Contains(index));
+        return GetAt(sparse.Get(index));
+    }
+
+    ConstReference Get(IndexType index) const
+    {
+        ASSUMERT(Contains(index));
+        return GetAt(sparse.Get(index));
+    }
 
+    // Element stored at a position of the dense columns.
+    Reference GetAt(size_t denseIndex)
+    {
+        ASSUMERT(denseIndex < indexes.size());
+        return std::apply([denseIndex](auto&... columns) { return Reference(typename Reference::References(columns[denseIndex]...)); }, columns);
+    }
+
+    ConstReference GetAt(size_t denseIndex) const
+    {
+        ASSUMERT(denseIndex < indexes.size());
+        return std::apply([denseIndex](const auto&... columns) { return ConstReference(typename ConstReference::References(columns[denseIndex]...)); },
+                          columns);
+    }
+
+    // Swaps two elements of the dense columns, e.g. to keep several sets in the same order.
+    void SwapAt(size_t firstDenseIndex, size_t secondDenseIndex)
+    {
+        ASSUMERT(firstDenseIndex < indexes.size() && secondDenseIndex < indexes.size());
+        if (firstDenseIndex == secondDenseIndex)
+            return;
+
+        std::swap(indexes[firstDenseIndex], indexes[secondDenseIndex]);
+        ForEachColumn([&]<size_t>(auto& column) { std::swap(column[firstDenseIndex], column[secondDenseIndex]); });
+        sparse.Set(indexes[firstDenseIndex], static_cast<IndexType>(firstDenseIndex));
+        sparse.Set(indexes[secondDenseIndex], static_cast<IndexType>(secondDenseIndex));
+    }
+
+    // Position of index in the dense columns, std::nullopt when not contained.
+    std::optional<size_t> FindDenseIndex(IndexType index) const
+    {
+        const IndexType denseIndex = sparse.Get(index);
+        if (denseIndex == kInvalidIndex)
+            return std::nullopt;
+
+        return denseIndex;
+    }
+
+    // Index stored at a position of the dense columns.
+    IndexType GetIndexAt(size_t denseIndex) const
+    {
+        ASSUMERT(denseIndex < indexes.size());
+        return indexes[denseIndex];
+    }
+
+    // Column of the field at FieldIndex in Tie(), parallel to GetIndexes.
+    template <size_t FieldIndex>
+    std::span<std::tuple_element_t<FieldIndex, std::tuple<Fields...>>> GetColumn()
+    {
+        return std::get<FieldIndex>(columns);
+    }
+
+    template <size_t FieldIndex>
+    std::span<const std::tuple_element_t<FieldIndex, std::tuple<Fields...>>> GetColumn() const
+    {
+        return std::get<FieldIndex>(columns);
+    }
+
+    std::span<const IndexType> GetIndexes() const { return indexes; }
+
+    // Checks the validity of the whole data structure.
+    // Basically just for debugging, it is not needed for production.
+    bool IsValid() const
+    {
+        if (sparse.GetUsedCount() != indexes.size())
+            return false;
+
+        bool columnsMatch = true;
+        ForEachColumn([&]<size_t>(const auto& column) { columnsMatch &= column.size() == indexes.size(); });
+        if (!columnsMatch)
+            return false;
+
+        for (size_t denseIndex = 0; denseIndex < indexes.size(); ++denseIndex)
+            if (sparse.Get(indexes[denseIndex]) != denseIndex)
+                return false;
+
+        return true;
+    }
+
+    size_t GetSparsePageCount() const { return sparse.GetAllocatedPageCount(); }
+
+    // Reserves the dense columns for count elements.
+    void Reserve(size_t count)
+    {
+        indexes.reserve(count);
+        ForEachColumn([count]<size_t>(auto& column) { column.reserve(count); });
+    }
+
+    auto size() const noexcept { return indexes.size(); }
+    auto empty() const noexcept { return indexes.empty(); }
+
+  private:
     inline static constexpr IndexType kInvalidIndex = std::numeric_limits<IndexType>::max();
 
-    std::vector<IndexType> sparse{};
-    std::vector<DenseElement> dense{};
+    // Makes room for count more elements, growing geometrically like SparseSet.
+    void ReserveForAdding(size_t count)
+    {
+        if (indexes.size() + count > indexes.capacity())
+            Reserve(std::max(indexes.size() + count, indexes.capacity() * 2));
+    }
+
+    // Calls func.template operator()<FieldIndex>(column) for every column.
+    void ForEachColumn(const auto& func)
+    {
+        [&]<size_t... FieldIndexes>(std::index_sequence<FieldIndexes...>)
+        { (func.template operator()<FieldIndexes>(std::get<FieldIndexes>(columns)), ...); }(std::index_sequence_for<Fields...>{});
+    }
+
+    void ForEachColumn(const auto& func) const
+    {
+        [&]<size_t... FieldIndexes>(std::index_sequence<FieldIndexes...>)
+        { (func.template operator()<FieldIndexes>(std::get<FieldIndexes>(columns)), ...); }(std::index_sequence_for<Fields...>{});
+    }
+
+    PagedArray<IndexType> sparse{kInvalidIndex};
+    std::pmr::vector<IndexType> indexes{};
+    std::tuple<std::pmr::vector<Fields>...> columns{};
 };
 
 }  // namespace tektonik
@@ -0,0 +1,266 @@
+module;
+#include "common-defines.hpp"
+export module spatial;
+
+import glm;
+import sparse_set;
+import ecs;
+import components;
+import std;
+
+// Broad-phase spatial indexes over the bounds of entities, kept up to date incrementally.
+export namespace tektonik::spatial
+{
+
+using ecs::Entity;
+
+struct Aabb
+{
+    glm::vec2 min{};
+    glm::vec2 max{};
+
+    bool Overlaps(const Aabb& other) const { return min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y && other.min.y <= max.y; }
+    bool Contains(const Aabb& other) const { return min.x <= other.min.x && min.y <= other.min.y && other.max.x <= max.x && other.max.y <= max.y; }
+};
+
+Aabb Union(const Aabb& first, const Aabb& second);
+Aabb Fatten(const Aabb& aabb, float margin);
+float GetPerimeter(const Aabb& aabb);
+float GetDistanceSquared(const Aabb& aabb, glm::vec2 point);
+
+// Bounds of a rotated and scaled box centered at the position, size is the full extent.
+Aabb GetBounds(const components::Transform2D& transform, const components::Box2D& box);
+// Bounds of a circle, scaled by the larger scale axis.
+Aabb GetBounds(const components::Transform2D& transform, const components::Circle2D& circle);
+
+// Points origin + t * direction for t in [0, maxDistance]. Distances are in units of direction, so use a unit direction for world distances.
+struct Ray
+{
+    glm::vec2 origin{};
+    glm::vec2 direction{1.0f, 0.0f};
+    float maxDistance = std::numeric_limits<float>::infinity();
+};
+
+// Smallest t at which the ray is inside the aabb, if within [0, maxDistance].
+std::optional<float> Intersect(const Ray& ray, const Aabb& aabb, float maxDistance);
+
+struct Hit
+{
+    Entity entity = 0;
+    float distance = 0;
+};
+
+// Queries are const and may run concurrently, updates must not run concurrently with anything else.
+class SpatialIndex
+{
+  public:
+    virtual ~SpatialIndex() = default;
+
+    // Inserts the entity or moves it to the new bounds.
+    virtual void Update(Entity entity, const Aabb& aabb) = 0;
+    virtual void Remove(Entity entity) = 0;
+    virtual bool Contains(Entity entity) const = 0;
+    virtual size_t GetCount() const = 0;
+    // Appends every entity in the index.
+    virtual void GetEntities(std::vector<Entity>& results) const = 0;
+
+    // Appends the entities whose bounds overlap the region.
+    virtual void QueryRegion(const Aabb& region, std::vector<Entity>& results) const = 0;
+    // Entity whose bounds are closest to the point, distance 0 when the point is inside.
+    virtual std::optional<Hit> QueryNearest(glm::vec2 point, float maxDistance) const = 0;
+    // First entity whose bounds the ray enters.
+    virtual std::optional<Hit> RayCast(const Ray& ray) const = 0;
+    // Replaces the content of pairs with every pair of entities with overlapping bounds, smaller entity first.
+    virtual void GeneratePairs(std::vector<std::pair<Entity, Entity>>& pairs) const = 0;
+};
+
+// Uniform grid of square cells stored in a hash map, so the world needs no bounds.
+// Best when objects are of similar size, about the cell size. Objects are stored in every cell they overlap,
+// moving within the same cells only rewrites their bounds.
+class HashGrid final : public SpatialIndex
+{
+  public:
+    explicit HashGrid(float cellSize);
+
+    void Update(Entity entity, const Aabb& aabb) override;
+    void Remove(Entity entity) override;
+    bool Contains(Entity entity) const override { return proxies.Contains(entity); }
+    size_t GetCount() const override { return proxies.size(); }
+    void GetEntities(std::vector<Entity>& results) const override;
+    // Count of cells holding at least one entity, empty cells are released.
+    size_t GetCellCount() const { return cells.size(); }
+
+    void QueryRegion(const Aabb& region, std::vector<Entity>& results) const override;
+    std::optional<Hit> QueryNearest(glm::vec2 point, float maxDistance) const override;
+    std::optional<Hit> RayCast(const Ray& ray) const override;
+    void GeneratePairs(std::vector<std::pair<Entity, Entity>>& pairs) const override;
+
+  private:
+    struct Cell
+    {
+        std::int32_t x = 0;
+        std::int32_t y = 0;
+
+        bool operator==(const Cell&) const = default;
+    };
+
+    struct CellRange
+    {
+        Cell min{};
+        Cell max{};
+
+        bool operator==(const CellRange&) const = default;
+    };
+
+    // Copy of the bounds in every cell, so queries do not look up the entity.
+    struct CellEntry
+    {
+        Aabb aabb{};
+        Entity entity = 0;
+    };
+
+    Cell GetCell(glm::vec2 point) const;
+    CellRange GetCellRange(const Aabb& aabb) const;
+    static std::uint64_t GetKey(Cell cell);
+    const std::vector<CellEntry>* FindCell(Cell cell) const;
+    void Insert(Entity entity, const Aabb& aabb, const CellRange& range);
+    void Erase(Entity entity, const CellRange& range);
+    // Counts a cell that became occupied or empty in occupiedColumns and occupiedRows.
+    void CountCell(Cell cell, bool occupiedNow);
+    void UpdateOccupied();
+
+    // Empty range, min is above max.
+    static constexpr CellRange kNoCells{.min = {std::numeric_limits<std::int32_t>::max(), std::numeric_limits<std::int32_t>::max()},
+                                        .max = {std::numeric_limits<std::int32_t>::min(), std::numeric_limits<std::int32_t>::min()}};
+
+    float cellSize;
+    float inverseCellSize;
+    // Only cells with entries, emptied cells are erased.
+    std::unordered_map<std::uint64_t, std::vector<CellEntry>> cells{};
+    // Cells an entity occupies.
+    SparseSet<CellRange, Entity> proxies{};
+    // Count of cells in every occupied column and row, so occupied can shrink when border cells are emptied.
+    std::map<std::int32_t, std::uint32_t> occupiedColumns{};
+    std::map<std::int32_t, std::uint32_t> occupiedRows{};
+    // Bounds of the cells, limits the nearest neighbour and ray searches.
+    CellRange occupied = kNoCells;
+};
+
+// Dynamic bounding volume tree balanced by rotations, like Box2D's b2DynamicTree.
+// Works for objects of any size and sparse worlds. Leaves store bounds enlarged by margin,
+// objects moving within them do not change the tree.
+class AabbTree final : public SpatialIndex
+{
+  public:
+    explicit AabbTree(float margin);
+
+    void Update(Entity entity, const Aabb& aabb) override;
+    void Remove(Entity entity) override;
+    bool Contains(Entity entity) const override { return proxies.Contains(entity); }
+    size_t GetCount() const override { return proxies.size(); }
+    void GetEntities(std::vector<Entity>& results) const override;
+
+    void QueryRegion(const Aabb& region, std::vector<Entity>& results) const override;
+    std::optional<Hit> QueryNearest(glm::vec2 point, float maxDistance) const override;
+    std::optional<Hit> RayCast(const Ray& ray) const override;
+    void GeneratePairs(std::vector<std::pair<Entity, Entity>>& pairs) const override;
+
+    // Height of the root, 0 for a single leaf.
+    std::int32_t GetHeight() const;
+    // Checks the links, heights and bounds of every node.
+    bool IsValid() const;
+
+  private:
+    static constexpr std::int32_t kNullNode = -1;
+
+    struct Node
+    {
+        // Enlarged by the margin for leaves.
+        Aabb fatAabb{};
+        // Exact bounds of a leaf.
+        Aabb aabb{};
+        // Next free node when the node is free.
+        std::int32_t parent = kNullNode;
+        std::int32_t left = kNullNode;
+        std::int32_t right = kNullNode;
+        // 0 for leaves, -1 for free nodes.
+        std::int32_t height = 0;
+        Entity entity = 0;
+
+        bool IsLeaf() const { return left == kNullNode; }
+    };
+
+    std::int32_t AllocateNode();
+    void FreeNode(std::int32_t node);
+    void InsertLeaf(std::int32_t leaf);
+    void RemoveLeaf(std::int32_t leaf);
+    void ReplaceChild(std::int32_t parent, std::int32_t oldChild, std::int32_t newChild);
+    // Refits and rebalances the ancestors starting at node.
+    void FixUpwards(std::int32_t node);
+    std::int32_t Balance(std::int32_t node);
+    void QueryLeaves(const Aabb& region, auto&& func) const;
+
+    float margin;
+    std::vector<Node> nodes{};
+    std::int32_t root = kNullNode;
+    std::int32_t freeList = kNullNode;
+    // Leaf node of every entity.
+    SparseSet<std::int32_t, Entity> proxies{};
+};
+
+// Bounds of an entity with a Transform2D and a Box2D or Circle2D, the box wins when it has both like collision::GetShape.
+template <typename ComponentManagerType>
+std::optional<Aabb> GetBounds(const ComponentManagerType& componentManager, Entity entity)
+{
+    constexpr size_t kTransformIndex = ComponentManagerType::template kTypeIndex<components::Transform2D>;
+    constexpr size_t kBoxIndex = ComponentManagerType::template kTypeIndex<components::Box2D>;
+    constexpr size_t kCircleIndex = ComponentManagerType::template kTypeIndex<components::Circle2D>;
+    constexpr size_t kTypeCount = ComponentManagerType::kComponentTypeCount;
+
+    const auto signature = componentManager.GetSignature(entity);
+    if constexpr (kTransformIndex < kTypeCount)
+    {
+        if (!signature[kTransformIndex])
+            return std::nullopt;
+        const components::Transform2D& transform = componentManager.template GetComponent<components::Transform2D>(entity);
+
+        if constexpr (kBoxIndex < kTypeCount)
+            if (signature[kBoxIndex])
+                return GetBounds(transform, componentManager.template GetComponent<components::Box2D>(entity));
+        if constexpr (kCircleIndex < kTypeCount)
+            if (signature[kCircleIndex])
+                return GetBounds(transform, componentManager.template GetComponent<components::Circle2D>(entity));
+    }
+    return std::nullopt;
+}
+
+// Brings the index up to date with entities that have a Transform2D and a Box2D or Circle2D,
+// visiting only those whose components were added or mutably accessed after lastUpdateTick, like ecs::Changed.
+// Entities that lose their shape or are destroyed are removed by RemoveStale.
+template <typename ComponentManagerType>
+void UpdateIndex(SpatialIndex& index, ComponentManagerType& componentManager, ecs::Tick lastUpdateTick)
+{
+    const auto update = [&]<typename ShapeType>()
+    {
+        // Bounds come from GetBounds, so an entity with both shapes gets the box bounds from either pass.
+        const auto updateEntity = [&](Entity entity, const components::Transform2D&, const ShapeType&)
+        { index.Update(entity, *GetBounds(std::as_const(componentManager), entity)); };
+        componentManager.template Each<const components::Transform2D, const ShapeType>(updateEntity, ecs::Changed<components::Transform2D>{lastUpdateTick});
+        componentManager.template Each<const components::Transform2D, const ShapeType>(updateEntity, ecs::Changed<ShapeType>{lastUpdateTick});
+    };
+    update.template operator()<components::Box2D>();
+    update.template operator()<components::Circle2D>();
+}
+
+// Removes the entities that were destroyed or lost their Transform2D or shape, visits every entity in the index.
+template <typename ComponentManagerType>
+void RemoveStale(SpatialIndex& index, const ComponentManagerType& componentManager)
+{
+    std::vector<Entity> entities{};
+    index.GetEntities(entities);
+    for (Entity entity : entities)
+        if (!GetBounds(componentManager, entity))
+            index.Remove(entity);
+}
+
+}  // namespace tektonik::spatial
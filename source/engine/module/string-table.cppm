@@ -0,0 +1,97 @@
+module;
+#include "common-defines.hpp"
+export module string_table;
+
+import std;
+
+export namespace tektonik
+{
+
+// Handle of a string interned in the StringTable singleton. Equal strings have equal handles,
+// so copying, comparing and hashing only touch 32 bits. The default value is the empty string.
+class InternedString
+{
+  public:
+    InternedString() = default;
+    // Interns the string, see StringTable::Intern.
+    explicit InternedString(std::string_view string);
+
+    // The interned characters, valid as long as the StringTable.
+    std::string_view View() const;
+    std::uint32_t GetHandle() const { return handle; }
+
+    bool operator==(const InternedString&) const = default;
+
+  private:
+    friend class StringTable;
+
+    std::uint32_t handle = 0;
+};
+
+// Append-only table of unique strings. Resolving handles and finding strings that are already interned
+// do not lock, interning a new string does. Strings are never removed and their characters never move.
+class StringTable
+{
+  public:
+    StringTable();
+    ~StringTable();
+
+    StringTable(const StringTable&) = delete;
+    StringTable& operator=(const StringTable&) = delete;
+
+    InternedString Intern(std::string_view string);
+    // Handle of a string that is already interned.
+    std::optional<InternedString> Find(std::string_view string) const;
+    std::string_view Resolve(InternedString string) const;
+
+    // Count of interned strings, including the empty string.
+    std::size_t GetCount() const { return count.load(std::memory_order_acquire); }
+
+  private:
+    // Entries are stored in chunks that double in size, so they never move. Chunk k holds kFirstChunkSize << k entries.
+    static constexpr std::size_t kFirstChunkBits = 8;
+    static constexpr std::size_t kFirstChunkSize = std::size_t{1} << kFirstChunkBits;
+    static constexpr std::size_t kChunkCount = 33 - kFirstChunkBits;
+    // Slots keep the upper half of the hash next to the handle, so probing rarely compares strings.
+    static constexpr std::uint64_t kSlotHashMask = 0xFFFF'FFFF'0000'0000;
+
+    // Open addressing hash set of handles. A slot holds the upper hash bits and handle + 1, 0 when empty.
+    struct Slots
+    {
+        explicit Slots(std::size_t capacity) : values(capacity) {}
+
+        std::vector<std::atomic<std::uint64_t>> values;
+    };
+
+    const std::string_view& GetEntry(std::uint32_t handle) const;
+    std::string_view& AddEntry(std::uint32_t handle);
+    static void Insert(Slots& slots, std::uint64_t hash, std::uint32_t handle);
+    void Grow();
+
+    std::array<std::atomic<std::string_view*>, kChunkCount> chunks{};
+    std::atomic<std::uint32_t> count{0};
+    std::atomic<const Slots*> slots{nullptr};
+    // Written under the mutex only.
+    std::mutex mutex{};
+    // The current slots and the replaced ones, readers may still be probing those.
+    std::vector<std::unique_ptr<Slots>> ownedSlots{};
+    std::pmr::monotonic_buffer_resource characters{};
+};
+
+}  // namespace tektonik
+
+template <>
+struct std::hash<tektonik::InternedString>
+{
+    std::size_t operator()(const tektonik::InternedString& string) const noexcept { return std::hash<std::uint32_t>{}(string.GetHandle()); }
+};
+
+// Formats the characters, so Tie() based printing shows the string.
+template <>
+struct std::formatter<tektonik::InternedString> : std::formatter<std::string_view>
+{
+    auto format(const tektonik::InternedString& string, std::format_context& context) const
+    {
+        return std::formatter<std::string_view>::format(string.View(), context);
+    }
+};
@@ -0,0 +1,78 @@
+module;
+#include "common-defines.hpp"
+export module transform;
+
+import glm;
+import components;
+import std;
+
+// Batch kernels over the columns of components::Transform2D, see ComponentManager::GetFieldColumn.
+// Every kernel has SSE4.2 and AVX2 paths selected at runtime and a scalar fallback. All paths use the same operations
+// in the same order, including the sine and cosine approximation, so their results are the same up to the last bit.
+export namespace tektonik::transform
+{
+
+enum class InstructionSet
+{
+    Scalar,
+    Sse42,
+    Avx2,
+};
+
+// Best instruction set supported by the CPU.
+InstructionSet GetSupportedInstructionSet();
+InstructionSet GetInstructionSet();
+// Overrides the runtime selection, e.g. to compare the paths. Must be supported by the CPU.
+void SetInstructionSet(InstructionSet instructionSet);
+
+// Sine and cosine as computed by the kernels. Accurate to a few ulp for angles up to about 8000 radians.
+std::pair<float, float> SinCos(float angle);
+// Same for every angle, the spans have the same size.
+void SinCos(std::span<const float> angles, std::span<float> sines, std::span<float> cosines);
+
+// Columns of transforms, all spans have the same size.
+struct TransformColumns
+{
+    std::span<glm::vec2> positions;
+    std::span<float> rotations;
+    std::span<glm::vec2> scales;
+};
+
+struct ConstTransformColumns
+{
+    ConstTransformColumns(std::span<const glm::vec2> positions, std::span<const float> rotations, std::span<const glm::vec2> scales)
+        : positions(positions), rotations(rotations), scales(scales)
+    {
+    }
+    ConstTransformColumns(const TransformColumns& columns) : ConstTransformColumns(columns.positions, columns.rotations, columns.scales) {}
+
+    std::span<const glm::vec2> positions;
+    std::span<const float> rotations;
+    std::span<const glm::vec2> scales;
+};
+
+// Columns of every Transform2D in a ComponentManager, parallel to its GetEntityColumn<components::Transform2D>().
+template <typename ComponentManagerType>
+TransformColumns GetTransformColumns(ComponentManagerType& componentManager)
+{
+    return TransformColumns{
+        .positions = componentManager.template GetFieldColumn<components::Transform2D, 0>(),
+        .rotations = componentManager.template GetFieldColumn<components::Transform2D, 1>(),
+        .scales = componentManager.template GetFieldColumn<components::Transform2D, 2>(),
+    };
+}
+
+// values[i] += rates[i] * deltaTime, e.g. positions and velocities, rotations and angular velocities or scales and their rates.
+void Integrate(std::span<glm::vec2> values, std::span<const glm::vec2> rates, float deltaTime);
+void Integrate(std::span<float> values, std::span<const float> rates, float deltaTime);
+
+// Applies parents[i] to locals[i]: the local position is scaled, rotated and translated by the parent,
+// rotations are added and scales multiplied. Matches the matrix product when the parent scale is uniform.
+// results may be the same columns as parents or locals.
+void Compose(const ConstTransformColumns& parents, const ConstTransformColumns& locals, const TransformColumns& results);
+
+// Column major translation * rotation * scale matrices, 3x3 for 2D or 4x4 with z = 0.
+void ToMatrices(const ConstTransformColumns& transforms, std::span<glm::mat3> matrices);
+void ToMatrices(const ConstTransformColumns& transforms, std::span<glm::mat4> matrices);
+
+}  // namespace tektonik::transform
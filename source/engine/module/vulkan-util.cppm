@@ -58,6 +58,34 @@ export bool AreDeviceExtensionsSupported(
     return unavailables.empty();
 }
 
+export std::uint32_t FindMemoryType(const vk::raii::PhysicalDevice& physicalDevice, std::uint32_t typeBits, vk::MemoryPropertyFlags properties)
+{
+    const vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+    for (std::uint32_t index = 0; index < memoryProperties.memoryTypeCount; ++index)
+        if ((typeBits & (1u << index)) && (memoryProperties.memoryTypes[index].propertyFlags & properties) == properties)
+            return index;
+
+    throw std::runtime_error("There is no suitable Vulkan memory type.");
+}
+
+export std::vector<vk::raii::Semaphore> CreateSemaphores(const vk::raii::Device& device, std::size_t count)
+{
+    std::vector<vk::raii::Semaphore> semaphores;
+    semaphores.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+        semaphores.push_back(device.createSemaphore(vk::SemaphoreCreateInfo{}));
+    return semaphores;
+}
+
+export std::vector<vk::raii::Fence> CreateFences(const vk::raii::Device& device, std::size_t count, bool signaled = false)
+{
+    std::vector<vk::raii::Fence> fences;
+    fences.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+        fences.push_back(device.createFence(vk::FenceCreateInfo{.flags = signaled ? vk::FenceCreateFlagBits::eSignaled : vk::FenceCreateFlags{}}));
+    return fences;
+}
+
 export class RaiiWindowWrapper
 {
   public:
@@ -95,7 +123,7 @@ export class RaiiWindowWrapper
     SDL_Window* operator*() { return window; }
 
   private:
-    SDL_Window* window;
+    SDL_Window* window = nullptr;
 };
 
 /// Vulkan KHR surface wrapper with SDL constructor and destructor.
@@ -0,0 +1,27 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Shades all materials of renderer::Material, chosen by a specialization constant.
+
+layout(constant_id = 0) const uint kMaterial = 0;
+const uint kMaterialCircle = 1;
+const uint kMaterialSprite = 2;
+
+// Must match renderer::kMaxTextures.
+layout(set = 0, binding = 0) uniform sampler2D textures[1024];
+
+layout(location = 0) in vec2 inUv;
+layout(location = 1) in vec4 inColor;
+layout(location = 2) flat in uint inTextureSlot;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    if (kMaterial == kMaterialCircle && length(inUv - 0.5) > 0.5)
+        discard;
+
+    outColor = inColor;
+    if (kMaterial == kMaterialSprite)
+        outColor *= texture(textures[nonuniformEXT(inTextureSlot)], inUv);
+}
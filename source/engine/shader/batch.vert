@@ -0,0 +1,37 @@
+#version 450
+
+// Instanced quads of renderer::InstanceBatch, see renderer::Instance.
+
+layout(location = 0) in vec2 instancePosition;
+layout(location = 1) in vec2 instanceSize;
+layout(location = 2) in float instanceRotation;
+layout(location = 3) in uint instanceTextureSlot;
+layout(location = 4) in vec4 instanceColor;
+
+// Maps world units to clip space.
+layout(push_constant) uniform View
+{
+    vec2 scale;
+    vec2 offset;
+} view;
+
+layout(location = 0) out vec2 outUv;
+layout(location = 1) out vec4 outColor;
+layout(location = 2) flat out uint outTextureSlot;
+
+// Two triangles of a unit quad, so no vertex buffer is needed.
+const vec2 kCorners[6] = vec2[](vec2(-0.5, -0.5), vec2(0.5, -0.5), vec2(0.5, 0.5), vec2(-0.5, -0.5), vec2(0.5, 0.5), vec2(-0.5, 0.5));
+
+void main()
+{
+    const vec2 corner = kCorners[gl_VertexIndex];
+    const vec2 local = corner * instanceSize;
+    const float c = cos(instanceRotation);
+    const float s = sin(instanceRotation);
+    const vec2 world = instancePosition + vec2(c * local.x - s * local.y, s * local.x + c * local.y);
+
+    gl_Position = vec4(world * view.scale + view.offset, 0.0, 1.0);
+    outUv = vec2(corner.x + 0.5, 0.5 - corner.y);
+    outColor = instanceColor;
+    outTextureSlot = instanceTextureSlot;
+}
@@ -6,6 +6,7 @@ int main(int argc, char* argv[])
 {
     tektonik::Runtime runtime = tektonik::Runtime(tektonik::Runtime::RunOptions{.argc = argc, .argv = argv});
     runtime.Test();
+    runtime.Benchmark();
     runtime.Init();
 
     std::cout << "### END OF MAIN ###" << std::endl;